@@ -60,6 +60,7 @@ buildfile 'src/unittest-cpp/unittest-cpp.forge';
 
 toolset:all {
     'src/forge/forge/all';
+    'src/forge/forge_benchmark/all';
     'src/forge/forge_hooks/all';
     'src/forge/forge_test/all';
 };
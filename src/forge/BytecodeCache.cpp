@@ -0,0 +1,189 @@
+//
+// BytecodeCache.cpp
+// Copyright (c) Charles Baker. All rights reserved.
+//
+
+#include "BytecodeCache.hpp"
+#include "Forge.hpp"
+#include "System.hpp"
+#include <assert/assert.hpp>
+#include <lua.hpp>
+#include <fstream>
+#include <sstream>
+#include <stdint.h>
+#include <stdio.h>
+
+using std::string;
+using std::filesystem::path;
+using namespace sweet;
+using namespace sweet::forge;
+
+/**
+// Constructor.
+//
+// @param forge
+//  The Forge that this BytecodeCache is part of.
+*/
+BytecodeCache::BytecodeCache( Forge* forge )
+: forge_( forge )
+, directory_()
+{
+    SWEET_ASSERT( forge_ );
+}
+
+/**
+// Set the directory that bytecode is cached in.
+//
+// @param directory
+//  The directory to cache bytecode in (relative paths are considered
+//  relative to the current working directory) or empty to disable caching
+//  and always load chunks from source.
+*/
+void BytecodeCache::set_directory( const std::filesystem::path& directory )
+{
+    directory_ = directory.empty() ? path() : forge_->absolute( directory );
+}
+
+/**
+// Get the directory that bytecode is cached in.
+//
+// @return
+//  The directory or an empty path if caching is disabled.
+*/
+const std::filesystem::path& BytecodeCache::directory() const
+{
+    return directory_;
+}
+
+/**
+// Load a Lua chunk from \e filename as a function on top of the stack.
+//
+// Loads from previously cached bytecode when the cached bytecode was compiled
+// from a file with the same path, last write time, and size by the same
+// release of Lua.  Otherwise the chunk is compiled from source, as with
+// `luaL_loadfile()`, and its bytecode is written to the cache to be loaded
+// next time.  Failing to read or write cached bytecode silently falls back to
+// loading from source.
+//
+// @param lua_state
+//  The lua_State to load the chunk into.
+//
+// @param filename
+//  The name of the file to load the chunk from.
+//
+// @return
+//  The result of loading the chunk as returned by `luaL_loadfile()`.
+*/
+int BytecodeCache::load( lua_State* lua_state, const char* filename )
+{
+    SWEET_ASSERT( lua_state );
+    SWEET_ASSERT( filename );
+
+    if ( directory_.empty() )
+    {
+        return luaL_loadfile( lua_state, filename );
+    }
+
+    std::error_code error;
+    std::filesystem::file_time_type last_write_time = std::filesystem::last_write_time( filename, error );
+    uintmax_t size = !error ? std::filesystem::file_size( filename, error ) : 0;
+    if ( error )
+    {
+        return luaL_loadfile( lua_state, filename );
+    }
+
+    path cache_filename = bytecode_filename( filename );
+    string expected_header = header( filename, last_write_time, size );
+    std::ifstream cache_file( cache_filename, std::ios::binary );
+    if ( cache_file.is_open() )
+    {
+        std::ostringstream stream;
+        stream << cache_file.rdbuf();
+        const string& bytecode = stream.str();
+        if ( bytecode.compare(0, expected_header.size(), expected_header) == 0 )
+        {
+            string chunkname = string( "@" ) + filename;
+            const char* chunk = bytecode.c_str() + expected_header.size();
+            size_t chunk_size = bytecode.size() - expected_header.size();
+            if ( luaL_loadbufferx(lua_state, chunk, chunk_size, chunkname.c_str(), "b") == LUA_OK )
+            {
+                return LUA_OK;
+            }
+            lua_pop( lua_state, 1 );
+        }
+    }
+
+    int result = luaL_loadfile( lua_state, filename );
+    if ( result == LUA_OK )
+    {
+        string bytecode = expected_header;
+        if ( lua_dump(lua_state, &BytecodeCache::write_bytecode, &bytecode, 0) == 0 )
+        {
+            // Write to a temporary file, unique to this process, and rename
+            // over the cached bytecode so that concurrent builds never see,
+            // or write over, partially written files.
+            path temporary_filename = forge_->system()->temporary_filename( cache_filename.string() );
+            std::filesystem::create_directories( directory_, error );
+            std::ofstream file( temporary_filename, std::ios::binary | std::ios::trunc );
+            if ( file.is_open() && file.write(bytecode.c_str(), bytecode.size()) )
+            {
+                file.close();
+                std::filesystem::rename( temporary_filename, cache_filename, error );
+            }
+            if ( error || !file )
+            {
+                std::filesystem::remove( temporary_filename, error );
+            }
+        }
+    }
+    return result;
+}
+
+/**
+// Generate the header that identifies the source that cached bytecode was
+// compiled from.
+*/
+std::string BytecodeCache::header( const char* filename, const std::filesystem::file_time_type& last_write_time, uintmax_t size ) const
+{
+    SWEET_ASSERT( filename );
+    std::ostringstream header;
+    header
+        << "forge bytecode\n"
+        << LUA_RELEASE << "\n"
+        << filename << "\n"
+        << static_cast<long long>( last_write_time.time_since_epoch().count() ) << "\n"
+        << static_cast<unsigned long long>( size ) << "\n"
+    ;
+    return header.str();
+}
+
+/**
+// Get the name of the file that bytecode compiled from \e filename is
+// cached in.
+//
+// The name is the FNV-1a hash of the source file's path so that it is
+// stable between runs.  Collisions are harmless as the path is also checked
+// in the header of the cached bytecode.
+*/
+std::filesystem::path BytecodeCache::bytecode_filename( const char* filename ) const
+{
+    SWEET_ASSERT( filename );
+    const uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325;
+    const uint64_t FNV_PRIME = 0x100000001b3;
+    uint64_t hash = FNV_OFFSET_BASIS;
+    for ( const char* character = filename; *character; ++character )
+    {
+        hash = (hash ^ static_cast<unsigned char>(*character)) * FNV_PRIME;
+    }
+    char leaf [32];
+    snprintf( leaf, sizeof(leaf), "%016llx.luac", static_cast<unsigned long long>(hash) );
+    return directory_ / leaf;
+}
+
+int BytecodeCache::write_bytecode( lua_State* /*lua_state*/, const void* data, size_t size, void* context )
+{
+    SWEET_ASSERT( context );
+    string* bytecode = reinterpret_cast<string*>( context );
+    bytecode->append( reinterpret_cast<const char*>(data), size );
+    return 0;
+}
@@ -0,0 +1,42 @@
+#ifndef FORGE_BYTECODECACHE_HPP_INCLUDED
+#define FORGE_BYTECODECACHE_HPP_INCLUDED
+
+#include <filesystem>
+#include <string>
+
+struct lua_State;
+
+namespace sweet
+{
+
+namespace forge
+{
+
+class Forge;
+
+/**
+// Cache compiled Lua chunks on disk so that unchanged buildfiles and modules
+// are loaded from bytecode rather than parsed from source.
+*/
+class BytecodeCache
+{
+    Forge* forge_; ///< The Forge that this BytecodeCache is part of.
+    std::filesystem::path directory_; ///< The directory to store bytecode in or empty to disable caching.
+
+public:
+    BytecodeCache( Forge* forge );
+    void set_directory( const std::filesystem::path& directory );
+    const std::filesystem::path& directory() const;
+    int load( lua_State* lua_state, const char* filename );
+
+private:
+    std::string header( const char* filename, const std::filesystem::file_time_type& last_write_time, uintmax_t size ) const;
+    std::filesystem::path bytecode_filename( const char* filename ) const;
+    static int write_bytecode( lua_State* lua_state, const void* data, size_t size, void* context );
+};
+
+}
+
+}
+
+#endif
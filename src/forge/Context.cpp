@@ -154,6 +154,30 @@ std::filesystem::path Context::relative( const std::filesystem::path& path ) con
     return sweet::forge::relative( path, directory() );        
 }
 
+/**
+// Reset this Context so that it can be reused to run another script.
+//
+// Closes the Lua coroutine, discarding its stack and any error status left
+// by the script that last ran on it, and clears the working directory, job,
+// and other state left over from that script.
+*/
+void Context::reset()
+{
+    SWEET_ASSERT( lua_state_ );
+#if LUA_VERSION_NUM >= 504 && LUA_VERSION_RELEASE_NUM >= 50406
+    lua_closethread( lua_state_, nullptr );
+#else
+    lua_resetthread( lua_state_ );
+#endif
+    current_buildfile_ = nullptr;
+    working_directory_ = nullptr;
+    directories_.clear();
+    job_ = nullptr;
+    exit_code_ = 0;
+    buildfile_calling_context_ = nullptr;
+    prune_ = false;
+}
+
 /**
 // Reset the working directory stack to contain only the directory represented
 // by the Target \e directory.
@@ -47,6 +47,7 @@ class Context
         std::filesystem::path absolute( const std::filesystem::path& path ) const;
         std::filesystem::path relative( const std::filesystem::path& path ) const;
 
+        void reset();
         void reset_directory_to_target( Target* directory );
         void reset_directory( const std::filesystem::path& directory );
         void change_directory( const std::filesystem::path& directory );
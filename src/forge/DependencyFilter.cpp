@@ -0,0 +1,134 @@
+//
+// DependencyFilter.cpp
+// Copyright (c) Charles Baker. All rights reserved.
+//
+
+#include "DependencyFilter.hpp"
+#include "Target.hpp"
+#include <assert/assert.hpp>
+#include <algorithm>
+
+using std::vector;
+using namespace sweet;
+using namespace sweet::forge;
+
+/**
+// Constructor.
+//
+// The default filter follows explicit dependencies and yields, but doesn't
+// recurse into, every dependency.
+*/
+DependencyFilter::DependencyFilter()
+: kinds_( KIND_EXPLICIT )
+, rules_()
+, filename_( false )
+, recurse_yielded_( false )
+, recurse_unyielded_( false )
+, recurse_unruled_( false )
+{
+}
+
+/**
+// Set the kinds of dependency followed.
+//
+// @param kinds
+//  The bitwise or of the DependencyFilter::Kind values to follow.
+*/
+void DependencyFilter::set_kinds( int kinds )
+{
+    kinds_ = kinds & KIND_ALL;
+}
+
+/**
+// Get the kinds of dependency followed.
+*/
+int DependencyFilter::kinds() const
+{
+    return kinds_;
+}
+
+/**
+// Yield Targets with \e rule.
+*/
+void DependencyFilter::add_rule( Rule* rule )
+{
+    SWEET_ASSERT( rule );
+    vector<Rule*>::iterator i = std::lower_bound( rules_.begin(), rules_.end(), rule );
+    if ( i == rules_.end() || *i != rule )
+    {
+        rules_.insert( i, rule );
+    }
+}
+
+/**
+// Set whether or not yielded Targets must have a filename.
+*/
+void DependencyFilter::set_filename( bool filename )
+{
+    filename_ = filename;
+}
+
+/**
+// Set which Targets are recursed into.
+//
+// @param yielded
+//  True to recurse into yielded Targets.
+//
+// @param unyielded
+//  True to recurse into Targets that aren't yielded.
+//
+// @param unruled
+//  True to recurse into Targets without a Rule whether or not they're
+//  yielded.
+*/
+void DependencyFilter::set_recurse( bool yielded, bool unyielded, bool unruled )
+{
+    recurse_yielded_ = yielded;
+    recurse_unyielded_ = unyielded;
+    recurse_unruled_ = unruled;
+}
+
+/**
+// Is \e target yielded by this filter?
+*/
+bool DependencyFilter::yields( Target* target ) const
+{
+    SWEET_ASSERT( target );
+    if ( !rules_.empty() && !std::binary_search(rules_.begin(), rules_.end(), target->rule()) )
+    {
+        return false;
+    }
+    if ( filename_ )
+    {
+        const vector<std::string>& filenames = target->filenames();
+        return !filenames.empty() && !filenames.front().empty();
+    }
+    return true;
+}
+
+/**
+// Is \e target recursed into by this filter?
+//
+// @param yielded
+//  The value returned by DependencyFilter::yields() for \e target.
+*/
+bool DependencyFilter::recurses( Target* target, bool yielded ) const
+{
+    SWEET_ASSERT( target );
+    return
+        (yielded ? recurse_yielded_ : recurse_unyielded_) ||
+        (recurse_unruled_ && !target->rule())
+    ;
+}
+
+bool DependencyFilter::operator==( const DependencyFilter& filter ) const
+{
+    return
+        kinds_ == filter.kinds_ &&
+        rules_ == filter.rules_ &&
+        filename_ == filter.filename_ &&
+        recurse_yielded_ == filter.recurse_yielded_ &&
+        recurse_unyielded_ == filter.recurse_unyielded_ &&
+        recurse_unruled_ == filter.recurse_unruled_
+    ;
+}
@@ -0,0 +1,63 @@
+#ifndef FORGE_DEPENDENCYFILTER_HPP_INCLUDED
+#define FORGE_DEPENDENCYFILTER_HPP_INCLUDED
+
+#include <vector>
+
+namespace sweet
+{
+
+namespace forge
+{
+
+class Rule;
+class Target;
+
+/**
+// Select the Targets yielded and recursed into by a transitive dependency
+// walk (see Graph::transitive_dependencies()).
+//
+// A dependency is yielded when its Rule is one of the filter's Rules, or the
+// filter has no Rules, and, if the filter requires filenames, it has a
+// filename.  Yielded and unyielded dependencies are recursed into as
+// configured; dependencies without a Rule can be recursed into regardless.
+*/
+class DependencyFilter
+{
+public:
+    /**
+    // The kinds of dependency followed by a walk.
+    */
+    enum Kind
+    {
+        KIND_EXPLICIT = 0x01, ///< Follow explicit dependencies.
+        KIND_IMPLICIT = 0x02, ///< Follow implicit dependencies.
+        KIND_ORDERING = 0x04, ///< Follow ordering dependencies.
+        KIND_PASSIVE = 0x08, ///< Follow passive dependencies.
+        KIND_ALL = 0x0f ///< Follow all dependencies.
+    };
+
+private:
+    int kinds_; ///< The kinds of dependency followed.
+    std::vector<Rule*> rules_; ///< The Rules of yielded Targets in address order or empty to yield Targets with any Rule.
+    bool filename_; ///< Whether or not yielded Targets must have a filename.
+    bool recurse_yielded_; ///< Whether or not yielded Targets are recursed into.
+    bool recurse_unyielded_; ///< Whether or not Targets that aren't yielded are recursed into.
+    bool recurse_unruled_; ///< Whether or not Targets without a Rule are always recursed into.
+
+public:
+    DependencyFilter();
+    void set_kinds( int kinds );
+    int kinds() const;
+    void add_rule( Rule* rule );
+    void set_filename( bool filename );
+    void set_recurse( bool yielded, bool unyielded, bool unruled );
+    bool yields( Target* target ) const;
+    bool recurses( Target* target, bool yielded ) const;
+    bool operator==( const DependencyFilter& filter ) const;
+};
+
+}
+
+}
+
+#endif
@@ -0,0 +1,533 @@
+//
+// DirectoryCache.cpp
+// Copyright (c) Charles Baker. All rights reserved.
+//
+
+#include "DirectoryCache.hpp"
+#include "GraphWriter.hpp"
+#include "GraphReader.hpp"
+#include "DirectoryReader.hpp"
+#include <assert/assert.hpp>
+#include <algorithm>
+#include <chrono>
+#include <string.h>
+
+using std::map;
+using std::string;
+using std::vector;
+using std::filesystem::file_time_type;
+using namespace sweet;
+using namespace sweet::forge;
+
+/**
+// Directories written more recently than this aren't trusted to be
+// unchanged when their last write time matches next time; an entry could
+// be added within the resolution of the file system's timestamps after
+// the directory has been read.
+*/
+static const std::chrono::seconds RACY_INTERVAL( 2 );
+
+/**
+// Join \e name to \e directory with a '/' separator.
+*/
+static string join( const string& directory, const string& name )
+{
+    if ( directory.empty() )
+    {
+        return name;
+    }
+    if ( directory.back() == '/' )
+    {
+        return directory + name;
+    }
+    return directory + "/" + name;
+}
+
+/**
+// Match \e text against \e pattern.
+//
+// A `*` matches any sequence of characters other than '/', a `?` matches
+// any single character other than '/', and a `**` matches any sequence of
+// characters including '/'.  A `**` followed by '/' also matches nothing,
+// along with the '/', so that a `**` element between two other elements
+// matches no directories at all as well as any number of directories.  Any
+// other character matches itself.
+*/
+static bool match( const char* pattern, const char* text )
+{
+    SWEET_ASSERT( pattern );
+    SWEET_ASSERT( text );
+    while ( *pattern )
+    {
+        if ( pattern[0] == '*' && pattern[1] == '*' )
+        {
+            pattern += 2;
+            if ( *pattern == '/' )
+            {
+                ++pattern;
+                while ( true )
+                {
+                    if ( match(pattern, text) )
+                    {
+                        return true;
+                    }
+                    text = strchr( text, '/' );
+                    if ( !text )
+                    {
+                        return false;
+                    }
+                    ++text;
+                }
+            }
+            while ( true )
+            {
+                if ( match(pattern, text) )
+                {
+                    return true;
+                }
+                if ( !*text )
+                {
+                    return false;
+                }
+                ++text;
+            }
+        }
+        else if ( *pattern == '*' )
+        {
+            ++pattern;
+            while ( true )
+            {
+                if ( match(pattern, text) )
+                {
+                    return true;
+                }
+                if ( !*text || *text == '/' )
+                {
+                    return false;
+                }
+                ++text;
+            }
+        }
+        else if ( *pattern == '?' )
+        {
+            if ( !*text || *text == '/' )
+            {
+                return false;
+            }
+            ++pattern;
+            ++text;
+        }
+        else
+        {
+            if ( *pattern != *text )
+            {
+                return false;
+            }
+            ++pattern;
+            ++text;
+        }
+    }
+    return *text == 0;
+}
+
+/**
+// Does \e filename match any of the patterns in \e excludes?
+*/
+static bool excluded( const string& filename, const vector<string>& excludes )
+{
+    for ( vector<string>::const_iterator i = excludes.begin(); i != excludes.end(); ++i )
+    {
+        if ( match(i->c_str(), filename.c_str()) )
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+// Does \e name have one of the extensions in \e extensions (or is
+// \e extensions empty)?
+*/
+static bool has_extension( const string& name, const vector<string>& extensions )
+{
+    if ( extensions.empty() )
+    {
+        return true;
+    }
+    string::size_type dot = name.rfind( '.' );
+    if ( dot == string::npos )
+    {
+        return false;
+    }
+    for ( vector<string>::const_iterator i = extensions.begin(); i != extensions.end(); ++i )
+    {
+        if ( name.compare(dot, string::npos, *i) == 0 )
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+DirectoryCache::DirectoryCache()
+: directories_(),
+  globbed_directories_()
+{
+}
+
+/**
+// Get the listing of the directory at \e path.
+//
+// The directory's last write time is checked on every call and the
+// directory is only read again if it has changed since it was last read.
+// Reading a directory again forgets the listings of any subdirectories
+// that have been removed from it.
+//
+// @param path
+//  The absolute path to the directory to list.
+//
+// @return
+//  The listing, empty if \e path isn't a directory, or null if \e path
+//  doesn't exist.
+*/
+const DirectoryCache::Directory* DirectoryCache::directory( const std::string& path )
+{
+    SWEET_ASSERT( !path.empty() );
+    std::error_code error;
+    file_time_type last_write_time = std::filesystem::last_write_time( path, error );
+    if ( error )
+    {
+        directories_.erase( path );
+        erase_descendants( path );
+        return nullptr;
+    }
+
+    map<string, Directory>::iterator i = directories_.find( path );
+    if ( i != directories_.end() && i->second.last_write_time == last_write_time )
+    {
+        return &i->second;
+    }
+
+    if ( i == directories_.end() )
+    {
+        i = directories_.insert( std::make_pair(path, Directory()) ).first;
+    }
+    read_directory( path, last_write_time, &i->second );
+    return &i->second;
+}
+
+/**
+// Find the files matching \e pattern beneath \e directory.
+//
+// Each '/' separated element of \e pattern matches the names of
+// directories, or the names of files for the last element, as described
+// for `match()` above.  An element that is exactly `**` matches any number
+// of directories, including none, and, as the last element, any file in
+// those directories.
+//
+// @param directory
+//  The absolute path to the directory that \e pattern is relative to.
+//
+// @param prefix
+//  The prefix to prepend to matching files, usually \e directory as it
+//  was written in the buildfile, or empty to return paths relative to
+//  \e directory.
+//
+// @param pattern
+//  The pattern to match files against.
+//
+// @param excludes
+//  Patterns matched against the prefixed path of each file and directory
+//  to exclude them, and anything beneath them, from the results.
+//
+// @param extensions
+//  The extensions, including the leading '.', of the files to return or
+//  empty to return files with any extension.
+//
+// @param buildfile
+//  The path to the buildfile that is globbing, to record the directories
+//  listed against, or empty if no buildfile is being loaded.
+//
+// @param filenames
+//  A vector to append the sorted prefixed paths to the matching files to.
+*/
+void DirectoryCache::glob( const std::string& directory, const std::string& prefix, const std::string& pattern, const std::vector<std::string>& excludes, const std::vector<std::string>& extensions, const std::string& buildfile, std::vector<std::string>* filenames )
+{
+    SWEET_ASSERT( filenames );
+
+    vector<string> elements;
+    string::size_type begin = 0;
+    while ( begin <= pattern.size() )
+    {
+        string::size_type end = pattern.find( '/', begin );
+        if ( end == string::npos )
+        {
+            end = pattern.size();
+        }
+        if ( end > begin )
+        {
+            elements.push_back( pattern.substr(begin, end - begin) );
+        }
+        begin = end + 1;
+    }
+    if ( elements.empty() )
+    {
+        return;
+    }
+
+    struct Match
+    {
+        string directory;
+        string path;
+        size_t element;
+    };
+
+    // Directories that don't exist are recorded with the latest possible
+    // last write time so that creating them counts as a change.
+    map<string, file_time_type>* globbed_directories = !buildfile.empty() ? &globbed_directories_[buildfile] : nullptr;
+    vector<string> matches;
+    vector<Match> stack;
+    stack.push_back( Match{directory, prefix, 0} );
+    while ( !stack.empty() )
+    {
+        Match current = stack.back();
+        stack.pop_back();
+
+        const Directory* listing = DirectoryCache::directory( current.directory );
+        if ( globbed_directories )
+        {
+            (*globbed_directories)[current.directory] = listing ? listing->last_write_time : file_time_type::max();
+        }
+        if ( !listing )
+        {
+            continue;
+        }
+
+        const string& element = elements[current.element];
+        bool last = current.element + 1 == elements.size();
+        bool recursive = element == "**";
+        if ( recursive && !last )
+        {
+            stack.push_back( Match{current.directory, current.path, current.element + 1} );
+        }
+
+        if ( last )
+        {
+            for ( vector<string>::const_iterator i = listing->files.begin(); i != listing->files.end(); ++i )
+            {
+                const string& name = *i;
+                if ( (recursive || match(element.c_str(), name.c_str())) && has_extension(name, extensions) )
+                {
+                    string path = join( current.path, name );
+                    if ( !excluded(path, excludes) )
+                    {
+                        matches.push_back( path );
+                    }
+                }
+            }
+        }
+
+        if ( !last || recursive )
+        {
+            for ( vector<string>::const_reverse_iterator i = listing->directories.rbegin(); i != listing->directories.rend(); ++i )
+            {
+                const string& name = *i;
+                if ( recursive || match(element.c_str(), name.c_str()) )
+                {
+                    string path = join( current.path, name );
+                    if ( !excluded(path, excludes) )
+                    {
+                        stack.push_back( Match{join(current.directory, name), path, recursive ? current.element : current.element + 1} );
+                    }
+                }
+            }
+        }
+    }
+
+    std::sort( matches.begin(), matches.end() );
+    matches.erase( std::unique(matches.begin(), matches.end()), matches.end() );
+    filenames->insert( filenames->end(), matches.begin(), matches.end() );
+}
+
+/**
+// Forget the directories globbed by \e buildfile when it is about to be
+// loaded again.
+*/
+void DirectoryCache::clear_globbed_directories( const std::string& buildfile )
+{
+    globbed_directories_.erase( buildfile );
+}
+
+/**
+// Forget the directories globbed by all buildfiles.
+*/
+void DirectoryCache::clear_globbed_directories()
+{
+    globbed_directories_.clear();
+}
+
+/**
+// Find the buildfiles that have globbed directories that have changed since
+// they were globbed.
+//
+// Directories that were written within the racy interval of being listed
+// are recorded with the earliest possible last write time and so always
+// count as changed.
+//
+// @param buildfiles
+//  A vector to append the paths to the buildfiles to.
+*/
+void DirectoryCache::changed_buildfiles( std::vector<std::string>* buildfiles ) const
+{
+    SWEET_ASSERT( buildfiles );
+    for ( map<string, map<string, file_time_type>>::const_iterator i = globbed_directories_.begin(); i != globbed_directories_.end(); ++i )
+    {
+        const map<string, file_time_type>& directories = i->second;
+        for ( map<string, file_time_type>::const_iterator j = directories.begin(); j != directories.end(); ++j )
+        {
+            std::error_code error;
+            file_time_type last_write_time = std::filesystem::last_write_time( j->first, error );
+            if ( (error ? file_time_type::max() : last_write_time) != j->second )
+            {
+                buildfiles->push_back( i->first );
+                break;
+            }
+        }
+    }
+}
+
+/**
+// Forget all cached listings.
+*/
+void DirectoryCache::clear()
+{
+    directories_.clear();
+}
+
+/**
+// Swap the cached listings of this DirectoryCache with \e directory_cache.
+*/
+void DirectoryCache::swap( DirectoryCache& directory_cache )
+{
+    directories_.swap( directory_cache.directories_ );
+    globbed_directories_.swap( directory_cache.globbed_directories_ );
+}
+
+void DirectoryCache::write( GraphWriter& writer ) const
+{
+    writer.value( int(directories_.size()) );
+    for ( map<string, Directory>::const_iterator i = directories_.begin(); i != directories_.end(); ++i )
+    {
+        const Directory& directory = i->second;
+        writer.value( i->first );
+        writer.value( directory.last_write_time );
+        writer.value( directory.files );
+        writer.value( directory.directories );
+    }
+
+    writer.value( int(globbed_directories_.size()) );
+    for ( map<string, map<string, file_time_type>>::const_iterator i = globbed_directories_.begin(); i != globbed_directories_.end(); ++i )
+    {
+        writer.value( i->first );
+        writer.value( int(i->second.size()) );
+        for ( map<string, file_time_type>::const_iterator j = i->second.begin(); j != i->second.end(); ++j )
+        {
+            writer.value( j->first );
+            writer.value( j->second );
+        }
+    }
+}
+
+void DirectoryCache::read( GraphReader& reader )
+{
+    directories_.clear();
+    int size = 0;
+    reader.value( &size );
+    for ( int i = 0; i < size; ++i )
+    {
+        string path;
+        reader.value( &path );
+        Directory& directory = directories_[path];
+        reader.value( &directory.last_write_time );
+        reader.value( &directory.files );
+        reader.value( &directory.directories );
+    }
+
+    globbed_directories_.clear();
+    int buildfiles = 0;
+    reader.value( &buildfiles );
+    for ( int i = 0; i < buildfiles; ++i )
+    {
+        string buildfile;
+        reader.value( &buildfile );
+        map<string, file_time_type>& directories = globbed_directories_[buildfile];
+        int size = 0;
+        reader.value( &size );
+        for ( int j = 0; j < size; ++j )
+        {
+            string path;
+            reader.value( &path );
+            reader.value( &directories[path] );
+        }
+    }
+}
+
+void DirectoryCache::read_directory( const std::string& path, std::filesystem::file_time_type last_write_time, Directory* directory )
+{
+    SWEET_ASSERT( directory );
+
+    vector<string> directories;
+    directories.swap( directory->directories );
+    directory->files.clear();
+
+    // Symbolic links are followed to directories so that linked
+    // directories are globbed like any other; the types of all other
+    // entries come from the directory listing without a `stat()` each.
+    vector<DirectoryEntry> entries;
+    DirectoryReader::read( path, &entries );
+    size_t prefix_length = !path.empty() && path.back() == '/' ? path.size() : path.size() + 1;
+    for ( vector<DirectoryEntry>::const_iterator entry = entries.begin(); entry != entries.end(); ++entry )
+    {
+        std::error_code error;
+        string name = entry->path.substr( prefix_length );
+        if ( entry->type == DIRECTORY_ENTRY_DIRECTORY || (entry->type == DIRECTORY_ENTRY_LINK && std::filesystem::is_directory(entry->path, error)) )
+        {
+            directory->directories.push_back( name );
+        }
+        else
+        {
+            directory->files.push_back( name );
+        }
+    }
+    std::sort( directory->files.begin(), directory->files.end() );
+    std::sort( directory->directories.begin(), directory->directories.end() );
+
+    // Forget the listings of subdirectories that have gone.
+    for ( vector<string>::const_iterator i = directories.begin(); i != directories.end(); ++i )
+    {
+        if ( !std::binary_search(directory->directories.begin(), directory->directories.end(), *i) )
+        {
+            string subdirectory = join( path, *i );
+            directories_.erase( subdirectory );
+            erase_descendants( subdirectory );
+        }
+    }
+
+    bool racy = last_write_time > file_time_type::clock::now() - RACY_INTERVAL;
+    directory->last_write_time = racy ? file_time_type::min() : last_write_time;
+}
+
+/**
+// Forget the listings of all directories beneath \e path.
+*/
+void DirectoryCache::erase_descendants( const std::string& path )
+{
+    SWEET_ASSERT( !path.empty() );
+    string prefix = join( path, string() );
+    map<string, Directory>::iterator i = directories_.lower_bound( prefix );
+    while ( i != directories_.end() && i->first.compare(0, prefix.size(), prefix) == 0 )
+    {
+        i = directories_.erase( i );
+    }
+}
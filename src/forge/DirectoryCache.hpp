@@ -0,0 +1,71 @@
+#ifndef FORGE_DIRECTORYCACHE_HPP_INCLUDED
+#define FORGE_DIRECTORYCACHE_HPP_INCLUDED
+
+#include <filesystem>
+#include <vector>
+#include <string>
+#include <map>
+
+namespace sweet
+{
+
+namespace forge
+{
+
+class GraphWriter;
+class GraphReader;
+
+/**
+// Cache directory listings, keyed by the last write time of each directory,
+// so that `glob()` only reads directories that have changed.
+//
+// The listings are saved with the Graph in its cache file so that globbing
+// an unchanged source tree costs one `stat()` per directory rather than
+// reading every directory again.  Adding, removing, or renaming an entry in
+// a directory updates the directory's last write time and so causes that
+// directory, and only that directory, to be read again.
+//
+// The directories listed by `glob()` while loading each buildfile are also
+// recorded, with their last write times, so that a Graph reused from the
+// cache file loads a buildfile again when the results of its globs might
+// have changed (see Graph::reuse_buildfiles()).
+*/
+class DirectoryCache
+{
+public:
+    /**
+    // The cached listing of a single directory.
+    */
+    struct Directory
+    {
+        std::filesystem::file_time_type last_write_time; ///< The last write time of the directory when it was listed.
+        std::vector<std::string> files; ///< The sorted names of the files in the directory.
+        std::vector<std::string> directories; ///< The sorted names of the directories in the directory.
+    };
+
+private:
+    std::map<std::string, Directory> directories_; ///< The cached listings by absolute path.
+    std::map<std::string, std::map<std::string, std::filesystem::file_time_type>> globbed_directories_; ///< The last write times of the directories globbed by each buildfile by the path to the buildfile and then to the directory.
+
+public:
+    DirectoryCache();
+    const Directory* directory( const std::string& path );
+    void glob( const std::string& directory, const std::string& prefix, const std::string& pattern, const std::vector<std::string>& excludes, const std::vector<std::string>& extensions, const std::string& buildfile, std::vector<std::string>* filenames );
+    void clear_globbed_directories( const std::string& buildfile );
+    void clear_globbed_directories();
+    void changed_buildfiles( std::vector<std::string>* buildfiles ) const;
+    void clear();
+    void swap( DirectoryCache& directory_cache );
+    void write( GraphWriter& writer ) const;
+    void read( GraphReader& reader );
+
+private:
+    void read_directory( const std::string& path, std::filesystem::file_time_type last_write_time, Directory* directory );
+    void erase_descendants( const std::string& path );
+};
+
+}
+
+}
+
+#endif
@@ -0,0 +1,569 @@
+//
+// DirectoryMirror.cpp
+// Copyright (c) Charles Baker. All rights reserved.
+//
+
+#include "DirectoryMirror.hpp"
+#include "DirectoryReader.hpp"
+#include "System.hpp"
+#include "Target.hpp"
+#include "GraphWriter.hpp"
+#include "GraphReader.hpp"
+#include <assert/assert.hpp>
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+
+#if !defined(BUILD_OS_WINDOWS)
+#include <sys/stat.h>
+#endif
+
+using std::string;
+using std::vector;
+using namespace sweet;
+using namespace sweet::forge;
+
+/**
+// The minimum number of files to copy on each thread; fewer files than this
+// are copied on the calling thread.
+*/
+static const size_t FILES_PER_THREAD = 16;
+
+/**
+// Join \e path to \e directory with a '/' separator.
+*/
+static string join( const string& directory, const string& path )
+{
+    if ( !directory.empty() && directory.back() == '/' )
+    {
+        return directory + path;
+    }
+    return directory + "/" + path;
+}
+
+/**
+// Get the size and last write time of the file at \e path with a single
+// `stat()`, following symbolic links.
+//
+// @return
+//  True if \e path exists otherwise false.
+*/
+static bool file_status( const string& path, uint64_t* size, int64_t* last_write_time, bool* directory )
+{
+    SWEET_ASSERT( size );
+    SWEET_ASSERT( last_write_time );
+    SWEET_ASSERT( directory );
+#if defined(BUILD_OS_WINDOWS)
+    std::error_code error;
+    std::filesystem::file_status status = std::filesystem::status( path, error );
+    if ( error || !std::filesystem::exists(status) )
+    {
+        return false;
+    }
+    *directory = std::filesystem::is_directory( status );
+    *size = *directory ? 0 : std::filesystem::file_size( path, error );
+    *last_write_time = std::filesystem::last_write_time( path, error ).time_since_epoch().count();
+    return !error;
+#else
+    struct stat status;
+    if ( stat(path.c_str(), &status) != 0 )
+    {
+        return false;
+    }
+    *directory = S_ISDIR( status.st_mode );
+    *size = uint64_t( status.st_size );
+#if defined(BUILD_OS_MACOS)
+    *last_write_time = int64_t( status.st_mtimespec.tv_sec ) * 1000000000 + status.st_mtimespec.tv_nsec;
+#else
+    *last_write_time = int64_t( status.st_mtim.tv_sec ) * 1000000000 + status.st_mtim.tv_nsec;
+#endif
+    return true;
+#endif
+}
+
+/**
+// Are the entries \e lhs and \e rhs the same?
+*/
+static bool same( const DirectoryMirror::Entry& lhs, const DirectoryMirror::Entry& rhs )
+{
+    return
+        lhs.path == rhs.path &&
+        lhs.size == rhs.size &&
+        lhs.last_write_time == rhs.last_write_time &&
+        lhs.directory == rhs.directory
+    ;
+}
+
+/**
+// Are the manifests \e lhs and \e rhs the same?
+*/
+static bool same( const vector<DirectoryMirror::Entry>& lhs, const vector<DirectoryMirror::Entry>& rhs )
+{
+    if ( lhs.size() != rhs.size() )
+    {
+        return false;
+    }
+    for ( size_t i = 0; i < lhs.size(); ++i )
+    {
+        if ( !same(lhs[i], rhs[i]) )
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+DirectoryMirror::DirectoryMirror()
+: mirrors_()
+{
+}
+
+/**
+// Add a source directory to the mirror at \e destination.
+//
+// @param destination
+//  The absolute path to the destination directory, the filename of the
+//  Target that represents the mirror.
+//
+// @param source
+//  The absolute path to the directory to mirror into \e destination.
+//  Entries in later sources replace entries at the same relative path in
+//  earlier sources.  Adding a source more than once has no effect other
+//  than recording another buildfile that adds it.
+//
+// @param buildfile
+//  The path to the buildfile that adds the source or empty if the source
+//  isn't added by a buildfile.
+*/
+void DirectoryMirror::add_source( const std::string& destination, const std::string& source, const std::string& buildfile )
+{
+    Mirror& mirror = mirrors_[destination];
+    vector<string>::iterator i = std::find( mirror.sources.begin(), mirror.sources.end(), source );
+    if ( i == mirror.sources.end() )
+    {
+        mirror.sources.push_back( source );
+        mirror.source_buildfiles.push_back( vector<string>() );
+        mirror.scanned = false;
+        i = mirror.sources.end() - 1;
+    }
+    vector<string>& buildfiles = mirror.source_buildfiles[i - mirror.sources.begin()];
+    if ( !buildfile.empty() && std::find(buildfiles.begin(), buildfiles.end(), buildfile) == buildfiles.end() )
+    {
+        buildfiles.push_back( buildfile );
+    }
+}
+
+/**
+// Clear the sources added by the buildfile at \e buildfile.
+//
+// Called when a single buildfile is to be loaded again while the rest of
+// the Graph is reused so that sources it no longer adds stop being
+// mirrored.  Sources that are also added by other buildfiles are kept.
+//
+// @param buildfile
+//  The path to the buildfile whose sources are cleared.
+*/
+void DirectoryMirror::clear_sources( const std::string& buildfile )
+{
+    for ( std::map<string, Mirror>::iterator i = mirrors_.begin(); i != mirrors_.end(); ++i )
+    {
+        Mirror& mirror = i->second;
+        SWEET_ASSERT( mirror.sources.size() == mirror.source_buildfiles.size() );
+        size_t source = 0;
+        while ( source < mirror.sources.size() )
+        {
+            vector<string>& buildfiles = mirror.source_buildfiles[source];
+            vector<string>::iterator j = std::find( buildfiles.begin(), buildfiles.end(), buildfile );
+            if ( j != buildfiles.end() )
+            {
+                buildfiles.erase( j );
+                if ( buildfiles.empty() )
+                {
+                    mirror.sources.erase( mirror.sources.begin() + source );
+                    mirror.source_buildfiles.erase( mirror.source_buildfiles.begin() + source );
+                    mirror.pending.clear();
+                    mirror.pending_sources.clear();
+                    mirror.scanned = false;
+                    continue;
+                }
+            }
+            ++source;
+        }
+    }
+}
+
+/**
+// Clear the sources of all mirrors.
+//
+// Called when the Graph's buildfiles are to be loaded again so that sources
+// no longer added by any buildfile stop being mirrored.  Manifests are kept
+// so that building a mirror without sources removes the entries that were
+// mirrored from them.
+*/
+void DirectoryMirror::clear_sources()
+{
+    for ( std::map<string, Mirror>::iterator i = mirrors_.begin(); i != mirrors_.end(); ++i )
+    {
+        Mirror& mirror = i->second;
+        mirror.sources.clear();
+        mirror.source_buildfiles.clear();
+        mirror.pending.clear();
+        mirror.pending_sources.clear();
+        mirror.scanned = false;
+    }
+}
+
+/**
+// Scan the sources of the mirror bound to by \e target, if there is one,
+// and mark \e target as outdated if they differ from its manifest.
+//
+// Called as each Target is bound, before Target::bind(), so that a mirror
+// is built if and only if any of its entries have changed.  A destination
+// directory that has been removed is considered to have nothing mirrored
+// into it.
+*/
+void DirectoryMirror::bind( Target* target )
+{
+    SWEET_ASSERT( target );
+    if ( mirrors_.empty() || target->filenames().empty() )
+    {
+        return;
+    }
+
+    std::map<string, Mirror>::iterator i = mirrors_.find( target->filename(0) );
+    if ( i != mirrors_.end() )
+    {
+        Mirror& mirror = i->second;
+        std::error_code error;
+        if ( !std::filesystem::exists(i->first, error) )
+        {
+            mirror.manifest.clear();
+        }
+        scan( &mirror );
+        if ( !same(mirror.pending, mirror.manifest) )
+        {
+            target->set_outdated( true );
+        }
+    }
+}
+
+/**
+// Copy new and changed entries from the sources of the mirror at
+// \e destination and remove the entries mirrored previously that are no
+// longer in any source.
+//
+// Files are copied on up to \e threads threads with System::cp() so that
+// each copy is a reflink where possible and keeps the last write time of its
+// source.  Files in \e destination that already have the
+// same size and last write time as their source, e.g. when the manifest has
+// been lost along with the cache file, aren't copied again.
+//
+// @param destination
+//  The absolute path to the destination directory.
+//
+// @param system
+//  The System to copy files with.
+//
+// @param threads
+//  The maximum number of threads to copy files on.
+//
+// @param error
+//  Set to a message describing the first failure, if any.
+//
+// @return
+//  True if every entry was mirrored successfully otherwise false.  Entries
+//  that fail to copy are left out of the manifest so that they're copied
+//  again next time.
+*/
+bool DirectoryMirror::sync( const std::string& destination, const System* system, int threads, std::string* error )
+{
+    SWEET_ASSERT( system );
+    SWEET_ASSERT( error );
+
+    std::map<string, Mirror>::iterator i = mirrors_.find( destination );
+    if ( i == mirrors_.end() )
+    {
+        return true;
+    }
+
+    Mirror& mirror = i->second;
+    if ( !mirror.scanned )
+    {
+        scan( &mirror );
+    }
+
+    // Find the new, changed, and removed entries by merging the sorted
+    // pending entries with the sorted manifest.
+    const vector<Entry>& pending = mirror.pending;
+    const vector<Entry>& manifest = mirror.manifest;
+    vector<size_t> directories;
+    vector<size_t> copies;
+    vector<const Entry*> removals;
+    size_t p = 0;
+    size_t m = 0;
+    while ( p < pending.size() || m < manifest.size() )
+    {
+        int compare = p == pending.size() ? 1 : m == manifest.size() ? -1 : pending[p].path.compare( manifest[m].path );
+        if ( compare > 0 )
+        {
+            removals.push_back( &manifest[m] );
+            ++m;
+            continue;
+        }
+        if ( compare == 0 )
+        {
+            bool changed = !same( pending[p], manifest[m] );
+            if ( changed && pending[p].directory != manifest[m].directory )
+            {
+                removals.push_back( &manifest[m] );
+            }
+            ++m;
+            if ( !changed )
+            {
+                ++p;
+                continue;
+            }
+        }
+        if ( pending[p].directory )
+        {
+            directories.push_back( p );
+        }
+        else
+        {
+            copies.push_back( p );
+        }
+        ++p;
+    }
+
+    // Remove stale entries in reverse order so that the entries in a
+    // directory are removed before the directory itself.  Directories that
+    // still contain entries that weren't mirrored are left in place.
+    for ( vector<const Entry*>::const_reverse_iterator removal = removals.rbegin(); removal != removals.rend(); ++removal )
+    {
+        std::error_code remove_error;
+        std::filesystem::remove( join(destination, (*removal)->path), remove_error );
+    }
+
+    // Create the destination and then directories in order so that parents
+    // are created first.
+    std::error_code create_destination_error;
+    std::filesystem::create_directories( destination, create_destination_error );
+    for ( vector<size_t>::const_iterator directory = directories.begin(); directory != directories.end(); ++directory )
+    {
+        std::error_code create_error;
+        std::filesystem::create_directories( join(destination, pending[*directory].path), create_error );
+    }
+
+    std::atomic<size_t> next_copy( 0 );
+    std::mutex error_mutex;
+    vector<char> failed( copies.size(), 0 );
+    auto copy_files = [&]()
+    {
+        size_t index = next_copy++;
+        while ( index < copies.size() )
+        {
+            const Entry& entry = pending[copies[index]];
+            string from = join( mirror.sources[mirror.pending_sources[copies[index]]], entry.path );
+            string to = join( destination, entry.path );
+            uint64_t size = 0;
+            int64_t last_write_time = 0;
+            bool directory = false;
+            if ( !file_status(to, &size, &last_write_time, &directory) || directory || size != entry.size || last_write_time != entry.last_write_time )
+            {
+                try
+                {
+                    system->cp( from, to );
+                }
+                catch ( const std::exception& exception )
+                {
+                    failed[index] = 1;
+                    std::lock_guard<std::mutex> lock( error_mutex );
+                    if ( error->empty() )
+                    {
+                        *error = exception.what();
+                    }
+                }
+            }
+            index = next_copy++;
+        }
+    };
+
+    size_t copy_threads = std::min( size_t(std::max(threads, 1)), copies.size() / FILES_PER_THREAD + 1 );
+    vector<std::thread> workers;
+    for ( size_t thread = 1; thread < copy_threads; ++thread )
+    {
+        workers.push_back( std::thread(copy_files) );
+    }
+    copy_files();
+    for ( vector<std::thread>::iterator worker = workers.begin(); worker != workers.end(); ++worker )
+    {
+        worker->join();
+    }
+
+    // Entries that failed to copy are left out of the manifest so that
+    // they're copied again by the next sync.
+    vector<Entry> mirrored;
+    mirrored.reserve( pending.size() );
+    size_t copy = 0;
+    for ( size_t index = 0; index < pending.size(); ++index )
+    {
+        if ( copy < copies.size() && copies[copy] == index )
+        {
+            if ( failed[copy++] )
+            {
+                continue;
+            }
+        }
+        mirrored.push_back( pending[index] );
+    }
+    mirror.manifest.swap( mirrored );
+    mirror.pending.clear();
+    mirror.pending_sources.clear();
+    mirror.scanned = false;
+    return error->empty();
+}
+
+/**
+// Remove the entries mirrored into \e destination.
+*/
+void DirectoryMirror::clean( const std::string& destination )
+{
+    std::map<string, Mirror>::iterator i = mirrors_.find( destination );
+    if ( i != mirrors_.end() )
+    {
+        Mirror& mirror = i->second;
+        for ( vector<Entry>::const_reverse_iterator entry = mirror.manifest.rbegin(); entry != mirror.manifest.rend(); ++entry )
+        {
+            std::error_code error;
+            std::filesystem::remove( join(destination, entry->path), error );
+        }
+        mirror.manifest.clear();
+        mirror.scanned = false;
+    }
+}
+
+/**
+// Swap the mirrors of this DirectoryMirror with \e directory_mirror.
+*/
+void DirectoryMirror::swap( DirectoryMirror& directory_mirror )
+{
+    mirrors_.swap( directory_mirror.mirrors_ );
+}
+
+void DirectoryMirror::write( GraphWriter& writer ) const
+{
+    writer.value( int(mirrors_.size()) );
+    for ( std::map<string, Mirror>::const_iterator i = mirrors_.begin(); i != mirrors_.end(); ++i )
+    {
+        const Mirror& mirror = i->second;
+        writer.value( i->first );
+        writer.value( mirror.sources );
+        for ( vector<vector<string>>::const_iterator buildfiles = mirror.source_buildfiles.begin(); buildfiles != mirror.source_buildfiles.end(); ++buildfiles )
+        {
+            writer.value( *buildfiles );
+        }
+        writer.value( int(mirror.manifest.size()) );
+        for ( vector<Entry>::const_iterator entry = mirror.manifest.begin(); entry != mirror.manifest.end(); ++entry )
+        {
+            writer.value( entry->path );
+            writer.value( entry->size );
+            writer.value( uint64_t(entry->last_write_time) );
+            writer.value( entry->directory );
+        }
+    }
+}
+
+void DirectoryMirror::read( GraphReader& reader )
+{
+    mirrors_.clear();
+    int mirrors = 0;
+    reader.value( &mirrors );
+    for ( int i = 0; i < mirrors; ++i )
+    {
+        string destination;
+        reader.value( &destination );
+        Mirror& mirror = mirrors_[destination];
+        reader.value( &mirror.sources );
+        mirror.source_buildfiles.resize( mirror.sources.size() );
+        for ( vector<vector<string>>::iterator buildfiles = mirror.source_buildfiles.begin(); buildfiles != mirror.source_buildfiles.end(); ++buildfiles )
+        {
+            reader.value( &(*buildfiles) );
+        }
+        int entries = 0;
+        reader.value( &entries );
+        mirror.manifest.resize( entries );
+        for ( vector<Entry>::iterator entry = mirror.manifest.begin(); entry != mirror.manifest.end(); ++entry )
+        {
+            uint64_t last_write_time = 0;
+            reader.value( &entry->path );
+            reader.value( &entry->size );
+            reader.value( &last_write_time );
+            reader.value( &entry->directory );
+            entry->last_write_time = int64_t( last_write_time );
+        }
+        mirror.scanned = false;
+    }
+}
+
+/**
+// Scan the sources of \e mirror into its pending entries.
+//
+// Only directories, files, and symbolic links to files are mirrored.
+// Entries in later sources replace entries with the same relative path in
+// earlier sources.
+*/
+void DirectoryMirror::scan( Mirror* mirror )
+{
+    SWEET_ASSERT( mirror );
+
+    vector<std::pair<Entry, int>> entries;
+    for ( int source = 0; source < int(mirror->sources.size()); ++source )
+    {
+        const string& path = mirror->sources[source];
+        size_t prefix_length = !path.empty() && path.back() == '/' ? path.size() : path.size() + 1;
+        DirectoryReader directory_reader( path, true );
+        DirectoryEntry directory_entry;
+        while ( directory_reader.next(&directory_entry) )
+        {
+            Entry entry;
+            entry.path = directory_entry.path.substr( prefix_length );
+            entry.size = 0;
+            entry.last_write_time = 0;
+            entry.directory = directory_entry.type == DIRECTORY_ENTRY_DIRECTORY;
+            if ( directory_entry.type == DIRECTORY_ENTRY_FILE || directory_entry.type == DIRECTORY_ENTRY_LINK )
+            {
+                bool directory = false;
+                if ( !file_status(directory_entry.path, &entry.size, &entry.last_write_time, &directory) || directory )
+                {
+                    continue;
+                }
+            }
+            else if ( !entry.directory )
+            {
+                continue;
+            }
+            entries.push_back( std::make_pair(std::move(entry), source) );
+        }
+    }
+
+    std::stable_sort( entries.begin(), entries.end(), []( const std::pair<Entry, int>& lhs, const std::pair<Entry, int>& rhs ) {
+        return lhs.first.path < rhs.first.path;
+    } );
+
+    mirror->pending.clear();
+    mirror->pending_sources.clear();
+    mirror->pending.reserve( entries.size() );
+    mirror->pending_sources.reserve( entries.size() );
+    for ( size_t i = 0; i < entries.size(); ++i )
+    {
+        if ( i + 1 < entries.size() && entries[i + 1].first.path == entries[i].first.path )
+        {
+            continue;
+        }
+        mirror->pending.push_back( std::move(entries[i].first) );
+        mirror->pending_sources.push_back( entries[i].second );
+    }
+    mirror->scanned = true;
+}
@@ -0,0 +1,80 @@
+#ifndef FORGE_DIRECTORYMIRROR_HPP_INCLUDED
+#define FORGE_DIRECTORYMIRROR_HPP_INCLUDED
+
+#include <vector>
+#include <string>
+#include <map>
+#include <stdint.h>
+
+namespace sweet
+{
+
+namespace forge
+{
+
+class Target;
+class System;
+class GraphWriter;
+class GraphReader;
+
+/**
+// Mirror source directories into destination directories, copying only
+// the entries that have changed since the last time they were mirrored.
+//
+// Each mirror is a single Target, bound to its destination directory, with
+// a manifest of the relative path, size, and last write time of each entry
+// mirrored.  Manifests are saved with the Graph in its cache file.  When a
+// mirror is bound its sources are scanned and compared to its manifest to
+// decide whether or not it is outdated; building it then copies new and
+// changed files, in parallel, and removes the entries that were mirrored
+// previously but are no longer in any source.  Entries in the destination
+// that weren't mirrored are left alone.
+*/
+class DirectoryMirror
+{
+public:
+    /**
+    // An entry in a mirror's manifest.
+    */
+    struct Entry
+    {
+        std::string path; ///< The path to the entry relative to its source directory.
+        uint64_t size; ///< The size of the file or 0 for directories.
+        int64_t last_write_time; ///< The last write time of the file or 0 for directories.
+        bool directory; ///< True if the entry is a directory.
+    };
+
+private:
+    struct Mirror
+    {
+        std::vector<std::string> sources; ///< The absolute paths to the directories mirrored, later sources take precedence.
+        std::vector<std::vector<std::string>> source_buildfiles; ///< The paths to the buildfiles that added each source.
+        std::vector<Entry> manifest; ///< The entries as they were last mirrored sorted by path.
+        std::vector<Entry> pending; ///< The entries as they were last scanned sorted by path.
+        std::vector<int> pending_sources; ///< The index of the source directory of each pending entry.
+        bool scanned; ///< True if the sources have been scanned since they were last mirrored.
+    };
+
+    std::map<std::string, Mirror> mirrors_; ///< The mirrors by absolute path to their destination directory.
+
+public:
+    DirectoryMirror();
+    void add_source( const std::string& destination, const std::string& source, const std::string& buildfile );
+    void clear_sources( const std::string& buildfile );
+    void clear_sources();
+    void bind( Target* target );
+    bool sync( const std::string& destination, const System* system, int threads, std::string* error );
+    void clean( const std::string& destination );
+    void swap( DirectoryMirror& directory_mirror );
+    void write( GraphWriter& writer ) const;
+    void read( GraphReader& reader );
+
+private:
+    static void scan( Mirror* mirror );
+};
+
+}
+
+}
+
+#endif
@@ -0,0 +1,234 @@
+//
+// DirectoryReader.cpp
+// Copyright (c) Charles Baker. All rights reserved.
+//
+
+#include "DirectoryReader.hpp"
+#include <assert/assert.hpp>
+#include <filesystem>
+
+#if defined(BUILD_OS_LINUX)
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <string.h>
+#endif
+
+using std::string;
+using std::vector;
+using namespace sweet;
+using namespace sweet::forge;
+
+#if defined(BUILD_OS_LINUX)
+
+/**
+// The layout of the records returned by the `getdents64` system call.
+*/
+struct linux_dirent64
+{
+    ino64_t d_ino;
+    off64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[1];
+};
+
+/**
+// The size of the buffer that directory entries are read into; large
+// enough that most directories are read in one system call.
+*/
+static const size_t GETDENTS_BUFFER_SIZE = 64 * 1024;
+
+/**
+// Get the type of the entry at \e path from `lstat()` for file systems that
+// don't report types in their directory entries.
+*/
+static DirectoryEntryType lstat_type( const string& path )
+{
+    struct stat status;
+    if ( lstat(path.c_str(), &status) != 0 )
+    {
+        return DIRECTORY_ENTRY_OTHER;
+    }
+    if ( S_ISREG(status.st_mode) )
+    {
+        return DIRECTORY_ENTRY_FILE;
+    }
+    if ( S_ISDIR(status.st_mode) )
+    {
+        return DIRECTORY_ENTRY_DIRECTORY;
+    }
+    if ( S_ISLNK(status.st_mode) )
+    {
+        return DIRECTORY_ENTRY_LINK;
+    }
+    return DIRECTORY_ENTRY_OTHER;
+}
+
+#endif
+
+/**
+// Constructor.
+//
+// @param path
+//  The absolute path to the directory to read; a directory that doesn't
+//  exist or can't be read has no entries.
+//
+// @param recursive
+//  True to read the directories beneath \e path as well.
+*/
+DirectoryReader::DirectoryReader( const std::string& path, bool recursive )
+: recursive_( recursive )
+, levels_()
+{
+    push( path );
+}
+
+/**
+// Get the next entry.
+//
+// @param entry
+//  The DirectoryEntry to set to the next entry.
+//
+// @return
+//  True if \e entry was set to the next entry or false if there are no
+//  more entries.
+*/
+bool DirectoryReader::next( DirectoryEntry* entry )
+{
+    SWEET_ASSERT( entry );
+    while ( !levels_.empty() )
+    {
+        Level& level = levels_.back();
+        if ( level.index < level.entries.size() )
+        {
+            entry->path.swap( level.entries[level.index].path );
+            entry->type = level.entries[level.index].type;
+            ++level.index;
+            if ( recursive_ && entry->type == DIRECTORY_ENTRY_DIRECTORY )
+            {
+                push( entry->path );
+            }
+            return true;
+        }
+        levels_.pop_back();
+    }
+    return false;
+}
+
+/**
+// Read the entries of the directory at \e path.
+//
+// @param path
+//  The absolute path to the directory to read.
+//
+// @param entries
+//  The vector to append the entries, other than "." and "..", to.
+*/
+void DirectoryReader::read( const std::string& path, std::vector<DirectoryEntry>* entries )
+{
+    SWEET_ASSERT( entries );
+
+#if defined(BUILD_OS_LINUX)
+    int fd = open( path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC );
+    if ( fd < 0 )
+    {
+        return;
+    }
+
+    string prefix = path;
+    if ( prefix.empty() || prefix.back() != '/' )
+    {
+        prefix.push_back( '/' );
+    }
+
+    vector<char> buffer( GETDENTS_BUFFER_SIZE );
+    while ( true )
+    {
+        long bytes = syscall( SYS_getdents64, fd, &buffer[0], buffer.size() );
+        if ( bytes <= 0 )
+        {
+            break;
+        }
+        long position = 0;
+        while ( position < bytes )
+        {
+            const linux_dirent64* dirent = reinterpret_cast<const linux_dirent64*>( &buffer[position] );
+            position += dirent->d_reclen;
+            const char* name = dirent->d_name;
+            if ( name[0] == '.' && (name[1] == 0 || (name[1] == '.' && name[2] == 0)) )
+            {
+                continue;
+            }
+
+            DirectoryEntry entry;
+            entry.path.reserve( prefix.size() + strlen(name) );
+            entry.path.append( prefix );
+            entry.path.append( name );
+            switch ( dirent->d_type )
+            {
+                case DT_REG:
+                    entry.type = DIRECTORY_ENTRY_FILE;
+                    break;
+                case DT_DIR:
+                    entry.type = DIRECTORY_ENTRY_DIRECTORY;
+                    break;
+                case DT_LNK:
+                    entry.type = DIRECTORY_ENTRY_LINK;
+                    break;
+                case DT_UNKNOWN:
+                    entry.type = lstat_type( entry.path );
+                    break;
+                default:
+                    entry.type = DIRECTORY_ENTRY_OTHER;
+                    break;
+            }
+            entries->push_back( std::move(entry) );
+        }
+    }
+    close( fd );
+#else
+    std::error_code error;
+    std::filesystem::directory_iterator i( path, error );
+    std::filesystem::directory_iterator end;
+    while ( !error && i != end )
+    {
+        std::error_code type_error;
+        std::filesystem::file_status status = i->symlink_status( type_error );
+        DirectoryEntry entry;
+        entry.path = i->path().string();
+        if ( std::filesystem::is_regular_file(status) )
+        {
+            entry.type = DIRECTORY_ENTRY_FILE;
+        }
+        else if ( std::filesystem::is_directory(status) )
+        {
+            entry.type = DIRECTORY_ENTRY_DIRECTORY;
+        }
+        else if ( std::filesystem::is_symlink(status) )
+        {
+            entry.type = DIRECTORY_ENTRY_LINK;
+        }
+        else
+        {
+            entry.type = DIRECTORY_ENTRY_OTHER;
+        }
+        entries->push_back( std::move(entry) );
+        i.increment( error );
+    }
+#endif
+}
+
+void DirectoryReader::push( const std::string& path )
+{
+    levels_.push_back( Level() );
+    Level& level = levels_.back();
+    level.index = 0;
+    read( path, &level.entries );
+    if ( level.entries.empty() )
+    {
+        levels_.pop_back();
+    }
+}
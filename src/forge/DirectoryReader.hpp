@@ -0,0 +1,69 @@
+#ifndef FORGE_DIRECTORYREADER_HPP_INCLUDED
+#define FORGE_DIRECTORYREADER_HPP_INCLUDED
+
+#include <vector>
+#include <string>
+
+namespace sweet
+{
+
+namespace forge
+{
+
+/**
+// The types of entry returned by DirectoryReader.
+*/
+enum DirectoryEntryType
+{
+    DIRECTORY_ENTRY_FILE, ///< A regular file.
+    DIRECTORY_ENTRY_DIRECTORY, ///< A directory.
+    DIRECTORY_ENTRY_LINK, ///< A symbolic link (not followed).
+    DIRECTORY_ENTRY_OTHER ///< Any other type of entry (device, pipe, socket, etc).
+};
+
+/**
+// An entry returned by DirectoryReader.
+*/
+struct DirectoryEntry
+{
+    std::string path; ///< The path to the entry.
+    DirectoryEntryType type; ///< The type of the entry.
+};
+
+/**
+// Read the entries of a directory, and optionally of the directories
+// beneath it, in bulk.
+//
+// Each directory is read in one pass, with `getdents64()` on Linux, and
+// its entries buffered so that only one directory is open at a time.  The
+// type of each entry comes from the directory itself so that callers don't
+// need to `stat()` every entry to tell files from directories.  Entries
+// are returned in directory order with a directory's entries returned
+// directly after the directory when reading recursively.  Symbolic links
+// aren't followed.
+*/
+class DirectoryReader
+{
+    struct Level
+    {
+        std::vector<DirectoryEntry> entries; ///< The entries read from the directory.
+        size_t index; ///< The index of the next entry to return.
+    };
+
+    bool recursive_; ///< True to read the directories beneath the directory too.
+    std::vector<Level> levels_; ///< The directories being read from outermost to innermost.
+
+public:
+    DirectoryReader( const std::string& path, bool recursive );
+    bool next( DirectoryEntry* entry );
+    static void read( const std::string& path, std::vector<DirectoryEntry>* entries );
+
+private:
+    void push( const std::string& path );
+};
+
+}
+
+}
+
+#endif
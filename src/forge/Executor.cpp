@@ -9,10 +9,12 @@
 #include "Context.hpp"
 #include "Reader.hpp"
 #include "Scheduler.hpp"
+#include <forge/forge_lua/LuaStatePool.hpp>
 #include <process/Process.hpp>
 #include <process/Environment.hpp>
 #include <error/Error.hpp>
 #include <assert/assert.hpp>
+#include <chrono>
 #include <stdlib.h>
 
 #if defined BUILD_OS_WINDOWS
@@ -28,24 +30,34 @@ using namespace sweet;
 using namespace sweet::process;
 using namespace sweet::forge;
 
+static const int KILL_DELAY_MILLISECONDS = 2000;
+
 Executor::Executor( Forge* forge )
 : forge_( forge ),
   jobs_mutex_(),
   jobs_empty_condition_(),
   jobs_ready_condition_(),
   jobs_(),
+  processes_empty_condition_(),
+  processes_(),
   forge_hooks_library_(),
+  lua_state_pool_( nullptr ),
   maximum_parallel_jobs_( 1 ),
   threads_(),
-  done_( false )
+  kill_thread_( nullptr ),
+  done_( false ),
+  cancelled_( false )
 {
     SWEET_ASSERT( forge_ );
     initialize_build_hooks_windows();
+    lua_state_pool_ = new LuaStatePool;
 }
 
 Executor::~Executor()
 {
     stop();
+    delete lua_state_pool_;
+    lua_state_pool_ = nullptr;
 }
 
 const std::string& Executor::forge_hooks_library() const
@@ -80,6 +92,76 @@ void Executor::execute( const std::string& command, const std::string& command_l
     jobs_ready_condition_.notify_all();
 }
 
+/**
+// Call a function in a Lua module on a separate Lua state in the thread
+// pool (see LuaStatePool::call()).
+*/
+void Executor::spawn_lua( const std::string& package_path, const std::string& module, const std::string& function, const std::string& arguments, Context* context )
+{
+    SWEET_ASSERT( !module.empty() );
+    SWEET_ASSERT( !function.empty() );
+    SWEET_ASSERT( context );
+
+    start();
+    std::unique_lock<std::mutex> lock( jobs_mutex_ );
+    jobs_.push_back( std::bind(&Executor::thread_spawn_lua, this, package_path, module, function, arguments, context) );
+    jobs_ready_condition_.notify_all();
+}
+
+/**
+// Cancel queued and running jobs.
+//
+// Jobs that haven't started yet finish immediately with a failing exit code
+// without running their process.  Running processes are sent SIGTERM and, if
+// they haven't exited after a short delay, SIGKILL.  Processes are only 
+// signalled along with the processes that they start when they were started 
+// in their own process group, i.e. when Forge::keep_going() limits the 
+// number of failures.
+//
+// Jobs stay cancelled until Executor::reset_cancelled() is called.
+*/
+void Executor::cancel()
+{
+    std::unique_lock<std::mutex> lock( jobs_mutex_ );
+    if ( !cancelled_ )
+    {
+        cancelled_ = true;
+        for ( vector<Process*>::const_iterator process = processes_.begin(); process != processes_.end(); ++process )
+        {
+            (*process)->terminate( false );
+        }
+        SWEET_ASSERT( !kill_thread_ );
+        kill_thread_ = new std::thread( &Executor::thread_kill, this );
+    }
+}
+
+/**
+// Have jobs been cancelled by a call to Executor::cancel()?
+*/
+bool Executor::cancelled()
+{
+    std::unique_lock<std::mutex> lock( jobs_mutex_ );
+    return cancelled_;
+}
+
+/**
+// Resume running jobs after they've been cancelled.
+//
+// Waits for the thread that kills processes that ignore SIGTERM to finish
+// so this should only be called once there are no more jobs running.
+*/
+void Executor::reset_cancelled()
+{
+    if ( kill_thread_ )
+    {
+        kill_thread_->join();
+        delete kill_thread_;
+        kill_thread_ = nullptr;
+    }
+    std::unique_lock<std::mutex> lock( jobs_mutex_ );
+    cancelled_ = false;
+}
+
 int Executor::thread_main( void* context )
 {
     Executor* executor = reinterpret_cast<Executor*>( context );
@@ -110,9 +192,60 @@ void Executor::thread_process()
     }
 }
 
+void Executor::thread_kill()
+{
+    std::unique_lock<std::mutex> lock( jobs_mutex_ );
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds( KILL_DELAY_MILLISECONDS );
+    while ( !processes_.empty() && processes_empty_condition_.wait_until(lock, deadline) != std::cv_status::timeout )
+    {
+    }
+    for ( vector<Process*>::const_iterator process = processes_.begin(); process != processes_.end(); ++process )
+    {
+        (*process)->terminate( true );
+    }
+}
+
 void Executor::thread_execute( const std::string& command, const std::string& command_line, process::Environment* environment, Filter* dependencies_filter, Filter* stdout_filter, Filter* stderr_filter, Arguments* arguments, Target* working_directory, Context* context )
 {
     SWEET_ASSERT( forge_ );
+
+    // Track running processes so that they can be terminated if jobs are 
+    // cancelled.  Processes that start after jobs are cancelled are 
+    // terminated as soon as they're tracked.
+    struct RunningProcess
+    {
+        Executor* executor_;
+        Process* process_;
+
+        RunningProcess( Executor* executor, Process* process )
+        : executor_( executor ),
+          process_( process )
+        {
+            std::unique_lock<std::mutex> lock( executor_->jobs_mutex_ );
+            executor_->processes_.push_back( process_ );
+            if ( executor_->cancelled_ )
+            {
+                process_->terminate( false );
+            }
+        }
+
+        ~RunningProcess()
+        {
+            std::unique_lock<std::mutex> lock( executor_->jobs_mutex_ );
+            vector<Process*>& processes = executor_->processes_;
+            processes.erase( find(processes.begin(), processes.end(), process_) );
+            if ( processes.empty() )
+            {
+                executor_->processes_empty_condition_.notify_all();
+            }
+        }
+    };
+
+    if ( cancelled() )
+    {
+        forge_->scheduler()->push_execute_finished( EXIT_FAILURE, context, environment );
+        return;
+    }
     
     try
     {
@@ -128,12 +261,14 @@ void Executor::thread_execute( const std::string& command, const std::string& co
         process.directory( working_directory->path().c_str() );
         process.environment( environment );
         process.start_suspended( true );
+        process.process_group( forge_->keep_going() > 0 );
 
         intptr_t read_dependencies_pipe = dependencies_filter && !forge_hooks_library_.empty() ? process.pipe( PIPE_USER_0 ) : -1;
         intptr_t write_dependencies_pipe = (intptr_t) process.write_pipe( 0 );
         intptr_t stdout_pipe = process.pipe( PIPE_STDOUT );
         intptr_t stderr_pipe = process.pipe( PIPE_STDERR );
         process.run( command_line.c_str() );
+        RunningProcess running_process( this, &process );
         inject_build_hooks_windows( &process, write_dependencies_pipe );
         process.resume();
 
@@ -150,12 +285,35 @@ void Executor::thread_execute( const std::string& command, const std::string& co
 
     catch ( const std::exception& exception )
     {
+        // Don't report processes failing because they've been terminated 
+        // after jobs were cancelled; the failure that caused the cancel has
+        // already been reported.
         Scheduler* scheduler = forge_->scheduler();
-        scheduler->push_errorf( "%s", exception.what() );
+        if ( !cancelled() )
+        {
+            scheduler->push_errorf( "%s", exception.what() );
+        }
         scheduler->push_execute_finished( EXIT_FAILURE, context, environment );
     }
 }
 
+void Executor::thread_spawn_lua( const std::string& package_path, const std::string& module, const std::string& function, const std::string& arguments, Context* context )
+{
+    SWEET_ASSERT( forge_ );
+    SWEET_ASSERT( lua_state_pool_ );
+
+    Scheduler* scheduler = forge_->scheduler();
+    if ( cancelled() )
+    {
+        scheduler->push_spawn_lua_finished( false, "Cancelled calling '" + module + "." + function + "'", context );
+        return;
+    }
+
+    string results;
+    bool success = lua_state_pool_->call( package_path, module, function, arguments, &results );
+    scheduler->push_spawn_lua_finished( success, results, context );
+}
+
 void Executor::start()
 {
     SWEET_ASSERT( maximum_parallel_jobs_ > 0 );
@@ -210,6 +368,8 @@ void Executor::stop()
             delete threads.back();
             threads.pop_back();
         }
+
+        reset_cancelled();
     }
 }
 
@@ -28,6 +28,7 @@ class Context;
 class Target;
 class Filter;
 class Forge;
+class LuaStatePool;
 
 /**
 // A thread pool and queue of scan and execute calls to be executed in that
@@ -40,10 +41,15 @@ class Executor
     std::condition_variable jobs_empty_condition_; ///< The condition attribute that is used to notify threads that there are jobs ready to be processed.
     std::condition_variable jobs_ready_condition_; ///< The condition attribute that is used to notify threads that there are jobs ready to be processed.
     std::deque<std::function<void ()> > jobs_; ///< The functions to be executed in the thread pool.
+    std::condition_variable processes_empty_condition_; ///< The condition attribute that is used to notify the kill thread that there are no processes running.
+    std::vector<process::Process*> processes_; ///< The processes that are currently running.
     std::string forge_hooks_library_; ///< The full path to the build hooks library.
+    LuaStatePool* lua_state_pool_; ///< The Lua states used to call Lua functions in the thread pool.
     int maximum_parallel_jobs_; ///< The maximum number of parallel jobs to allow.
     std::vector<std::thread*> threads_; ///< The thread pool of threads used to process Jobs.
+    std::thread* kill_thread_; ///< The thread that kills processes that haven't exited after being cancelled.
     bool done_; ///< Whether or not this Executor has finished processing (indicates to the threads in the thread pool that they should return).
+    bool cancelled_; ///< Whether or not jobs have been cancelled (see Executor::cancel()).
 
     public:
         Executor( Forge* forge );
@@ -53,11 +59,17 @@ class Executor
         void set_forge_hooks_library( const std::string& forge_hook_library );
         void set_maximum_parallel_jobs( int maximum_parallel_jobs );
         void execute( const std::string& command, const std::string& command_line, process::Environment* environment, Filter* dependencies_filter, Filter* stdout_filter, Filter* stderr_filter, Arguments* arguments, Context* context );
+        void spawn_lua( const std::string& package_path, const std::string& module, const std::string& function, const std::string& arguments, Context* context );
+        void cancel();
+        bool cancelled();
+        void reset_cancelled();
 
     private:
         static int thread_main( void* context );
+        void thread_kill();
         void thread_process();
         void thread_execute( const std::string& command, const std::string& command_line, process::Environment* environment, Filter* dependencies_filter, Filter* stdout_filter, Filter* stderr_filter, Arguments* arguments, Target* working_directory, Context* context );
+        void thread_spawn_lua( const std::string& package_path, const std::string& module, const std::string& function, const std::string& arguments, Context* context );
         void start();
         void stop();
         process::Environment* inject_build_hooks_linux( process::Environment* environment, bool dependencies_filter_exists ) const;
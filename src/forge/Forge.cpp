@@ -8,12 +8,14 @@
 #include "Scheduler.hpp"
 #include "Executor.hpp"
 #include "Reader.hpp"
+#include "BytecodeCache.hpp"
 #include "Graph.hpp"
 #include "Toolset.hpp"
 #include "Target.hpp"
 #include "Context.hpp"
 #include "path_functions.hpp"
 #include <forge/forge_lua/Lua.hpp>
+#include <forge/forge_lua/LuaAllocator.hpp>
 #include <forge/forge_lua/LuaTarget.hpp>
 #include <forge/forge_lua/LuaRule.hpp>
 #include <forge/forge_lua/LuaToolset.hpp>
@@ -26,6 +28,31 @@ using std::filesystem::path;
 using namespace sweet;
 using namespace sweet::forge;
 
+/**
+// Hash the build script, variable assignments, and command for a run with
+// FNV-1a so that a cached Graph is only reused by identical invocations.
+*/
+static uint64_t configuration_hash( const std::vector<std::string>& assignments, const std::string& build_script, const std::string& command )
+{
+    const uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325;
+    const uint64_t FNV_PRIME = 0x100000001b3;
+    uint64_t hash = FNV_OFFSET_BASIS;
+    auto append = [&hash]( const std::string& value )
+    {
+        for ( size_t i = 0; i <= value.size(); ++i )
+        {
+            hash = (hash ^ static_cast<unsigned char>(value.c_str()[i])) * FNV_PRIME;
+        }
+    };
+    append( build_script );
+    for ( vector<string>::const_iterator i = assignments.begin(); i != assignments.end(); ++i )
+    {
+        append( *i );
+    }
+    append( command );
+    return hash;
+}
+
 /**
 // Constructor.
 //
@@ -41,6 +68,7 @@ Forge::Forge( const std::string& initial_directory, error::ErrorPolicy& error_po
 , lua_( nullptr )
 , system_( nullptr )
 , reader_( nullptr )
+, bytecode_cache_( nullptr )
 , graph_( nullptr )
 , scheduler_( nullptr )
 , executor_( nullptr )
@@ -49,6 +77,7 @@ Forge::Forge( const std::string& initial_directory, error::ErrorPolicy& error_po
 , home_directory_()
 , executable_directory_()
 , stack_trace_enabled_( false )
+, keep_going_( 0 )
 {
     SWEET_ASSERT( std::filesystem::path(initial_directory).is_absolute() );
 
@@ -105,6 +134,18 @@ Reader* Forge::reader() const
     return reader_;
 }
 
+/**
+// Get the BytecodeCache for this Forge.
+//
+// @return
+//  The BytecodeCache.
+*/
+BytecodeCache* Forge::bytecode_cache() const
+{
+    SWEET_ASSERT( bytecode_cache_ );
+    return bytecode_cache_;
+}
+
 /**
 // Get the Graph for this Forge.
 //
@@ -288,6 +329,36 @@ int Forge::maximum_parallel_jobs() const
     return executor_->maximum_parallel_jobs();
 }
 
+/**
+// Set the number of failed jobs that stops traversals.
+//
+// Once \e keep_going jobs have failed a traversal stops visiting targets,
+// cancels the processes that are still running, and waits for the visits 
+// in progress to finish.  The targets that were built before the traversal
+// stopped stay built so that saving the dependency graph doesn't lose 
+// them.
+//
+// @param keep_going
+//  The number of failed jobs to stop after (e.g. 1 to stop on the first
+//  failure) or 0 to keep going no matter how many jobs fail (the default).
+*/
+void Forge::set_keep_going( int keep_going )
+{
+    keep_going_ = keep_going > 0 ? keep_going : 0;
+}
+
+/**
+// Get the number of failed jobs that stops traversals.
+//
+// @return
+//  The number of failed jobs that stops traversals or 0 if traversals never
+//  stop because of failed jobs.
+*/
+int Forge::keep_going() const
+{
+    return keep_going_;
+}
+
 /**
 // Set the path to the build hooks library.
 //
@@ -343,6 +414,7 @@ void Forge::reset()
     lua_ = new Lua( this );
     system_ = new System;
     reader_ = new Reader( this );
+    bytecode_cache_ = new BytecodeCache( this );
     graph_ = new Graph( this );
     scheduler_ = new Scheduler( this );
     executor_ = new Executor( this );
@@ -363,6 +435,7 @@ void Forge::destroy()
     delete executor_;
     delete scheduler_;
     delete graph_;
+    delete bytecode_cache_;
     delete reader_;
     delete system_;
     delete lua_;
@@ -391,6 +464,10 @@ int Forge::file( const std::string& filename )
 // @param command
 //  The global Lua function to call to execute the command.
 //
+// The build script is added as a dependency of the cache Target, if the 
+// build script loaded a cache file, so that changes to the build script 
+// prevent the cached Graph from being reused on later runs.
+//
 // @return
 //  The number of errors that occurred executing the command.
 */
@@ -398,8 +475,17 @@ int Forge::command( const std::vector<std::string>& assignments, const std::stri
 {
     reset();
     error_policy_.push_errors();
+    graph_->set_configuration_hash( configuration_hash(assignments, build_script, command) );
     lua_->assign_variables( assignments );
-    scheduler_->load( path(root_directory_ / build_script) );
+    path build_script_path = path( root_directory_ / build_script ).lexically_normal();
+    scheduler_->load( build_script_path );
+    Target* cache_target = graph_->cache_target();
+    if ( cache_target )
+    {
+        Target* build_script_target = graph_->target( build_script_path.generic_string() );
+        build_script_target->set_filename( build_script_path.generic_string(), 0 );
+        cache_target->add_explicit_dependency( build_script_target );
+    }
     if ( error_policy_.errors() == 0 )
     {
         scheduler_->command( root_directory_, command );
@@ -421,6 +507,27 @@ int Forge::script( const std::string& script )
     return error_policy_.pop_errors();
 }
 
+/**
+// Print statistics gathered while running the most recent command or
+// script.
+*/
+void Forge::print_statistics()
+{
+    SWEET_ASSERT( scheduler_ );
+    SWEET_ASSERT( graph_ );
+    SWEET_ASSERT( lua_ );
+    outputf( "forge: contexts: %d live, %d created, %d recycled", scheduler_->live_contexts(), scheduler_->created_contexts(), scheduler_->recycled_contexts() );
+    size_t targets = 0;
+    size_t target_bytes = graph_->root_target()->memory_usage( &targets );
+    outputf( "forge: targets: %zu targets, %zu bytes, %zu bytes per target", targets, target_bytes, target_bytes / targets );
+    size_t ids = 0;
+    size_t id_bytes = graph_->ids_memory_usage( &ids );
+    outputf( "forge: ids: %zu interned, %zu bytes", ids, id_bytes );
+    outputf( "forge: prepare: %d prepared, %d restored, %.3f seconds hashing structure", graph_->prepared_targets(), graph_->restored_targets(), graph_->structural_hash_seconds() );
+    LuaAllocator* lua_allocator = lua_->lua_allocator();
+    outputf( "forge: lua memory: %zu bytes in use, %zu bytes peak, %zu bytes in small block chunks", lua_allocator->bytes_in_use(), lua_allocator->peak_bytes_in_use(), lua_allocator->reserved_bytes() );
+}
+
 void Forge::create_target_lua_binding( Target* target )
 {
     SWEET_ASSERT( lua_ );
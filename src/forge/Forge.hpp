@@ -22,6 +22,7 @@ namespace forge
 
 class Context;
 class Reader;
+class BytecodeCache;
 class Executor;
 class Scheduler;
 class System;
@@ -40,6 +41,7 @@ class Forge
     Lua* lua_; ///< The Lua bindings to the Forge library.
     System* system_; ///< The System that provides access to the operating system.
     Reader* reader_; ///< The reader that filters executable output and dependencies.
+    BytecodeCache* bytecode_cache_; ///< The cache of compiled buildfiles and Lua modules.
     Graph* graph_; ///< The dependency graph of targets used to determine which targets are outdated.
     Scheduler* scheduler_; ///< The scheduler that schedules environments to process jobs in the dependency graph.
     Executor* executor_; ///< The executor that schedules threads to process commands.
@@ -48,6 +50,7 @@ class Forge
     std::filesystem::path home_directory_; ///< The full path to the user's home directory.
     std::filesystem::path executable_directory_; ///< The full path to the build executable directory.
     bool stack_trace_enabled_; ///< Print stack traces on error when true.
+    int keep_going_; ///< The number of failed jobs to stop a traversal after or 0 to never stop.
 
     public:
         Forge( const std::string& initial_directory, error::ErrorPolicy& error_policy );
@@ -56,6 +59,7 @@ class Forge
         error::ErrorPolicy& error_policy() const;
         System* system() const;
         Reader* reader() const;
+        BytecodeCache* bytecode_cache() const;
         Graph* graph() const;
         Scheduler* scheduler() const;
         Executor* executor() const;
@@ -77,6 +81,8 @@ class Forge
         bool stack_trace_enabled() const;
         void set_maximum_parallel_jobs( int maximum_parallel_jobs );
         int maximum_parallel_jobs() const;
+        void set_keep_going( int keep_going );
+        int keep_going() const;
         void set_forge_hooks_library( const std::string& forge_hooks_library );
         const std::string& forge_hooks_library() const;
 
@@ -87,6 +93,7 @@ class Forge
         int file( const std::string& filename );
         int command( const std::vector<std::string>& assignments, const std::string& build_script, const std::string& command );
         int script( const std::string& script );
+        void print_statistics();
 
         void create_target_lua_binding( Target* target );
         void update_target_lua_binding( Target* target );
@@ -9,6 +9,7 @@
 #include "Target.hpp"
 #include "Forge.hpp"
 #include "Scheduler.hpp"
+#include "Context.hpp"
 #include "System.hpp"
 #include "path_functions.hpp"
 #include "GraphReader.hpp"
@@ -16,21 +17,33 @@
 #include <assert/assert.hpp>
 #include <algorithm>
 #include <chrono>
+#include <climits>
 #include <ctime>
 #include <list>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
 #include <memory>
 #include <fstream>
+#include <sstream>
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
 
 using std::list;
+using std::map;
+using std::set;
 using std::vector;
 using std::string;
 using std::unique_ptr;
+using std::unordered_set;
 using std::transform;
 using namespace sweet;
 using namespace sweet::forge;
 
+static const uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325;
+static const uint64_t FNV_PRIME = 0x100000001b3;
+
 /**
 // Constructor.
 */
@@ -39,11 +52,28 @@ Graph::Graph()
 , rules_()
 , toolsets_()
 , filename_()
+, ids_()
 , root_target_( nullptr )
 , cache_target_( nullptr )
+, configuration_hash_( 0 )
+, reuse_( false )
+, reused_( false )
+, incremental_( false )
+, outdated_buildfiles_()
 , traversal_in_progress_( false )
 , visited_revision_( 0 )
 , successful_revision_( 0 )
+, checkpoint_interval_( 0 )
+, checkpoint_jobs_( 0 )
+, checkpoint_thread_( nullptr )
+, dependency_filters_()
+, transitive_dependencies_()
+, structural_hashes_()
+, structural_hash_time_( 0 )
+, prepared_targets_( 0 )
+, restored_targets_( 0 )
+, directory_cache_()
+, directory_mirror_()
 {
 }
 
@@ -58,11 +88,28 @@ Graph::Graph( Forge* forge )
 , rules_()
 , toolsets_()
 , filename_()
+, ids_()
 , root_target_()
 , cache_target_()
+, configuration_hash_( 0 )
+, reuse_( false )
+, reused_( false )
+, incremental_( false )
+, outdated_buildfiles_()
 , traversal_in_progress_( false )
 , visited_revision_( 0 )
 , successful_revision_( 0 )
+, checkpoint_interval_( 0 )
+, checkpoint_jobs_( 0 )
+, checkpoint_thread_( nullptr )
+, dependency_filters_()
+, transitive_dependencies_()
+, structural_hashes_()
+, structural_hash_time_( 0 )
+, prepared_targets_( 0 )
+, restored_targets_( 0 )
+, directory_cache_()
+, directory_mirror_()
 {
     SWEET_ASSERT( forge_ );
     root_target_.reset( new Target("$$root", this) );
@@ -70,6 +117,8 @@ Graph::Graph( Forge* forge )
 
 Graph::~Graph()
 {
+    wait_for_checkpoint();
+
     while ( !toolsets_.empty() )
     {
         delete toolsets_.back();
@@ -105,6 +154,50 @@ Target* Graph::root_target() const
     return root_target_.get();
 }
 
+/**
+// Intern a Target identifier in this Graph.
+//
+// Identifiers repeat across the Target namespace, for example the same
+// source and object filenames appear in the directories of each variant, so
+// Targets point to a single copy of each identifier rather than storing their
+// own.  Interned identifiers live as long as this Graph or until a Graph
+// loaded from a cache file replaces them (see Graph::load_binary()).
+//
+// @param id
+//  The identifier to intern.
+//
+// @return
+//  The interned copy of \e id.
+*/
+const std::string* Graph::intern( const std::string& id )
+{
+    return &*ids_.insert( id ).first;
+}
+
+/**
+// Estimate the memory used by the identifiers interned in this Graph.
+//
+// @param ids
+//  A count to set to the number of interned identifiers (assumed not null).
+//
+// @return
+//  The number of bytes used by the interned identifiers.
+*/
+size_t Graph::ids_memory_usage( size_t* ids ) const
+{
+    SWEET_ASSERT( ids );
+
+    const size_t SMALL_STRING_CAPACITY = string().capacity();
+    size_t bytes = ids_.bucket_count() * sizeof(void*);
+    for ( unordered_set<string>::const_iterator id = ids_.begin(); id != ids_.end(); ++id )
+    {
+        bytes += sizeof(string) + 2 * sizeof(void*);
+        bytes += id->capacity() > SMALL_STRING_CAPACITY ? id->capacity() + 1 : 0;
+    }
+    *ids = ids_.size();
+    return bytes;
+}
+
 /**
 // Get the Target for the file that this Graph is loaded from.
 //
@@ -129,6 +222,71 @@ Forge* Graph::forge() const
     return forge_;
 }
 
+/**
+// Set the hash of the configuration that the cache Target is built with.
+//
+// The configuration hash is stored as the hash of the cache Target so that
+// the cache is considered outdated when the build script, the variables
+// assigned on the command line, or the command change between runs even 
+// when none of the buildfiles have.
+//
+// @param configuration_hash
+//  The configuration hash to set (must be set before the Graph is loaded to
+//  have any effect).
+*/
+void Graph::set_configuration_hash( uint64_t configuration_hash )
+{
+    configuration_hash_ = configuration_hash;
+}
+
+/**
+// Get the hash of the configuration that the cache Target is built with.
+//
+// @return
+//  The configuration hash.
+*/
+uint64_t Graph::configuration_hash() const
+{
+    return configuration_hash_;
+}
+
+/**
+// Has the Graph loaded from the cache file been reused as is?
+//
+// @return
+//  True if the most recent call to Graph::load_binary() reused the Graph 
+//  loaded from the cache file without requiring any buildfiles, other than
+//  the build script, to be loaded again otherwise false.
+*/
+bool Graph::reused() const
+{
+    return reused_;
+}
+
+/**
+// Get the cache of directory listings used to glob files.
+//
+// The cache is saved and loaded with this Graph so that globbing files in
+// directories that haven't changed since the previous build doesn't read
+// those directories again (see DirectoryCache).
+*/
+DirectoryCache* Graph::directory_cache()
+{
+    return &directory_cache_;
+}
+
+/**
+// Get the mirrors of directories copied by CopyDirectory targets.
+//
+// The manifests of mirrored directories are saved and loaded with this
+// Graph so that only the entries that have changed since the previous build
+// are copied (see DirectoryMirror).
+*/
+DirectoryMirror* Graph::directory_mirror()
+{
+    return &directory_mirror_;
+}
+
 /**
 // Mark this graph as being traversed and increment the visited and
 // successful revisions.
@@ -146,6 +304,203 @@ void Graph::begin_traversal()
     traversal_in_progress_ = true;
     ++visited_revision_;
     ++successful_revision_;
+    dependency_filters_.clear();
+    transitive_dependencies_.clear();
+    structural_hashes_.clear();
+}
+
+/**
+// Set how often postorder traversals checkpoint this Graph.
+//
+// Checkpoints save the built state of the Targets built so far to the file
+// that this Graph was loaded from so that an interrupted build doesn't 
+// build them again (see Graph::checkpoint_binary()).
+//
+// @param seconds
+//  The number of seconds between checkpoints or 0 to not checkpoint as time
+//  elapses.
+//
+// @param jobs
+//  The number of jobs to complete between checkpoints or 0 to not checkpoint
+//  as jobs complete.
+*/
+void Graph::set_checkpoint_interval( int seconds, int jobs )
+{
+    checkpoint_interval_ = seconds > 0 ? seconds : 0;
+    checkpoint_jobs_ = jobs > 0 ? jobs : 0;
+}
+
+/**
+// Get the number of seconds between checkpoints or 0 if postorder 
+// traversals don't checkpoint as time elapses.
+*/
+int Graph::checkpoint_interval() const
+{
+    return checkpoint_interval_;
+}
+
+/**
+// Get the number of jobs completed between checkpoints or 0 if postorder
+// traversals don't checkpoint as jobs complete.
+*/
+int Graph::checkpoint_jobs() const
+{
+    return checkpoint_jobs_;
+}
+
+/**
+// Walk the transitive dependencies of \e target selected by \e filter.
+//
+// Each dependency of \e target of the kinds followed by \e filter is
+// yielded and/or recursed into as \e filter selects.  Dependencies yielded
+// more than once are kept only at their last position so that Targets are
+// listed before the Targets that they depend on, e.g. static libraries in
+// the order they're passed to a linker.  Cycles are broken by not recursing
+// into Targets that are already being walked.
+//
+// The dependencies of each Targetrecursed into are remembered, by Target
+// and filter, until the current traversal ends or that Target's
+// dependencies change.  This avoids walking shared dependencies again for
+// every Target that depends on them, e.g. the libraries shared by many
+// executables, while their dependencies are collected in the prepare pass.
+// The dependencies of \e target itself are always walked again.
+//
+// @param target
+//  The Target to walk the dependencies of.
+//
+// @param filter
+//  The filter that selects the dependencies to follow, yield, and recurse
+//  into.
+//
+// @return
+//  The yielded dependencies.
+*/
+std::vector<Target*> Graph::transitive_dependencies( Target* target, const DependencyFilter& filter )
+{
+    SWEET_ASSERT( target );
+
+    if ( !traversal_in_progress_ )
+    {
+        map<std::pair<Target*, int>, vector<Target*>> transitive_dependencies;
+        return walk_transitive_dependencies( target, filter, 0, &transitive_dependencies );
+    }
+
+    int filter_index = 0;
+    while ( filter_index < int(dependency_filters_.size()) && !(dependency_filters_[filter_index] == filter) )
+    {
+        ++filter_index;
+    }
+    if ( filter_index == int(dependency_filters_.size()) )
+    {
+        dependency_filters_.push_back( filter );
+    }
+    return walk_transitive_dependencies( target, filter, filter_index, &transitive_dependencies_ );
+}
+
+/**
+// Calculate the structural hash of \e target.
+//
+// The structural hash covers the path, Rule, and settings hash (see
+// Target::set_hash()) of \e target and of every Target that it
+// transitively depends on, through explicit and passive dependencies,
+// along with the kind of each dependency.  It changes whenever the
+// dependency structure that a structural prepare function examines changes
+// and is used to skip preparing Targets again when it hasn't (see
+// Target::restore_prepared()).  Implicit and ordering dependencies,
+// filenames, and attributes set directly on Targets from Lua aren't covered
+// so that discovering headers doesn't invalidate every binary and only
+// prepare functions that don't read them can be skipped.
+//
+// Hashes are remembered for each Target hashed during a traversal, until
+// the traversal ends or that Target's dependencies change, so that hashing
+// every binary in a prepare pass hashes shared dependencies only once.
+//
+// @return
+//  The structural hash of \e target (never 0).
+*/
+uint64_t Graph::structural_hash( Target* target )
+{
+    SWEET_ASSERT( target );
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    uint64_t hash = 0;
+    if ( !traversal_in_progress_ )
+    {
+        std::unordered_map<Target*, uint64_t> structural_hashes;
+        hash = hash_structure( target, &structural_hashes );
+    }
+    else
+    {
+        hash = hash_structure( target, &structural_hashes_ );
+    }
+    structural_hash_time_ += std::chrono::steady_clock::now() - start;
+    return hash;
+}
+
+/**
+// Discard remembered transitive dependencies and structural hashes after
+// the dependencies of \e target change.
+//
+// If \e target has been recursed into then the remembered dependencies of
+// any Target that depends on it may also be out of date so all remembered
+// dependencies are discarded.  Only the structural hash of \e target itself
+// is discarded; Targets that depend on it are prepared before it by the
+// preorder prepare pass and so hash it as it was before it changed.
+*/
+void Graph::dependencies_changed( Target* target )
+{
+    if ( !structural_hashes_.empty() )
+    {
+        structural_hashes_.erase( target );
+    }
+    if ( !transitive_dependencies_.empty() )
+    {
+        map<std::pair<Target*, int>, vector<Target*>>::const_iterator i = transitive_dependencies_.lower_bound( std::make_pair(target, 0) );
+        if ( i != transitive_dependencies_.end() && i->first.first == target )
+        {
+            transitive_dependencies_.clear();
+        }
+    }
+}
+
+/**
+// Count a Target as prepared by calling its prepare function or, if
+// \e restored is true, as restored to how it was last prepared instead.
+*/
+void Graph::count_prepared( bool restored )
+{
+    if ( restored )
+    {
+        ++restored_targets_;
+    }
+    else
+    {
+        ++prepared_targets_;
+    }
+}
+
+/**
+// Get the number of Targets prepared by calling their prepare functions.
+*/
+int Graph::prepared_targets() const
+{
+    return prepared_targets_;
+}
+
+/**
+// Get the number of Targets restored to how they were last prepared without
+// calling their prepare functions.
+*/
+int Graph::restored_targets() const
+{
+    return restored_targets_;
+}
+
+/**
+// Get the total time spent calculating structural hashes in seconds.
+*/
+double Graph::structural_hash_seconds() const
+{
+    return std::chrono::duration<double>( structural_hash_time_ ).count();
 }
 
 /**
@@ -155,6 +510,9 @@ void Graph::end_traversal()
 {
     SWEET_ASSERT( traversal_in_progress_ );
     traversal_in_progress_ = false;
+    dependency_filters_.clear();
+    transitive_dependencies_.clear();
+    structural_hashes_.clear();
 }
 
 /**
@@ -440,6 +798,11 @@ Target* Graph::find_or_create_target_by_element( Target* target, const std::stri
 /**
 // Load a buildfile into this Graph.
 //
+// The buildfile is recorded as being loaded by the current buildfile, if
+// any, so that it is loaded again whenever the current buildfile needs to 
+// be.  When this Graph has been reused from a cache file only buildfiles 
+// that need to be loaded again are loaded (see Graph::load_binary()).
+//
 // @param filename
 //  The name of the buildfile to load.
 //
@@ -456,42 +819,42 @@ int Graph::buildfile( const std::string& filename )
     SWEET_ASSERT( path.is_absolute() );
     Target* buildfile_target = Graph::target( path.generic_string() );
     buildfile_target->set_filename( path.generic_string(), 0 );
+    Context* context = forge_->scheduler()->context();
+    if ( context )
+    {
+        buildfile_target->add_buildfile( context->current_buildfile() );
+    }
     if ( cache_target_ )
     {
         cache_target_->add_explicit_dependency( buildfile_target );
     }
+    if ( incremental_ && outdated_buildfiles_.find(buildfile_target) == outdated_buildfiles_.end() )
+    {
+        return 0;
+    }
+    directory_cache_.clear_globbed_directories( buildfile_target->path() );
+    directory_mirror_.clear_sources( buildfile_target->path() );
     return forge_->scheduler()->buildfile( path );
 }
 
-struct ScopedVisit
+struct Bind
 {
-    Target* target_;
-
-    ScopedVisit( Target* target )
-    : target_( target )
-    {
-        SWEET_ASSERT( target_ );
-        SWEET_ASSERT( target_->visiting() == false );
-        target_->set_visited( true );
-        target_->set_visiting( true );
-    }
-
-    ~ScopedVisit()
+    struct Visit
     {
-        SWEET_ASSERT( target_ );
-        SWEET_ASSERT( target_->visiting() == true );
-        target_->set_visiting( false );
-    }
-};
+        Target* target_; ///< The Target being visited.
+        int dependency_; ///< The index of the next binding dependency to visit.
+    };
 
-struct Bind
-{
     Forge* forge_;
     int failures_;
+    vector<Visit> visits_; ///< The Targets being visited from the outermost to the innermost.
+    const unordered_set<Target*>* scope_; ///< The Targets to restrict binding to or null to bind all visited Targets.
 
-    Bind( Forge* forge )
+    Bind( Forge* forge, const unordered_set<Target*>* scope = nullptr )
     : forge_( forge ),
-      failures_( 0 )
+      failures_( 0 ),
+      visits_(),
+      scope_( scope )
     {
         SWEET_ASSERT( forge_ );
         forge_->graph()->begin_traversal();
@@ -499,39 +862,67 @@ struct Bind
 
     ~Bind()
     {
+        while ( !visits_.empty() )
+        {
+            visits_.back().target_->set_visiting( false );
+            visits_.pop_back();
+        }
         forge_->graph()->end_traversal();
     }
 
     void visit( Target* target )
     {
         SWEET_ASSERT( target );
+        SWEET_ASSERT( visits_.empty() );
 
+        // Keep the Targets being visited on an explicit stack rather than 
+        // recursing so that arbitrarily deep chains of dependencies don't 
+        // overflow the C++ stack.
         if ( !target->visited() )
         {
-            ScopedVisit visit( target );
+            begin_visit( target );
+        }
 
-            int i = 0;
-            Target* dependency = target->binding_dependency( i );
-            while ( dependency )
+        while ( !visits_.empty() )
+        {
+            Visit& visit = visits_.back();
+            Target* target = visit.target_;
+            Target* dependency = target->binding_dependency( visit.dependency_ );
+            if ( dependency )
             {
-                if ( !dependency->visiting() )
-                {
-                    Bind::visit( dependency );
-                }
-                else
+                ++visit.dependency_;
+                if ( dependency->visiting() )
                 {
                     forge_->errorf( "Cyclic dependency from %s to %s in bind", target->error_identifier().c_str(), dependency->error_identifier().c_str() );
                     dependency->set_successful( true );
                     ++failures_;
                 }
-                ++i;
-                dependency = target->binding_dependency( i );
+                else if ( !dependency->visited() && (!scope_ || scope_->count(dependency)) )
+                {
+                    begin_visit( dependency );
+                }
+            }
+            else
+            {
+                visits_.pop_back();
+                forge_->graph()->directory_mirror()->bind( target );
+                target->bind();
+                target->set_successful( true );
+                SWEET_ASSERT( target->visiting() );
+                target->set_visiting( false );
             }
-
-            target->bind();
-            target->set_successful( true );
         }
     }
+
+    void begin_visit( Target* target )
+    {
+        SWEET_ASSERT( target );
+        SWEET_ASSERT( !target->visiting() );
+        target->set_visited( true );
+        target->set_visiting( true );
+        Visit visit = { target, 0 };
+        visits_.push_back( visit );
+    }
 };
 
 /**
@@ -562,84 +953,476 @@ int Graph::bind( Target* target )
 }
 
 /**
-// Swap this Graph with \e graph.
+// Make a postorder pass over \e targets to bind them.
 //
-// @param graph
-//  The Graph to swap this Graph's members with.
+// Only the Targets in \e targets are bound.  Their dependencies that aren't
+// in \e targets are assumed to be unchanged and keep the timestamps and 
+// outdated flags that they already have.
+//
+// @param targets
+//  The Targets to bind (see Graph::affected_targets()).
+//
+// @return
+//  The number of cyclic dependencies found between \e targets.
 */
-void Graph::swap( Graph& graph )
+int Graph::bind( const std::vector<Target*>& targets )
 {
-    std::swap( root_target_, graph.root_target_ );
+    Graph* graph = forge_->graph();
+    if ( graph->traversal_in_progress() )
+    {
+        forge_->error( "Bind called from within another bind or postorder traversal" );
+        return 0;
+    }
+
+    unordered_set<Target*> scope( targets.begin(), targets.end() );
+    Bind bind( forge_, &scope );
+    for ( vector<Target*>::const_iterator i = targets.begin(); i != targets.end(); ++i )
+    {
+        Target* target = *i;
+        SWEET_ASSERT( target );
+        SWEET_ASSERT( target->graph() == this );
+        bind.visit( target );
+    }
+    return bind.failures_;
 }
 
 /**
-// Clear all of the targets in this graph.
+// Find the Targets affected by changes to \e filenames.
 //
-// The name of the file that this Graph was most recently loaded from is used
-// to create the implicit cache target in the newly cleared Graph.  This gives
-// an implicit target for the cache file that buildfiles are able to depend
-// on (see Graph::buildfile()) so that the cache can be marked as outdated if
-// any buildfiles change and become newer than the cache.
+// An index from each Target to the Targets that depend on it is built on
+// demand from explicit, implicit, ordering, and passive dependencies.  The
+// Targets bound to \e filenames are then found and the index is followed 
+// from them to collect every Target that transitively depends on them.
+// Passive dependencies are included so that binaries are affected by the
+// static libraries that the prepare pass links into them.
 //
-// This might be a bit strange if the Graph is then saved to a cache file with
-// a different filename which is why the save functions don't take filename
-// arguments and one of the load functions must be called first to provide the
-// name of the cache file.
+// Building the index only walks Targets in memory; no files are checked.
+//
+// @param filenames
+//  The absolute paths to the files that have changed.
+//
+// @return
+//  The Targets bound to \e filenames followed by the Targets that depend on
+//  them in breadth first order.
 */
-void Graph::clear()
+std::vector<Target*> Graph::affected_targets( const std::vector<std::string>& filenames )
 {
-    SWEET_ASSERT( forge_ );
+    SWEET_ASSERT( root_target_ );
+
+    unordered_set<string> changed_filenames( filenames.begin(), filenames.end() );
+    vector<Target*> affected;
+    vector<std::pair<Target*, Target*>> dependents;
 
-    struct RecursiveClear
+    vector<Target*> targets;
+    targets.push_back( root_target_.get() );
+    while ( !targets.empty() )
     {
-        static void clear( Target* target )
-        {
-            SWEET_ASSERT( target );
-            target->clear_explicit_dependencies();
-            target->clear_ordering_dependencies();
-            target->destroy_anonymous_targets();
-            target->graph()->forge()->destroy_target_lua_binding( target );
+        Target* target = targets.back();
+        targets.pop_back();
+        SWEET_ASSERT( target );
 
-            const vector<Target*>& targets = target->targets();
-            for ( vector<Target*>::const_iterator i = targets.begin(); i != targets.end(); ++i )
+        const vector<string>& target_filenames = target->filenames();
+        for ( vector<string>::const_iterator filename = target_filenames.begin(); filename != target_filenames.end(); ++filename )
+        {
+            if ( changed_filenames.count(*filename) )
             {
-                Target* target = *i;
-                SWEET_ASSERT( target );
-                RecursiveClear::clear( target );
+                affected.push_back( target );
+                break;
             }
         }
-    };
 
-    RecursiveClear::clear( root_target_.get() );
-}
+        int i = 0;
+        Target* dependency = target->any_dependency( i );
+        while ( dependency )
+        {
+            dependents.push_back( std::make_pair(dependency, target) );
+            ++i;
+            dependency = target->any_dependency( i );
+        }
 
-/**
-// Recover implicit relationships after this Graph has been loaded from an
-// Archive.
-*/
-void Graph::recover()
-{
-    SWEET_ASSERT( root_target_ );
-    root_target_->recover( this );
-    if ( !filename_.empty() )
+        const vector<Target*>& children = target->targets();
+        targets.insert( targets.end(), children.begin(), children.end() );
+    }
+
+    std::sort( dependents.begin(), dependents.end() );
+    unordered_set<Target*> visited( affected.begin(), affected.end() );
+    for ( size_t i = 0; i < affected.size(); ++i )
     {
-        cache_target_ = target( filename_ );
-        cache_target_->set_filename( filename_, 0 );
-        bind( cache_target_ );
+        typedef vector<std::pair<Target*, Target*>>::const_iterator iterator;
+        std::pair<iterator, iterator> range = std::equal_range( 
+            dependents.begin(), dependents.end(), std::make_pair(affected[i], (Target*) nullptr ),
+            []( const std::pair<Target*, Target*>& lhs, const std::pair<Target*, Target*>& rhs ) { return lhs.first < rhs.first; }
+        );
+        for ( iterator dependent = range.first; dependent != range.second; ++dependent )
+        {
+            if ( visited.insert(dependent->second).second )
+            {
+                affected.push_back( dependent->second );
+            }
+        }
     }
+    return affected;
 }
 
 /**
-// Load this Graph from a binary file.
+// Find the Targets that shard \e shard of \e shards builds.
 //
-// @param filename
-//  The name of the file to load this Graph from.
+// The work below each Target is first estimated as one plus the estimates
+// of its dependencies, in a single pass that counts a dependency shared by
+// several Targets once for each of them, so that the estimate grows with
+// the number of jobs that depend on it.  The dependencies of \e target then
+// become units of work.  Units heavier than a shard's share of the total
+// are split into their own dependencies, repeatedly, so that a goal with
+// only one or two large dependencies (e.g. an executable) still divides its
+// jobs between every shard.  Units are assigned heaviest first to the shard
+// with the least weight so far.  Ties are broken by path and shard index so
+// that every machine sharing the same dependency graph makes the same
+// assignment.
+//
+// Each shard builds the units assigned to it and everything that they
+// depend on, so dependencies shared by units in different shards are built
+// by each of those shards.  \e target and the units that were split are
+// left for a final build after the shards' cache files have been merged
+// (see Graph::merge_binary()).
+//
+// @param target
+//  The Target whose dependencies are divided between shards.
+//
+// @param shard
+//  The index of the shard to get the Targets of, from 0 to \e shards - 1.
+//
+// @param shards
+//  The number of shards to divide the build between.
+//
+// @return
+//  The Targets that the shard builds in no particular order.
+*/
+std::vector<Target*> Graph::shard_targets( Target* target, int shard, int shards )
+{
+    SWEET_ASSERT( target );
+    SWEET_ASSERT( target->graph() == this );
+    SWEET_ASSERT( shards > 0 );
+    SWEET_ASSERT( shard >= 0 && shard < shards );
+
+    struct Weigh
+    {
+        Target* target_; ///< The Target being weighed.
+        int index_; ///< The index of the next binding dependency to weigh.
+        size_t weight_; ///< The weight accumulated so far.
+    };
+
+    // Weigh every Target reachable from target from an explicit stack.
+    // Dependencies that are already being weighed, i.e. that are part of a
+    // cycle, add nothing.  Weights saturate rather than overflow.
+    std::unordered_map<Target*, size_t> weights;
+    unordered_set<Target*> weighing;
+    vector<Weigh> stack;
+    Weigh root = { target, 0, 1 };
+    stack.push_back( root );
+    weighing.insert( target );
+    while ( !stack.empty() )
+    {
+        Weigh& weigh = stack.back();
+        Target* dependency = weigh.target_->binding_dependency( weigh.index_ );
+        if ( dependency )
+        {
+            ++weigh.index_;
+            std::unordered_map<Target*, size_t>::const_iterator weighed = weights.find( dependency );
+            if ( weighed != weights.end() )
+            {
+                weigh.weight_ = weigh.weight_ <= SIZE_MAX - weighed->second ? weigh.weight_ + weighed->second : SIZE_MAX;
+            }
+            else if ( weighing.insert(dependency).second )
+            {
+                Weigh dependency_weigh = { dependency, 0, 1 };
+                stack.push_back( dependency_weigh );
+            }
+        }
+        else
+        {
+            Target* weighed_target = weigh.target_;
+            size_t weight = weigh.weight_;
+            weights.insert( std::make_pair(weighed_target, weight) );
+            weighing.erase( weighed_target );
+            stack.pop_back();
+            if ( !stack.empty() )
+            {
+                size_t& parent_weight = stack.back().weight_;
+                parent_weight = parent_weight <= SIZE_MAX - weight ? parent_weight + weight : SIZE_MAX;
+            }
+        }
+    }
+
+    // Split units heavier than a shard's share into their dependencies.
+    size_t share = std::max( (weights[target] - 1) / size_t(shards), size_t(1) );
+    vector<Target*> units;
+    vector<Target*> candidates;
+    unordered_set<Target*> unique;
+    unique.insert( target );
+    int i = 0;
+    Target* dependency = target->binding_dependency( i );
+    while ( dependency )
+    {
+        if ( unique.insert(dependency).second )
+        {
+            candidates.push_back( dependency );
+        }
+        ++i;
+        dependency = target->binding_dependency( i );
+    }
+    while ( !candidates.empty() )
+    {
+        Target* candidate = candidates.back();
+        candidates.pop_back();
+        if ( weights[candidate] > share && candidate->binding_dependency(0) )
+        {
+            int j = 0;
+            Target* dependency = candidate->binding_dependency( j );
+            while ( dependency )
+            {
+                if ( unique.insert(dependency).second )
+                {
+                    candidates.push_back( dependency );
+                }
+                ++j;
+                dependency = candidate->binding_dependency( j );
+            }
+        }
+        else
+        {
+            units.push_back( candidate );
+        }
+    }
+
+    std::sort( units.begin(), units.end(), [&weights]( Target* lhs, Target* rhs ) {
+        size_t lhs_weight = weights[lhs];
+        size_t rhs_weight = weights[rhs];
+        return lhs_weight > rhs_weight || (lhs_weight == rhs_weight && lhs->path() < rhs->path());
+    } );
+
+    // Collect the Targets that the units assigned to this shard depend on
+    // directly or indirectly from an explicit stack.
+    vector<size_t> shard_weights( shards, 0 );
+    unordered_set<Target*> visited;
+    vector<Target*> targets;
+    for ( vector<Target*>::const_iterator unit = units.begin(); unit != units.end(); ++unit )
+    {
+        int lightest = int( std::min_element(shard_weights.begin(), shard_weights.end()) - shard_weights.begin() );
+        size_t weight = weights[*unit];
+        shard_weights[lightest] = shard_weights[lightest] <= SIZE_MAX - weight ? shard_weights[lightest] + weight : SIZE_MAX;
+        if ( lightest == shard )
+        {
+            vector<Target*> collect( 1, *unit );
+            while ( !collect.empty() )
+            {
+                Target* target = collect.back();
+                collect.pop_back();
+                if ( visited.insert(target).second )
+                {
+                    targets.push_back( target );
+                    int j = 0;
+                    Target* dependency = target->binding_dependency( j );
+                    while ( dependency )
+                    {
+                        collect.push_back( dependency );
+                        ++j;
+                        dependency = target->binding_dependency( j );
+                    }
+                }
+            }
+        }
+    }
+    return targets;
+}
+
+/**
+// Find the Targets that a postorder pass from \e target visits.
+//
+// @param target
+//  The Target to start from.
+//
+// @return
+//  \e target and the Targets that it depends on directly or indirectly
+//  through explicit, implicit, and ordering dependencies in no particular
+//  order.
+*/
+std::vector<Target*> Graph::reachable_targets( Target* target )
+{
+    SWEET_ASSERT( target );
+    SWEET_ASSERT( target->graph() == this );
+
+    unordered_set<Target*> visited;
+    vector<Target*> targets;
+    vector<Target*> stack( 1, target );
+    while ( !stack.empty() )
+    {
+        Target* target = stack.back();
+        stack.pop_back();
+        if ( visited.insert(target).second )
+        {
+            targets.push_back( target );
+            int i = 0;
+            Target* dependency = target->binding_dependency( i );
+            while ( dependency )
+            {
+                stack.push_back( dependency );
+                ++i;
+                dependency = target->binding_dependency( i );
+            }
+        }
+    }
+    return targets;
+}
+
+/**
+// Clean \e targets by removing the files that they're bound to.
+//
+// The files of all of \e targets are removed together, concurrently and
+// grouped by directory (see System::rm_many()), and then each Target has
+// its filenames cleared and is marked as not built.  This is the clean that
+// `clean_visit()` in Lua makes for cleanable Targets without a `clean`
+// function, made in bulk.
+//
+// @param targets
+//  The Targets to clean.
+//
+// @param threads
+//  The maximum number of threads to remove files on.
+//
+// @param error
+//  Set to a message describing the first failure, if any.
+//
+// @return
+//  The number of files that failed to be removed.
+*/
+int Graph::clean( const std::vector<Target*>& targets, int threads, std::string* error )
+{
+    SWEET_ASSERT( forge_ );
+    SWEET_ASSERT( error );
+
+    vector<string> filenames;
+    for ( vector<Target*>::const_iterator i = targets.begin(); i != targets.end(); ++i )
+    {
+        Target* target = *i;
+        SWEET_ASSERT( target );
+        const vector<string>& target_filenames = target->filenames();
+        for ( vector<string>::const_iterator filename = target_filenames.begin(); filename != target_filenames.end(); ++filename )
+        {
+            if ( !filename->empty() )
+            {
+                filenames.push_back( *filename );
+            }
+        }
+    }
+
+    int failures = forge_->system()->rm_many( filenames, threads, error );
+
+    for ( vector<Target*>::const_iterator i = targets.begin(); i != targets.end(); ++i )
+    {
+        Target* target = *i;
+        target->clear_filenames( 0, INT_MAX );
+        target->set_built( false );
+    }
+    return failures;
+}
+
+/**
+// Swap this Graph with \e graph.
+//
+// @param graph
+//  The Graph to swap this Graph's members with.
+*/
+void Graph::swap( Graph& graph )
+{
+    std::swap( ids_, graph.ids_ );
+    std::swap( root_target_, graph.root_target_ );
+}
+
+/**
+// Clear all of the targets in this graph.
+//
+// The name of the file that this Graph was most recently loaded from is used
+// to create the implicit cache target in the newly cleared Graph.  This gives
+// an implicit target for the cache file that buildfiles are able to depend
+// on (see Graph::buildfile()) so that the cache can be marked as outdated if
+// any buildfiles change and become newer than the cache.
+//
+// This might be a bit strange if the Graph is then saved to a cache file with
+// a different filename which is why the save functions don't take filename
+// arguments and one of the load functions must be called first to provide the
+// name of the cache file.
+*/
+void Graph::clear()
+{
+    SWEET_ASSERT( forge_ );
+
+    // Clear Targets in the same order as a recursive preorder traversal of
+    // the namespace but from an explicit stack; children are pushed in 
+    // reverse so that the first child is cleared first.
+    vector<Target*> targets;
+    targets.push_back( root_target_.get() );
+    while ( !targets.empty() )
+    {
+        Target* target = targets.back();
+        targets.pop_back();
+        SWEET_ASSERT( target );
+        target->clear_explicit_dependencies();
+        target->clear_ordering_dependencies();
+        target->destroy_anonymous_targets();
+        forge_->destroy_target_lua_binding( target );
+
+        const vector<Target*>& children = target->targets();
+        targets.insert( targets.end(), children.rbegin(), children.rend() );
+    }
+    incremental_ = false;
+    outdated_buildfiles_.clear();
+    directory_cache_.clear_globbed_directories();
+    directory_mirror_.clear_sources();
+}
+
+/**
+// Recover implicit relationships after this Graph has been loaded from an
+// Archive.
+*/
+void Graph::recover()
+{
+    SWEET_ASSERT( root_target_ );
+    root_target_->recover( this );
+    if ( !filename_.empty() )
+    {
+        cache_target_ = target( filename_ );
+        cache_target_->set_filename( filename_, 0 );
+        cache_target_->set_hash( configuration_hash_ );
+        bind( cache_target_ );
+    }
+}
+
+/**
+// Load this Graph from a binary file.
+//
+// When \e reuse is true the loaded Graph is kept, including its explicit
+// dependencies, and only the buildfiles that have changed, or are affected 
+// by changes, are loaded again (see Graph::reuse_buildfiles()).  Calls to
+// Graph::buildfile() for the other buildfiles return without loading them.
+// If nothing has changed at all then Graph::reused() returns true.
+//
+// Otherwise the explicit dependencies and cleanable flags saved with the 
+// Graph are discarded so that they are declared again by loading all of the
+// buildfiles as usual.  The Graph can only be reused if it was saved by a
+// build that was itself reusing; builds that aren't don't save the state
+// that reuse needs so that they don't pay for writing and reading it.
+//
+// @param filename
+//  The name of the file to load this Graph from.
+//
+// @param reuse
+//  True to reuse the loaded Graph if it is still valid otherwise false.
 //
 // @return
 //  The target that corresponds to the file that this Graph was loaded from or
 //  null if there was no cache target.
 */
-Target* Graph::load_binary( const std::string& filename )
+Target* Graph::load_binary( const std::string& filename, bool reuse )
 {
     SWEET_ASSERT( !filename.empty() );
     SWEET_ASSERT( std::filesystem::path(filename).is_absolute() );
@@ -647,16 +1430,34 @@ Target* Graph::load_binary( const std::string& filename )
 
     filename_ = filename;
     cache_target_ = NULL;
+    reuse_ = reuse;
+    reused_ = false;
+    incremental_ = false;
+    outdated_buildfiles_.clear();
 
     if ( forge_->system()->exists(filename) )
     {
         std::ifstream ifstream( filename, std::ios::binary );
         GraphReader graph_reader( &ifstream, &forge_->error_policy() );
-        unique_ptr<Target> root_target = graph_reader.read( filename );
+        unordered_set<string> ids;
+        DirectoryCache directory_cache;
+        DirectoryMirror directory_mirror;
+        unique_ptr<Target> root_target = graph_reader.read( filename, &ids, &directory_cache, &directory_mirror );
         if ( root_target )
         {
+            // The Targets being replaced are destroyed before the identifiers
+            // that they point to as they are declared after them.
+            ids_.swap( ids );
             root_target_.swap( root_target );
+            directory_cache_.swap( directory_cache );
+            directory_mirror_.swap( directory_mirror );
             recover();
+            if ( !reuse || !graph_reader.reuse() || !reuse_buildfiles() )
+            {
+                discard_cached_dependencies();
+                directory_cache_.clear_globbed_directories();
+                directory_mirror_.clear_sources();
+            }
             return cache_target_;
         }
     }
@@ -674,9 +1475,22 @@ void Graph::save_binary()
 
     if ( !filename_.empty() )
     {
-        std::ofstream ofstream( filename_, std::ios::binary );
-        GraphWriter graph_writer( &ofstream );
-        graph_writer.write( root_target_.get() );
+        // Write to a temporary file and rename over the cache file so that 
+        // interrupting the save never leaves a truncated cache file behind.
+        wait_for_checkpoint();
+        string temporary_filename = forge_->system()->temporary_filename( filename_ );
+        {
+            std::ofstream ofstream( temporary_filename, std::ios::binary );
+            GraphWriter graph_writer( &ofstream, false, reuse_ );
+            graph_writer.write( root_target_.get(), &directory_cache_, &directory_mirror_ );
+        }
+        std::error_code error;
+        std::filesystem::rename( temporary_filename, filename_, error );
+        if ( error )
+        {
+            forge_->errorf( "Saving the dependency graph to '%s' failed - %s", filename_.c_str(), error.message().c_str() );
+            std::filesystem::remove( temporary_filename, error );
+        }
     }
     else
     {
@@ -684,6 +1498,678 @@ void Graph::save_binary()
     }
 }
 
+/**
+// Checkpoint this Graph to the binary file that it was loaded from.
+//
+// The Graph is written to memory on the calling thread, while no Targets 
+// are changing, and then from memory to disk on a separate thread so that
+// the build isn't held up.  Outdated Targets that haven't been visited
+// successfully by the traversal in progress are saved as not built (see 
+// Target::write()).  Waits for the previous checkpoint to be written before
+// starting another.  Does nothing if this Graph hasn't been loaded from a
+// file.
+*/
+void Graph::checkpoint_binary()
+{
+    if ( !filename_.empty() )
+    {
+        wait_for_checkpoint();
+        std::ostringstream ostream;
+        GraphWriter graph_writer( &ostream, true, reuse_ );
+        graph_writer.write( root_target_.get(), &directory_cache_, &directory_mirror_ );
+        checkpoint_thread_ = new std::thread( &Graph::write_checkpoint, filename_, forge_->system()->temporary_filename(filename_), ostream.str() );
+    }
+}
+
+/**
+// Wait for the thread writing the most recent checkpoint to finish.
+*/
+void Graph::wait_for_checkpoint()
+{
+    if ( checkpoint_thread_ )
+    {
+        checkpoint_thread_->join();
+        delete checkpoint_thread_;
+        checkpoint_thread_ = nullptr;
+    }
+}
+
+/**
+// Merge a Graph saved to a binary file into this Graph.
+//
+// Targets in the other Graph are matched with Targets in this Graph by 
+// path, creating any Targets that don't exist in this Graph, and the built 
+// state of each Target that was built more recently in the other Graph is 
+// merged into this Graph (see Target::merge()).  This combines the cache 
+// files saved by each shard of a sharded build (see Graph::shard_targets())
+// so that a final build only builds what the shards didn't.
+//
+// @param filename
+//  The absolute path to the binary file to merge from.
+//
+// @return
+//  The number of Targets whose built state was merged or -1 if the file
+//  couldn't be read.
+*/
+int Graph::merge_binary( const std::string& filename )
+{
+    SWEET_ASSERT( !filename.empty() );
+    SWEET_ASSERT( std::filesystem::path(filename).is_absolute() );
+    SWEET_ASSERT( root_target_ );
+
+    if ( !forge_->system()->exists(filename) )
+    {
+        forge_->errorf( "The dependency graph '%s' to merge doesn't exist", filename.c_str() );
+        return -1;
+    }
+
+    std::ifstream ifstream( filename, std::ios::binary );
+    GraphReader graph_reader( &ifstream, &forge_->error_policy() );
+    unordered_set<string> other_ids;
+    unique_ptr<Target> other_root_target = graph_reader.read( filename, &other_ids );
+    if ( !other_root_target )
+    {
+        return -1;
+    }
+
+    std::unordered_map<Target*, Target*> targets;
+    vector<Target*> other_targets;
+    vector<std::pair<Target*, Target*>> stack;
+    stack.push_back( std::make_pair(other_root_target.get(), root_target_.get()) );
+    while ( !stack.empty() )
+    {
+        Target* other_target = stack.back().first;
+        Target* target = stack.back().second;
+        stack.pop_back();
+        targets.insert( std::make_pair(other_target, target) );
+        other_targets.push_back( other_target );
+
+        const vector<Target*>& children = other_target->targets();
+        for ( vector<Target*>::const_iterator i = children.begin(); i != children.end(); ++i )
+        {
+            Target* child = *i;
+            SWEET_ASSERT( child );
+            if ( !child->id().empty() )
+            {
+                stack.push_back( std::make_pair(child, find_or_create_target_by_element(target, child->id())) );
+            }
+        }
+    }
+
+    int merged = 0;
+    for ( vector<Target*>::const_iterator i = other_targets.begin(); i != other_targets.end(); ++i )
+    {
+        Target* other_target = *i;
+        if ( targets[other_target]->merge(other_target, targets) )
+        {
+            ++merged;
+        }
+    }
+    return merged;
+}
+
+/**
+// Work out which buildfiles need to be loaded again to bring the Graph just
+// loaded from the cache file up to date.
+//
+// Every Target is bound with the hash that it was saved with.  Buildfiles
+// that are newer than the cache file or that declared outdated Targets need
+// to be loaded again as do, transitively, the buildfiles that loaded them 
+// and the buildfiles that declared Targets depending on their Targets.  The
+// build script (and any other script that loads buildfiles without being
+// loaded as a buildfile itself) is always loaded again.
+//
+// Rules and the fields that scripts set on Targets aren't saved with the
+// Graph so the buildfiles that declared the Targets that the Targets of a
+// buildfile being loaded again depend on, and the buildfiles that loaded
+// them, are loaded again too, transitively.  Their Targets are then
+// declared with their Rules and fields for the build functions that read
+// them, e.g. to link against static libraries.
+//
+// The contributions of the buildfiles that need to be loaded again are then 
+// retracted by clearing the explicit, ordering, and passive dependencies,
+// cleanable flags, hashes, and recorded buildfiles of the Targets that they
+// declared.  Everything else is kept as loaded from the cache file.
+//
+// The Graph can't be reused, even in part, if the cache Target's hash 
+// doesn't match the current configuration hash, if the build script, local
+// settings, or any Lua module has changed, if an outdated cleanable Target
+// wasn't declared by a buildfile, or if a Target declared by a buildfile
+// that needs to be loaded again is shared with other buildfiles.
+//
+// @return
+//  True if the Graph has been reused in whole or in part otherwise false.
+*/
+bool Graph::reuse_buildfiles()
+{
+    SWEET_ASSERT( cache_target_ );
+
+    struct Recursive
+    {
+        static void bind( Bind& bind, Target* target )
+        {
+            SWEET_ASSERT( target );
+            target->set_hash( target->hash() );
+            bind.visit( target );
+
+            const vector<Target*>& targets = target->targets();
+            for ( vector<Target*>::const_iterator i = targets.begin(); i != targets.end(); ++i )
+            {
+                Recursive::bind( bind, *i );
+            }
+        }
+
+        static void collect( Target* target, vector<Target*>* targets )
+        {
+            SWEET_ASSERT( target );
+            targets->push_back( target );
+            const vector<Target*>& children = target->targets();
+            for ( vector<Target*>::const_iterator i = children.begin(); i != children.end(); ++i )
+            {
+                Recursive::collect( *i, targets );
+            }
+        }
+    };
+
+    if ( cache_target_->outdated() )
+    {
+        return false;
+    }
+
+    int failures = 0;
+    {
+        Bind bind( forge_ );
+        Recursive::bind( bind, root_target_.get() );
+        failures = bind.failures_;
+    }
+    if ( failures > 0 )
+    {
+        return false;
+    }
+
+    vector<Target*> targets;
+    Recursive::collect( root_target_.get(), &targets );
+
+    set<Target*> outdated_buildfiles;
+    bool outdated = false;
+    for ( vector<Target*>::const_iterator i = targets.begin(); i != targets.end(); ++i )
+    {
+        Target* target = *i;
+        Target* buildfile = target->buildfile();
+        if ( buildfile && !buildfile->buildfile() )
+        {
+            outdated_buildfiles.insert( buildfile );
+        }
+        if ( target->outdated() )
+        {
+            // Outdated source files aren't declared by any buildfile but
+            // aren't built either; the Targets that depend on them are
+            // outdated too and bring in their own buildfiles.  Outdated
+            // cleanable Targets are built but no buildfile would declare
+            // them again with their Rules.
+            if ( !buildfile )
+            {
+                if ( target->cleanable() )
+                {
+                    return false;
+                }
+                continue;
+            }
+            outdated_buildfiles.insert( buildfile );
+            outdated = true;
+        }
+    }
+
+    int n = 0;
+    Target* dependency = cache_target_->explicit_dependency( n );
+    while ( dependency )
+    {
+        if ( dependency->timestamp() > cache_target_->last_write_time() )
+        {
+            if ( !dependency->buildfile() )
+            {
+                return false;
+            }
+            outdated_buildfiles.insert( dependency );
+            outdated = true;
+        }
+        ++n;
+        dependency = cache_target_->explicit_dependency( n );
+    }
+
+    // Buildfiles that globbed directories that have changed since need to
+    // be loaded again to glob those directories again.
+    vector<string> globbing_buildfiles;
+    directory_cache_.changed_buildfiles( &globbing_buildfiles );
+    for ( vector<string>::const_iterator i = globbing_buildfiles.begin(); i != globbing_buildfiles.end(); ++i )
+    {
+        Target* buildfile = find_target( *i, nullptr );
+        if ( !buildfile )
+        {
+            return false;
+        }
+        outdated_buildfiles.insert( buildfile );
+        outdated = true;
+    }
+
+    // A buildfile needs to be loaded again if any buildfile that it loaded
+    // needs to be loaded again or if any of its Targets depend on Targets 
+    // declared by a buildfile that needs to be loaded again.
+    map<Target*, set<Target*>> dependent_buildfiles;
+    map<Target*, set<Target*>> dependency_buildfiles;
+    for ( vector<Target*>::const_iterator i = targets.begin(); i != targets.end(); ++i )
+    {
+        Target* target = *i;
+        Target* buildfile = target->buildfile();
+        if ( buildfile )
+        {
+            int j = 0;
+            Target* dependency = target->any_dependency( j );
+            while ( dependency )
+            {
+                if ( dependency->buildfile() && dependency->buildfile() != buildfile )
+                {
+                    dependent_buildfiles[dependency->buildfile()].insert( buildfile );
+                    dependency_buildfiles[buildfile].insert( dependency->buildfile() );
+                }
+                ++j;
+                dependency = target->any_dependency( j );
+            }
+        }
+    }
+
+    vector<Target*> buildfiles( outdated_buildfiles.begin(), outdated_buildfiles.end() );
+    while ( !buildfiles.empty() )
+    {
+        Target* buildfile = buildfiles.back();
+        buildfiles.pop_back();
+        Target* loading_buildfile = buildfile->buildfile();
+        if ( loading_buildfile && outdated_buildfiles.insert(loading_buildfile).second )
+        {
+            buildfiles.push_back( loading_buildfile );
+        }
+        map<Target*, set<Target*>>::const_iterator dependents = dependent_buildfiles.find( buildfile );
+        if ( dependents != dependent_buildfiles.end() )
+        {
+            for ( set<Target*>::const_iterator j = dependents->second.begin(); j != dependents->second.end(); ++j )
+            {
+                if ( outdated_buildfiles.insert(*j).second )
+                {
+                    buildfiles.push_back( *j );
+                }
+            }
+        }
+    }
+
+    // The buildfiles that declared the Targets depended on by Targets of the
+    // buildfiles to be loaded again, and the buildfiles that loaded them,
+    // are loaded again to declare those Targets with their Rules and fields.
+    // They haven't changed so the buildfiles that depend on them don't need
+    // to be loaded again on their account.
+    buildfiles.assign( outdated_buildfiles.begin(), outdated_buildfiles.end() );
+    while ( !buildfiles.empty() )
+    {
+        Target* buildfile = buildfiles.back();
+        buildfiles.pop_back();
+        Target* loading_buildfile = buildfile->buildfile();
+        if ( loading_buildfile && outdated_buildfiles.insert(loading_buildfile).second )
+        {
+            buildfiles.push_back( loading_buildfile );
+        }
+        map<Target*, set<Target*>>::const_iterator dependencies = dependency_buildfiles.find( buildfile );
+        if ( dependencies != dependency_buildfiles.end() )
+        {
+            for ( set<Target*>::const_iterator j = dependencies->second.begin(); j != dependencies->second.end(); ++j )
+            {
+                if ( outdated_buildfiles.insert(*j).second )
+                {
+                    buildfiles.push_back( *j );
+                }
+            }
+        }
+    }
+
+    // Retracting a Target that other buildfiles have modified would lose
+    // their modifications so give up if any Target to be retracted is
+    // shared.  Shared Targets that aren't retracted are left as they are.
+    for ( vector<Target*>::const_iterator i = targets.begin(); i != targets.end(); ++i )
+    {
+        Target* target = *i;
+        if ( target->shared() && outdated_buildfiles.find(target->buildfile()) != outdated_buildfiles.end() )
+        {
+            return false;
+        }
+    }
+
+    for ( vector<Target*>::const_iterator i = targets.begin(); i != targets.end(); ++i )
+    {
+        Target* target = *i;
+        if ( outdated_buildfiles.find(target->buildfile()) != outdated_buildfiles.end() )
+        {
+            target->clear_explicit_dependencies();
+            target->clear_ordering_dependencies();
+            target->clear_passive_dependencies();
+            target->set_cleanable( false );
+            target->set_hash( 0 );
+            target->clear_buildfile();
+            target->unbind();
+        }
+        else if ( outdated )
+        {
+            target->unbind();
+        }
+    }
+
+    if ( outdated )
+    {
+        bind( cache_target_ );
+    }
+
+    outdated_buildfiles_.swap( outdated_buildfiles );
+    incremental_ = true;
+    reused_ = !outdated;
+    return true;
+}
+
+/**
+// Discard the explicit, ordering, and passive dependencies, cleanable
+// flags, hashes, and recorded buildfiles loaded from the cache file.
+//
+// Every Target is also unbound so that binding is redone after the 
+// buildfiles have declared their dependencies again.  The cache Target is
+// bound again straight away to match the state that it is left in by 
+// Graph::recover().
+*/
+void Graph::discard_cached_dependencies()
+{
+    struct RecursiveDiscard
+    {
+        static void discard( Target* target )
+        {
+            SWEET_ASSERT( target );
+            target->clear_explicit_dependencies();
+            target->clear_ordering_dependencies();
+            target->clear_passive_dependencies();
+            target->set_cleanable( false );
+            target->set_hash( 0 );
+            target->clear_buildfile();
+            target->unbind();
+
+            const vector<Target*>& targets = target->targets();
+            for ( vector<Target*>::const_iterator i = targets.begin(); i != targets.end(); ++i )
+            {
+                RecursiveDiscard::discard( *i );
+            }
+        }
+    };
+
+    RecursiveDiscard::discard( root_target_.get() );
+    if ( cache_target_ )
+    {
+        cache_target_->set_hash( configuration_hash_ );
+        bind( cache_target_ );
+    }
+}
+
+/**
+// Get the next dependency of \e target of the DependencyFilter::Kind values
+// in \e kinds.
+//
+// @param kind
+//  The kind of dependency being iterated over, initially
+//  DependencyFilter::KIND_EXPLICIT, updated to the kind of the dependency
+//  returned.
+//
+// @param index
+//  The index of the next dependency of \e kind, initially 0.
+//
+// @return
+//  The next dependency or null if there are no more dependencies.
+*/
+static Target* next_dependency( Target* target, int kinds, int* kind, int* index )
+{
+    SWEET_ASSERT( target );
+    SWEET_ASSERT( kind );
+    SWEET_ASSERT( index );
+    while ( *kind <= DependencyFilter::KIND_PASSIVE )
+    {
+        if ( kinds & *kind )
+        {
+            Target* dependency = nullptr;
+            switch ( *kind )
+            {
+                case DependencyFilter::KIND_EXPLICIT:
+                    dependency = target->explicit_dependency( *index );
+                    break;
+                case DependencyFilter::KIND_IMPLICIT:
+                    dependency = target->implicit_dependency( *index );
+                    break;
+                case DependencyFilter::KIND_ORDERING:
+                    dependency = target->ordering_dependency( *index );
+                    break;
+                default:
+                    dependency = target->passive_dependency( *index );
+                    break;
+            }
+            if ( dependency )
+            {
+                ++*index;
+                return dependency;
+            }
+        }
+        *kind <<= 1;
+        *index = 0;
+    }
+    return nullptr;
+}
+
+/**
+// Walk the transitive dependencies of \e target selected by \e filter
+// from an explicit stack, remembering the dependencies of each Target
+// recursed into in \e transitive_dependencies.
+*/
+std::vector<Target*> Graph::walk_transitive_dependencies( Target* target, const DependencyFilter& filter, int filter_index, std::map<std::pair<Target*, int>, std::vector<Target*>>* transitive_dependencies )
+{
+    SWEET_ASSERT( target );
+    SWEET_ASSERT( transitive_dependencies );
+
+    struct Walk
+    {
+        Target* target;
+        int kind;
+        int index;
+        vector<Target*> dependencies;
+
+        Walk( Target* target )
+        : target( target )
+        , kind( DependencyFilter::KIND_EXPLICIT )
+        , index( 0 )
+        , dependencies()
+        {
+        }
+
+        void keep_last_occurrences()
+        {
+            unordered_set<Target*> kept;
+            vector<Target*>::iterator last = dependencies.end();
+            for ( vector<Target*>::reverse_iterator i = dependencies.rbegin(); i != dependencies.rend(); ++i )
+            {
+                if ( kept.insert(*i).second )
+                {
+                    --last;
+                    *last = *i;
+                }
+            }
+            dependencies.erase( dependencies.begin(), last );
+        }
+    };
+
+    vector<Walk> walks;
+    unordered_set<Target*> walking;
+    walks.push_back( Walk(target) );
+    walking.insert( target );
+    while ( true )
+    {
+        Walk& walk = walks.back();
+        Target* dependency = next_dependency( walk.target, filter.kinds(), &walk.kind, &walk.index );
+        if ( dependency )
+        {
+            bool yielded = filter.yields( dependency );
+            if ( yielded )
+            {
+                walk.dependencies.push_back( dependency );
+            }
+            if ( filter.recurses(dependency, yielded) && !walking.count(dependency) )
+            {
+                map<std::pair<Target*, int>, vector<Target*>>::const_iterator i = transitive_dependencies->find( std::make_pair(dependency, filter_index) );
+                if ( i != transitive_dependencies->end() )
+                {
+                    walk.dependencies.insert( walk.dependencies.end(), i->second.begin(), i->second.end() );
+                }
+                else
+                {
+                    walks.push_back( Walk(dependency) );
+                    walking.insert( dependency );
+                }
+            }
+        }
+        else
+        {
+            walk.keep_last_occurrences();
+            walking.erase( walk.target );
+            if ( walks.size() == 1 )
+            {
+                break;
+            }
+            Walk& parent = walks[walks.size() - 2];
+            parent.dependencies.insert( parent.dependencies.end(), walk.dependencies.begin(), walk.dependencies.end() );
+            transitive_dependencies->insert( std::make_pair(std::make_pair(walk.target, filter_index), std::move(walk.dependencies)) );
+            walks.pop_back();
+        }
+    }
+    return std::move( walks.back().dependencies );
+}
+
+/**
+// Hash the structure of \e target from an explicit stack, remembering the
+// hash of each Target hashed in \e structural_hashes.
+//
+// Dependencies that are already being hashed, i.e. that are part of a
+// cycle, contribute only their path to the hash.
+*/
+uint64_t Graph::hash_structure( Target* target, std::unordered_map<Target*, uint64_t>* structural_hashes )
+{
+    SWEET_ASSERT( target );
+    SWEET_ASSERT( structural_hashes );
+
+    const int STRUCTURAL_KINDS = DependencyFilter::KIND_EXPLICIT | DependencyFilter::KIND_PASSIVE;
+
+    struct Hash
+    {
+        Target* target;
+        int kind;
+        int index;
+        uint64_t hash;
+
+        Hash( Target* target )
+        : target( target )
+        , kind( DependencyFilter::KIND_EXPLICIT )
+        , index( 0 )
+        , hash( FNV_OFFSET_BASIS )
+        {
+            const string& path = target->path();
+            append( path.c_str(), path.size() + 1 );
+            Rule* rule = target->rule();
+            const string& id = rule ? rule->id() : string();
+            append( id.c_str(), id.size() + 1 );
+            uint64_t settings_hash = target->pending_hash();
+            append( &settings_hash, sizeof(settings_hash) );
+        }
+
+        void append( const void* data, size_t length )
+        {
+            const unsigned char* bytes = reinterpret_cast<const unsigned char*>( data );
+            for ( size_t i = 0; i < length; ++i )
+            {
+                hash = (hash ^ bytes[i]) * FNV_PRIME;
+            }
+        }
+
+        void append_dependency( uint64_t dependency_hash )
+        {
+            append( &kind, sizeof(kind) );
+            append( &dependency_hash, sizeof(dependency_hash) );
+        }
+    };
+
+    std::unordered_map<Target*, uint64_t>::const_iterator hashed = structural_hashes->find( target );
+    if ( hashed != structural_hashes->end() )
+    {
+        return hashed->second;
+    }
+
+    vector<Hash> hashes;
+    unordered_set<Target*> hashing;
+    hashes.push_back( Hash(target) );
+    hashing.insert( target );
+    while ( true )
+    {
+        Hash& hash = hashes.back();
+        Target* dependency = next_dependency( hash.target, STRUCTURAL_KINDS, &hash.kind, &hash.index );
+        if ( dependency )
+        {
+            hashed = structural_hashes->find( dependency );
+            if ( hashed != structural_hashes->end() )
+            {
+                hash.append_dependency( hashed->second );
+            }
+            else if ( hashing.count(dependency) )
+            {
+                hash.append_dependency( Hash(dependency).hash );
+            }
+            else
+            {
+                hashes.push_back( Hash(dependency) );
+                hashing.insert( dependency );
+            }
+        }
+        else
+        {
+            uint64_t structural_hash = hash.hash != 0 ? hash.hash : 1;
+            structural_hashes->insert( std::make_pair(hash.target, structural_hash) );
+            hashing.erase( hash.target );
+            hashes.pop_back();
+            if ( hashes.empty() )
+            {
+                return structural_hash;
+            }
+            hashes.back().append_dependency( structural_hash );
+        }
+    }
+}
+
+/**
+// Write a checkpoint of a Graph to \e filename through the temporary file
+// \e temporary_filename.
+//
+// Runs on the checkpoint thread so errors are ignored; a checkpoint that 
+// fails to be written leaves the previous cache file in place.
+*/
+void Graph::write_checkpoint( const std::string& filename, const std::string& temporary_filename, const std::string& graph )
+{
+    std::error_code error;
+    std::ofstream ofstream( temporary_filename, std::ios::binary | std::ios::trunc );
+    if ( ofstream.is_open() && ofstream.write(graph.c_str(), graph.size()) )
+    {
+        ofstream.close();
+        std::filesystem::rename( temporary_filename, filename, error );
+    }
+    if ( error || !ofstream )
+    {
+        std::filesystem::remove( temporary_filename, error );
+    }
+}
+
 /**
 // Print the dependency graph of Targets in this Graph.
 //
@@ -1,10 +1,20 @@
 #ifndef FORGE_GRAPH_HPP_INCLUDED
 #define FORGE_GRAPH_HPP_INCLUDED
 
+#include "DependencyFilter.hpp"
+#include "DirectoryCache.hpp"
+#include "DirectoryMirror.hpp"
 #include <error/macros.hpp>
 #include <vector>
 #include <string>
 #include <memory>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <thread>
+#include <chrono>
+#include <stdint.h>
 
 namespace sweet
 {
@@ -27,11 +37,28 @@ class Graph
     std::vector<Rule*> rules_; ///< The Rules that have been created.
     std::vector<Toolset*> toolsets_; ///< The Toolsets that have been created.
     std::string filename_; ///< The filename that this Graph was most recently loaded from.
+    std::unordered_set<std::string> ids_; ///< The identifiers of the Targets in this Graph, interned so that Targets with the same identifier share one string.
     std::unique_ptr<Target> root_target_; ///< The root Target for this Graph.
     Target* cache_target_; ///< The cache Target for this Graph.
+    uint64_t configuration_hash_; ///< The hash of the build script, variables, and command for the cache Target.
+    bool reuse_; ///< True when the Graph is saved with the state needed to reuse it (see Graph::load_binary()).
+    bool reused_; ///< True when the Graph loaded from the cache file has been reused as is.
+    bool incremental_; ///< True when only the buildfiles in outdated_buildfiles_ need to be loaded.
+    std::set<Target*> outdated_buildfiles_; ///< The buildfiles that need to be loaded again when loading incrementally.
     bool traversal_in_progress_; ///< True when a traversal is in progress otherwise false.
     int visited_revision_; ///< The current visit revision.
     int successful_revision_; ///< The current success revision.
+    int checkpoint_interval_; ///< The number of seconds between checkpoints during postorder traversals or 0 to not checkpoint after time elapses.
+    int checkpoint_jobs_; ///< The number of completed jobs between checkpoints during postorder traversals or 0 to not checkpoint after jobs complete.
+    std::thread* checkpoint_thread_; ///< The thread writing the most recent checkpoint or null if there is none.
+    std::vector<DependencyFilter> dependency_filters_; ///< The filters used to walk transitive dependencies during the current traversal.
+    std::map<std::pair<Target*, int>, std::vector<Target*>> transitive_dependencies_; ///< The transitive dependencies of Targets walked during the current traversal by Target and index of filter.
+    std::unordered_map<Target*, uint64_t> structural_hashes_; ///< The structural hashes of Targets hashed during the current traversal.
+    std::chrono::steady_clock::duration structural_hash_time_; ///< The time spent calculating structural hashes.
+    int prepared_targets_; ///< The number of Targets with structural prepare functions prepared by calling them (see Graph::count_prepared()).
+    int restored_targets_; ///< The number of Targets with structural prepare functions restored as they were last prepared instead.
+    DirectoryCache directory_cache_; ///< The directory listings used to glob files, saved and loaded with this Graph.
+    DirectoryMirror directory_mirror_; ///< The manifests of mirrored directories, saved and loaded with this Graph.
 
     public:
         Graph();
@@ -40,14 +67,31 @@ class Graph
 
         const std::vector<Toolset*> toolsets() const;
         Target* root_target() const;
+        const std::string* intern( const std::string& id );
+        size_t ids_memory_usage( size_t* ids ) const;
         Target* cache_target() const;
         Forge* forge() const;
+        void set_configuration_hash( uint64_t configuration_hash );
+        uint64_t configuration_hash() const;
+        bool reused() const;
+        DirectoryCache* directory_cache();
+        DirectoryMirror* directory_mirror();
 
         void begin_traversal();
         void end_traversal();
         bool traversal_in_progress() const;
         int visited_revision() const;
         int successful_revision() const;             
+        void set_checkpoint_interval( int seconds, int jobs );
+        int checkpoint_interval() const;
+        int checkpoint_jobs() const;
+        std::vector<Target*> transitive_dependencies( Target* target, const DependencyFilter& filter );
+        uint64_t structural_hash( Target* target );
+        void dependencies_changed( Target* target );
+        void count_prepared( bool restored );
+        int prepared_targets() const;
+        int restored_targets() const;
+        double structural_hash_seconds() const;
 
         Rule* add_rule( const std::string& id );
         Toolset* add_toolset( const std::string& id );
@@ -59,13 +103,28 @@ class Graph
                 
         int buildfile( const std::string& filename );
         int bind( Target* target = NULL );        
+        int bind( const std::vector<Target*>& targets );
+        std::vector<Target*> affected_targets( const std::vector<std::string>& filenames );
+        std::vector<Target*> shard_targets( Target* target, int shard, int shards );
+        std::vector<Target*> reachable_targets( Target* target );
+        int clean( const std::vector<Target*>& targets, int threads, std::string* error );
         void swap( Graph& graph );
         void clear();
         void recover();
-        Target* load_binary( const std::string& filename );
+        Target* load_binary( const std::string& filename, bool reuse = false );
         void save_binary();
+        void checkpoint_binary();
+        void wait_for_checkpoint();
+        int merge_binary( const std::string& filename );
         void print_dependencies( Target* target, const std::string& directory );
         void print_namespace( Target* target );
+
+    private:
+        bool reuse_buildfiles();
+        void discard_cached_dependencies();
+        std::vector<Target*> walk_transitive_dependencies( Target* target, const DependencyFilter& filter, int filter_index, std::map<std::pair<Target*, int>, std::vector<Target*>>* transitive_dependencies );
+        uint64_t hash_structure( Target* target, std::unordered_map<Target*, uint64_t>* structural_hashes );
+        static void write_checkpoint( const std::string& filename, const std::string& temporary_filename, const std::string& graph );
 };
 
 }
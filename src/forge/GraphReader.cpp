@@ -5,6 +5,8 @@
 
 #include "GraphReader.hpp"
 #include "Target.hpp"
+#include "DirectoryCache.hpp"
+#include "DirectoryMirror.hpp"
 #include <error/ErrorPolicy.hpp>
 #include <assert/assert.hpp>
 #include <memory>
@@ -21,20 +23,40 @@ using namespace sweet::forge;
 GraphReader::GraphReader( std::istream* istream, error::ErrorPolicy* error_policy  )
 : istream_( istream ),
   error_policy_( error_policy ),
-  address_by_old_address_()
+  address_by_old_address_(),
+  ids_( nullptr ),
+  reuse_( false )
 {
     SWEET_ASSERT( istream_ );
     SWEET_ASSERT( error_policy_ );
 }
 
+/**
+// Was the Graph being read written with the state that is only needed to
+// reuse it without loading buildfiles (see GraphWriter::reuse())?
+*/
+bool GraphReader::reuse() const
+{
+    return reuse_;
+}
+
 void* GraphReader::find_address_by_old_address( const void* old_address ) const
 {
     map<const void*, void*>::const_iterator i = address_by_old_address_.find( old_address );
     return i != address_by_old_address_.end() ? i->second : nullptr;
 }
 
-std::unique_ptr<Target> GraphReader::read( const std::string& filename )
+/**
+// Read a Graph interning the identifiers of its Targets in \e ids.
+//
+// The identifiers must outlive the Targets read as the Targets point to
+// them (see Graph::intern()).
+*/
+std::unique_ptr<Target> GraphReader::read( const std::string& filename, std::unordered_set<std::string>* ids, DirectoryCache* directory_cache, DirectoryMirror* directory_mirror )
 {
+    SWEET_ASSERT( ids );
+    ids_ = ids;
+
     const char FORMAT [] = "Forge Graph";
     char format [sizeof(FORMAT)];
     value( &format[0], sizeof(format) );
@@ -44,7 +66,7 @@ std::unique_ptr<Target> GraphReader::read( const std::string& filename )
         return unique_ptr<Target>();
     }
 
-    const int VERSION = 34;
+    const int VERSION = 44;
     int version = 0;
     value( &version );
     if ( version != VERSION )
@@ -52,14 +74,29 @@ std::unique_ptr<Target> GraphReader::read( const std::string& filename )
         error_policy_->print( "The file '%s' is version %d not version %d as expected", filename.c_str(), version, VERSION );
         return unique_ptr<Target>();
     }
+    value( &reuse_ );
 
     unique_ptr<Target> root_target;
     root_target.reset( new Target );
     root_target->read( *this );
     root_target->resolve( *this );
+    if ( directory_cache )
+    {
+        directory_cache->read( *this );
+        if ( directory_mirror )
+        {
+            directory_mirror->read( *this );
+        }
+    }
     return root_target;
 }
 
+const std::string* GraphReader::intern( const std::string& id )
+{
+    SWEET_ASSERT( ids_ );
+    return &*ids_->insert( id ).first;
+}
+
 void GraphReader::object_address( void* address )
 {
     const void* old_address = nullptr;
@@ -126,12 +163,21 @@ void GraphReader::value( std::vector<Target*>* values )
     }
 }
 
+void GraphReader::refer( Target** value )
+{
+    istream_->read( reinterpret_cast<char*>(value), sizeof(*value) );
+}
+
+/**
+// Read references and append them to \e values.
+*/
 void GraphReader::refer( std::vector<Target*>* values )
 {
     size_t length = 0;
     istream_->read( reinterpret_cast<char*>(&length), sizeof(length) );
-    values->resize( length );
-    for ( vector<Target*>::iterator i = values->begin(); i != values->end(); ++i )
+    size_t start = values->size();
+    values->resize( start + length );
+    for ( vector<Target*>::iterator i = values->begin() + start; i != values->end(); ++i )
     {
         Target* target = nullptr;
         istream_->read( reinterpret_cast<char*>(&target), sizeof(target) );
@@ -2,6 +2,7 @@
 #define FORGE_GRAPHREADER_HPP_INCLUDED
 
 #include <map>
+#include <unordered_set>
 #include <vector>
 #include <string>
 #include <istream>
@@ -23,17 +24,23 @@ namespace forge
 {
 
 class Target;
+class DirectoryCache;
+class DirectoryMirror;
 
 class GraphReader
 {
     std::istream* istream_;
     error::ErrorPolicy* error_policy_;
     std::map<const void*, void*> address_by_old_address_;
+    std::unordered_set<std::string>* ids_;
+    bool reuse_;
 
 public:
     GraphReader( std::istream* ostream, error::ErrorPolicy* error_policy );
+    bool reuse() const;
     void* find_address_by_old_address( const void* old_address ) const;
-    std::unique_ptr<Target> read( const std::string& filename );
+    std::unique_ptr<Target> read( const std::string& filename, std::unordered_set<std::string>* ids, DirectoryCache* directory_cache = nullptr, DirectoryMirror* directory_mirror = nullptr );
+    const std::string* intern( const std::string& id );
     void object_address( void* address );
     void value( bool* value );
     void value( int* value );
@@ -43,6 +50,7 @@ public:
     void value( char* value, size_t size );
     void value( std::vector<std::string>* values );
     void value( std::vector<Target*>* values );
+    void refer( Target** reference );
     void refer( std::vector<Target*>* references );
 };
 
@@ -5,26 +5,53 @@
 
 #include "GraphWriter.hpp"
 #include "Target.hpp"
+#include "DirectoryCache.hpp"
+#include "DirectoryMirror.hpp"
 #include <assert/assert.hpp>
 
 using std::string;
 using std::vector;
 using namespace sweet::forge;
 
-GraphWriter::GraphWriter( std::ostream* ostream )
+GraphWriter::GraphWriter( std::ostream* ostream, bool checkpoint, bool reuse )
 : ostream_( ostream )
+, checkpoint_( checkpoint )
+, reuse_( reuse )
 {
     SWEET_ASSERT( ostream_ );
 }
 
-void GraphWriter::write( Target* root_target )
+/**
+// Is this GraphWriter writing a checkpoint taken during a postorder 
+// traversal (see Graph::checkpoint_binary())?
+*/
+bool GraphWriter::checkpoint() const
+{
+    return checkpoint_;
+}
+
+/**
+// Is this GraphWriter writing the state that is only needed to reuse the
+// Graph without loading buildfiles (see Graph::load_binary())?
+*/
+bool GraphWriter::reuse() const
+{
+    return reuse_;
+}
+
+void GraphWriter::write( Target* root_target, const DirectoryCache* directory_cache, const DirectoryMirror* directory_mirror )
 {
     SWEET_ASSERT( root_target );
+    SWEET_ASSERT( directory_cache );
+    SWEET_ASSERT( directory_mirror );
     const char FORMAT [] = "Forge Graph";
     value( &FORMAT[0], sizeof(FORMAT) );
-    const int VERSION = 34;
+    const int VERSION = 44;
     value( VERSION );
+    value( reuse_ );
     root_target->write( *this );
+    directory_cache->write( *this );
+    directory_mirror->write( *this );
 }
 
 void GraphWriter::object_address( const void* address )
@@ -87,11 +114,17 @@ void GraphWriter::value( const std::vector<Target*>& values )
     }
 }
 
-void GraphWriter::refer( const std::vector<Target*>& values )
+void GraphWriter::refer( const Target* value )
 {
-    size_t length = values.size();
+    ostream_->write( reinterpret_cast<const char*>(&value), sizeof(value) );
+}
+
+void GraphWriter::refer( Target* const* begin, Target* const* end )
+{
+    SWEET_ASSERT( begin <= end );
+    size_t length = end - begin;
     ostream_->write( reinterpret_cast<const char*>(&length), sizeof(length) );
-    for ( vector<Target*>::const_iterator i = values.begin(); i != values.end(); ++i )
+    for ( Target* const* i = begin; i != end; ++i )
     {
         Target* target = *i;
         SWEET_ASSERT( target );
@@ -15,14 +15,20 @@ namespace forge
 {
 
 class Target;
+class DirectoryCache;
+class DirectoryMirror;
 
 class GraphWriter
 {
     std::ostream* ostream_;
+    bool checkpoint_;
+    bool reuse_;
 
 public:
-    GraphWriter( std::ostream* ostream );
-    void write( Target* root_target );
+    GraphWriter( std::ostream* ostream, bool checkpoint = false, bool reuse = false );
+    bool checkpoint() const;
+    bool reuse() const;
+    void write( Target* root_target, const DirectoryCache* directory_cache, const DirectoryMirror* directory_mirror );
     void object_address( const void* address );
     void value( bool value );
     void value( int value );
@@ -32,7 +38,8 @@ public:
     void value( const char* value, size_t size );
     void value( const std::vector<std::string>& values );
     void value( const std::vector<Target*>& values );
-    void refer( const std::vector<Target*>& references );
+    void refer( const Target* reference );
+    void refer( Target* const* begin, Target* const* end );
 };
 
 }
@@ -11,8 +11,10 @@
 #include "Context.hpp"
 #include "Executor.hpp"
 #include "Reader.hpp"
+#include "BytecodeCache.hpp"
 #include "Filter.hpp"
 #include "Arguments.hpp"
+#include <forge/forge_lua/LuaStatePool.hpp>
 #include <process/Environment.hpp>
 #include <luaxx/luaxx.hpp>
 #include <error/ErrorPolicy.hpp>
@@ -28,6 +30,7 @@ using std::vector;
 using std::string;
 using std::unique_ptr;
 using std::function;
+using std::unordered_set;
 using namespace sweet;
 using namespace sweet::lua;
 using namespace sweet::luaxx;
@@ -36,19 +39,36 @@ using namespace sweet::forge;
 Scheduler::Scheduler( Forge* forge )
 : forge_( forge )
 , active_contexts_()
+, free_contexts_()
+, live_contexts_( 0 )
+, recycled_contexts_( 0 )
 , results_mutex_()
 , results_condition_()
 , results_()
 , pending_results_( 0 )
 , buildfile_calls_( 0 )
+, failed_jobs_( 0 )
+, completed_jobs_( 0 )
+, checkpoint_completed_jobs_( 0 )
+, checkpoint_time_()
 {
     SWEET_ASSERT( forge_ );
 }
 
+Scheduler::~Scheduler()
+{
+    while ( !free_contexts_.empty() )
+    {
+        delete free_contexts_.back();
+        free_contexts_.pop_back();
+    }
+}
+
 void Scheduler::load( const std::filesystem::path& path )
 {
     SWEET_ASSERT( path.is_absolute() );
     Context* context = allocate_context( forge_->graph()->target(path.parent_path().generic_string()) );
+    context->set_current_buildfile( forge_->graph()->target(path.generic_string()) );
     process_begin( context );
     lua_State* lua_state = context->lua_state();
     dofile( lua_state, path.string().c_str() );
@@ -182,6 +202,33 @@ void Scheduler::execute_finished( int exit_code, Context* context, process::Envi
     delete environment;
 }
 
+/**
+// Resume \e context after a call made by `spawn_lua()` has finished.
+//
+// The coroutine is resumed with true and the values returned by the called
+// function if it succeeded or false and the error message if it failed.
+*/
+void Scheduler::spawn_lua_finished( bool success, const std::string& results, Context* context )
+{
+    SWEET_ASSERT( context );
+
+    process_begin( context );
+    lua_State* lua_state = context->lua_state();
+    lua_pushboolean( lua_state, success ? 1 : 0 );
+    int values = 1;
+    if ( success )
+    {
+        values += LuaStatePool::unmarshal( lua_state, results );
+    }
+    else
+    {
+        lua_pushlstring( lua_state, results.c_str(), results.size() );
+        ++values;
+    }
+    resume( lua_state, values );
+    process_end( context );
+}
+
 void Scheduler::read_finished( Filter* filter, Arguments* arguments )
 {
     // Delete filters and arguments on the main thread to avoid accessing the
@@ -264,6 +311,15 @@ void Scheduler::push_execute_finished( int exit_code, Context* context, process:
     results_condition_.notify_all();
 }
 
+void Scheduler::push_spawn_lua_finished( bool success, const std::string& results, Context* context )
+{
+    std::unique_lock<std::mutex> lock( results_mutex_ );
+    SWEET_ASSERT( pending_results_ > 0 );
+    --pending_results_;
+    results_.push_back( std::bind(&Scheduler::spawn_lua_finished, this, success, results, context) );
+    results_condition_.notify_all();
+}
+
 void Scheduler::push_read_finished( Filter* filter, Arguments* arguments )
 {
     std::unique_lock<std::mutex> lock( results_mutex_ );
@@ -288,6 +344,13 @@ void Scheduler::read( intptr_t fd_or_handle, Filter* filter, Arguments* argument
     ++pending_results_;
 }
 
+void Scheduler::spawn_lua( const std::string& package_path, const std::string& module, const std::string& function, const std::string& arguments, Context* context )
+{
+    std::unique_lock<std::mutex> lock( results_mutex_ );
+    forge_->executor()->spawn_lua( package_path, module, function, arguments, context );
+    ++pending_results_;
+}
+
 void Scheduler::prune()
 {
     if ( !active_contexts_.empty() )
@@ -309,36 +372,72 @@ void Scheduler::wait()
     }
 }
 
-struct ScopedVisit
+int Scheduler::preorder( Target* target, int function )
 {
-    Target* target_;
+    vector<Target*> targets( 1, target ? target : forge_->graph()->root_target() );
+    return preorder_targets( targets, nullptr, function );
+}
 
-    ScopedVisit( Target* target )
-    : target_( target )
+/**
+// Make a preorder pass over just \e targets.
+//
+// The pass starts from the Targets in \e targets that aren't dependencies
+// of other Targets in \e targets and only visits dependencies that are in
+// \e targets.
+//
+// @param targets
+//  The Targets to visit (see Graph::affected_targets()).
+//
+// @param function
+//  The reference to the Lua function to call for each visited Target.
+//
+// @return
+//  The number of errors that occured during the pass.
+*/
+int Scheduler::preorder( const std::vector<Target*>& targets, int function )
+{
+    unordered_set<Target*> scope( targets.begin(), targets.end() );
+    unordered_set<Target*> dependencies;
+    for ( vector<Target*>::const_iterator i = targets.begin(); i != targets.end(); ++i )
     {
-        SWEET_ASSERT( target_ );
-        SWEET_ASSERT( !target_->visiting() );
-        target_->set_visited( true );
-        target_->set_visiting( true );
+        Target* target = *i;
+        SWEET_ASSERT( target );
+        int index = 0;
+        Target* dependency = target->any_dependency( index );
+        while ( dependency )
+        {
+            if ( dependency != target && scope.count(dependency) )
+            {
+                dependencies.insert( dependency );
+            }
+            ++index;
+            dependency = target->any_dependency( index );
+        }
     }
 
-    ~ScopedVisit()
+    vector<Target*> roots;
+    for ( vector<Target*>::const_iterator i = targets.begin(); i != targets.end(); ++i )
     {
-        SWEET_ASSERT( target_->visiting() );
-        target_->set_visiting( false );
+        if ( !dependencies.count(*i) )
+        {
+            roots.push_back( *i );
+        }
     }
-};
+    return preorder_targets( roots, &scope, function );
+}
 
-int Scheduler::preorder( Target* target, int function )
+int Scheduler::preorder_targets( const std::vector<Target*>& targets, const std::unordered_set<Target*>* scope, int function )
 {
     struct Preorder
     {
         Forge* forge_;
         list<Job> jobs_;
+        const unordered_set<Target*>* scope_; ///< The Targets to restrict the pass to or null to visit all dependencies.
 
-        Preorder( Forge* forge )
+        Preorder( Forge* forge, const unordered_set<Target*>* scope )
         : forge_( forge )
         , jobs_()
+        , scope_( scope )
         {
             SWEET_ASSERT( forge_ );
             forge_->graph()->begin_traversal();
@@ -396,7 +495,7 @@ int Scheduler::preorder( Target* target, int function )
                         Target* dependency = target->any_dependency( i );
                         while ( dependency )
                         {
-                            if ( dependency->referenced_by_script() && dependency->working_directory() && !dependency->visited() )
+                            if ( dependency->referenced_by_script() && dependency->working_directory() && !dependency->visited() && (!scope_ || scope_->count(dependency)) )
                             {
                                 if ( !dependency->visiting() )
                                 {
@@ -427,6 +526,28 @@ int Scheduler::preorder( Target* target, int function )
         {
             return jobs_.empty();
         }
+
+        void cancel()
+        {
+            // Drop waiting and complete jobs without queueing the jobs for 
+            // their dependencies, leaving only the jobs still processing.
+            list<Job>::iterator job = jobs_.begin();
+            while ( job != jobs_.end() )
+            {
+                if ( job->state() != JOB_PROCESSING )
+                {
+                    if ( job->state() == JOB_COMPLETE )
+                    {
+                        job->target()->set_visiting( false );
+                    }
+                    job = jobs_.erase( job );
+                }
+                else
+                {
+                    ++job;
+                }
+            }
+        }
     };
 
     Graph* graph = forge_->graph();
@@ -438,34 +559,82 @@ int Scheduler::preorder( Target* target, int function )
 
     error::ErrorPolicy& error_policy = forge_->error_policy();
     error_policy.push_errors();
+    failed_jobs_ = 0;
 
-    Preorder preorder( forge_ );
-    preorder.begin_traversal( target ? target : graph->root_target() );
+    Preorder preorder( forge_, scope );
+    for ( vector<Target*>::const_iterator target = targets.begin(); target != targets.end(); ++target )
+    {
+        preorder.begin_traversal( *target );
+    }
     while ( !preorder.empty() )
     {
-        Job* job = preorder.pull_job();
+        Job* job = keep_going() ? preorder.pull_job() : nullptr;
         while ( job )
         {
             preorder_visit( function, job );
-            job = preorder.pull_job();
+            job = keep_going() ? preorder.pull_job() : nullptr;
+        }
+        if ( !keep_going() )
+        {
+            preorder.cancel();
         }
         dispatch_results();
     }
     wait();
+    forge_->executor()->reset_cancelled();
 
     return error_policy.pop_errors();
 }
 
 int Scheduler::postorder( Target* target, int function )
+{
+    vector<Target*> targets( 1, target ? target : forge_->graph()->root_target() );
+    return postorder_targets( targets, nullptr, function );
+}
+
+/**
+// Make a postorder pass over just \e targets.
+//
+// Dependencies that aren't in \e targets are assumed to be up to date; they
+// aren't visited and don't prevent the Targets that depend on them from
+// being visited.
+//
+// @param targets
+//  The Targets to visit (see Graph::affected_targets()).
+//
+// @param function
+//  The reference to the Lua function to call for each visited Target.
+//
+// @return
+//  The number of errors that occured during the pass.
+*/
+int Scheduler::postorder( const std::vector<Target*>& targets, int function )
+{
+    unordered_set<Target*> scope( targets.begin(), targets.end() );
+    return postorder_targets( targets, &scope, function );
+}
+
+int Scheduler::postorder_targets( const std::vector<Target*>& targets, const std::unordered_set<Target*>* scope, int function )
 {
     struct Postorder
     {
+        struct Visit
+        {
+            Target* target_; ///< The Target being visited.
+            int dependency_; ///< The index of the next binding dependency to visit.
+            int height_; ///< The greatest height of the dependencies visited so far.
+        };
+
         Forge* forge_;
         list<Job> jobs_;
+        vector<Visit> visits_; ///< The Targets being visited from the outermost to the innermost.
+        const unordered_set<Target*>* scope_; ///< The Targets to restrict the pass to or null to visit all dependencies.
 
-        Postorder( Forge* forge )
+        Postorder( Forge* forge, const unordered_set<Target*>* scope )
         : forge_( forge )
         , jobs_()
+        , visits_()
+        , scope_( scope )
         {
             SWEET_ASSERT( forge_ );
             forge_->graph()->begin_traversal();
@@ -473,20 +642,34 @@ int Scheduler::postorder( Target* target, int function )
 
         ~Postorder()
         {
+            while ( !visits_.empty() )
+            {
+                visits_.back().target_->set_visiting( false );
+                visits_.pop_back();
+            }
             forge_->graph()->end_traversal();
         }
 
         Job* pull_job()
         {
-            remove_complete_jobs();
-
+            // Complete jobs are removed only as far as the first job that 
+            // can be processed; those further along the list can't affect 
+            // which job is pulled and are removed by later pulls.  This keeps
+            // pulling jobs from long chains of dependencies linear rather
+            // than quadratic in the number of jobs.
             int height = INT_MAX;
             list<Job>::iterator job = jobs_.begin();
-
             while ( job != jobs_.end() && (job->state() != JOB_WAITING || job->height() > height) )
             {
-                height = std::min( height, job->height() );
-                ++job;
+                if ( job->state() == JOB_COMPLETE )
+                {
+                    job = jobs_.erase( job );
+                }
+                else
+                {
+                    height = std::min( height, job->height() );
+                    ++job;
+                }
             }
 
             if ( job != jobs_.end() )
@@ -498,12 +681,19 @@ int Scheduler::postorder( Target* target, int function )
             return job != jobs_.end() ? &(*job) : NULL;
         }
 
-        void remove_complete_jobs()
+        bool empty() const
+        {
+            return jobs_.empty();
+        }
+
+        void cancel()
         {
+            // Drop waiting and complete jobs leaving only the jobs still 
+            // processing.
             list<Job>::iterator job = jobs_.begin();
             while ( job != jobs_.end() )
             {
-                if ( job->state() == JOB_COMPLETE )
+                if ( job->state() != JOB_PROCESSING )
                 {
                     job = jobs_.erase( job );
                 }
@@ -514,51 +704,85 @@ int Scheduler::postorder( Target* target, int function )
             }
         }
 
-        bool empty() const
-        {
-            return jobs_.empty();
-        }
-
         void visit( Target* target )
         {
             SWEET_ASSERT( target );
+            SWEET_ASSERT( visits_.empty() );
 
+            // Keep the Targets being visited on an explicit stack rather than 
+            // recursing so that arbitrarily deep chains of dependencies don't 
+            // overflow the C++ stack.
             if ( !target->visited() )
             {
-                ScopedVisit visit( target );
+                begin_visit( target );
+            }
 
-                int height = 0;
-                int i = 0;
-                Target* dependency = target->binding_dependency( i );
-                while ( dependency )
+            while ( !visits_.empty() )
+            {
+                Visit& visit = visits_.back();
+                Target* target = visit.target_;
+                Target* dependency = target->binding_dependency( visit.dependency_ );
+                if ( dependency )
                 {
-                    if ( !dependency->visiting() )
+                    ++visit.dependency_;
+                    if ( scope_ && !scope_->count(dependency) )
                     {
-                        Postorder::visit( dependency );
-                        height = std::max( height, dependency->postorder_height() + 1 );
+                        dependency->set_successful( true );
                     }
-                    else
+                    else if ( dependency->visiting() )
                     {
                         forge_->errorf( "Cyclic dependency from %s to %s in postorder", target->error_identifier().c_str(), dependency->error_identifier().c_str() );
                         dependency->set_successful( true );
                     }
-
-                    ++i;
-                    dependency = target->binding_dependency( i );
-                }
-
-                if ( target->referenced_by_script() && target->working_directory() )
-                {
-                    target->set_postorder_height( height );
-                    jobs_.push_back( Job(target, height) );
+                    else if ( dependency->visited() )
+                    {
+                        visit.height_ = std::max( visit.height_, dependency->postorder_height() + 1 );
+                    }
+                    else
+                    {
+                        begin_visit( dependency );
+                    }
                 }
                 else
                 {
-                    target->set_postorder_height( -1 );
-                    target->set_successful( true );
+                    int height = visit.height_;
+                    visits_.pop_back();
+                    end_visit( target, height );
+                    if ( !visits_.empty() )
+                    {
+                        Visit& parent = visits_.back();
+                        parent.height_ = std::max( parent.height_, target->postorder_height() + 1 );
+                    }
                 }
             }
         }
+
+        void begin_visit( Target* target )
+        {
+            SWEET_ASSERT( target );
+            SWEET_ASSERT( !target->visiting() );
+            target->set_visited( true );
+            target->set_visiting( true );
+            Visit visit = { target, 0, 0 };
+            visits_.push_back( visit );
+        }
+
+        void end_visit( Target* target, int height )
+        {
+            SWEET_ASSERT( target );
+            if ( target->referenced_by_script() && target->working_directory() )
+            {
+                target->set_postorder_height( height );
+                jobs_.push_back( Job(target, height) );
+            }
+            else
+            {
+                target->set_postorder_height( -1 );
+                target->set_successful( true );
+            }
+            SWEET_ASSERT( target->visiting() );
+            target->set_visiting( false );
+        }
     };
 
     Graph* graph = forge_->graph();
@@ -570,22 +794,35 @@ int Scheduler::postorder( Target* target, int function )
 
     error::ErrorPolicy& error_policy = forge_->error_policy();
     error_policy.push_errors();
+    failed_jobs_ = 0;
+    checkpoint_completed_jobs_ = completed_jobs_;
+    checkpoint_time_ = std::chrono::steady_clock::now();
 
-    Postorder postorder( forge_ );
-    postorder.visit( target ? target : graph->root_target() );
+    Postorder postorder( forge_, scope );
+    for ( vector<Target*>::const_iterator target = targets.begin(); target != targets.end(); ++target )
+    {
+        postorder.visit( *target );
+    }
     if ( error_policy.errors() == 0 )
     {
         while ( !postorder.empty() )
         {
-            Job* job = postorder.pull_job();
+            Job* job = keep_going() ? postorder.pull_job() : nullptr;
             while ( job )
             {
                 postorder_visit( function, job );
-                job = postorder.pull_job();
+                job = keep_going() ? postorder.pull_job() : nullptr;
+            }
+            if ( !keep_going() )
+            {
+                postorder.cancel();
             }
             dispatch_results();
+            checkpoint();
         }
         wait();
+        forge_->executor()->reset_cancelled();
+        graph->wait_for_checkpoint();
     }
 
     return error_policy.pop_errors();
@@ -596,11 +833,48 @@ Context* Scheduler::context() const
     return !active_contexts_.empty() ? active_contexts_.back() : NULL;
 }
 
+/**
+// Get the number of Contexts that are allocated and not yet freed.
+*/
+int Scheduler::live_contexts() const
+{
+    return live_contexts_;
+}
+
+/**
+// Get the number of Contexts created by this Scheduler; both live and free
+// for reuse.
+*/
+int Scheduler::created_contexts() const
+{
+    return live_contexts_ + int(free_contexts_.size());
+}
+
+/**
+// Get the number of times a Context has been allocated by reusing a Context
+// from the free list rather than creating a new one.
+*/
+int Scheduler::recycled_contexts() const
+{
+    return recycled_contexts_;
+}
+
 Context* Scheduler::allocate_context( Target* working_directory, Job* job )
 {
     SWEET_ASSERT( working_directory );
     SWEET_ASSERT( !job || job->working_directory() == working_directory );
-    Context* context = new Context( forge_ );
+    Context* context = nullptr;
+    if ( !free_contexts_.empty() )
+    {
+        context = free_contexts_.back();
+        free_contexts_.pop_back();
+        ++recycled_contexts_;
+    }
+    else
+    {
+        context = new Context( forge_ );
+    }
+    ++live_contexts_;
     context->reset_directory_to_target( working_directory );
     context->set_job( job );
     return context;
@@ -615,9 +889,10 @@ void Scheduler::free_context( Context* context )
     {
         job->set_state( JOB_COMPLETE );
         job->set_prune( context->prune() );
+        ++completed_jobs_;
     }
 
-    delete context;
+    recycle_context( context );
 }
 
 void Scheduler::destroy_context( Context* context )
@@ -630,9 +905,28 @@ void Scheduler::destroy_context( Context* context )
         job->set_state( JOB_COMPLETE );
         job->set_prune( true );
         job->target()->set_successful( false );
+        ++failed_jobs_;
+        ++completed_jobs_;
     }
 
-    delete context;
+    recycle_context( context );
+}
+
+/**
+// Reset \e context and return it to the free list to be reused by the next
+// call to Scheduler::allocate_context().
+//
+// Reusing Contexts reuses their Lua coroutines rather than creating a new
+// coroutine for every visit, buildfile, and line of output and leaving the
+// old ones for the garbage collector.
+*/
+void Scheduler::recycle_context( Context* context )
+{
+    SWEET_ASSERT( context );
+    SWEET_ASSERT( live_contexts_ > 0 );
+    context->reset();
+    free_contexts_.push_back( context );
+    --live_contexts_;
 }
 
 bool Scheduler::dispatch_results()
@@ -696,7 +990,7 @@ void Scheduler::dofile( lua_State* lua_state, const char* filename )
 {
     SWEET_ASSERT( lua_state );
     SWEET_ASSERT( filename );
-    int result = luaL_loadfile( lua_state, filename );
+    int result = forge_->bytecode_cache()->load( lua_state, filename );
     switch ( result )
     {
         case LUA_OK:
@@ -835,3 +1129,54 @@ void Scheduler::resume( lua_State* lua_state, int parameters )
         }
     }
 }
+
+/**
+// Should a traversal keep visiting Targets?
+//
+// Once the number of failed Jobs reaches the limit set by
+// Forge::set_keep_going() the Executor is cancelled so that processes still
+// running are terminated and no more are started.  The traversal then only
+// waits for the visits in progress to finish before returning.
+//
+// @return
+//  True to keep visiting Targets or false to stop.
+*/
+bool Scheduler::keep_going()
+{
+    int keep_going = forge_->keep_going();
+    if ( keep_going > 0 && failed_jobs_ >= keep_going )
+    {
+        Executor* executor = forge_->executor();
+        if ( !executor->cancelled() )
+        {
+            forge_->outputf( "forge: stopping after %d failed job%s", failed_jobs_, failed_jobs_ != 1 ? "s" : "" );
+            executor->cancel();
+        }
+        return false;
+    }
+    return true;
+}
+
+/**
+// Checkpoint the Graph if enough time has passed or enough Jobs have 
+// completed since it was last checkpointed (see 
+// Graph::set_checkpoint_interval()).
+*/
+void Scheduler::checkpoint()
+{
+    Graph* graph = forge_->graph();
+    int interval = graph->checkpoint_interval();
+    int jobs = graph->checkpoint_jobs();
+    int completed_jobs = completed_jobs_ - checkpoint_completed_jobs_;
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    bool checkpoint = completed_jobs > 0 && (
+        (interval > 0 && now - checkpoint_time_ >= std::chrono::seconds(interval)) ||
+        (jobs > 0 && completed_jobs >= jobs)
+    );
+    if ( checkpoint )
+    {
+        graph->checkpoint_binary();
+        checkpoint_completed_jobs_ = completed_jobs_;
+        checkpoint_time_ = now;
+    }
+}
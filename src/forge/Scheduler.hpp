@@ -4,9 +4,11 @@
 #include <filesystem>
 #include <deque>
 #include <vector>
+#include <unordered_set>
 #include <functional>
 #include <mutex>
 #include <condition_variable>
+#include <chrono>
 
 struct lua_State;
 
@@ -39,15 +41,23 @@ class Scheduler
 {
     Forge* forge_; ///< The Forge that this Scheduler is part of.
     std::vector<Context*> active_contexts_; ///< The stack of Contexts that are currently executing Lua scripts.
+    std::vector<Context*> free_contexts_; ///< The Contexts that have finished executing and are available for reuse.
+    int live_contexts_; ///< The number of Contexts allocated and not yet freed.
+    int recycled_contexts_; ///< The number of Contexts allocated by reusing a free Context.
     std::mutex results_mutex_; ///< The mutex that ensures exclusive access to the results queue.
     std::condition_variable results_condition_; ///< The Condition that is used to wait for results.
     std::deque<std::function<void()> > results_; ///< The functions to be executed as a result of jobs processing in the thread pool.
     std::vector<Target*> buildfiles_stack_; ///< The stack of currently processing buildfiles.
     int pending_results_; ///< The number of results waiting on execute and read tasks to finish.
     int buildfile_calls_; ///< The number of outstanding calls made to load buildfiles.
+    int failed_jobs_; ///< The number of Jobs that have failed during the current traversal.
+    int completed_jobs_; ///< The number of Jobs that have completed.
+    int checkpoint_completed_jobs_; ///< The number of Jobs that had completed when the Graph was last checkpointed.
+    std::chrono::steady_clock::time_point checkpoint_time_; ///< The time that the Graph was last checkpointed.
 
     public:
         Scheduler( Forge* forge );
+        ~Scheduler();
 
         void load( const std::filesystem::path& path );
         void script( const std::filesystem::path& working_directory, const std::string& script );
@@ -57,6 +67,7 @@ class Scheduler
         void postorder_visit( int function, Job* job );
         void execute_finished( int exit_code, Context* context, process::Environment* environment );
         void read_finished( Filter* filter, Arguments* arguments );
+        void spawn_lua_finished( bool success, const std::string& results, Context* context );
         void buildfile_finished( Context* context, bool success );
         void output( const std::string& output, Filter* filter, Arguments* arguments, Target* working_directory );
         void error( const std::string& what );
@@ -65,16 +76,23 @@ class Scheduler
         void push_errorf( const char* format, ... );
         void push_execute_finished( int exit_code, Context* context, process::Environment* environment );
         void push_read_finished( Filter* filter, Arguments* arguments );
+        void push_spawn_lua_finished( bool success, const std::string& results, Context* context );
 
         void execute( const std::string& command, const std::string& command_line, process::Environment* environment, Filter* dependencies_filter, Filter* stdout_filter, Filter* stderr_filter, Arguments* arguments, Context* context );
         void read( intptr_t fd_or_handle, Filter* filter, Arguments* arguments, Target* working_directory );
+        void spawn_lua( const std::string& package_path, const std::string& module, const std::string& function, const std::string& arguments, Context* context );
         void prune();
         void wait();
         
         int preorder( Target* target, int function );        
+        int preorder( const std::vector<Target*>& targets, int function );
         int postorder( Target* target, int function );        
+        int postorder( const std::vector<Target*>& targets, int function );
 
         Context* context() const;
+        int live_contexts() const;
+        int created_contexts() const;
+        int recycled_contexts() const;
 
     private:
         bool dispatch_results();
@@ -83,11 +101,16 @@ class Scheduler
         Context* allocate_context( Target* working_directory, Job* job = NULL );
         void free_context( Context* context );
         void destroy_context( Context* context );
+        void recycle_context( Context* context );
         void push_context( Context* context );
         int pop_context( Context* context );
         void dofile( lua_State* lua_state, const char* filename );
         void doscript( lua_State* lua_state, const char* script );
         void resume( lua_State* lua_state, int parameters );
+        bool keep_going();
+        void checkpoint();
+        int preorder_targets( const std::vector<Target*>& targets, const std::unordered_set<Target*>* scope, int function );
+        int postorder_targets( const std::vector<Target*>& targets, const std::unordered_set<Target*>* scope, int function );
 };
 
 }
@@ -5,6 +5,10 @@
 
 #include "System.hpp"
 #include <assert/assert.hpp>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
 
 #if defined(BUILD_OS_WINDOWS)
 #include <windows.h>
@@ -14,16 +18,162 @@
 #include <mach-o/dyld.h>
 #include <sys/types.h>
 #include <sys/sysctl.h>
+#include <sys/clonefile.h>
 #elif defined(BUILD_OS_LINUX)
 #include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <linux/fs.h>
 #include <linux/limits.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
 #include <sys/sysinfo.h>
 #endif
 
 using std::string;
+using std::vector;
 using namespace sweet;
 using namespace sweet::forge;
 
+#if defined(BUILD_OS_LINUX)
+
+/**
+// The size of the buffer used to copy files that can be neither cloned nor
+// copied with `copy_file_range()`.
+*/
+static const size_t COPY_BUFFER_SIZE = 128 * 1024;
+
+/**
+// Copy the file \e from to the new file \e to in the kernel.
+//
+// Tries a reflink with `ioctl(FICLONE)` first, which shares the source's
+// extents on file systems that support it (btrfs, XFS) and so copies any
+// size of file in constant time, then `copy_file_range()`, which avoids
+// copying data through user space, and finally `read()` and `write()` from
+// wherever `copy_file_range()` stopped.  The copy keeps the permissions and
+// last write time of \e from.
+*/
+static std::error_code copy_file( const string& from, const string& to )
+{
+    int source = open( from.c_str(), O_RDONLY | O_CLOEXEC );
+    if ( source < 0 )
+    {
+        return std::error_code( errno, std::generic_category() );
+    }
+
+    struct stat status;
+    if ( fstat(source, &status) != 0 )
+    {
+        int error = errno;
+        close( source );
+        return std::error_code( error, std::generic_category() );
+    }
+
+    int destination = open( to.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, status.st_mode & 07777 );
+    if ( destination < 0 )
+    {
+        int error = errno;
+        close( source );
+        return std::error_code( error, std::generic_category() );
+    }
+
+    int error = 0;
+    if ( ioctl(destination, FICLONE, source) != 0 )
+    {
+        off_t remaining = status.st_size;
+        while ( remaining > 0 )
+        {
+            ssize_t bytes = copy_file_range( source, nullptr, destination, nullptr, size_t(remaining), 0 );
+            if ( bytes <= 0 )
+            {
+                break;
+            }
+            remaining -= bytes;
+        }
+
+        vector<char> buffer;
+        while ( remaining > 0 && error == 0 )
+        {
+            buffer.resize( COPY_BUFFER_SIZE );
+            ssize_t bytes = read( source, &buffer[0], buffer.size() );
+            if ( bytes < 0 && errno == EINTR )
+            {
+                continue;
+            }
+            if ( bytes <= 0 )
+            {
+                error = bytes < 0 ? errno : 0;
+                break;
+            }
+            ssize_t written = 0;
+            while ( written < bytes )
+            {
+                ssize_t write_bytes = write( destination, &buffer[written], size_t(bytes - written) );
+                if ( write_bytes < 0 && errno != EINTR )
+                {
+                    error = errno;
+                    break;
+                }
+                written += std::max( write_bytes, ssize_t(0) );
+            }
+            remaining -= written;
+        }
+    }
+
+    if ( error == 0 )
+    {
+        struct timespec times [2] = { status.st_atim, status.st_mtim };
+        if ( fchmod(destination, status.st_mode & 07777) != 0 || futimens(destination, times) != 0 )
+        {
+            error = errno;
+        }
+    }
+    if ( close(destination) != 0 && error == 0 )
+    {
+        error = errno;
+    }
+    close( source );
+
+    if ( error != 0 )
+    {
+        unlink( to.c_str() );
+        return std::error_code( error, std::generic_category() );
+    }
+    return std::error_code();
+}
+
+#else
+
+/**
+// Copy the file \e from to the new file \e to.
+//
+// Clones the file with `clonefile()` on macOS when the file system supports
+// it (APFS) before falling back to a full copy.  The copy keeps the last
+// write time of \e from.
+*/
+static std::error_code copy_file( const string& from, const string& to )
+{
+#if defined(BUILD_OS_MACOS)
+    if ( clonefile(from.c_str(), to.c_str(), 0) == 0 )
+    {
+        return std::error_code();
+    }
+#endif
+    std::error_code error;
+    std::filesystem::copy_file( from, to, error );
+    if ( !error )
+    {
+        std::filesystem::file_time_type last_write_time = std::filesystem::last_write_time( from, error );
+        if ( !error )
+        {
+            std::filesystem::last_write_time( to, last_write_time, error );
+        }
+    }
+    return error;
+}
+
+#endif
+
 /**
 // Constructor.
 */
@@ -243,17 +393,111 @@ void System::rmdir( const std::string& path ) const
 }
 
 /**
-// Copy a file or directory.
+// Copy a file.
+//
+// Any existing file at \e to is removed first, rather than overwritten, so
+// that a previous copy that was hard linked to its source never has its
+// source overwritten through it.  The copy is a reflink where the file
+// system supports it and otherwise made in the kernel where possible (see
+// `copy_file()`).  The copy keeps the last write time of \e from so that it
+// doesn't appear newer than the file it was copied from.
 //
 // @param from
 //  The file to copy.
 //
 // @param to
 //  The destination to copy the file to.
+//
+// @param link
+//  True to hard link \e to to \e from rather than copying it.  Only link
+//  files that are never modified in place after they're copied as the link
+//  and its source share the same contents.  Falls back to a copy when the
+//  link can't be made, e.g. across file systems.
+*/
+void System::cp( const std::string& from, const std::string& to, bool link ) const
+{
+    std::error_code error;
+    std::filesystem::remove( to, error );
+    if ( error )
+    {
+        throw std::filesystem::filesystem_error( "cp", to, error );
+    }
+
+    if ( link )
+    {
+        std::filesystem::create_hard_link( from, to, error );
+        if ( !error )
+        {
+            return;
+        }
+    }
+
+    error = copy_file( from, to );
+    if ( error )
+    {
+        throw std::filesystem::filesystem_error( "cp", from, to, error );
+    }
+}
+
+/**
+// Copy many files concurrently.
+//
+// @param copies
+//  The source and destination paths of each file to copy.
+//
+// @param link
+//  True to hard link files rather than copying them (see System::cp()).
+//
+// @param threads
+//  The maximum number of threads to copy files on.
+//
+// @param error
+//  Set to a message describing the first failure, if any.
+//
+// @return
+//  The number of files that failed to copy.
 */
-void System::cp( const std::string& from, const std::string& to ) const
+int System::cp_many( const std::vector<std::pair<std::string, std::string>>& copies, bool link, int threads, std::string* error ) const
 {
-    std::filesystem::copy_file( from, to );
+    SWEET_ASSERT( error );
+
+    std::atomic<size_t> next_copy( 0 );
+    std::atomic<int> failures( 0 );
+    std::mutex error_mutex;
+    auto copy_files = [&]()
+    {
+        size_t index = next_copy++;
+        while ( index < copies.size() )
+        {
+            try
+            {
+                cp( copies[index].first, copies[index].second, link );
+            }
+            catch ( const std::exception& exception )
+            {
+                ++failures;
+                std::lock_guard<std::mutex> lock( error_mutex );
+                if ( error->empty() )
+                {
+                    *error = exception.what();
+                }
+            }
+            index = next_copy++;
+        }
+    };
+
+    size_t copy_threads = std::min( size_t(std::max(threads, 1)), copies.size() );
+    vector<std::thread> workers;
+    for ( size_t thread = 1; thread < copy_threads; ++thread )
+    {
+        workers.push_back( std::thread(copy_files) );
+    }
+    copy_files();
+    for ( vector<std::thread>::iterator worker = workers.begin(); worker != workers.end(); ++worker )
+    {
+        worker->join();
+    }
+    return failures;
 }
 
 /**
@@ -267,6 +511,130 @@ void System::rm( const std::string& path ) const
     std::filesystem::remove( path );
 }
 
+/**
+// Remove many files concurrently.
+//
+// Paths are grouped by the directory that contains them and each group is
+// removed on one thread.  On Linux each directory is opened once and its
+// entries removed relative to it with `unlinkat()` so that the path isn't
+// resolved again for every file.  Paths that don't exist are ignored and
+// empty directories are removed as per System::rm().
+//
+// @param paths
+//  The absolute paths to the files to remove.
+//
+// @param threads
+//  The maximum number of threads to remove files on.
+//
+// @param error
+//  Set to a message describing the first failure, if any.
+//
+// @return
+//  The number of paths that failed to be removed.
+*/
+int System::rm_many( const std::vector<std::string>& paths, int threads, std::string* error ) const
+{
+    SWEET_ASSERT( error );
+
+    vector<string> sorted_paths( paths );
+    std::sort( sorted_paths.begin(), sorted_paths.end() );
+    sorted_paths.erase( std::unique(sorted_paths.begin(), sorted_paths.end()), sorted_paths.end() );
+
+    // Each group is the range of paths from its start to the start of the
+    // next group; paths in the same directory are adjacent once sorted.
+    vector<size_t> groups;
+    string::size_type previous_length = string::npos;
+    for ( size_t i = 0; i < sorted_paths.size(); ++i )
+    {
+        string::size_type length = sorted_paths[i].rfind( '/' );
+        if ( groups.empty() || length != previous_length || sorted_paths[i].compare(0, length, sorted_paths[groups.back()], 0, length) != 0 )
+        {
+            groups.push_back( i );
+            previous_length = length;
+        }
+    }
+    groups.push_back( sorted_paths.size() );
+
+    std::atomic<size_t> next_group( 0 );
+    std::atomic<int> failures( 0 );
+    std::mutex error_mutex;
+    auto fail = [&]( const string& path, const std::error_code& remove_error )
+    {
+        ++failures;
+        std::lock_guard<std::mutex> lock( error_mutex );
+        if ( error->empty() )
+        {
+            *error = std::filesystem::filesystem_error( "rm", path, remove_error ).what();
+        }
+    };
+    auto remove_groups = [&]()
+    {
+        size_t group = next_group++;
+        while ( group + 1 < groups.size() )
+        {
+            size_t begin = groups[group];
+            size_t end = groups[group + 1];
+#if defined(BUILD_OS_LINUX)
+            string::size_type length = sorted_paths[begin].rfind( '/' );
+            string directory = length == 0 ? string( "/" ) : sorted_paths[begin].substr( 0, length );
+            int directory_fd = length == string::npos ? AT_FDCWD : open( directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC );
+            if ( directory_fd >= 0 || directory_fd == AT_FDCWD )
+            {
+                for ( size_t i = begin; i < end; ++i )
+                {
+                    const char* name = sorted_paths[i].c_str() + (length == string::npos ? 0 : length + 1);
+                    int result = unlinkat( directory_fd, name, 0 );
+                    if ( result != 0 && errno == EISDIR )
+                    {
+                        result = unlinkat( directory_fd, name, AT_REMOVEDIR );
+                    }
+                    if ( result != 0 && errno != ENOENT )
+                    {
+                        fail( sorted_paths[i], std::error_code(errno, std::generic_category()) );
+                    }
+                }
+                if ( directory_fd != AT_FDCWD )
+                {
+                    close( directory_fd );
+                }
+            }
+            else if ( errno != ENOENT )
+            {
+                std::error_code open_error( errno, std::generic_category() );
+                for ( size_t i = begin; i < end; ++i )
+                {
+                    fail( sorted_paths[i], open_error );
+                }
+            }
+#else
+            for ( size_t i = begin; i < end; ++i )
+            {
+                std::error_code remove_error;
+                std::filesystem::remove( sorted_paths[i], remove_error );
+                if ( remove_error )
+                {
+                    fail( sorted_paths[i], remove_error );
+                }
+            }
+#endif
+            group = next_group++;
+        }
+    };
+
+    size_t remove_threads = std::min( size_t(std::max(threads, 1)), groups.size() - 1 );
+    vector<std::thread> workers;
+    for ( size_t thread = 1; thread < remove_threads; ++thread )
+    {
+        workers.push_back( std::thread(remove_groups) );
+    }
+    remove_groups();
+    for ( vector<std::thread>::iterator worker = workers.begin(); worker != workers.end(); ++worker )
+    {
+        worker->join();
+    }
+    return failures;
+}
+
 /**
 // Get a string that identifies the host operating system.
 //
@@ -302,6 +670,29 @@ const char* System::getenv( const char* name ) const
     return ::getenv( name );
 }
 
+/**
+// Get the name of a temporary file to write before renaming it over
+// \e filename.
+//
+// The name includes the id of this process so that concurrent builds
+// writing the same file never write to the same temporary file.
+//
+// @param filename
+//  The name of the file that the temporary file will be renamed to.
+//
+// @return
+//  The name of the temporary file.
+*/
+std::string System::temporary_filename( const std::string& filename ) const
+{
+#if defined(BUILD_OS_WINDOWS)
+    unsigned long process_id = GetCurrentProcessId();
+#else
+    unsigned long process_id = static_cast<unsigned long>( getpid() );
+#endif
+    return filename + "." + std::to_string( process_id ) + ".tmp";
+}
+
 /**
 // Get the number of logical processors available in the system.
 //
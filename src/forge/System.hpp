@@ -2,6 +2,7 @@
 #define FORGE_SYSTEM_HPP_INCLUDED
 
 #include <filesystem>
+#include <vector>
 #include <string>
 
 namespace sweet
@@ -31,10 +32,13 @@ public:
     std::string home() const;
     void mkdir( const std::string& path ) const;
     void rmdir( const std::string& path ) const;
-    void cp( const std::string& from, const std::string& to ) const;
+    void cp( const std::string& from, const std::string& to, bool link = false ) const;
+    int cp_many( const std::vector<std::pair<std::string, std::string>>& copies, bool link, int threads, std::string* error ) const;
     void rm( const std::string& path ) const;
+    int rm_many( const std::vector<std::string>& paths, int threads, std::string* error ) const;
     const char* operating_system() const;
     const char* getenv( const char* name ) const;
+    std::string temporary_filename( const std::string& filename ) const;
     int number_of_logical_processors() const;
     void sleep( float milliseconds ) const;
     float ticks() const;
@@ -24,38 +24,47 @@ using file_time_type = std::filesystem::file_time_type;
 using namespace sweet;
 using namespace sweet::forge;
 
+/**
+// The number of dependencies above which a Target indexes its dependencies
+// to check membership in constant rather than linear time.
+*/
+static const size_t DEPENDENCY_INDEX_THRESHOLD = 32;
+
 /**
 // Constructor.
 */
 Target::Target()
-: id_()
-, path_()
-, branch_()
-, graph_( nullptr )
-, rule_( nullptr )
-, timestamp_( file_time_type::min() )
-, last_write_time_( file_time_type::min() )
-, hash_( 0 )
-, pending_hash_( 0 )
-, outdated_( false )
+: outdated_( false )
 , bound_to_file_( false )
 , bound_to_dependencies_( false )
+, visiting_( false )
 , referenced_by_script_( false )
 , cleanable_( false )
 , built_( false )
-, working_directory_( nullptr )
-, parent_( nullptr )
-, targets_()
-, dependencies_()
-, implicit_dependencies_()
-, ordering_dependencies_()
-, passive_dependencies_()
-, filenames_()
-, visiting_( false )
+, shared_( false )
 , visited_revision_( 0 )
 , successful_revision_( 0 )
 , postorder_height_( -1 )
 , anonymous_( 0 )
+, timestamp_( file_time_type::min() )
+, last_write_time_( file_time_type::min() )
+, hash_( 0 )
+, pending_hash_( 0 )
+, prepared_hash_( 0 )
+, prepared_pruned_( false )
+, prepared_dependencies_()
+, dependencies_()
+, dependency_begins_()
+, dependency_index_()
+, graph_( nullptr )
+, rule_( nullptr )
+, working_directory_( nullptr )
+, parent_( nullptr )
+, buildfile_( nullptr )
+, id_( nullptr )
+, path_()
+, targets_()
+, filenames_()
 {
 }
 
@@ -69,36 +78,40 @@ Target::Target()
 //  The Graph that this Target is part of.
 */
 Target::Target( const std::string& id, Graph* graph )
-: id_( id )
-, path_()
-, branch_()
-, graph_( graph )
-, rule_( nullptr )
-, timestamp_( file_time_type::min() )
-, last_write_time_( file_time_type::min() )
-, hash_( 0 )
-, pending_hash_( 0 )
-, outdated_( false )
+: outdated_( false )
 , bound_to_file_( false )
 , bound_to_dependencies_( false )
+, visiting_( false )
 , referenced_by_script_( false )
 , cleanable_( false )
 , built_( false )
-, working_directory_( nullptr )
-, parent_( nullptr )
-, targets_()
-, dependencies_()
-, implicit_dependencies_()
-, ordering_dependencies_()
-, filenames_()
-, visiting_( false )
+, shared_( false )
 , visited_revision_( 0 )
 , successful_revision_( 0 )
 , postorder_height_( -1 )
 , anonymous_( 0 )
+, timestamp_( file_time_type::min() )
+, last_write_time_( file_time_type::min() )
+, hash_( 0 )
+, pending_hash_( 0 )
+, prepared_hash_( 0 )
+, prepared_pruned_( false )
+, prepared_dependencies_()
+, dependencies_()
+, dependency_begins_()
+, dependency_index_()
+, graph_( graph )
+, rule_( nullptr )
+, working_directory_( nullptr )
+, parent_( nullptr )
+, buildfile_( nullptr )
+, id_( graph->intern(id) )
+, path_()
+, targets_()
+, filenames_()
 {
-    SWEET_ASSERT( !id_.empty() );
     SWEET_ASSERT( graph_ );
+    SWEET_ASSERT( !id_->empty() );
 }
 
 Target::~Target()
@@ -116,7 +129,11 @@ Target::~Target()
 }
 
 /**
-// Recover this Target after it has been loaded from an Archive.
+// Recover this Target and the Targets in its namespace after they have been
+// loaded from an Archive.
+//
+// The namespace is walked with an explicit stack rather than recursively so
+// that deeply nested namespaces don't overflow the C++ stack.
 //
 // @param graph
 //  The Graph that this Target is part of.
@@ -124,16 +141,24 @@ Target::~Target()
 void Target::recover( Graph* graph )
 {
     SWEET_ASSERT( graph );    
-    SWEET_ASSERT( graph_ == nullptr || graph_ == graph );
-
-    graph_ = graph;
 
-    for ( vector<Target*>::const_iterator i = targets_.begin(); i != targets_.end(); ++i )
+    vector<Target*> targets;
+    targets.push_back( this );
+    while ( !targets.empty() )
     {
-        Target* target = *i;
+        Target* target = targets.back();
+        targets.pop_back();
         SWEET_ASSERT( target );
-        target->parent_ = this;
-        target->recover( graph );
+        SWEET_ASSERT( target->graph_ == nullptr || target->graph_ == graph );
+        target->graph_ = graph;
+
+        for ( vector<Target*>::const_iterator i = target->targets_.begin(); i != target->targets_.end(); ++i )
+        {
+            Target* child = *i;
+            SWEET_ASSERT( child );
+            child->parent_ = target;
+            targets.push_back( child );
+        }
     }
 }
 
@@ -146,7 +171,8 @@ void Target::recover( Graph* graph )
 */
 const std::string& Target::id() const
 {
-    return id_;
+    SWEET_ASSERT( id_ );
+    return *id_;
 }
 
 /**
@@ -168,52 +194,53 @@ const std::string& Target::path() const
 /**
 // Get the branch path to this Target is in.
 //
+// The branch isn't cached as it is only needed to generate the path, which
+// is.
+//
 // @return
 //  The branch path that this target is in.
 */
-const std::string& Target::branch() const
+std::string Target::branch() const
 {
-    if ( branch_.empty() )
+    string branch;
+    vector<Target*> targets_to_root;
+
+    Target* parent = Target::parent();
+    while ( parent )
     {
-        vector<Target*> targets_to_root;
+        targets_to_root.push_back( parent );
+        parent = parent->parent();
+    }
 
-        Target* parent = Target::parent();
-        while ( parent )
-        {
-            targets_to_root.push_back( parent );
-            parent = parent->parent();
-        }
+    if ( !targets_to_root.empty() )
+    {
+        vector<Target*>::const_reverse_iterator i = targets_to_root.rbegin();
+        ++i;
 
-        if ( !targets_to_root.empty() )
+        if ( i != targets_to_root.rend() )
         {
-            vector<Target*>::const_reverse_iterator i = targets_to_root.rbegin();
-            ++i;
-
-            if ( i != targets_to_root.rend() )
-            {
-                const char DRIVE = ':';
-                if ( (*i)->id().find(DRIVE) != std::string::npos )
-                {
-                    Target* target = *i;
-                    SWEET_ASSERT( target );
-                    branch_ += target->id();
-                    ++i;
-                }
-            }
-            branch_ += "/";
-
-            while ( i != targets_to_root.rend() )
+            const char DRIVE = ':';
+            if ( (*i)->id().find(DRIVE) != std::string::npos )
             {
                 Target* target = *i;
-                SWEET_ASSERT( target != 0 );
-                branch_ += target->id();
-                branch_ += "/";
+                SWEET_ASSERT( target );
+                branch += target->id();
                 ++i;
             }
         }
+        branch += "/";
+
+        while ( i != targets_to_root.rend() )
+        {
+            Target* target = *i;
+            SWEET_ASSERT( target != 0 );
+            branch += target->id();
+            branch += "/";
+            ++i;
+        }
     }
 
-    return branch_;
+    return branch;
 }
 
 /**
@@ -227,7 +254,8 @@ const std::string& Target::branch() const
 */
 bool Target::anonymous() const
 {
-    return id_.size() > 2 && id_[0] == '$' && id_[1] == '$';
+    const string& id = Target::id();
+    return id.size() > 2 && id[0] == '$' && id[1] == '$';
 }
 
 /**
@@ -241,6 +269,18 @@ uint64_t Target::hash() const
     return hash_;
 }
 
+/**
+// Get the hash value set for this Target in the current run (see
+// Target::set_hash()).
+//
+// @return
+//  The hash value or 0 if no hash value has been set.
+*/
+uint64_t Target::pending_hash() const
+{
+    return pending_hash_;
+}
+
 /**
 // Get the Graph that this Target is part of.
 //
@@ -293,6 +333,20 @@ void Target::bind()
     bind_to_dependencies();
 }
 
+/**
+// Unbind this Target.
+//
+// Clears the bound to file and bound to dependencies flags and the outdated
+// flag so that the next call to Target::bind() binds this Target again from
+// scratch.
+*/
+void Target::unbind()
+{
+    bound_to_file_ = false;
+    bound_to_dependencies_ = false;
+    outdated_ = false;
+}
+
 /**
 // Bind this Target to a file.
 //
@@ -365,7 +419,7 @@ void Target::bind_to_dependencies()
     {
         file_time_type timestamp = timestamp_;
         bool outdated = outdated_;
-        int finish = int(dependencies_.size() + implicit_dependencies_.size());
+        int finish = dependencies_end( DEPENDENCY_IMPLICIT );
 
         for (int i = 0; i < finish; ++i)
         {
@@ -473,6 +527,32 @@ bool Target::built() const
     return built_;
 }
 
+/**
+// Set the description of the inputs that this Target was built from.
+//
+// The description is opaque to Forge and saved with the Graph so that a
+// build function can compare it with the inputs that it is about to build
+// from in a later run, e.g. to replace only outdated archive members.
+//
+// @param built_inputs
+//  The description of the inputs that this Target was built from.
+*/
+void Target::set_built_inputs( const std::string& built_inputs )
+{
+    built_inputs_ = built_inputs;
+}
+
+/**
+// Get the description of the inputs that this Target was last built from.
+//
+// @return
+//  The description or the empty string if none has been set.
+*/
+const std::string& Target::built_inputs() const
+{
+    return built_inputs_;
+}
+
 /**
 // Set the timestamp for this Target.
 //
@@ -674,6 +754,61 @@ Target* Target::working_directory() const
     return working_directory_;
 }
 
+/**
+// Record that \e buildfile declared or modified this Target.
+//
+// The first buildfile to declare or modify this Target is recorded as its
+// buildfile so that the contributions made by that buildfile can be 
+// retracted when only changed buildfiles are loaded again (see 
+// Graph::load_binary()).  If another buildfile later declares or modifies 
+// this Target then it is marked as shared as its contributions can no longer
+// be attributed to a single buildfile.
+//
+// @param buildfile
+//  The buildfile that declared or modified this Target (quietly ignored if
+//  null).
+*/
+void Target::add_buildfile( Target* buildfile )
+{
+    if ( buildfile && buildfile != buildfile_ )
+    {
+        shared_ = shared_ || buildfile_ != nullptr;
+        buildfile_ = buildfile_ ? buildfile_ : buildfile;
+    }
+}
+
+/**
+// Clear the buildfile recorded for this Target and its shared flag.
+*/
+void Target::clear_buildfile()
+{
+    buildfile_ = nullptr;
+    shared_ = false;
+}
+
+/**
+// Get the buildfile that first declared or modified this Target.
+//
+// @return
+//  The buildfile or null if no buildfile has declared or modified this 
+//  Target.
+*/
+Target* Target::buildfile() const
+{
+    return buildfile_;
+}
+
+/**
+// Has this Target been declared or modified by more than one buildfile?
+//
+// @return
+//  True if this Target is shared between buildfiles otherwise false.
+*/
+bool Target::shared() const
+{
+    return shared_;
+}
+
 /**
 // Set the Target that is a parent of this Target in the Target namespace.
 //
@@ -769,6 +904,74 @@ const std::vector<Target*>& Target::targets() const
     return targets_;
 }
 
+/**
+// Remember that this Target has been prepared.
+//
+// Records \e structural_hash and this Target's explicit dependencies, as
+// left by its prepare function, so that they can be restored without
+// calling the prepare function again while the structural hash is
+// unchanged (see Target::restore_prepared()).
+//
+// @param structural_hash
+//  The structural hash of this Target before it was prepared (see
+//  Graph::structural_hash()).
+//
+// @param pruned
+//  Whether or not the traversal preparing this Target was pruned at it.
+*/
+void Target::set_prepared( uint64_t structural_hash, bool pruned )
+{
+    prepared_hash_ = structural_hash;
+    prepared_pruned_ = pruned;
+    prepared_dependencies_.assign( dependencies_.begin() + dependencies_begin(DEPENDENCY_EXPLICIT), dependencies_.begin() + dependencies_end(DEPENDENCY_EXPLICIT) );
+}
+
+/**
+// Restore the explicit dependencies that this Target had after it was last
+// prepared if its structural hash hasn't changed since.
+//
+// @param structural_hash
+//  The structural hash of this Target now.
+//
+// @return
+//  True if the dependencies were restored and this Target doesn't need to
+//  be prepared again otherwise false.
+*/
+bool Target::restore_prepared( uint64_t structural_hash )
+{
+    if ( prepared_hash_ == 0 || prepared_hash_ != structural_hash )
+    {
+        return false;
+    }
+    vector<Target*> dependencies;
+    dependencies.swap( prepared_dependencies_ );
+    clear_explicit_dependencies();
+    for ( vector<Target*>::const_iterator i = dependencies.begin(); i != dependencies.end(); ++i )
+    {
+        add_explicit_dependency( *i );
+    }
+    prepared_dependencies_.swap( dependencies );
+    return true;
+}
+
+/**
+// Forget that this Target has been prepared.
+*/
+void Target::clear_prepared()
+{
+    prepared_hash_ = 0;
+    prepared_pruned_ = false;
+    prepared_dependencies_.clear();
+}
+
+/**
+// Was the traversal that last prepared this Target pruned at it?
+*/
+bool Target::prepared_pruned() const
+{
+    return prepared_pruned_;
+}
+
 /**
 // Add a Target as an explicit dependency of this Target.
 //
@@ -797,7 +1000,7 @@ void Target::add_explicit_dependency( Target* target )
     {
         SWEET_ASSERT( target->graph() == graph() );
         remove_dependency( target );
-        dependencies_.push_back( target );
+        insert_dependency( DEPENDENCY_EXPLICIT, target );
         bound_to_dependencies_ = false;
     }
 }
@@ -810,7 +1013,7 @@ void Target::add_explicit_dependency( Target* target )
 */
 void Target::clear_explicit_dependencies()
 {
-    dependencies_.clear();
+    clear_dependencies( DEPENDENCY_EXPLICIT );
     bound_to_dependencies_ = false;
 }
 
@@ -837,7 +1040,7 @@ void Target::add_implicit_dependency( Target* target )
     if ( able_to_add_implicit_dependency )
     {
         remove_dependency( target );
-        implicit_dependencies_.push_back( target );
+        insert_dependency( DEPENDENCY_IMPLICIT, target );
         bound_to_dependencies_ = false;
     }
 }
@@ -857,10 +1060,10 @@ void Target::remove_implicit_dependency( Target* target )
     if ( target && target != this )
     {
         SWEET_ASSERT( target->graph() == graph() );
-        vector<Target*>::iterator i = find( implicit_dependencies_.begin(), implicit_dependencies_.end(), target );
-        if ( i != implicit_dependencies_.end() )
+        int index = find_dependency( DEPENDENCY_IMPLICIT, target );
+        if ( index >= 0 )
         {
-            implicit_dependencies_.erase( i );
+            erase_dependency( index );
             bound_to_dependencies_ = false;
         }
     }
@@ -874,7 +1077,7 @@ void Target::remove_implicit_dependency( Target* target )
 */
 void Target::clear_implicit_dependencies()
 {
-    implicit_dependencies_.clear();
+    clear_dependencies( DEPENDENCY_IMPLICIT );
     bound_to_dependencies_ = false;
 }
 
@@ -897,7 +1100,7 @@ void Target::add_ordering_dependency( Target* target )
     if ( able_to_add_ordering_dependency )
     {
         remove_dependency( target );
-        ordering_dependencies_.push_back( target );
+        insert_dependency( DEPENDENCY_ORDERING, target );
     }
 }
 
@@ -906,7 +1109,7 @@ void Target::add_ordering_dependency( Target* target )
 */
 void Target::clear_ordering_dependencies()
 {
-    ordering_dependencies_.clear();
+    clear_dependencies( DEPENDENCY_ORDERING );
 }
 
 /**
@@ -929,7 +1132,7 @@ void Target::add_passive_dependency( Target* target )
     if ( able_to_passive_dependency_add )
     {
         remove_dependency( target );
-        passive_dependencies_.push_back( target );
+        insert_dependency( DEPENDENCY_PASSIVE, target );
     }
 }
 
@@ -938,7 +1141,7 @@ void Target::add_passive_dependency( Target* target )
 */
 void Target::clear_passive_dependencies()
 {
-    passive_dependencies_.clear();
+    clear_dependencies( DEPENDENCY_PASSIVE );
 }
 
 /**
@@ -954,6 +1157,10 @@ void Target::clear_passive_dependencies()
 // dependencies flag for this Target is cleared to indicate that the outdated
 // flag and/or timestamp are potentially invalid.
 //
+// When the dependencies are indexed the kind of \e target is looked up and
+// only the dependencies of that kind are searched.  Erasing still shifts
+// the dependencies after \e target as each kind is kept in order.
+//
 // @param target
 //  The Target to remove as a dependency.
 */
@@ -962,36 +1169,31 @@ void Target::remove_dependency( Target* target )
     if ( target && target != this )
     {
         SWEET_ASSERT( target->graph() == graph() );
-        vector<Target*>::iterator i = find( dependencies_.begin(), dependencies_.end(), target );
-        if ( i != dependencies_.end() )
+        int index = -1;
+        if ( dependency_index_ )
         {
-            dependencies_.erase( i );
-            bound_to_dependencies_ = false;
+            std::unordered_map<Target*, DependencyKind>::const_iterator i = dependency_index_->find( target );
+            if ( i != dependency_index_->end() )
+            {
+                index = find_dependency( i->second, target );
+                SWEET_ASSERT( index >= 0 );
+            }
         }
-        else 
+        else
         {
-            i = find( implicit_dependencies_.begin(), implicit_dependencies_.end(), target );
-            if ( i != implicit_dependencies_.end() )
+            vector<Target*>::iterator i = find( dependencies_.begin(), dependencies_.end(), target );
+            if ( i != dependencies_.end() )
             {
-                implicit_dependencies_.erase( i );
-                bound_to_dependencies_ = false;
+                index = int(i - dependencies_.begin());
             }
-            else 
+        }
+        if ( index >= 0 )
+        {
+            if ( index < dependencies_end(DEPENDENCY_IMPLICIT) )
             {
-                i = find( ordering_dependencies_.begin(), ordering_dependencies_.end(), target );
-                if ( i != ordering_dependencies_.end() )
-                {
-                    ordering_dependencies_.erase( i );
-                }
-                else
-                {
-                    i = find( passive_dependencies_.begin(), passive_dependencies_.end(), target );
-                    if ( i != passive_dependencies_.end() )
-                    {
-                        passive_dependencies_.erase( i );
-                    }
-                }
+                bound_to_dependencies_ = false;
             }
+            erase_dependency( index );
         }
     }
 }
@@ -1007,7 +1209,7 @@ void Target::remove_dependency( Target* target )
 */
 bool Target::is_explicit_dependency( Target* target ) const
 {
-    return find( dependencies_.begin(), dependencies_.end(), target ) != dependencies_.end();
+    return has_dependency( DEPENDENCY_EXPLICIT, target );
 }
 
 /**
@@ -1021,7 +1223,7 @@ bool Target::is_explicit_dependency( Target* target ) const
 */
 bool Target::is_implicit_dependency( Target* target ) const
 {
-    return find( implicit_dependencies_.begin(), implicit_dependencies_.end(), target ) != implicit_dependencies_.end();
+    return has_dependency( DEPENDENCY_IMPLICIT, target );
 }
 
 /**
@@ -1035,12 +1237,12 @@ bool Target::is_implicit_dependency( Target* target ) const
 */
 bool Target::is_ordering_dependency( Target* target ) const
 {
-    return find( ordering_dependencies_.begin(), ordering_dependencies_.end(), target ) != ordering_dependencies_.end();
+    return has_dependency( DEPENDENCY_ORDERING, target );
 }
 
 bool Target::is_passive_dependency( Target* target ) const
 {
-    return find( passive_dependencies_.begin(), passive_dependencies_.end(), target ) != passive_dependencies_.end();
+    return has_dependency( DEPENDENCY_PASSIVE, target );
 }
 
 /**
@@ -1055,12 +1257,11 @@ bool Target::is_passive_dependency( Target* target ) const
 */
 bool Target::is_dependency( Target* target ) const
 {
-    return 
-        is_explicit_dependency( target ) ||
-        is_implicit_dependency( target ) ||
-        is_ordering_dependency( target ) ||
-        is_passive_dependency( target )
-    ;
+    if ( dependency_index_ )
+    {
+        return dependency_index_->find( target ) != dependency_index_->end();
+    }
+    return find( dependencies_.begin(), dependencies_.end(), target ) != dependencies_.end();
 }
 
 /**
@@ -1075,12 +1276,7 @@ bool Target::is_dependency( Target* target ) const
 */
 Target* Target::explicit_dependency( int n ) const
 {
-    SWEET_ASSERT( n >= 0 );
-    if ( n >= 0 && n < int(dependencies_.size()) )
-    {
-        return dependencies_[n];
-    }
-    return nullptr;
+    return dependency( DEPENDENCY_EXPLICIT, n );
 }
 
 /**
@@ -1095,12 +1291,7 @@ Target* Target::explicit_dependency( int n ) const
 */
 Target* Target::implicit_dependency( int n ) const
 {
-    SWEET_ASSERT( n >= 0 );
-    if ( n >= 0 && n < int(implicit_dependencies_.size()) )
-    {
-        return implicit_dependencies_[n];
-    }
-    return nullptr;
+    return dependency( DEPENDENCY_IMPLICIT, n );
 }
 
 /**
@@ -1115,12 +1306,7 @@ Target* Target::implicit_dependency( int n ) const
 */
 Target* Target::ordering_dependency( int n ) const
 {
-    SWEET_ASSERT( n >= 0 );
-    if ( n >= 0 && n < int(ordering_dependencies_.size()) )
-    {
-        return ordering_dependencies_[n];
-    }
-    return nullptr;
+    return dependency( DEPENDENCY_ORDERING, n );
 }
 
 /**
@@ -1135,12 +1321,7 @@ Target* Target::ordering_dependency( int n ) const
 */
 Target* Target::passive_dependency( int n ) const
 {
-    SWEET_ASSERT( n >= 0 );
-    if ( n >= 0 && n < int(passive_dependencies_.size()) )
-    {
-        return passive_dependencies_[n];
-    }
-    return nullptr;
+    return dependency( DEPENDENCY_PASSIVE, n );
 }
 
 /**
@@ -1168,24 +1349,10 @@ Target* Target::passive_dependency( int n ) const
 Target* Target::binding_dependency( int n ) const
 {
     SWEET_ASSERT( n >= 0 );
-
-    if ( n >= 0 && n < int(dependencies_.size()) )
+    if ( n >= 0 && n < dependencies_end(DEPENDENCY_ORDERING) )
     {
         return dependencies_[n];
     }
-
-    n -= int(dependencies_.size());
-    if ( n >= 0 && n < int(implicit_dependencies_.size()) )
-    {
-        return implicit_dependencies_[n];
-    }
-
-    n -= int(implicit_dependencies_.size());
-    if ( n >= 0 && n < int(ordering_dependencies_.size()) )
-    {
-        return ordering_dependencies_[n];
-    }
-
     return nullptr;
 }
 
@@ -1206,30 +1373,10 @@ Target* Target::binding_dependency( int n ) const
 Target* Target::any_dependency( int n ) const
 {
     SWEET_ASSERT( n >= 0 );
-
     if ( n >= 0 && n < int(dependencies_.size()) )
     {
         return dependencies_[n];
     }
-
-    n -= int(dependencies_.size());
-    if ( n >= 0 && n < int(implicit_dependencies_.size()) )
-    {
-        return implicit_dependencies_[n];
-    }
-
-    n -= int(implicit_dependencies_.size());
-    if ( n >= 0 && n < int(ordering_dependencies_.size()) )
-    {
-        return ordering_dependencies_[n];
-    }
-
-    n -= int(ordering_dependencies_.size());
-    if ( n >= 0 && n < int(passive_dependencies_.size()) )
-    {
-        return passive_dependencies_[n];
-    }
-
     return nullptr;
 }
 
@@ -1481,6 +1628,55 @@ int Target::next_anonymous_index()
     return anonymous_++;
 }
 
+/**
+// Estimate the memory used by this Target and its descendants in the Target
+// namespace.
+//
+// @param targets
+//  A count to increment by the number of Targets visited (assumed not null).
+//
+// @return
+//  The number of bytes used by this Target and its descendants including
+//  heap allocations made for their strings and arrays but not for their
+//  identifiers which are interned in the Graph (see Graph::ids_memory_usage()).
+*/
+size_t Target::memory_usage( size_t* targets ) const
+{
+    SWEET_ASSERT( targets );
+
+    const size_t SMALL_STRING_CAPACITY = string().capacity();
+    auto string_usage = [SMALL_STRING_CAPACITY]( const string& value ) -> size_t
+    {
+        return value.capacity() > SMALL_STRING_CAPACITY ? value.capacity() + 1 : 0;
+    };
+
+    size_t bytes = sizeof(Target);
+    bytes += string_usage( path_ );
+    bytes += dependencies_.capacity() * sizeof(Target*);
+    bytes += prepared_dependencies_.capacity() * sizeof(Target*);
+    if ( dependency_index_ )
+    {
+        bytes += sizeof(*dependency_index_);
+        bytes += dependency_index_->bucket_count() * sizeof(void*);
+        bytes += dependency_index_->size() * (sizeof(std::pair<Target*, DependencyKind>) + 2 * sizeof(void*));
+    }
+    bytes += targets_.capacity() * sizeof(Target*);
+    bytes += filenames_.capacity() * sizeof(string);
+    for ( vector<string>::const_iterator filename = filenames_.begin(); filename != filenames_.end(); ++filename )
+    {
+        bytes += string_usage( *filename );
+    }
+    ++*targets;
+
+    for ( vector<Target*>::const_iterator i = targets_.begin(); i != targets_.end(); ++i )
+    {
+        const Target* target = *i;
+        SWEET_ASSERT( target );
+        bytes += target->memory_usage( targets );
+    }
+    return bytes;
+}
+
 /**
 // Write this Target to \e writer.
 //
@@ -1490,13 +1686,36 @@ int Target::next_anonymous_index()
 void Target::write( GraphWriter& writer )
 {
     writer.object_address( this );
-    writer.value( id_ );
+    writer.value( id() );
     writer.value( last_write_time_ );
     writer.value( hash_ );
-    writer.value( built_ );
+
+    // Outdated Targets that haven't been visited successfully by the 
+    // traversal in progress are checkpointed as not built so that they're 
+    // built again if the build is interrupted before it finishes.
+    writer.value( built_ && (!writer.checkpoint() || !outdated_ || successful()) );
     writer.value( filenames_ );
     writer.value( targets_ );
-    writer.refer( implicit_dependencies_ );
+
+    // The declarations made by buildfiles are only saved when the Graph is
+    // going to be reused without loading the buildfiles again.
+    if ( writer.reuse() )
+    {
+        writer.value( cleanable_ );
+        writer.value( shared_ );
+        writer.refer( buildfile_ );
+        writer.refer( dependencies_.data() + dependencies_begin(DEPENDENCY_EXPLICIT), dependencies_.data() + dependencies_end(DEPENDENCY_EXPLICIT) );
+    }
+    writer.refer( dependencies_.data() + dependencies_begin(DEPENDENCY_IMPLICIT), dependencies_.data() + dependencies_end(DEPENDENCY_IMPLICIT) );
+    if ( writer.reuse() )
+    {
+        writer.refer( dependencies_.data() + dependencies_begin(DEPENDENCY_ORDERING), dependencies_.data() + dependencies_end(DEPENDENCY_ORDERING) );
+        writer.refer( dependencies_.data() + dependencies_begin(DEPENDENCY_PASSIVE), dependencies_.data() + dependencies_end(DEPENDENCY_PASSIVE) );
+    }
+    writer.value( prepared_hash_ );
+    writer.value( prepared_pruned_ );
+    writer.refer( prepared_dependencies_.data(), prepared_dependencies_.data() + prepared_dependencies_.size() );
+    writer.value( built_inputs_ );
 }
 
 /**
@@ -1508,32 +1727,79 @@ void Target::write( GraphWriter& writer )
 void Target::read( GraphReader& reader )
 {
     reader.object_address( this );
-    reader.value( &id_ );
+    string id;
+    reader.value( &id );
+    id_ = reader.intern( id );
     reader.value( &last_write_time_ );
     reader.value( &hash_ );
     reader.value( &built_ );
     reader.value( &filenames_ );
     reader.value( &targets_ );
-    reader.refer( &implicit_dependencies_ );
+    dependencies_.clear();
+    dependency_index_.reset();
+    if ( reader.reuse() )
+    {
+        reader.value( &cleanable_ );
+        reader.value( &shared_ );
+        reader.refer( &buildfile_ );
+        reader.refer( &dependencies_ );
+    }
+    dependency_begins_[DEPENDENCY_EXPLICIT] = 0;
+    dependency_begins_[DEPENDENCY_IMPLICIT] = int(dependencies_.size());
+    reader.refer( &dependencies_ );
+    dependency_begins_[DEPENDENCY_ORDERING] = int(dependencies_.size());
+    if ( reader.reuse() )
+    {
+        reader.refer( &dependencies_ );
+    }
+    dependency_begins_[DEPENDENCY_PASSIVE] = int(dependencies_.size());
+    if ( reader.reuse() )
+    {
+        reader.refer( &dependencies_ );
+    }
+    reader.value( &prepared_hash_ );
+    reader.value( &prepared_pruned_ );
+    prepared_dependencies_.clear();
+    reader.refer( &prepared_dependencies_ );
+    reader.value( &built_inputs_ );
 }
 
 /**
-// Resolve this Target's implicit dependencies to their new addresses.
+// Resolve this Target's buildfile and dependencies to their new addresses.
 //
-// Recursively updates the addresses of this Target and its ancestors implicit
-// dependencies from their old addresses when the Graph was written out to 
-// their new addresses now that the Graph has been read back in.
+// Recursively updates the addresses of this Target and its ancestors 
+// buildfile and dependencies from their old addresses
+// when the Graph was written out to their new addresses now that the Graph
+// has been read back in.
 //
 // @param reader
 //  The GraphReader just read in the Graph.
 */
 void Target::resolve( const GraphReader& reader )
 {
-    for ( vector<Target*>::iterator i = implicit_dependencies_.begin(); i != implicit_dependencies_.end(); ++i )
+    buildfile_ = reinterpret_cast<Target*>( reader.find_address_by_old_address(buildfile_) );
+
+    for ( int i = int(dependencies_.size()) - 1; i >= 0; --i )
+    {
+        dependencies_[i] = reinterpret_cast<Target*>( reader.find_address_by_old_address(dependencies_[i]) );
+        if ( !dependencies_[i] )
+        {
+            erase_dependency( i );
+        }
+    }
+    index_dependencies();
+
+    // Forget how this Target was prepared if any of the dependencies that
+    // preparing it added weren't read back in.
+    for ( vector<Target*>::iterator i = prepared_dependencies_.begin(); i != prepared_dependencies_.end(); ++i )
     {
         *i = reinterpret_cast<Target*>( reader.find_address_by_old_address(*i) );
+        if ( !*i )
+        {
+            clear_prepared();
+            break;
+        }
     }
-    implicit_dependencies_.erase( remove(implicit_dependencies_.begin(), implicit_dependencies_.end(), nullptr), implicit_dependencies_.end() );
 
     for ( vector<Target*>::const_iterator i = targets_.begin(); i != targets_.end(); ++i )
     {
@@ -1542,3 +1808,222 @@ void Target::resolve( const GraphReader& reader )
         target->resolve( reader );
     }
 }
+
+/**
+// Merge the state of \e target, read from another Graph's cache file, into
+// this Target.
+//
+// The built flag, last write time, hash, and implicit dependencies of 
+// \e target replace those of this Target when \e target has been built and
+// this Target hasn't or \e target was built from a later file.  Filenames 
+// are taken from \e target when this Target doesn't have any.
+//
+// @param target
+//  The Target to merge into this Target.
+//
+// @param targets
+//  The Targets in this Target's Graph that correspond to each Target in the
+//  Graph that \e target was read from.
+//
+// @return
+//  True if the built state of \e target was merged into this Target 
+//  otherwise false.
+*/
+bool Target::merge( const Target* target, const std::unordered_map<Target*, Target*>& targets )
+{
+    SWEET_ASSERT( target );
+
+    if ( filenames_.empty() )
+    {
+        filenames_ = target->filenames_;
+    }
+
+    bool newer = target->built_ && (!built_ || target->last_write_time_ > last_write_time_);
+    if ( newer )
+    {
+        built_ = true;
+        last_write_time_ = target->last_write_time_;
+        hash_ = target->hash_;
+        built_inputs_ = target->built_inputs_;
+        clear_implicit_dependencies();
+        for ( int i = target->dependencies_begin(DEPENDENCY_IMPLICIT); i < target->dependencies_end(DEPENDENCY_IMPLICIT); ++i )
+        {
+            std::unordered_map<Target*, Target*>::const_iterator dependency = targets.find( target->dependencies_[i] );
+            if ( dependency != targets.end() )
+            {
+                add_implicit_dependency( dependency->second );
+            }
+        }
+        bound_to_file_ = false;
+        bound_to_dependencies_ = false;
+    }
+    return newer;
+}
+
+/**
+// Get the index of the first dependency of \e kind in this Target's
+// dependencies.
+*/
+int Target::dependencies_begin( DependencyKind kind ) const
+{
+    SWEET_ASSERT( kind >= DEPENDENCY_EXPLICIT && kind < DEPENDENCY_KIND_COUNT );
+    return dependency_begins_[kind];
+}
+
+/**
+// Get the index one past the last dependency of \e kind in this Target's
+// dependencies.
+*/
+int Target::dependencies_end( DependencyKind kind ) const
+{
+    SWEET_ASSERT( kind >= DEPENDENCY_EXPLICIT && kind < DEPENDENCY_KIND_COUNT );
+    return kind + 1 < DEPENDENCY_KIND_COUNT ? dependency_begins_[kind + 1] : int(dependencies_.size());
+}
+
+/**
+// Find \e target in the dependencies of \e kind.
+//
+// @return
+//  The index of \e target in this Target's dependencies or -1 if \e target
+//  isn't a dependency of \e kind.
+*/
+int Target::find_dependency( DependencyKind kind, Target* target ) const
+{
+    vector<Target*>::const_iterator begin = dependencies_.begin() + dependencies_begin( kind );
+    vector<Target*>::const_iterator end = dependencies_.begin() + dependencies_end( kind );
+    vector<Target*>::const_iterator i = find( begin, end, target );
+    return i != end ? int(i - dependencies_.begin()) : -1;
+}
+
+/**
+// Is \e target a dependency of \e kind?
+//
+// Checks the dependency index when there is one otherwise searches the
+// dependencies of \e kind.
+*/
+bool Target::has_dependency( DependencyKind kind, Target* target ) const
+{
+    if ( dependency_index_ )
+    {
+        std::unordered_map<Target*, DependencyKind>::const_iterator i = dependency_index_->find( target );
+        return i != dependency_index_->end() && i->second == kind;
+    }
+    return find_dependency( kind, target ) >= 0;
+}
+
+/**
+// Index this Target's dependencies if there are more of them than the
+// threshold for indexing otherwise discard any existing index.
+*/
+void Target::index_dependencies()
+{
+    dependency_index_.reset();
+    if ( dependencies_.size() > DEPENDENCY_INDEX_THRESHOLD )
+    {
+        dependency_index_.reset( new std::unordered_map<Target*, DependencyKind> );
+        dependency_index_->reserve( dependencies_.size() );
+        for ( int kind = DEPENDENCY_EXPLICIT; kind < DEPENDENCY_KIND_COUNT; ++kind )
+        {
+            int end = dependencies_end( DependencyKind(kind) );
+            for ( int i = dependencies_begin(DependencyKind(kind)); i < end; ++i )
+            {
+                dependency_index_->insert( std::make_pair(dependencies_[i], DependencyKind(kind)) );
+            }
+        }
+    }
+}
+
+/**
+// Get the \e nth dependency of \e kind or null if \e n is out of range.
+*/
+Target* Target::dependency( DependencyKind kind, int n ) const
+{
+    SWEET_ASSERT( n >= 0 );
+    int index = dependencies_begin( kind ) + n;
+    if ( n >= 0 && index < dependencies_end(kind) )
+    {
+        return dependencies_[index];
+    }
+    return nullptr;
+}
+
+/**
+// Append \e target to the dependencies of \e kind.
+//
+// Dependencies of later kinds are shifted along by one to make room and
+// their first indices are updated to match.
+*/
+void Target::insert_dependency( DependencyKind kind, Target* target )
+{
+    SWEET_ASSERT( target );
+    dependencies_.insert( dependencies_.begin() + dependencies_end(kind), target );
+    for ( int later_kind = kind + 1; later_kind < DEPENDENCY_KIND_COUNT; ++later_kind )
+    {
+        ++dependency_begins_[later_kind];
+    }
+    if ( dependency_index_ )
+    {
+        dependency_index_->insert( std::make_pair(target, kind) );
+    }
+    else if ( dependencies_.size() > DEPENDENCY_INDEX_THRESHOLD )
+    {
+        index_dependencies();
+    }
+    if ( graph_ )
+    {
+        graph_->dependencies_changed( this );
+    }
+}
+
+/**
+// Erase the dependency at \e index from this Target's dependencies.
+*/
+void Target::erase_dependency( int index )
+{
+    SWEET_ASSERT( index >= 0 && index < int(dependencies_.size()) );
+    if ( dependency_index_ )
+    {
+        dependency_index_->erase( dependencies_[index] );
+    }
+    dependencies_.erase( dependencies_.begin() + index );
+    for ( int kind = DEPENDENCY_IMPLICIT; kind < DEPENDENCY_KIND_COUNT; ++kind )
+    {
+        if ( dependency_begins_[kind] > index )
+        {
+            --dependency_begins_[kind];
+        }
+    }
+    if ( graph_ )
+    {
+        graph_->dependencies_changed( this );
+    }
+}
+
+/**
+// Erase all of the dependencies of \e kind from this Target's dependencies.
+*/
+void Target::clear_dependencies( DependencyKind kind )
+{
+    int begin = dependencies_begin( kind );
+    int end = dependencies_end( kind );
+    if ( dependency_index_ )
+    {
+        for ( int i = begin; i < end; ++i )
+        {
+            dependency_index_->erase( dependencies_[i] );
+        }
+    }
+    dependencies_.erase( dependencies_.begin() + begin, dependencies_.begin() + end );
+    for ( int later_kind = kind + 1; later_kind < DEPENDENCY_KIND_COUNT; ++later_kind )
+    {
+        dependency_begins_[later_kind] -= end - begin;
+    }
+    if ( dependencies_.empty() )
+    {
+        dependency_index_.reset();
+    }
+    if ( graph_ )
+    {
+        graph_->dependencies_changed( this );
+    }
+}
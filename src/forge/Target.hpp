@@ -2,7 +2,9 @@
 #define FORGE_TARGET_HPP_INCLUDED
 
 #include <filesystem>
+#include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include <stdint.h>
 
@@ -23,34 +25,51 @@ class Forge;
 */
 class Target
 {
-    std::string id_; ///< The identifier of this Target.
-    mutable std::string path_; ///< The full path to this Target in the Target namespace.
-    mutable std::string branch_; ///< The branch path to this Target in the Target namespace.
-    Graph* graph_; ///< The Graph that this Target is part of.
-    Rule* rule_; ///< The rule for this Target or null if this Target has no rule.
-    std::filesystem::file_time_type timestamp_; ///< The timestamp for this Target.
-    std::filesystem::file_time_type last_write_time_; ///< The last write time of the file that this Target is bound to.
-    uint64_t hash_; ///< The hash for this Target the last time that it was built.
-    uint64_t pending_hash_; ///< The hash for this Target when it was created in the current run.
+    /**
+    // The kinds of dependency stored, in this order, in a Target's single
+    // array of dependencies.
+    */
+    enum DependencyKind
+    {
+        DEPENDENCY_EXPLICIT, ///< Explicit dependencies.
+        DEPENDENCY_IMPLICIT, ///< Implicit dependencies.
+        DEPENDENCY_ORDERING, ///< Targets that must build before this Target is built.
+        DEPENDENCY_PASSIVE, ///< Passive dependencies.
+        DEPENDENCY_KIND_COUNT
+    };
+
     bool outdated_; ///< Whether or not this Target is out of date.
     bool bound_to_file_; ///< Whether or not this Target is bound to a file.
     bool bound_to_dependencies_; ///< Whether or not this Target is bound to its dependencies.
+    bool visiting_; ///< Whether or not this Target is in the process of being visited.
     bool referenced_by_script_; ///< Whether or not this Target is referenced by a scripting object.  
     bool cleanable_; ///< Whether or not this Target is able to be cleaned.
     bool built_; ///< Whether or not this Target has had `Target::clear_implicit_dependencies()` called on it.
-    Target* working_directory_; ///< The Target that relative paths expressed when this Target is visited are relative to.
-    Target* parent_; ///< The parent of this Target in the Target namespace or null if this Target has no parent.
-    std::vector<Target*> targets_; ///< The children of this Target in the Target namespace.
-    std::vector<Target*> dependencies_; ///< Explicit dependencies.
-    std::vector<Target*> implicit_dependencies_; ///< Implicit dependencies.
-    std::vector<Target*> ordering_dependencies_; ///< Targets that must build before this Target is built.
-    std::vector<Target*> passive_dependencies_; ///< Passive dependencies of this Target.
-    std::vector<std::string> filenames_; ///< The filenames of this Target.
-    bool visiting_; ///< Whether or not this Target is in the process of being visited.
+    bool shared_; ///< Whether or not this Target has been declared or modified by more than one buildfile.
     int visited_revision_; ///< The visited revision the last time this Target was visited.
     int successful_revision_; ///< The successful revision the last time this Target was successfully visited.
     int postorder_height_; ///< The height of this Target in the current or most recent dependency graph traversal.
     int anonymous_; ///< The anonymous index for this Target that will generate the next anonymous identifier requested from this Target.
+    std::filesystem::file_time_type timestamp_; ///< The timestamp for this Target.
+    std::filesystem::file_time_type last_write_time_; ///< The last write time of the file that this Target is bound to.
+    uint64_t hash_; ///< The hash for this Target the last time that it was built.
+    uint64_t pending_hash_; ///< The hash for this Target when it was created in the current run.
+    uint64_t prepared_hash_; ///< The structural hash of this Target when it was last prepared or 0 if it hasn't been prepared.
+    bool prepared_pruned_; ///< Whether or not the traversal was pruned at this Target when it was last prepared.
+    std::vector<Target*> prepared_dependencies_; ///< The explicit dependencies of this Target after it was last prepared.
+    std::string built_inputs_; ///< The description of the inputs that this Target was last built from set by its build function.
+    std::vector<Target*> dependencies_; ///< The explicit, implicit, ordering, and passive dependencies of this Target in that order.
+    int dependency_begins_ [DEPENDENCY_KIND_COUNT]; ///< The index of the first dependency of each kind in dependencies_.
+    std::unique_ptr<std::unordered_map<Target*, DependencyKind>> dependency_index_; ///< The kind of each dependency once there are too many dependencies to search linearly or null.
+    Graph* graph_; ///< The Graph that this Target is part of.
+    Rule* rule_; ///< The rule for this Target or null if this Target has no rule.
+    Target* working_directory_; ///< The Target that relative paths expressed when this Target is visited are relative to.
+    Target* parent_; ///< The parent of this Target in the Target namespace or null if this Target has no parent.
+    Target* buildfile_; ///< The buildfile that first declared or modified this Target or null if no buildfile has.
+    const std::string* id_; ///< The identifier of this Target interned in its Graph (see Graph::intern()).
+    mutable std::string path_; ///< The full path to this Target in the Target namespace.
+    std::vector<Target*> targets_; ///< The children of this Target in the Target namespace.
+    std::vector<std::string> filenames_; ///< The filenames of this Target.
 
     public:
         Target();
@@ -60,15 +79,17 @@ class Target
 
         const std::string& id() const;
         const std::string& path() const;
-        const std::string& branch() const;
+        std::string branch() const;
         Graph* graph() const;
         bool anonymous() const;
         uint64_t hash() const;
+        uint64_t pending_hash() const;
 
         void set_rule( Rule* rule );
         Rule* rule() const;
 
         void bind();
+        void unbind();
         void bind_to_file();
         void bind_to_dependencies();
         void bind_to_hash();
@@ -83,6 +104,9 @@ class Target
         void set_built( bool built );
         bool built() const;
 
+        void set_built_inputs( const std::string& built_inputs );
+        const std::string& built_inputs() const;
+
         void set_timestamp( std::filesystem::file_time_type timestamp );
         std::filesystem::file_time_type timestamp() const;
         std::filesystem::file_time_type last_write_time() const;
@@ -101,6 +125,11 @@ class Target
         void set_working_directory( Target* target );
         Target* working_directory() const;
 
+        void add_buildfile( Target* buildfile );
+        void clear_buildfile();
+        Target* buildfile() const;
+        bool shared() const;
+
         void set_parent( Target* target );
         Target* parent() const;
 
@@ -109,6 +138,11 @@ class Target
         Target* find_target_by_id( const std::string& id ) const;
         const std::vector<Target*>& targets() const;
 
+        void set_prepared( uint64_t structural_hash, bool pruned );
+        bool restore_prepared( uint64_t structural_hash );
+        void clear_prepared();
+        bool prepared_pruned() const;
+
         void add_explicit_dependency( Target* target );
         void clear_explicit_dependencies();
         void add_implicit_dependency( Target* target );
@@ -148,11 +182,24 @@ class Target
         int postorder_height() const;
         
         int next_anonymous_index();
+        size_t memory_usage( size_t* targets ) const;
 
         void write( GraphWriter& writer );
         void read( GraphReader& reader );
         void resolve( const GraphReader& reader );
+        bool merge( const Target* target, const std::unordered_map<Target*, Target*>& targets );
         template <class Archive> void persist( Archive& archive );
+
+    private:
+        int dependencies_begin( DependencyKind kind ) const;
+        int dependencies_end( DependencyKind kind ) const;
+        int find_dependency( DependencyKind kind, Target* target ) const;
+        bool has_dependency( DependencyKind kind, Target* target ) const;
+        void index_dependencies();
+        Target* dependency( DependencyKind kind, int n ) const;
+        void insert_dependency( DependencyKind kind, Target* target );
+        void erase_dependency( int index );
+        void clear_dependencies( DependencyKind kind );
 };
 
 }
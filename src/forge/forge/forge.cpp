@@ -45,6 +45,8 @@ int main( int argc, char** argv )
         string root_directory;
         string build_script = "forge.lua";
         bool stack_trace_enabled = false;
+        bool statistics = false;
+        bool fail_fast = false;
         vector<string> assignments_and_commands;
 
         ForgeErrorPolicy error_policy;
@@ -55,6 +57,8 @@ int main( int argc, char** argv )
             ( "root", "r", "Set root directory", &root_directory )
             ( "build-script", "b", "Set build script filename", &build_script )
             ( "stack-trace", "s", "Stack traces on error", &stack_trace_enabled )
+            ( "stats", "", "Print statistics after each command", &statistics )
+            ( "fail-fast", "", "Stop building on the first failure", &fail_fast )
             ( &assignments_and_commands )
         ;
         command_line_parser.parse( argc, argv );
@@ -83,6 +87,7 @@ int main( int argc, char** argv )
         {
             Forge forge( directory, error_policy );
             forge.set_stack_trace_enabled( stack_trace_enabled );
+            forge.set_keep_going( fail_fast ? 1 : 0 );
             forge.set_root_directory( root_directory );
             bool executed_command = false;
             vector<string> assignments;
@@ -96,6 +101,10 @@ int main( int argc, char** argv )
                     const string& command = *i;
                     forge.command( assignments, build_script, command );
                     executed_command = true;
+                    if ( statistics )
+                    {
+                        forge.print_statistics();
+                    }
                 }
                 else
                 {
@@ -109,6 +118,10 @@ int main( int argc, char** argv )
             {
                 const string DEFAULT_COMMAND = "default";
                 forge.command( assignments, build_script, DEFAULT_COMMAND );
+                if ( statistics )
+                {
+                    forge.print_statistics();
+                }
             }
         }
 
@@ -0,0 +1,270 @@
+//
+// SyntheticGraph.cpp
+// Copyright (c) Charles Baker. All rights reserved.
+//
+
+#include "SyntheticGraph.hpp"
+#include <assert/assert.hpp>
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+
+using std::string;
+using std::vector;
+using std::pair;
+using namespace sweet;
+using namespace sweet::forge;
+
+static const char* SHAPE_NAMES [] =
+{
+    "wide",
+    "deep",
+    "diamond",
+    "libraries"
+};
+
+/**
+// Constructor.
+//
+// @param shape
+//  The shape of graph to generate.
+//
+// @param targets
+//  The approximate number of targets to generate; the exact number depends
+//  on how evenly \e targets divides into the structure of \e shape.
+*/
+SyntheticGraph::SyntheticGraph( SyntheticGraphShape shape, int targets )
+: shape_( shape )
+, ids_()
+, dependencies_()
+{
+    SWEET_ASSERT( shape_ >= SHAPE_WIDE && shape_ < SHAPE_NULL );
+    SWEET_ASSERT( targets > 0 );
+
+    ids_.reserve( targets + 1 );
+    add_target( "all" );
+    switch ( shape_ )
+    {
+        case SHAPE_WIDE:
+            generate_wide( targets );
+            break;
+
+        case SHAPE_DEEP:
+            generate_deep( targets );
+            break;
+
+        case SHAPE_DIAMOND:
+            generate_diamond( targets );
+            break;
+
+        case SHAPE_LIBRARIES:
+            generate_libraries( targets );
+            break;
+
+        default:
+            SWEET_ASSERT( false );
+            break;
+    }
+}
+
+SyntheticGraphShape SyntheticGraph::shape() const
+{
+    return shape_;
+}
+
+const char* SyntheticGraph::shape_name() const
+{
+    return SyntheticGraph::shape_name( shape_ );
+}
+
+/**
+// Get the identifiers of the targets in this graph.
+//
+// The first identifier is always the top target ("all") that depends,
+// directly or indirectly, on every other target in the graph.
+//
+// @return
+//  The target identifiers.
+*/
+const std::vector<std::string>& SyntheticGraph::ids() const
+{
+    return ids_;
+}
+
+/**
+// Get the explicit dependencies in this graph.
+//
+// @return
+//  The explicit dependencies as (target, dependency) pairs of indices into
+//  the identifiers returned by SyntheticGraph::ids().
+*/
+const std::vector<std::pair<int, int>>& SyntheticGraph::dependencies() const
+{
+    return dependencies_;
+}
+
+/**
+// Get the shape named \e name.
+//
+// @param name
+//  The name of the shape (one of "wide", "deep", "diamond", or "libraries").
+//
+// @return
+//  The shape or SHAPE_NULL if \e name doesn't name a shape.
+*/
+SyntheticGraphShape SyntheticGraph::shape_from_name( const std::string& name )
+{
+    for ( int shape = SHAPE_WIDE; shape < SHAPE_NULL; ++shape )
+    {
+        if ( name == SHAPE_NAMES[shape] )
+        {
+            return SyntheticGraphShape(shape);
+        }
+    }
+    return SHAPE_NULL;
+}
+
+const char* SyntheticGraph::shape_name( SyntheticGraphShape shape )
+{
+    SWEET_ASSERT( shape >= SHAPE_WIDE && shape < SHAPE_NULL );
+    return SHAPE_NAMES[shape];
+}
+
+int SyntheticGraph::add_target( const std::string& id )
+{
+    ids_.push_back( id );
+    return int(ids_.size()) - 1;
+}
+
+void SyntheticGraph::add_dependency( int target, int dependency )
+{
+    SWEET_ASSERT( target >= 0 && target < int(ids_.size()) );
+    SWEET_ASSERT( dependency >= 0 && dependency < int(ids_.size()) );
+    dependencies_.push_back( pair<int, int>(target, dependency) );
+}
+
+/**
+// Generate a single top target that depends directly on \e targets source
+// files spread across directories of 256 files each.
+*/
+void SyntheticGraph::generate_wide( int targets )
+{
+    char id [256];
+    for ( int i = 0; i < targets; ++i )
+    {
+        snprintf( id, sizeof(id), "wide/d%04d/f%07d.cpp", i / 256, i );
+        int target = add_target( id );
+        add_dependency( 0, target );
+    }
+}
+
+/**
+// Generate a chain of \e targets targets that each depend on the next
+// target in the chain.
+*/
+void SyntheticGraph::generate_deep( int targets )
+{
+    char id [256];
+    int previous = 0;
+    for ( int i = 0; i < targets; ++i )
+    {
+        snprintf( id, sizeof(id), "deep/d%04d/t%07d", i / 256, i );
+        int target = add_target( id );
+        add_dependency( previous, target );
+        previous = target;
+    }
+}
+
+/**
+// Generate roughly square layers of targets where each target depends on
+// the target directly below it and the target below and to the right of it
+// in the next layer so that most targets are reachable along many paths.
+*/
+void SyntheticGraph::generate_diamond( int targets )
+{
+    const int width = std::max( 1, int(sqrt(double(targets))) );
+    const int layers = std::max( 1, targets / width );
+
+    char id [256];
+    for ( int layer = 0; layer < layers; ++layer )
+    {
+        for ( int i = 0; i < width; ++i )
+        {
+            snprintf( id, sizeof(id), "diamond/l%05d/n%05d", layer, i );
+            add_target( id );
+        }
+    }
+
+    const int FIRST = 1;
+    for ( int i = 0; i < width; ++i )
+    {
+        add_dependency( 0, FIRST + i );
+    }
+
+    for ( int layer = 0; layer < layers - 1; ++layer )
+    {
+        int above = FIRST + layer * width;
+        int below = FIRST + (layer + 1) * width;
+        for ( int i = 0; i < width; ++i )
+        {
+            add_dependency( above + i, below + i );
+            if ( width > 1 )
+            {
+                add_dependency( above + i, below + (i + 1) % width );
+            }
+        }
+    }
+}
+
+/**
+// Generate many small static libraries of eight objects each that depend
+// on their source file, the two headers of their library, and a header
+// shared by all libraries, grouped sixteen libraries to an executable.
+*/
+void SyntheticGraph::generate_libraries( int targets )
+{
+    const int SOURCES_PER_LIBRARY = 8;
+    const int HEADERS_PER_LIBRARY = 2;
+    const int LIBRARIES_PER_EXECUTABLE = 16;
+    const int TARGETS_PER_LIBRARY = 2 * SOURCES_PER_LIBRARY + HEADERS_PER_LIBRARY + 1;
+    const int libraries = std::max( 1, targets / TARGETS_PER_LIBRARY );
+
+    char id [256];
+    int common_header = add_target( "src/include/common.hpp" );
+    int executable = -1;
+    for ( int library = 0; library < libraries; ++library )
+    {
+        if ( library % LIBRARIES_PER_EXECUTABLE == 0 )
+        {
+            snprintf( id, sizeof(id), "bin/executable%05d", library / LIBRARIES_PER_EXECUTABLE );
+            executable = add_target( id );
+            add_dependency( 0, executable );
+        }
+
+        snprintf( id, sizeof(id), "lib/library%05d.a", library );
+        int static_library = add_target( id );
+        add_dependency( executable, static_library );
+
+        int headers [HEADERS_PER_LIBRARY];
+        for ( int header = 0; header < HEADERS_PER_LIBRARY; ++header )
+        {
+            snprintf( id, sizeof(id), "src/library%05d/header%d.hpp", library, header );
+            headers[header] = add_target( id );
+        }
+
+        for ( int source = 0; source < SOURCES_PER_LIBRARY; ++source )
+        {
+            snprintf( id, sizeof(id), "src/library%05d/source%d.cpp", library, source );
+            int source_file = add_target( id );
+            snprintf( id, sizeof(id), "obj/library%05d/source%d.o", library, source );
+            int object = add_target( id );
+            add_dependency( static_library, object );
+            add_dependency( object, source_file );
+            add_dependency( object, common_header );
+            for ( int header = 0; header < HEADERS_PER_LIBRARY; ++header )
+            {
+                add_dependency( object, headers[header] );
+            }
+        }
+    }
+}
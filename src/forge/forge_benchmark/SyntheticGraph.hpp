@@ -0,0 +1,63 @@
+#ifndef FORGE_SYNTHETICGRAPH_HPP_INCLUDED
+#define FORGE_SYNTHETICGRAPH_HPP_INCLUDED
+
+#include <string>
+#include <vector>
+#include <utility>
+
+namespace sweet
+{
+
+namespace forge
+{
+
+/**
+// The shapes of dependency graph that SyntheticGraph is able to generate.
+*/
+enum SyntheticGraphShape
+{
+    SHAPE_WIDE, ///< A single target depending directly on every other target.
+    SHAPE_DEEP, ///< A single chain of targets each depending on the next.
+    SHAPE_DIAMOND, ///< Layers of targets each depending on two targets in the layer below.
+    SHAPE_LIBRARIES, ///< Many small static libraries of objects linked into executables.
+    SHAPE_NULL
+};
+
+/**
+// A synthetic dependency graph described as target identifiers and explicit
+// dependency edges between them.
+//
+// The graph is described independently of any Graph so that the same shape
+// can be added to many Graphs and the time taken to create its Targets can
+// be measured separately from the time taken to generate identifiers.
+*/
+class SyntheticGraph
+{
+    SyntheticGraphShape shape_; ///< The shape of this graph.
+    std::vector<std::string> ids_; ///< The identifiers of the targets in this graph, the first is the top target.
+    std::vector<std::pair<int, int>> dependencies_; ///< The (target, dependency) index pairs of the explicit dependencies in this graph.
+
+    public:
+        SyntheticGraph( SyntheticGraphShape shape, int targets );
+        SyntheticGraphShape shape() const;
+        const char* shape_name() const;
+        const std::vector<std::string>& ids() const;
+        const std::vector<std::pair<int, int>>& dependencies() const;
+
+        static SyntheticGraphShape shape_from_name( const std::string& name );
+        static const char* shape_name( SyntheticGraphShape shape );
+
+    private:
+        int add_target( const std::string& id );
+        void add_dependency( int target, int dependency );
+        void generate_wide( int targets );
+        void generate_deep( int targets );
+        void generate_diamond( int targets );
+        void generate_libraries( int targets );
+};
+
+}
+
+}
+
+#endif
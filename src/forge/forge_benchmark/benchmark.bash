@@ -0,0 +1,56 @@
+#!/bin/bash
+#
+# End-to-end build benchmark.
+#
+# Generates the synthetic project in `project/forge.lua` into an output
+# directory and times clean, no-op, and one file touched builds using the
+# forge and forge_fake_compiler executables from a build directory.  Results
+# are printed as tab separated values with a fixed header; the peak number of
+# bytes allocated by Lua is taken from the statistics that `--stats` prints.
+#
+# Usage: benchmark.bash [bin directory] [output directory] [sources] [variable=value]...
+#
+# Any trailing variable assignments (e.g. sleep_ms=5 or burn_ms=2) are
+# passed through to the project, see `project/forge.lua` for details.
+
+set -e
+
+SCRIPT_DIRECTORY=$(cd "$(dirname "$0")" && pwd)
+BIN=$(cd "${1:-$SCRIPT_DIRECTORY/../../../debug/bin}" && pwd)
+OUTPUT=${2:-${TMPDIR:-/tmp}/forge_benchmark_project}
+SOURCES=${3:-10000}
+shift 3 2>/dev/null || shift $#
+
+FORGE="$BIN/forge"
+VARIABLES=(
+    "fake_compiler=$BIN/forge_fake_compiler"
+    "lua_directory=$SCRIPT_DIRECTORY/../lua"
+    "sources=$SOURCES"
+    "$@"
+)
+
+milliseconds() {
+    echo $(( $(date +%s%N) / 1000000 ))
+}
+
+measure() {
+    local name=$1
+    shift
+    local start=$(milliseconds)
+    "$FORGE" --stats -r "$OUTPUT" "${VARIABLES[@]}" "$@" > "$OUTPUT/$name.log" 2>&1
+    local finish=$(milliseconds)
+    local lua_peak_bytes=$(sed -n 's/.*lua memory: [0-9]* bytes in use, \([0-9]*\) bytes peak.*/\1/p' "$OUTPUT/$name.log" | tail -n 1)
+    printf "%s\t%d\t%d\t%d\n" "$name" "$SOURCES" $(( finish - start )) "${lua_peak_bytes:-0}"
+}
+
+rm -rf "$OUTPUT"
+mkdir -p "$OUTPUT"
+cp "$SCRIPT_DIRECTORY/project/forge.lua" "$OUTPUT/forge.lua"
+"$FORGE" -r "$OUTPUT" "${VARIABLES[@]}" generate > "$OUTPUT/generate.log" 2>&1
+
+printf "build\tsources\tmilliseconds\tlua_peak_bytes\n"
+measure clean_build
+measure no_op_build
+touch "$OUTPUT/src/library00000/source00000.cpp"
+measure one_file_touched_build
+measure clean clean
@@ -0,0 +1,308 @@
+//
+// forge_fake_compiler.cpp
+// Copyright (c) Charles Baker. All rights reserved.
+//
+
+// A stand-in for gcc, clang, and ar used by the end-to-end build benchmark.
+//
+// Accepts the command lines generated by the `forge.cc` rules, reads the
+// declared inputs, follows `#include "..."` directives so that the build
+// hooks see the same pattern of reads as from a real compiler, optionally
+// sleeps and/or burns CPU for a configurable time, and then writes the
+// declared outputs.
+//
+// Options that aren't meaningful to the stand-in are ignored.  The following
+// options are recognized:
+//
+//  -rcs <archive> <inputs>...    Archive inputs (as passed to `ar`), keeping
+//                                members of an existing archive that
+//                                aren't replaced.  Also accepted as `-rc`
+//                                and with `--thin` before <archive>.
+//  -c                            Compile a single source file.
+//  -o <output>                   Write output to <output>.
+//  -MF <dependencies>            Write make style dependencies.
+//  -I <directory>                Search <directory> for included files.
+//  -L <directory>                Search <directory> for libraries.
+//  -l<library>                   Read lib<library>.a from a -L directory.
+//  --fake-sleep-ms=<ms>          Sleep for <ms> milliseconds.
+//  --fake-burn-ms=<ms>           Spin the CPU for <ms> milliseconds.
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using std::set;
+using std::string;
+using std::vector;
+using std::filesystem::path;
+
+static bool read_file( const path& filename, string* content )
+{
+    std::ifstream file( filename, std::ios::binary );
+    if ( !file.is_open() )
+    {
+        return false;
+    }
+    std::ostringstream stream;
+    stream << file.rdbuf();
+    if ( content )
+    {
+        *content = stream.str();
+    }
+    return true;
+}
+
+static bool write_file( const path& filename, const string& content )
+{
+    std::ofstream file( filename, std::ios::binary | std::ios::trunc );
+    if ( !file.is_open() )
+    {
+        fprintf( stderr, "forge_fake_compiler: Opening '%s' to write failed.\n", filename.generic_string().c_str() );
+        return false;
+    }
+    file << content;
+    return true;
+}
+
+/**
+// Read \e filename and, recursively, any files that it includes through
+// quoted include directives.
+//
+// Included files are searched for in the directory containing the including
+// file and then each include directory in order.  Each file is only read
+// once and files that can't be found are silently ignored as a real
+// compiler would otherwise report an error.
+*/
+static void read_includes( const path& filename, const vector<path>& include_directories, set<path>* files )
+{
+    if ( !files->insert(filename).second )
+    {
+        return;
+    }
+
+    string content;
+    if ( !read_file(filename, &content) )
+    {
+        return;
+    }
+
+    std::istringstream lines( content );
+    string line;
+    while ( std::getline(lines, line) )
+    {
+        const char* INCLUDE = "#include \"";
+        size_t start = line.find( INCLUDE );
+        if ( start != string::npos )
+        {
+            start += strlen( INCLUDE );
+            size_t finish = line.find( '"', start );
+            if ( finish != string::npos )
+            {
+                path include = line.substr( start, finish - start );
+                path candidate = filename.parent_path() / include;
+                vector<path>::const_iterator directory = include_directories.begin();
+                while ( !std::filesystem::exists(candidate) && directory != include_directories.end() )
+                {
+                    candidate = *directory / include;
+                    ++directory;
+                }
+                if ( std::filesystem::exists(candidate) )
+                {
+                    read_includes( candidate.lexically_normal(), include_directories, files );
+                }
+            }
+        }
+    }
+}
+
+static void burn( int milliseconds )
+{
+    using namespace std::chrono;
+    steady_clock::time_point finish = steady_clock::now() + std::chrono::milliseconds( milliseconds );
+    volatile unsigned int accumulator = 0;
+    while ( steady_clock::now() < finish )
+    {
+        for ( int i = 0; i < 4096; ++i )
+        {
+            accumulator = accumulator * 1664525u + 1013904223u;
+        }
+    }
+}
+
+int main( int argc, char** argv )
+{
+    bool archive = argc > 2 && (strcmp( argv[1], "-rcs" ) == 0 || strcmp( argv[1], "-rc" ) == 0);
+    bool compile = false;
+    int sleep_ms = 0;
+    int burn_ms = 0;
+    path output;
+    path dependencies;
+    vector<path> inputs;
+    vector<path> include_directories;
+    vector<path> library_directories;
+    vector<string> libraries;
+
+    int i = archive ? 2 : 1;
+    if ( archive && strcmp(argv[i], "--thin") == 0 )
+    {
+        ++i;
+    }
+    if ( archive && i < argc )
+    {
+        output = argv[i];
+        ++i;
+    }
+
+    while ( i < argc )
+    {
+        const char* argument = argv[i];
+        if ( strcmp(argument, "-c") == 0 )
+        {
+            compile = true;
+        }
+        else if ( strcmp(argument, "-o") == 0 && i + 1 < argc )
+        {
+            output = argv[++i];
+        }
+        else if ( strcmp(argument, "-MF") == 0 && i + 1 < argc )
+        {
+            dependencies = argv[++i];
+        }
+        else if ( strcmp(argument, "-I") == 0 && i + 1 < argc )
+        {
+            include_directories.push_back( argv[++i] );
+        }
+        else if ( strncmp(argument, "-I", 2) == 0 )
+        {
+            include_directories.push_back( argument + 2 );
+        }
+        else if ( strcmp(argument, "-L") == 0 && i + 1 < argc )
+        {
+            library_directories.push_back( argv[++i] );
+        }
+        else if ( strncmp(argument, "-L", 2) == 0 )
+        {
+            library_directories.push_back( argument + 2 );
+        }
+        else if ( strncmp(argument, "-l", 2) == 0 )
+        {
+            libraries.push_back( argument + 2 );
+        }
+        else if ( strcmp(argument, "-x") == 0 || strcmp(argument, "-MT") == 0 || strcmp(argument, "-arch") == 0 )
+        {
+            ++i;
+        }
+        else if ( strncmp(argument, "--fake-sleep-ms=", 16) == 0 )
+        {
+            sleep_ms = atoi( argument + 16 );
+        }
+        else if ( strncmp(argument, "--fake-burn-ms=", 15) == 0 )
+        {
+            burn_ms = atoi( argument + 15 );
+        }
+        else if ( argument[0] != '-' )
+        {
+            inputs.push_back( argument );
+        }
+        ++i;
+    }
+
+    if ( output.empty() )
+    {
+        fprintf( stderr, "forge_fake_compiler: No output specified.\n" );
+        return EXIT_FAILURE;
+    }
+
+    // Archives keep the members of an existing archive that aren't replaced
+    // by inputs, as `ar -r` does, so that incremental archiving is exercised.
+    std::ostringstream content;
+    if ( archive )
+    {
+        string existing;
+        if ( read_file(output, &existing) )
+        {
+            set<string> replaced;
+            for ( vector<path>::const_iterator input = inputs.begin(); input != inputs.end(); ++input )
+            {
+                replaced.insert( input->generic_string() );
+            }
+            std::istringstream members( existing );
+            string member;
+            while ( std::getline(members, member) )
+            {
+                if ( replaced.find(member) == replaced.end() )
+                {
+                    content << member << "\n";
+                }
+            }
+        }
+    }
+
+    set<path> files;
+    for ( vector<path>::const_iterator input = inputs.begin(); input != inputs.end(); ++input )
+    {
+        if ( compile )
+        {
+            read_includes( input->lexically_normal(), include_directories, &files );
+        }
+        else if ( !read_file(*input, nullptr) )
+        {
+            fprintf( stderr, "forge_fake_compiler: Reading '%s' failed.\n", input->generic_string().c_str() );
+            return EXIT_FAILURE;
+        }
+        content << input->generic_string() << "\n";
+    }
+
+    for ( vector<string>::const_iterator library = libraries.begin(); library != libraries.end(); ++library )
+    {
+        for ( vector<path>::const_iterator directory = library_directories.begin(); directory != library_directories.end(); ++directory )
+        {
+            path filename = *directory / ("lib" + *library + ".a");
+            if ( read_file(filename, nullptr) )
+            {
+                content << filename.generic_string() << "\n";
+                break;
+            }
+        }
+    }
+
+    if ( sleep_ms > 0 )
+    {
+        std::this_thread::sleep_for( std::chrono::milliseconds(sleep_ms) );
+    }
+
+    if ( burn_ms > 0 )
+    {
+        burn( burn_ms );
+    }
+
+    if ( !write_file(output, content.str()) )
+    {
+        return EXIT_FAILURE;
+    }
+
+    if ( !dependencies.empty() )
+    {
+        std::ostringstream make_dependencies;
+        make_dependencies << output.generic_string() << ":";
+        for ( set<path>::const_iterator file = files.begin(); file != files.end(); ++file )
+        {
+            make_dependencies << " \\\n  " << file->generic_string();
+        }
+        make_dependencies << "\n";
+        if ( !write_file(dependencies, make_dependencies.str()) )
+        {
+            return EXIT_FAILURE;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,297 @@
+//
+// main.cpp
+// Copyright (c) Charles Baker. All rights reserved.
+//
+
+#include "SyntheticGraph.hpp"
+#include <forge/Forge.hpp>
+#include <forge/Graph.hpp>
+#include <forge/Target.hpp>
+#include <forge/Scheduler.hpp>
+#include <cmdline/Parser.hpp>
+#include <error/ErrorPolicy.hpp>
+#include <assert/assert.hpp>
+#include <lua.hpp>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <exception>
+#include <stdio.h>
+#include <stdlib.h>
+
+using std::string;
+using std::vector;
+using namespace sweet;
+using namespace sweet::forge;
+
+/**
+// The times in milliseconds taken by each iteration of one operation.
+*/
+struct Samples
+{
+    const char* operation_;
+    vector<double> times_;
+
+    Samples( const char* operation )
+    : operation_( operation )
+    , times_()
+    {
+    }
+};
+
+/**
+// Time a single call to \e function and add the elapsed time to \e samples.
+*/
+template <class Function>
+static void measure( Samples& samples, Function function )
+{
+    using namespace std::chrono;
+    steady_clock::time_point start = steady_clock::now();
+    function();
+    steady_clock::time_point finish = steady_clock::now();
+    samples.times_.push_back( duration<double, std::milli>(finish - start).count() );
+}
+
+/**
+// Print one line of tab separated values for \e samples.
+//
+// The line contains the shape, operation, number of targets, number of
+// dependencies, number of iterations, and the minimum, median, and maximum
+// times in milliseconds.  The columns and their order are stable so that
+// results can be compared between runs by scripts.
+*/
+static void report( FILE* stream, const SyntheticGraph& graph, Samples& samples )
+{
+    vector<double>& times = samples.times_;
+    SWEET_ASSERT( !times.empty() );
+    std::sort( times.begin(), times.end() );
+    fprintf( stream, "%s\t%s\t%d\t%d\t%d\t%.3f\t%.3f\t%.3f\n",
+        graph.shape_name(),
+        samples.operation_,
+        int(graph.ids().size()),
+        int(graph.dependencies().size()),
+        int(times.size()),
+        times.front(),
+        times[times.size() / 2],
+        times.back()
+    );
+    fflush( stream );
+}
+
+/**
+// Create a Lua function that does nothing to pass as the visit function to
+// preorder and postorder traversals.
+//
+// @return
+//  The reference to the function in the Lua registry.
+*/
+static int create_no_op_visit( lua_State* lua_state )
+{
+    SWEET_ASSERT( lua_state );
+    luaL_loadstring( lua_state, "return function() end" );
+    lua_call( lua_state, 0, 1 );
+    return luaL_ref( lua_state, LUA_REGISTRYINDEX );
+}
+
+/**
+// Benchmark the graph operations for \e graph.
+//
+// Each iteration resets \e forge and loads a missing cache file so that the
+// Graph knows where to save to, adds the Targets and their dependencies,
+// binds, traverses the Graph in preorder and postorder with visit functions
+// that do nothing, and then saves the Graph and loads it back again in a
+// freshly reset Forge.
+*/
+static int benchmark( Forge& forge, const SyntheticGraph& graph, const std::filesystem::path& cache, int iterations, FILE* stream )
+{
+    Samples add_or_find_target( "add_or_find_target" );
+    Samples add_dependency( "add_explicit_dependency" );
+    Samples bind( "bind" );
+    Samples preorder( "preorder" );
+    Samples postorder( "postorder" );
+    Samples save_binary( "save_binary" );
+    Samples load_binary( "load_binary" );
+
+    error::ErrorPolicy& error_policy = forge.error_policy();
+    error_policy.push_errors();
+
+    const vector<string>& ids = graph.ids();
+    const vector<std::pair<int, int>>& dependencies = graph.dependencies();
+    vector<Target*> targets( ids.size(), nullptr );
+
+    for ( int iteration = 0; iteration < iterations && error_policy.errors() == 0; ++iteration )
+    {
+        std::error_code error;
+        std::filesystem::remove( cache, error );
+
+        forge.reset();
+        Graph* forge_graph = forge.graph();
+        forge_graph->load_binary( cache.generic_string() );
+        Target* working_directory = forge_graph->target( forge.root().generic_string() );
+
+        measure( add_or_find_target, [&]()
+        {
+            for ( size_t i = 0; i < ids.size(); ++i )
+            {
+                targets[i] = forge_graph->add_or_find_target( ids[i], working_directory );
+            }
+        } );
+
+        measure( add_dependency, [&]()
+        {
+            for ( size_t i = 0; i < dependencies.size(); ++i )
+            {
+                targets[dependencies[i].first]->add_explicit_dependency( targets[dependencies[i].second] );
+            }
+        } );
+
+        for ( size_t i = 0; i < targets.size(); ++i )
+        {
+            forge.create_target_lua_binding( targets[i] );
+        }
+
+        measure( bind, [&]()
+        {
+            forge_graph->bind( targets[0] );
+        } );
+
+        lua_State* lua_state = forge.lua_state();
+        int visit = create_no_op_visit( lua_state );
+        measure( preorder, [&]()
+        {
+            forge.scheduler()->preorder( targets[0], visit );
+        } );
+        measure( postorder, [&]()
+        {
+            forge.scheduler()->postorder( targets[0], visit );
+        } );
+        luaL_unref( lua_state, LUA_REGISTRYINDEX, visit );
+
+        measure( save_binary, [&]()
+        {
+            forge_graph->save_binary();
+        } );
+
+        forge.reset();
+        measure( load_binary, [&]()
+        {
+            forge.graph()->load_binary( cache.generic_string() );
+        } );
+    }
+
+    std::error_code error;
+    std::filesystem::remove( cache, error );
+
+    int errors = error_policy.pop_errors();
+    if ( errors == 0 )
+    {
+        report( stream, graph, add_or_find_target );
+        report( stream, graph, add_dependency );
+        report( stream, graph, bind );
+        report( stream, graph, preorder );
+        report( stream, graph, postorder );
+        report( stream, graph, save_binary );
+        report( stream, graph, load_binary );
+    }
+    return errors;
+}
+
+int main( int argc, char** argv )
+{
+    try
+    {
+        bool help = false;
+        string directory = (std::filesystem::temp_directory_path() / "forge_benchmark").generic_string();
+        string output;
+        int targets = 10000;
+        int iterations = 5;
+        vector<string> shapes;
+
+        error::ErrorPolicy error_policy;
+        cmdline::Parser command_line_parser;
+        command_line_parser.add_options()
+            ( "help", "h", "Print this message and exit", &help )
+            ( "directory", "d", "Set the directory to write cache files to", &directory )
+            ( "output", "o", "Write results to a file instead of stdout", &output )
+            ( "targets", "t", "Set the approximate number of targets per graph", &targets )
+            ( "iterations", "i", "Set the number of iterations per shape", &iterations )
+            ( &shapes )
+        ;
+        command_line_parser.parse( argc, argv );
+
+        if ( help )
+        {
+            printf( "Usage: forge_benchmark [options] [wide|deep|diamond|libraries] ... \n" );
+            printf( "Options: \n" );
+            command_line_parser.print( stdout );
+            return EXIT_SUCCESS;
+        }
+
+        if ( shapes.empty() )
+        {
+            for ( int shape = SHAPE_WIDE; shape < SHAPE_NULL; ++shape )
+            {
+                shapes.push_back( SyntheticGraph::shape_name(SyntheticGraphShape(shape)) );
+            }
+        }
+
+        for ( vector<string>::const_iterator i = shapes.begin(); i != shapes.end(); ++i )
+        {
+            error_policy.error( SyntheticGraph::shape_from_name(*i) == SHAPE_NULL, "Unknown shape '%s'", i->c_str() );
+        }
+        error_policy.error( targets <= 0, "The number of targets must be greater than zero" );
+        error_policy.error( iterations <= 0, "The number of iterations must be greater than zero" );
+        if ( error_policy.errors() > 0 )
+        {
+            fprintf( stderr, "forge_benchmark: Invalid arguments.\n" );
+            return EXIT_FAILURE;
+        }
+
+        FILE* stream = stdout;
+        if ( !output.empty() )
+        {
+            stream = fopen( output.c_str(), "wb" );
+            if ( !stream )
+            {
+                fprintf( stderr, "forge_benchmark: Opening '%s' failed.\n", output.c_str() );
+                return EXIT_FAILURE;
+            }
+        }
+
+        std::filesystem::create_directories( directory );
+        std::filesystem::path cache = std::filesystem::path( directory ) / ".forge";
+
+        Forge forge( directory, error_policy );
+        forge.set_root_directory( directory );
+        fprintf( stream, "shape\toperation\ttargets\tdependencies\titerations\tminimum_ms\tmedian_ms\tmaximum_ms\n" );
+        for ( vector<string>::const_iterator i = shapes.begin(); i != shapes.end() && error_policy.errors() == 0; ++i )
+        {
+            SyntheticGraph graph( SyntheticGraph::shape_from_name(*i), targets );
+            if ( benchmark(forge, graph, cache, iterations, stream) > 0 )
+            {
+                fprintf( stderr, "forge_benchmark: Benchmarking '%s' failed.\n", i->c_str() );
+            }
+        }
+
+        if ( stream != stdout )
+        {
+            fclose( stream );
+        }
+        return error_policy.errors() == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    catch ( const std::exception& exception )
+    {
+        fprintf( stderr, "forge_benchmark: %s.\n", exception.what() );
+        return EXIT_FAILURE;
+    }
+
+    catch ( ... )
+    {
+        fprintf( stderr, "forge_benchmark: An unexpected error occured.\n" );
+        return EXIT_FAILURE;
+    }
+}
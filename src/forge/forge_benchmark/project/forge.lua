@@ -0,0 +1,135 @@
+-- Synthetic C++ project for the end-to-end build benchmark.
+--
+-- Declares static libraries of generated source files linked into a single
+-- executable using the real `forge.cc` rules but with the compiler, linker,
+-- and archiver replaced by `forge_fake_compiler` so that the build measures
+-- forge and the build hooks rather than a toolchain.  See `benchmark.bash`
+-- for the driver that generates, builds, and times this project.
+--
+-- Variables:
+--   fake_compiler={path}          Path to forge_fake_compiler, required.
+--   lua_directory={path}          Directory containing the forge Lua scripts.
+--   sources={sources}             Number of source files, default 10000.
+--   sources_per_library={n}       Source files per library, default 100.
+--   headers_per_library={n}       Headers per library, default 8.
+--   includes_per_source={n}       Headers included by each source, default 4.
+--   sleep_ms={ms}                 Time each tool invocation sleeps, default 0.
+--   burn_ms={ms}                  Time each tool invocation burns CPU, default 0.
+
+if lua_directory then
+    package.path = ('%s/?.lua;%s/?/init.lua'):format(lua_directory, lua_directory);
+end
+
+variant = variant or 'debug';
+sources = tonumber(sources or 10000);
+sources_per_library = tonumber(sources_per_library or 100);
+headers_per_library = tonumber(headers_per_library or 8);
+includes_per_source = math.min(tonumber(includes_per_source or 4), headers_per_library);
+sleep_ms = tonumber(sleep_ms or 0);
+burn_ms = tonumber(burn_ms or 0);
+
+local libraries = math.max(1, math.ceil(sources / sources_per_library));
+
+local function library_directory(library)
+    return ('src/library%05d'):format(library);
+end
+
+local function source_filename(library, source)
+    return ('%s/source%05d.cpp'):format(library_directory(library), source);
+end
+
+local function header_filename(library, header)
+    return ('%s/header%02d.hpp'):format(library_directory(library), header);
+end
+
+local function sources_in_library(library)
+    local first = library * sources_per_library;
+    return math.min(sources_per_library, sources - first);
+end
+
+local forge = require('forge'):load(variant);
+
+local fake_compiler = fake_compiler and absolute(fake_compiler);
+local toolset = forge.Toolset 'cc_${platform}_${architecture}' {
+    platform = operating_system();
+    bin = root(('%s/bin'):format(variant));
+    lib = root(('%s/lib'):format(variant));
+    obj = root(('%s/obj'):format(variant));
+    include_directories = {
+        root('src/include');
+    };
+    library_directories = {
+        root(('%s/lib'):format(variant));
+    };
+    cppflags = {
+        ('--fake-sleep-ms=%d'):format(sleep_ms);
+        ('--fake-burn-ms=%d'):format(burn_ms);
+    };
+    ldflags = {
+        ('--fake-sleep-ms=%d'):format(sleep_ms);
+        ('--fake-burn-ms=%d'):format(burn_ms);
+    };
+    gcc = {
+        gcc = fake_compiler;
+        gxx = fake_compiler;
+        ar = fake_compiler;
+    };
+    clang = {
+        cc = fake_compiler;
+        cxx = fake_compiler;
+        ar = fake_compiler;
+    };
+    architecture = 'native';
+    warnings_as_errors = false;
+};
+
+if fake_compiler then
+    toolset:install('forge.cc');
+
+    local executable_dependencies = {};
+    for library = 0, libraries - 1 do
+        local library_sources = {};
+        for source = 0, sources_in_library(library) - 1 do
+            table.insert(library_sources, source_filename(library, source));
+        end
+        local identifier = ('${lib}/library%05d'):format(library);
+        toolset:StaticLibrary(identifier) {
+            toolset:Cxx '${obj}/%1' (library_sources);
+        };
+        table.insert(executable_dependencies, identifier);
+    end
+
+    toolset:all {
+        toolset:Executable '${bin}/benchmark' (executable_dependencies);
+    };
+end
+
+-- Write the source files and headers of the project.
+function generate()
+    assertf(fake_compiler, 'The fake_compiler variable must be set to the path to forge_fake_compiler');
+    local function write(filename, content)
+        local filename = root(filename);
+        mkdir(branch(filename));
+        local file = io.open(filename, 'wb');
+        assertf(file, 'Opening "%s" to write failed', filename);
+        file:write(content);
+        file:close();
+    end
+
+    write('src/include/common.hpp', '#pragma once\n');
+    for library = 0, libraries - 1 do
+        for header = 0, headers_per_library - 1 do
+            write(header_filename(library, header), '#pragma once\n#include "common.hpp"\n');
+        end
+        for source = 0, sources_in_library(library) - 1 do
+            local lines = {};
+            for include = 0, includes_per_source - 1 do
+                local header = (source + include) % headers_per_library;
+                table.insert(lines, ('#include "header%02d.hpp"'):format(header));
+            end
+            table.insert(lines, ('int source%05d_%05d() { return %d; }'):format(library, source, source));
+            write(source_filename(library, source), table.concat(lines, '\n')..'\n');
+        end
+    end
+    printf('forge: generated %d sources in %d libraries', sources, libraries);
+end
@@ -4,6 +4,7 @@
 //
 
 #include "Lua.hpp"
+#include "LuaAllocator.hpp"
 #include "LuaFileSystem.hpp"
 #include "LuaSystem.hpp"
 #include "LuaContext.hpp"
@@ -25,6 +26,7 @@ using namespace sweet::forge;
 
 Lua::Lua( Forge* forge )
 : forge_( nullptr )
+, lua_allocator_( nullptr )
 , lua_state_( nullptr )
 , lua_file_system_( nullptr )
 , lua_context_( nullptr )
@@ -48,6 +50,12 @@ lua_State* Lua::lua_state() const
     return lua_state_;
 }
 
+LuaAllocator* Lua::lua_allocator() const
+{
+    SWEET_ASSERT( lua_allocator_ );
+    return lua_allocator_;
+}
+
 LuaTarget* Lua::lua_target() const
 {
     SWEET_ASSERT( lua_target_ );
@@ -73,7 +81,8 @@ void Lua::create( Forge* forge )
     destroy();
 
     forge_ = forge;
-    lua_state_ = luaxx_newstate();
+    lua_allocator_ = new LuaAllocator;
+    lua_state_ = luaxx_newstate( &LuaAllocator::allocate, lua_allocator_ );
     lua_file_system_ = new LuaFileSystem;
     lua_context_ = new LuaContext;
     lua_graph_ = new LuaGraph;
@@ -132,6 +141,11 @@ void Lua::destroy()
         lua_close( lua_state_ );
     }
 
+    // Release the memory used by the Lua state in bulk once it has been
+    // closed and has freed all of its blocks.
+    delete lua_allocator_;
+    lua_allocator_ = nullptr;
+
     lua_state_ = nullptr;
     forge_ = nullptr;
 }
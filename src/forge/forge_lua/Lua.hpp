@@ -23,10 +23,12 @@ class LuaSystem;
 class LuaTarget;
 class LuaRule;
 class LuaToolset;
+class LuaAllocator;
 
 class Lua
 {
     Forge* forge_;
+    LuaAllocator* lua_allocator_;
     lua_State* lua_state_;
     LuaFileSystem* lua_file_system_;
     LuaContext* lua_context_;
@@ -40,6 +42,7 @@ public:
     Lua( Forge* forge );
     ~Lua();
     lua_State* lua_state() const;
+    LuaAllocator* lua_allocator() const;
     LuaTarget* lua_target() const;
     LuaRule* lua_rule() const;
     LuaToolset* lua_toolset() const;
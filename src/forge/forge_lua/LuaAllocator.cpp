@@ -0,0 +1,272 @@
+//
+// LuaAllocator.cpp
+// Copyright (c) Charles Baker. All rights reserved.
+//
+
+#include "LuaAllocator.hpp"
+#include <assert/assert.hpp>
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
+
+using std::vector;
+using namespace sweet;
+using namespace sweet::forge;
+
+LuaAllocator::LuaAllocator()
+: free_lists_()
+, chunks_()
+, chunk_position_( nullptr )
+, chunk_end_( nullptr )
+, reserved_bytes_( 0 )
+, bytes_in_use_( 0 )
+, peak_bytes_in_use_( 0 )
+{
+    chunks_.reserve( 1 );
+}
+
+/**
+// Destructor.
+//
+// Releases every chunk and adopted large block that small blocks have been
+// carved from in one pass rather than freeing blocks individually.  The Lua
+// state using this LuaAllocator must already have been closed.
+*/
+LuaAllocator::~LuaAllocator()
+{
+    for ( vector<void*>::const_iterator chunk = chunks_.begin(); chunk != chunks_.end(); ++chunk )
+    {
+        free( *chunk );
+    }
+}
+
+/**
+// Get the number of bytes currently allocated by Lua.
+*/
+size_t LuaAllocator::bytes_in_use() const
+{
+    return bytes_in_use_;
+}
+
+/**
+// Get the largest number of bytes allocated by Lua at any one time.
+*/
+size_t LuaAllocator::peak_bytes_in_use() const
+{
+    return peak_bytes_in_use_;
+}
+
+/**
+// Get the number of bytes reserved in chunks and adopted large blocks for
+// small blocks.
+*/
+size_t LuaAllocator::reserved_bytes() const
+{
+    return reserved_bytes_;
+}
+
+/**
+// Implement the lua_Alloc function.
+//
+// @param context
+//  The LuaAllocator passed to `lua_newstate()`.
+//
+// @param ptr
+//  The address of any existing allocation to be reallocated or freed or null
+//  to allocate a new block of memory.
+//
+// @param osize
+//  The size of the existing block if \e ptr is not null otherwise the type
+//  of object being allocated (ignored).
+//
+// @param nsize
+//  The size of the memory block to allocate or 0 to free \e ptr.
+//
+// @return
+//  A pointer to the newly allocated memory or null if \e nsize is 0 or the
+//  allocation failed.
+*/
+void* LuaAllocator::allocate( void* context, void* ptr, size_t osize, size_t nsize )
+{
+    SWEET_ASSERT( context );
+    LuaAllocator* allocator = reinterpret_cast<LuaAllocator*>( context );
+    return allocator->reallocate( ptr, ptr ? osize : 0, nsize );
+}
+
+void* LuaAllocator::reallocate( void* ptr, size_t osize, size_t nsize )
+{
+    if ( nsize == 0 )
+    {
+        if ( ptr )
+        {
+            free_block( ptr, osize );
+            bytes_in_use_ -= osize;
+        }
+        return nullptr;
+    }
+
+    void* block = nullptr;
+    if ( !ptr )
+    {
+        block = allocate_block( nsize );
+    }
+    else if ( osize <= MAXIMUM_SMALL_SIZE && nsize <= MAXIMUM_SMALL_SIZE && size_class(osize) == size_class(nsize) )
+    {
+        block = ptr;
+    }
+    else if ( osize > MAXIMUM_SMALL_SIZE && nsize > MAXIMUM_SMALL_SIZE )
+    {
+        block = realloc( ptr, nsize );
+        if ( !block && nsize <= osize )
+        {
+            block = ptr;
+        }
+    }
+    else
+    {
+        block = allocate_block( nsize );
+        if ( block )
+        {
+            memcpy( block, ptr, std::min(osize, nsize) );
+            free_block( ptr, osize );
+        }
+        else if ( nsize <= osize && adopt_block(ptr, osize) )
+        {
+            // Lua assumes that shrinking a block never fails.  The existing
+            // block is large enough to be reused as a block of the smaller
+            // size class but, once Lua frees it with that size, it can only
+            // be recycled through that size class's free list.  Adopting it
+            // as a chunk releases it with the chunks when the LuaAllocator
+            // is destroyed rather than leaking it.
+            block = ptr;
+        }
+    }
+
+    if ( block )
+    {
+        bytes_in_use_ = bytes_in_use_ - osize + nsize;
+        peak_bytes_in_use_ = std::max( peak_bytes_in_use_, bytes_in_use_ );
+    }
+    return block;
+}
+
+void* LuaAllocator::allocate_block( size_t size )
+{
+    SWEET_ASSERT( size > 0 );
+    if ( size <= MAXIMUM_SMALL_SIZE )
+    {
+        size_t index = size_class( size );
+        void* block = free_lists_[index];
+        if ( block )
+        {
+            free_lists_[index] = *reinterpret_cast<void**>( block );
+            return block;
+        }
+        return allocate_small_block( index );
+    }
+    return malloc( size );
+}
+
+void LuaAllocator::free_block( void* ptr, size_t size )
+{
+    SWEET_ASSERT( ptr );
+    if ( size <= MAXIMUM_SMALL_SIZE )
+    {
+        size_t index = size_class( size );
+        *reinterpret_cast<void**>( ptr ) = free_lists_[index];
+        free_lists_[index] = ptr;
+    }
+    else
+    {
+        free( ptr );
+    }
+}
+
+/**
+// Carve a new block of \e size_class from the current chunk, starting a new
+// chunk if the current chunk is full.
+*/
+void* LuaAllocator::allocate_small_block( size_t size_class )
+{
+    SWEET_ASSERT( size_class < SIZE_CLASSES );
+    size_t size = (size_class + 1) * GRANULARITY;
+    if ( chunk_end_ - chunk_position_ < ptrdiff_t(size) )
+    {
+        char* chunk = reinterpret_cast<char*>( malloc(CHUNK_SIZE) );
+        if ( !chunk )
+        {
+            return nullptr;
+        }
+        if ( !reserve_chunk_slots() )
+        {
+            free( chunk );
+            return nullptr;
+        }
+        chunks_.push_back( chunk );
+        reserved_bytes_ += CHUNK_SIZE;
+        chunk_position_ = chunk;
+        chunk_end_ = chunk + CHUNK_SIZE;
+    }
+    void* block = chunk_position_;
+    chunk_position_ += size;
+    return block;
+}
+
+/**
+// Adopt the large block at \e ptr, of \e size bytes, as a chunk so that it
+// is freed with the chunks when this LuaAllocator is destroyed.
+//
+// Adoption happens when a large block is shrunk to a small size while
+// memory is exhausted so it must not allocate.  The slot for the block is
+// taken from the spare slot that `reserve_chunk_slots()` keeps at the end
+// of the chunks and a new spare slot is reserved if possible.
+//
+// @return
+//  True if the block was adopted or false if there was no spare slot.
+*/
+bool LuaAllocator::adopt_block( void* ptr, size_t size )
+{
+    SWEET_ASSERT( ptr );
+    SWEET_ASSERT( size > MAXIMUM_SMALL_SIZE );
+    if ( chunks_.size() >= chunks_.capacity() )
+    {
+        return false;
+    }
+    chunks_.push_back( ptr );
+    reserved_bytes_ += size;
+    reserve_chunk_slots();
+    return true;
+}
+
+/**
+// Reserve space for another chunk and a spare slot after it so that a
+// large block can always be adopted without allocating.
+//
+// @return
+//  True if the space was reserved otherwise false.
+*/
+bool LuaAllocator::reserve_chunk_slots()
+{
+    size_t size = chunks_.size() + 2;
+    if ( chunks_.capacity() < size )
+    {
+        try
+        {
+            chunks_.reserve( std::max(chunks_.capacity() * 2, size) );
+        }
+        catch ( ... )
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+// Get the index of the size class for blocks of \e size bytes.
+*/
+size_t LuaAllocator::size_class( size_t size )
+{
+    SWEET_ASSERT( size > 0 && size <= MAXIMUM_SMALL_SIZE );
+    return (size - 1) / GRANULARITY;
+}
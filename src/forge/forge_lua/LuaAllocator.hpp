@@ -0,0 +1,64 @@
+#ifndef FORGE_LUAALLOCATOR_HPP_INCLUDED
+#define FORGE_LUAALLOCATOR_HPP_INCLUDED
+
+#include <vector>
+#include <stddef.h>
+
+namespace sweet
+{
+
+namespace forge
+{
+
+/**
+// Allocate memory for a Lua state from size-class free lists backed by
+// large chunks.
+//
+// Small blocks, the strings, tables, and closures that Lua allocates in huge
+// numbers while buildfiles run and dependency filters process output, are
+// carved from chunks and recycled through a free list per size class.
+// Larger blocks are passed through to `realloc()` and `free()`.  All chunks
+// are released at once when the LuaAllocator is destroyed after its Lua
+// state is closed.
+//
+// A LuaAllocator isn't thread safe; it must only be used by a single Lua
+// state and its coroutines.
+*/
+class LuaAllocator
+{
+    static const size_t GRANULARITY = 16; ///< The difference in size between consecutive size classes.
+    static const size_t SIZE_CLASSES = 16; ///< The number of size classes for small blocks.
+    static const size_t MAXIMUM_SMALL_SIZE = GRANULARITY * SIZE_CLASSES; ///< The size of the largest small block.
+    static const size_t CHUNK_SIZE = 64 * 1024; ///< The size of each chunk that small blocks are carved from.
+
+    void* free_lists_ [SIZE_CLASSES]; ///< The singly linked lists of free small blocks for each size class.
+    std::vector<void*> chunks_; ///< The chunks and adopted large blocks that small blocks have been carved from.
+    char* chunk_position_; ///< The first unused byte in the current chunk.
+    char* chunk_end_; ///< One past the last byte in the current chunk.
+    size_t reserved_bytes_; ///< The number of bytes in chunks and adopted large blocks.
+    size_t bytes_in_use_; ///< The number of bytes currently allocated by Lua.
+    size_t peak_bytes_in_use_; ///< The largest number of bytes allocated by Lua at any one time.
+
+public:
+    LuaAllocator();
+    ~LuaAllocator();
+    size_t bytes_in_use() const;
+    size_t peak_bytes_in_use() const;
+    size_t reserved_bytes() const;
+    static void* allocate( void* context, void* ptr, size_t osize, size_t nsize );
+
+private:
+    void* reallocate( void* ptr, size_t osize, size_t nsize );
+    void* allocate_block( size_t size );
+    void free_block( void* ptr, size_t size );
+    void* allocate_small_block( size_t size_class );
+    bool adopt_block( void* ptr, size_t size );
+    bool reserve_chunk_slots();
+    static size_t size_class( size_t size );
+};
+
+}
+
+}
+
+#endif
@@ -6,19 +6,24 @@
 #include "LuaFileSystem.hpp"
 #include "types.hpp"
 #include <forge/Forge.hpp>
+#include <forge/System.hpp>
+#include <forge/Graph.hpp>
+#include <forge/Target.hpp>
+#include <forge/Context.hpp>
+#include <forge/DirectoryCache.hpp>
+#include <forge/DirectoryReader.hpp>
 #include <luaxx/luaxx.hpp>
 #include <assert/assert.hpp>
 #include <lua.hpp>
+#include <unordered_set>
 
 using std::string;
-using std::filesystem::directory_iterator;
-using std::filesystem::recursive_directory_iterator;
+using std::vector;
 using namespace sweet;
 using namespace sweet::luaxx;
 using namespace sweet::forge;
 
-static const char* DIRECTORY_ITERATOR_METATABLE = "std::filesystem::directory_iterator";
-static const char* RECURSIVE_DIRECTORY_ITERATOR_METATABLE = "std::filesystem::recursive_directory_iterator";
+static const char* DIRECTORY_READER_METATABLE = "forge::DirectoryReader";
 
 LuaFileSystem::LuaFileSystem()
 : lua_state_( NULL )
@@ -44,9 +49,11 @@ void LuaFileSystem::create( Forge* forge, lua_State* lua_state )
         { "is_directory", &LuaFileSystem::is_directory },
         { "ls", &LuaFileSystem::ls },
         { "find", &LuaFileSystem::find },
+        { "glob", &LuaFileSystem::glob },
         { "mkdir", &LuaFileSystem::mkdir },
         { "rmdir", &LuaFileSystem::rmdir },
         { "cp", &LuaFileSystem::cp },
+        { "cp_many", &LuaFileSystem::cp_many },
         { "rm", &LuaFileSystem::rm },
         { "touch", &LuaFileSystem::touch },
         { NULL, NULL }
@@ -56,15 +63,9 @@ void LuaFileSystem::create( Forge* forge, lua_State* lua_state )
     luaL_setfuncs( lua_state, functions, 1 );
     lua_pop( lua_state, 1 );
 
-    luaL_newmetatable( lua_state, DIRECTORY_ITERATOR_METATABLE );
+    luaL_newmetatable( lua_state, DIRECTORY_READER_METATABLE );
     lua_pushstring( lua_state, "__gc" );
-    lua_pushcfunction( lua_state, &LuaFileSystem::directory_iterator_gc );
-    lua_rawset( lua_state, -3 );
-    lua_pop( lua_state, 1 );
-
-    luaL_newmetatable( lua_state, RECURSIVE_DIRECTORY_ITERATOR_METATABLE );
-    lua_pushstring( lua_state, "__gc" );
-    lua_pushcfunction( lua_state, &LuaFileSystem::recursive_directory_iterator_gc );
+    lua_pushcfunction( lua_state, &LuaFileSystem::directory_reader_gc );
     lua_rawset( lua_state, -3 );
     lua_pop( lua_state, 1 );
 
@@ -75,11 +76,7 @@ void LuaFileSystem::destroy()
 {
     if ( lua_state_ )
     {
-        lua_pushstring( lua_state_, DIRECTORY_ITERATOR_METATABLE );
-        lua_pushnil( lua_state_ );
-        lua_rawset( lua_state_, LUA_REGISTRYINDEX );
-
-        lua_pushstring( lua_state_, RECURSIVE_DIRECTORY_ITERATOR_METATABLE );
+        lua_pushstring( lua_state_, DIRECTORY_READER_METATABLE );
         lua_pushnil( lua_state_ );
         lua_rawset( lua_state_, LUA_REGISTRYINDEX );
 
@@ -112,21 +109,129 @@ int LuaFileSystem::is_directory( lua_State* lua_state )
     return 1;
 }
 
+/**
+// List the entries in a directory.
+//
+// ~~~lua
+// function ls( path )
+// ~~~
+//
+// @return
+//  An iterator that returns the path and type ("file", "directory", "link",
+//  or "other") of each entry in the directory (see DirectoryReader).
+*/
 int LuaFileSystem::ls( lua_State* lua_state )
 {
     const int PATH = 1;
     std::filesystem::path path = absolute( lua_state, PATH );
-    LuaFileSystem::push_directory_iterator( lua_state, directory_iterator(path) );
-    lua_pushcclosure( lua_state, &LuaFileSystem::ls_iterator, 1 );
+    LuaFileSystem::push_directory_reader( lua_state, path, false );
+    lua_pushcclosure( lua_state, &LuaFileSystem::directory_reader_iterator, 1 );
     return 1;
 }
 
+/**
+// List the entries in a directory and the directories beneath it.
+//
+// ~~~lua
+// function find( path )
+// ~~~
+//
+// @return
+//  An iterator that returns the path and type ("file", "directory", "link",
+//  or "other") of each entry in the directory and the directories beneath
+//  it (see DirectoryReader).
+*/
 int LuaFileSystem::find( lua_State* lua_state )
 {
     const int PATH = 1;
     std::filesystem::path path = absolute( lua_state, PATH );
-    LuaFileSystem::push_recursive_directory_iterator( lua_state, recursive_directory_iterator(path) );
-    lua_pushcclosure( lua_state, &LuaFileSystem::find_iterator, 1 );
+    LuaFileSystem::push_directory_reader( lua_state, path, true );
+    lua_pushcclosure( lua_state, &LuaFileSystem::directory_reader_iterator, 1 );
+    return 1;
+}
+
+/**
+// Find files matching one or more glob patterns.
+//
+// The leading elements of each pattern without wildcards name the
+// directory to search from.  The remaining elements are matched against
+// directory listings from the Graph's DirectoryCache so that directories
+// that haven't changed since they were last listed, in this build or a
+// previous build saved to the same cache file, aren't read again.
+//
+// ~~~lua
+// function glob( patterns, options )
+// ~~~
+//
+// @return
+//  An array of the paths to matching files, each starting with the
+//  directory part of the pattern that matched it, sorted within each
+//  pattern and listed once.
+*/
+int LuaFileSystem::glob( lua_State* lua_state )
+{
+    const int FORGE = lua_upvalueindex( 1 );
+    const int PATTERNS = 1;
+    const int OPTIONS = 2;
+    luaL_argcheck( lua_state, lua_type(lua_state, PATTERNS) == LUA_TSTRING || lua_istable(lua_state, PATTERNS), PATTERNS, "expected pattern string or table" );
+    luaL_argcheck( lua_state, lua_isnoneornil(lua_state, OPTIONS) || lua_istable(lua_state, OPTIONS), OPTIONS, "expected options table" );
+
+    vector<string> patterns;
+    vector<string> excludes;
+    vector<string> extensions;
+    strings( lua_state, PATTERNS, &patterns );
+    if ( lua_istable(lua_state, OPTIONS) )
+    {
+        lua_getfield( lua_state, OPTIONS, "exclude" );
+        strings( lua_state, -1, &excludes );
+        lua_getfield( lua_state, OPTIONS, "extensions" );
+        strings( lua_state, -1, &extensions );
+        lua_pop( lua_state, 2 );
+    }
+    for ( vector<string>::iterator extension = extensions.begin(); extension != extensions.end(); ++extension )
+    {
+        if ( extension->empty() || (*extension)[0] != '.' )
+        {
+            extension->insert( extension->begin(), '.' );
+        }
+    }
+
+    Forge* forge = (Forge*) lua_touserdata( lua_state, FORGE );
+    SWEET_ASSERT( forge );
+    DirectoryCache* directory_cache = forge->graph()->directory_cache();
+    Context* context = forge->context();
+    Target* buildfile = context ? context->current_buildfile() : nullptr;
+    string buildfile_path = buildfile ? buildfile->path() : string();
+    vector<string> filenames;
+    for ( vector<string>::const_iterator i = patterns.begin(); i != patterns.end(); ++i )
+    {
+        // Split the pattern before the first element containing a wildcard
+        // or before the last element if there are no wildcards.
+        const string& pattern = *i;
+        string::size_type wildcard = pattern.find_first_of( "*?" );
+        string::size_type slash = pattern.rfind( '/', wildcard );
+        string prefix;
+        string remainder = pattern;
+        if ( slash != string::npos )
+        {
+            prefix = slash > 0 ? pattern.substr( 0, slash ) : string( "/" );
+            remainder = pattern.substr( slash + 1 );
+        }
+        string directory = forge->absolute( prefix ).generic_string();
+        directory_cache->glob( directory, prefix, remainder, excludes, extensions, buildfile_path, &filenames );
+    }
+
+    std::unordered_set<string> listed;
+    lua_createtable( lua_state, int(filenames.size()), 0 );
+    int index = 0;
+    for ( vector<string>::const_iterator filename = filenames.begin(); filename != filenames.end(); ++filename )
+    {
+        if ( listed.insert(*filename).second )
+        {
+            lua_pushlstring( lua_state, filename->c_str(), filename->size() );
+            lua_rawseti( lua_state, -2, ++index );
+        }
+    }
     return 1;
 }
 
@@ -146,13 +251,79 @@ int LuaFileSystem::rmdir( lua_State* lua_state )
     return 0;
 }
 
+/**
+// Copy a file, replacing any existing file, and keeping its last write time.
+//
+// ~~~lua
+// function cp( to, from, link )
+// ~~~
+//
+// Pass true for `link` to hard link rather than copy (see System::cp()).
+*/
 int LuaFileSystem::cp( lua_State* lua_state )
 {
+    const int FORGE = lua_upvalueindex( 1 );
     const int TO = 1;
     const int FROM = 2;
+    const int LINK = 3;
+    Forge* forge = (Forge*) lua_touserdata( lua_state, FORGE );
     std::filesystem::path to = absolute( lua_state, TO );
     std::filesystem::path from = absolute( lua_state, FROM );
-    std::filesystem::copy_file( from, to );
+    bool link = lua_toboolean( lua_state, LINK ) != 0;
+    forge->system()->cp( from.string(), to.string(), link );
+    return 0;
+}
+
+/**
+// Copy many files concurrently.
+//
+// ~~~lua
+// function cp_many( copies, link )
+// ~~~
+//
+// Each element of `copies` is a `{to, from}` pair as passed to `cp()`.
+// Files are copied on up to the maximum number of parallel jobs threads.
+// An error describing the first failure is raised after all of the other
+// files have been copied if any file fails to copy.
+*/
+int LuaFileSystem::cp_many( lua_State* lua_state )
+{
+    const int FORGE = lua_upvalueindex( 1 );
+    const int COPIES = 1;
+    const int LINK = 2;
+    Forge* forge = (Forge*) lua_touserdata( lua_state, FORGE );
+    luaL_checktype( lua_state, COPIES, LUA_TTABLE );
+    bool link = lua_toboolean( lua_state, LINK ) != 0;
+
+    int failures = 0;
+    {
+        vector<std::pair<string, string>> copies;
+        for ( int i = 1; lua_rawgeti(lua_state, COPIES, i) != LUA_TNIL; ++i )
+        {
+            lua_rawgeti( lua_state, -1, 1 );
+            lua_rawgeti( lua_state, -2, 2 );
+            const char* to = lua_tostring( lua_state, -2 );
+            const char* from = lua_tostring( lua_state, -1 );
+            if ( !to || !from )
+            {
+                luaL_error( lua_state, "expected {to, from} pair of strings in copies" );
+            }
+            copies.push_back( std::make_pair(forge->absolute(string(from)).string(), forge->absolute(string(to)).string()) );
+            lua_pop( lua_state, 3 );
+        }
+        lua_pop( lua_state, 1 );
+
+        string error;
+        failures = forge->system()->cp_many( copies, link, forge->maximum_parallel_jobs(), &error );
+        if ( failures > 0 )
+        {
+            lua_pushstring( lua_state, error.c_str() );
+        }
+    }
+    if ( failures > 0 )
+    {
+        return lua_error( lua_state );
+    }
     return 0;
 }
 
@@ -172,78 +343,76 @@ int LuaFileSystem::touch( lua_State* lua_state )
     return 0;
 }
 
-int LuaFileSystem::ls_iterator( lua_State* lua_state )
+int LuaFileSystem::directory_reader_iterator( lua_State* lua_state )
 {
-    directory_iterator& iterator = *LuaFileSystem::to_directory_iterator( lua_state, lua_upvalueindex(1) );
-    directory_iterator end;
-    if ( iterator != end )
+    static const char* TYPES [] = { "file", "directory", "link", "other" };
+    DirectoryReader* directory_reader = LuaFileSystem::to_directory_reader( lua_state, lua_upvalueindex(1) );
+    DirectoryEntry entry;
+    if ( directory_reader->next(&entry) )
     {
-        const std::filesystem::directory_entry& entry = *iterator;
-        lua_pushlstring( lua_state, entry.path().string().c_str(), entry.path().string().length() );
-        ++iterator;
-        return 1;
+        lua_pushlstring( lua_state, entry.path.c_str(), entry.path.length() );
+        lua_pushstring( lua_state, TYPES[entry.type] );
+        return 2;
     }
     return 0;
 }
 
-void LuaFileSystem::push_directory_iterator( lua_State* lua_state, const std::filesystem::directory_iterator& iterator )
+void LuaFileSystem::push_directory_reader( lua_State* lua_state, const std::filesystem::path& path, bool recursive )
 {
-    directory_iterator* other_iterator = (directory_iterator*) lua_newuserdata( lua_state, sizeof(directory_iterator) );
-    new (other_iterator) directory_iterator( iterator );
-    luaL_getmetatable( lua_state, DIRECTORY_ITERATOR_METATABLE );
+    DirectoryReader* directory_reader = (DirectoryReader*) lua_newuserdata( lua_state, sizeof(DirectoryReader) );
+    new (directory_reader) DirectoryReader( path.string(), recursive );
+    luaL_getmetatable( lua_state, DIRECTORY_READER_METATABLE );
     lua_setmetatable( lua_state, -2 );
 }
 
-std::filesystem::directory_iterator* LuaFileSystem::to_directory_iterator( lua_State* lua_state, int index )
+DirectoryReader* LuaFileSystem::to_directory_reader( lua_State* lua_state, int index )
 {
-    directory_iterator* iterator = (directory_iterator*) luaL_checkudata( lua_state, index, DIRECTORY_ITERATOR_METATABLE );
-    luaL_argcheck( lua_state, iterator != NULL, index, "directory iterator expected" );
-    return iterator;
+    DirectoryReader* directory_reader = (DirectoryReader*) luaL_checkudata( lua_state, index, DIRECTORY_READER_METATABLE );
+    luaL_argcheck( lua_state, directory_reader != NULL, index, "directory reader expected" );
+    return directory_reader;
 }
 
-int LuaFileSystem::directory_iterator_gc( lua_State* lua_state )
+int LuaFileSystem::directory_reader_gc( lua_State* lua_state )
 {
-    const int ITERATOR = 1;
-    const directory_iterator* iterator = LuaFileSystem::to_directory_iterator( lua_state, ITERATOR );
-    iterator->~directory_iterator();
+    const int DIRECTORY_READER = 1;
+    DirectoryReader* directory_reader = LuaFileSystem::to_directory_reader( lua_state, DIRECTORY_READER );
+    directory_reader->~DirectoryReader();
     return 0;
 }
 
-int LuaFileSystem::find_iterator( lua_State* lua_state )
+/**
+// Append the string or array of strings at \e index to \e values; nil
+// appends nothing.
+*/
+void LuaFileSystem::strings( lua_State* lua_state, int index, std::vector<std::string>* values )
 {
-    recursive_directory_iterator& iterator = *LuaFileSystem::to_recursive_directory_iterator( lua_state, lua_upvalueindex(1) );
-    recursive_directory_iterator end;
-    if ( iterator != end )
+    SWEET_ASSERT( values );
+    index = lua_absindex( lua_state, index );
+    if ( lua_type(lua_state, index) == LUA_TSTRING )
     {
-        const std::filesystem::directory_entry& entry = *iterator;
-        lua_pushlstring( lua_state, entry.path().string().c_str(), entry.path().string().length() );
-        ++iterator;
-        return 1;
+        size_t length = 0;
+        const char* value = lua_tolstring( lua_state, index, &length );
+        values->push_back( string(value, length) );
+    }
+    else if ( lua_istable(lua_state, index) )
+    {
+        for ( int i = 1; lua_rawgeti(lua_state, index, i) != LUA_TNIL; ++i )
+        {
+            if ( lua_type(lua_state, -1) != LUA_TSTRING )
+            {
+                luaL_error( lua_state, "expected string in array of strings" );
+            }
+            size_t length = 0;
+            const char* value = lua_tolstring( lua_state, -1, &length );
+            values->push_back( string(value, length) );
+            lua_pop( lua_state, 1 );
+        }
+        lua_pop( lua_state, 1 );
+    }
+    else if ( !lua_isnoneornil(lua_state, index) )
+    {
+        luaL_error( lua_state, "expected string or array of strings" );
     }
-    return 0;
-}
-
-void LuaFileSystem::push_recursive_directory_iterator( lua_State* lua_state, const std::filesystem::recursive_directory_iterator& iterator )
-{
-    recursive_directory_iterator* other_iterator = (recursive_directory_iterator*) lua_newuserdata( lua_state, sizeof(recursive_directory_iterator) );
-    new (other_iterator) recursive_directory_iterator( iterator );
-    luaL_getmetatable( lua_state, DIRECTORY_ITERATOR_METATABLE );
-    lua_setmetatable( lua_state, -2 );
-}
-
-std::filesystem::recursive_directory_iterator* LuaFileSystem::to_recursive_directory_iterator( lua_State* lua_state, int index )
-{
-    recursive_directory_iterator* iterator = (recursive_directory_iterator*) luaL_checkudata( lua_state, index, DIRECTORY_ITERATOR_METATABLE );
-    luaL_argcheck( lua_state, iterator != NULL, index, "directory iterator expected" );
-    return iterator;
-}
-
-int LuaFileSystem::recursive_directory_iterator_gc( lua_State* lua_state )
-{
-    const int ITERATOR = 1;
-    const recursive_directory_iterator* iterator = LuaFileSystem::to_recursive_directory_iterator( lua_state, ITERATOR );
-    iterator->~recursive_directory_iterator();
-    return 0;
 }
 
 std::filesystem::path LuaFileSystem::absolute( lua_State* lua_state, int index )
@@ -2,6 +2,8 @@
 #define FORGE_LUAFILESYSTEM_HPP_INCLUDED
 
 #include <filesystem>
+#include <vector>
+#include <string>
 
 struct lua_State;
 
@@ -12,6 +14,7 @@ namespace forge
 {
 
 class Forge;
+class DirectoryReader;
 
 /**
 // Provide Lua bindings to file system operations.
@@ -32,22 +35,20 @@ private:
     static int is_directory( lua_State* lua_state );
     static int ls( lua_State* lua_state );
     static int find( lua_State* lua_state );
+    static int glob( lua_State* lua_state );
     static int mkdir( lua_State* lua_state );
     static int rmdir( lua_State* lua_state );
     static int cp( lua_State* lua_state );
+    static int cp_many( lua_State* lua_state );
     static int rm( lua_State* lua_state );
     static int touch( lua_State* lua_state );
 
-    static int ls_iterator( lua_State* lua_state );
-    static void push_directory_iterator( lua_State* lua_state, const std::filesystem::directory_iterator& iterator );
-    static std::filesystem::directory_iterator* to_directory_iterator( lua_State* lua_state, int index );
-    static int directory_iterator_gc( lua_State* lua_state );
-
-    static int find_iterator( lua_State* lua_state );
-    static void push_recursive_directory_iterator( lua_State* lua_state, const std::filesystem::recursive_directory_iterator& iterator );
-    static std::filesystem::recursive_directory_iterator* to_recursive_directory_iterator( lua_State* lua_state, int index );
-    static int recursive_directory_iterator_gc( lua_State* lua_state );
+    static int directory_reader_iterator( lua_State* lua_state );
+    static void push_directory_reader( lua_State* lua_state, const std::filesystem::path& path, bool recursive );
+    static DirectoryReader* to_directory_reader( lua_State* lua_state, int index );
+    static int directory_reader_gc( lua_State* lua_state );
 
+    static void strings( lua_State* lua_state, int index, std::vector<std::string>* values );
     static std::filesystem::path absolute( lua_State* lua_state, int index );
 }; 
 
@@ -11,6 +11,7 @@
 #include <forge/Graph.hpp>
 #include <forge/Toolset.hpp>
 #include <forge/Target.hpp>
+#include <forge/DirectoryMirror.hpp>
 #include <luaxx/luaxx.hpp>
 #include <assert/assert.hpp>
 #include <lua.hpp>
@@ -44,12 +45,15 @@ void LuaGraph::create( Forge* forge, lua_State* lua_state )
         { "add_toolset", &LuaGraph::add_toolset },
         { "all_toolsets", &LuaGraph::all_toolsets },
         { "find_target", &LuaGraph::find_target },
+        { "affected_targets", &LuaGraph::affected_targets },
+        { "shard_targets", &LuaGraph::shard_targets },
         { "anonymous", &LuaGraph::anonymous },
         { "current_buildfile", &LuaGraph::current_buildfile },
         { "working_directory", &LuaGraph::working_directory },
         { "buildfile", &LuaGraph::buildfile },
         { "preorder", &LuaGraph::preorder },
         { "postorder", &LuaGraph::postorder },
+        { "clean_targets", &LuaGraph::clean_targets },
         { "print_dependencies", &LuaGraph::print_dependencies },
         { "print_namespace", &LuaGraph::print_namespace },
         { "prune", &LuaGraph::prune },
@@ -57,6 +61,11 @@ void LuaGraph::create( Forge* forge, lua_State* lua_state )
         { "clear", &LuaGraph::clear },
         { "load_binary", &LuaGraph::load_binary },
         { "save_binary", &LuaGraph::save_binary },
+        { "merge_binary", &LuaGraph::merge_binary },
+        { "set_checkpoint_interval", &LuaGraph::set_checkpoint_interval },
+        { "add_mirror", &LuaGraph::add_mirror },
+        { "sync_mirror", &LuaGraph::sync_mirror },
+        { "clean_mirror", &LuaGraph::clean_mirror },
         { NULL, NULL }
     };
     lua_pushglobaltable( lua_state );
@@ -143,6 +152,62 @@ int LuaGraph::find_target( lua_State* lua_state )
     return 1;
 }
 
+int LuaGraph::affected_targets( lua_State* lua_state )
+{
+    const int FORGE = lua_upvalueindex( 1 );
+    const int FILENAMES = 1;
+    Forge* forge = (Forge*) lua_touserdata( lua_state, FORGE );
+    luaL_checktype( lua_state, FILENAMES, LUA_TTABLE );
+
+    vector<string> filenames;
+    int length = int( lua_rawlen(lua_state, FILENAMES) );
+    for ( int i = 1; i <= length; ++i )
+    {
+        lua_rawgeti( lua_state, FILENAMES, i );
+        const char* filename = luaL_checkstring( lua_state, -1 );
+        filenames.push_back( forge->absolute(string(filename)).generic_string() );
+        lua_pop( lua_state, 1 );
+    }
+
+    vector<Target*> targets = forge->graph()->affected_targets( filenames );
+    push_targets( lua_state, forge, targets );
+    return 1;
+}
+
+int LuaGraph::shard_targets( lua_State* lua_state )
+{
+    const int FORGE = lua_upvalueindex( 1 );
+    const int TARGET = 1;
+    const int SHARD = 2;
+    const int SHARDS = 3;
+    Forge* forge = (Forge*) lua_touserdata( lua_state, FORGE );
+    Target* target = (Target*) luaxx_check( lua_state, TARGET, TARGET_TYPE );
+    int shards = int( luaL_checkinteger(lua_state, SHARDS) );
+    luaL_argcheck( lua_state, shards >= 1, SHARDS, "expected shards >= 1" );
+    int shard = int( luaL_checkinteger(lua_state, SHARD) );
+    luaL_argcheck( lua_state, shard >= 1 && shard <= shards, SHARD, "expected 1 <= shard <= shards" );
+    vector<Target*> targets = forge->graph()->shard_targets( target, shard - 1, shards );
+    push_targets( lua_state, forge, targets );
+    return 1;
+}
+
+void LuaGraph::push_targets( lua_State* lua_state, Forge* forge, const std::vector<Target*>& targets )
+{
+    SWEET_ASSERT( lua_state );
+    SWEET_ASSERT( forge );
+    lua_createtable( lua_state, int(targets.size()), 0 );
+    for ( size_t i = 0; i < targets.size(); ++i )
+    {
+        Target* target = targets[i];
+        if ( !target->referenced_by_script() )
+        {
+            forge->create_target_lua_binding( target );
+        }
+        luaxx_push( lua_state, target );
+        lua_rawseti( lua_state, -2, int(i + 1) );
+    }
+}
+
 int LuaGraph::anonymous( lua_State* lua_state )
 {
     const int FORGE = lua_upvalueindex( 1 );
@@ -212,15 +277,17 @@ int LuaGraph::preorder( lua_State* lua_state )
         return luaL_error( lua_state, "Preorder called from within preorder or postorder" );
     }
 
+    vector<Target*> targets;
+    bool scoped = to_targets( lua_state, TARGET, &targets );
     Target* target = nullptr;
-    if ( !lua_isnoneornil(lua_state, TARGET) )
+    if ( !scoped && !lua_isnoneornil(lua_state, TARGET) )
     {
         target = (Target*) luaxx_to( lua_state, TARGET, TARGET_TYPE );
     }
 
     lua_pushvalue( lua_state, FUNCTION );
     int function = luaL_ref( lua_state, LUA_REGISTRYINDEX );
-    int failures = forge->scheduler()->preorder( target, function );
+    int failures = scoped ? forge->scheduler()->preorder( targets, function ) : forge->scheduler()->preorder( target, function );
     lua_pushinteger( lua_state, failures );
     luaL_unref( lua_state, LUA_REGISTRYINDEX, function );
     return 1;
@@ -239,13 +306,15 @@ int LuaGraph::postorder( lua_State* lua_state )
         return luaL_error( lua_state, "Postorder called from within preorder or postorder" );
     }
 
+    vector<Target*> targets;
+    bool scoped = to_targets( lua_state, TARGET, &targets );
     Target* target = nullptr;
-    if ( !lua_isnoneornil(lua_state, TARGET) )
+    if ( !scoped && !lua_isnoneornil(lua_state, TARGET) )
     {
         target = (Target*) luaxx_to( lua_state, TARGET, TARGET_TYPE );
     }
 
-    int bind_failures = graph->bind( target );
+    int bind_failures = scoped ? graph->bind( targets ) : graph->bind( target );
     if ( bind_failures > 0 )
     {
         lua_pushinteger( lua_state, bind_failures );
@@ -254,12 +323,93 @@ int LuaGraph::postorder( lua_State* lua_state )
 
     lua_pushvalue( lua_state, FUNCTION );
     int function = luaL_ref( lua_state, LUA_REGISTRYINDEX );
-    int failures = forge->scheduler()->postorder( target, function );
+    int failures = scoped ? forge->scheduler()->postorder( targets, function ) : forge->scheduler()->postorder( target, function );
     lua_pushinteger( lua_state, failures );
     luaL_unref( lua_state, LUA_REGISTRYINDEX, function );
     return 1;
 }
 
+/**
+// Clean the Targets that a postorder pass from a Target would visit.
+//
+// ~~~lua
+// function clean_targets( target, visit )
+// ~~~
+//
+// Targets with a `clean` function are visited first by a postorder pass
+// that calls \e visit so that their custom clean runs while the Targets
+// that they depend on are still bound to their files.  Cleanable Targets
+// without a `clean` function are then cleaned in bulk without being
+// visited from Lua (see Graph::clean()).
+//
+// @return
+//  The number of failures from visiting Targets with `clean` functions plus
+//  the number of files that failed to be removed.
+*/
+int LuaGraph::clean_targets( lua_State* lua_state )
+{
+    const int FORGE = lua_upvalueindex( 1 );
+    const int TARGET = 1;
+    const int FUNCTION = 2;
+
+    Forge* forge = (Forge*) lua_touserdata( lua_state, FORGE );
+    Graph* graph = forge->graph();
+    if ( graph->traversal_in_progress() )
+    {
+        return luaL_error( lua_state, "Clean called from within preorder or postorder" );
+    }
+
+    Target* target = nullptr;
+    if ( !lua_isnoneornil(lua_state, TARGET) )
+    {
+        target = (Target*) luaxx_to( lua_state, TARGET, TARGET_TYPE );
+    }
+
+    vector<Target*> targets = graph->reachable_targets( target ? target : graph->root_target() );
+    vector<Target*> scripted_targets;
+    vector<Target*> cleanable_targets;
+    for ( vector<Target*>::const_iterator i = targets.begin(); i != targets.end(); ++i )
+    {
+        Target* target = *i;
+        if ( target->referenced_by_script() && target->working_directory() )
+        {
+            luaxx_push( lua_state, target );
+            lua_getfield( lua_state, -1, "clean" );
+            if ( lua_isfunction(lua_state, -1) )
+            {
+                scripted_targets.push_back( target );
+            }
+            else if ( target->cleanable() )
+            {
+                cleanable_targets.push_back( target );
+            }
+            lua_pop( lua_state, 2 );
+        }
+    }
+
+    int failures = 0;
+    if ( !scripted_targets.empty() )
+    {
+        failures = graph->bind( scripted_targets );
+        if ( failures == 0 )
+        {
+            lua_pushvalue( lua_state, FUNCTION );
+            int function = luaL_ref( lua_state, LUA_REGISTRYINDEX );
+            failures = forge->scheduler()->postorder( scripted_targets, function );
+            luaL_unref( lua_state, LUA_REGISTRYINDEX, function );
+        }
+    }
+
+    string error;
+    int remove_failures = graph->clean( cleanable_targets, forge->maximum_parallel_jobs(), &error );
+    if ( remove_failures > 0 )
+    {
+        forge->error( error.c_str() );
+    }
+    lua_pushinteger( lua_state, failures + remove_failures );
+    return 1;
+}
+
 int LuaGraph::print_dependencies( lua_State* lua_state )
 {
     const int FORGE = lua_upvalueindex( 1 );
@@ -311,18 +461,24 @@ int LuaGraph::load_binary( lua_State* lua_state )
 {
     const int FORGE = lua_upvalueindex( 1 );
     const int FILENAME = 1;
+    const int REUSE = 2;
     Forge* forge = (Forge*) lua_touserdata( lua_state, FORGE );
     Context* context = forge->context();
     const char* filename = luaL_checkstring( lua_state, FILENAME );
+    bool reuse = lua_toboolean( lua_state, REUSE ) != 0;
     string working_directory = context->working_directory()->path();
-    Target* cache_target = forge->graph()->load_binary( forge->absolute(string(filename)).string() );
+    string current_buildfile = context->current_buildfile() ? context->current_buildfile()->path() : string();
+    Graph* graph = forge->graph();
+    Target* cache_target = graph->load_binary( forge->absolute(string(filename)).string(), reuse );
     context->reset_directory( working_directory );
+    context->set_current_buildfile( !current_buildfile.empty() ? graph->target(current_buildfile) : nullptr );
     if ( cache_target )
     {
         forge->create_target_lua_binding( cache_target );
     }
     luaxx_push( lua_state, cache_target );
-    return 1;
+    lua_pushboolean( lua_state, graph->reused() ? 1 : 0 );
+    return 2;
 }
 
 int LuaGraph::save_binary( lua_State* lua_state )
@@ -332,3 +488,105 @@ int LuaGraph::save_binary( lua_State* lua_state )
     forge->graph()->save_binary();
     return 0;
 }
+
+int LuaGraph::merge_binary( lua_State* lua_state )
+{
+    const int FORGE = lua_upvalueindex( 1 );
+    const int FILENAME = 1;
+    Forge* forge = (Forge*) lua_touserdata( lua_state, FORGE );
+    const char* filename = luaL_checkstring( lua_state, FILENAME );
+    int merged = forge->graph()->merge_binary( forge->absolute(string(filename)).string() );
+    lua_pushinteger( lua_state, merged );
+    return 1;
+}
+
+int LuaGraph::set_checkpoint_interval( lua_State* lua_state )
+{
+    const int FORGE = lua_upvalueindex( 1 );
+    const int SECONDS = 1;
+    const int JOBS = 2;
+    Forge* forge = (Forge*) lua_touserdata( lua_state, FORGE );
+    int seconds = static_cast<int>( luaL_optinteger(lua_state, SECONDS, 0) );
+    int jobs = static_cast<int>( luaL_optinteger(lua_state, JOBS, 0) );
+    forge->graph()->set_checkpoint_interval( seconds, jobs );
+    return 0;
+}
+
+int LuaGraph::add_mirror( lua_State* lua_state )
+{
+    const int FORGE = lua_upvalueindex( 1 );
+    const int DESTINATION = 1;
+    const int SOURCE = 2;
+    Forge* forge = (Forge*) lua_touserdata( lua_state, FORGE );
+    string destination = forge->absolute( string(luaL_checkstring(lua_state, DESTINATION)) ).generic_string();
+    string source = forge->absolute( string(luaL_checkstring(lua_state, SOURCE)) ).generic_string();
+    Context* context = forge->context();
+    Target* buildfile = context ? context->current_buildfile() : nullptr;
+    forge->graph()->directory_mirror()->add_source( destination, source, buildfile ? buildfile->path() : string() );
+    return 0;
+}
+
+int LuaGraph::sync_mirror( lua_State* lua_state )
+{
+    const int FORGE = lua_upvalueindex( 1 );
+    const int DESTINATION = 1;
+    Forge* forge = (Forge*) lua_touserdata( lua_state, FORGE );
+    bool success = true;
+    {
+        string destination = forge->absolute( string(luaL_checkstring(lua_state, DESTINATION)) ).generic_string();
+        string error;
+        int threads = forge->maximum_parallel_jobs();
+        success = forge->graph()->directory_mirror()->sync( destination, forge->system(), threads, &error );
+        if ( !success )
+        {
+            lua_pushstring( lua_state, error.c_str() );
+        }
+    }
+    if ( !success )
+    {
+        return lua_error( lua_state );
+    }
+    return 0;
+}
+
+int LuaGraph::clean_mirror( lua_State* lua_state )
+{
+    const int FORGE = lua_upvalueindex( 1 );
+    const int DESTINATION = 1;
+    Forge* forge = (Forge*) lua_touserdata( lua_state, FORGE );
+    string destination = forge->absolute( string(luaL_checkstring(lua_state, DESTINATION)) ).generic_string();
+    forge->graph()->directory_mirror()->clean( destination );
+    return 0;
+}
+
+/**
+// Convert the array of Targets at \e position to a vector of Targets.
+//
+// Preorder and postorder passes are restricted to just the Targets in an
+// array passed in place of a single Target (see `affected_targets()`).
+//
+// @return
+//  True if the value at \e position is an array of Targets rather than a 
+//  single Target or nil otherwise false.
+*/
+bool LuaGraph::to_targets( lua_State* lua_state, int position, std::vector<Target*>* targets )
+{
+    SWEET_ASSERT( lua_state );
+    SWEET_ASSERT( targets );
+
+    if ( !lua_istable(lua_state, position) || luaxx_to(lua_state, position, TARGET_TYPE) )
+    {
+        return false;
+    }
+
+    int length = int( lua_rawlen(lua_state, position) );
+    for ( int i = 1; i <= length; ++i )
+    {
+        lua_rawgeti( lua_state, position, i );
+        Target* target = (Target*) luaxx_to( lua_state, lua_gettop(lua_state), TARGET_TYPE );
+        luaL_argcheck( lua_state, target != nullptr, position, "expected array of targets" );
+        targets->push_back( target );
+        lua_pop( lua_state, 1 );
+    }
+    return true;
+}
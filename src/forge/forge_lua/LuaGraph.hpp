@@ -1,6 +1,8 @@
 #ifndef FORGE_LUAGRAPH_HPP_INCLUDED
 #define FORGE_LUAGRAPH_HPP_INCLUDED
 
+#include <vector>
+
 struct lua_State;
 
 namespace sweet
@@ -25,12 +27,15 @@ private:
     static int all_toolsets_iterator( lua_State* lua_state );
     static int all_toolsets( lua_State* lua_state );
     static int find_target( lua_State* lua_state );
+    static int affected_targets( lua_State* lua_state );
+    static int shard_targets( lua_State* lua_state );
     static int anonymous( lua_State* lua_state );
     static int current_buildfile( lua_State* lua_state );
     static int working_directory( lua_State* lua_state );
     static int buildfile( lua_State* lua_state );
     static int preorder( lua_State* lua_state );
     static int postorder( lua_State* lua_state );
+    static int clean_targets( lua_State* lua_state );
     static int print_dependencies( lua_State* lua_state );
     static int print_namespace( lua_State* lua_state );
     static int wait( lua_State* lua_state );
@@ -38,6 +43,13 @@ private:
     static int clear( lua_State* lua_state );
     static int load_binary( lua_State* lua_state );
     static int save_binary( lua_State* lua_state );
+    static int merge_binary( lua_State* lua_state );
+    static int set_checkpoint_interval( lua_State* lua_state );
+    static int add_mirror( lua_State* lua_state );
+    static int sync_mirror( lua_State* lua_state );
+    static int clean_mirror( lua_State* lua_state );
+    static bool to_targets( lua_State* lua_state, int position, std::vector<Target*>* targets );
+    static void push_targets( lua_State* lua_state, Forge* forge, const std::vector<Target*>& targets );
 };
 
 }
@@ -0,0 +1,337 @@
+//
+// LuaStatePool.cpp
+// Copyright (c) Charles Baker. All rights reserved.
+//
+
+#include "LuaStatePool.hpp"
+#include <assert/assert.hpp>
+#include <lua.hpp>
+#include <string.h>
+
+using std::string;
+using std::vector;
+using namespace sweet;
+using namespace sweet::forge;
+
+static const int MAXIMUM_TABLE_DEPTH = 64;
+
+LuaStatePool::LuaStatePool()
+: mutex_()
+, free_states_()
+{
+}
+
+/**
+// Destructor.
+//
+// Closes the states in the pool.  No states may be calling functions, i.e.
+// the Executor's worker threads must already have stopped.
+*/
+LuaStatePool::~LuaStatePool()
+{
+    while ( !free_states_.empty() )
+    {
+        lua_close( free_states_.back() );
+        free_states_.pop_back();
+    }
+}
+
+/**
+// Call a function exported by a Lua module in a state from this pool.
+//
+// This function is thread safe and is called from the Executor's worker
+// threads.
+//
+// @param package_path
+//  The value to set `package.path` to before requiring \e module; usually
+//  the value of `package.path` in the calling state.
+//
+// @param module
+//  The name of the module to `require()`.
+//
+// @param function
+//  The name of the function in the table returned by the module to call.
+//
+// @param arguments
+//  The arguments to pass to the function as marshalled by
+//  LuaStatePool::marshal().
+//
+// @param results
+//  Set to the marshalled values returned by the function on success or to
+//  the error message if the call fails.
+//
+// @return
+//  True if the function was called successfully otherwise false.
+*/
+bool LuaStatePool::call( const std::string& package_path, const std::string& module, const std::string& function, const std::string& arguments, std::string* results )
+{
+    SWEET_ASSERT( results );
+
+    lua_State* lua_state = acquire();
+    if ( !lua_state )
+    {
+        *results = "Creating a Lua state to call '" + module + "." + function + "' failed";
+        return false;
+    }
+
+    results->clear();
+    lua_pushcfunction( lua_state, &LuaStatePool::call_function );
+    lua_pushlightuserdata( lua_state, const_cast<string*>(&package_path) );
+    lua_pushlightuserdata( lua_state, const_cast<string*>(&module) );
+    lua_pushlightuserdata( lua_state, const_cast<string*>(&function) );
+    lua_pushlightuserdata( lua_state, const_cast<string*>(&arguments) );
+    lua_pushlightuserdata( lua_state, results );
+    int result = lua_pcall( lua_state, 5, 0, 0 );
+    if ( result != LUA_OK )
+    {
+        const char* message = lua_tostring( lua_state, -1 );
+        *results = message ? message : "Calling '" + module + "." + function + "' failed";
+        lua_settop( lua_state, 0 );
+
+        // Don't reuse a state that has run out of memory.
+        if ( result == LUA_ERRMEM )
+        {
+            lua_close( lua_state );
+            return false;
+        }
+    }
+
+    release( lua_state );
+    return result == LUA_OK;
+}
+
+/**
+// Marshal the values from \e first to \e last on the stack of \e lua_state
+// into a string.
+//
+// Raises a Lua error if any of the values can't be marshalled; only nil,
+// booleans, numbers, strings, and tables of those can be passed between
+// states.
+*/
+void LuaStatePool::marshal( lua_State* lua_state, int first, int last, std::string* values )
+{
+    SWEET_ASSERT( lua_state );
+    SWEET_ASSERT( values );
+    for ( int index = first; index <= last; ++index )
+    {
+        marshal_value( lua_state, index, 0, values );
+    }
+}
+
+/**
+// Push the values marshalled into \e values by LuaStatePool::marshal() onto
+// the stack of \e lua_state.
+//
+// @return
+//  The number of values pushed.
+*/
+int LuaStatePool::unmarshal( lua_State* lua_state, const std::string& values )
+{
+    SWEET_ASSERT( lua_state );
+    int count = 0;
+    size_t position = 0;
+    while ( position < values.size() )
+    {
+        luaL_checkstack( lua_state, 1, "too many values to unmarshal" );
+        position = unmarshal_value( lua_state, values, position );
+        ++count;
+    }
+    return count;
+}
+
+lua_State* LuaStatePool::acquire()
+{
+    {
+        std::unique_lock<std::mutex> lock( mutex_ );
+        if ( !free_states_.empty() )
+        {
+            lua_State* lua_state = free_states_.back();
+            free_states_.pop_back();
+            return lua_state;
+        }
+    }
+
+    lua_State* lua_state = luaL_newstate();
+    if ( lua_state )
+    {
+        luaL_openlibs( lua_state );
+    }
+    return lua_state;
+}
+
+void LuaStatePool::release( lua_State* lua_state )
+{
+    SWEET_ASSERT( lua_state );
+    std::unique_lock<std::mutex> lock( mutex_ );
+    free_states_.push_back( lua_state );
+}
+
+int LuaStatePool::call_function( lua_State* lua_state )
+{
+    const int PACKAGE_PATH = 1;
+    const int MODULE = 2;
+    const int FUNCTION = 3;
+    const int ARGUMENTS = 4;
+    const int RESULTS = 5;
+    const string* package_path = (const string*) lua_touserdata( lua_state, PACKAGE_PATH );
+    const string* module = (const string*) lua_touserdata( lua_state, MODULE );
+    const string* function = (const string*) lua_touserdata( lua_state, FUNCTION );
+    const string* arguments = (const string*) lua_touserdata( lua_state, ARGUMENTS );
+    string* results = (string*) lua_touserdata( lua_state, RESULTS );
+
+    lua_getglobal( lua_state, "package" );
+    lua_pushlstring( lua_state, package_path->c_str(), package_path->size() );
+    lua_setfield( lua_state, -2, "path" );
+    lua_pop( lua_state, 1 );
+
+    lua_getglobal( lua_state, "require" );
+    lua_pushlstring( lua_state, module->c_str(), module->size() );
+    lua_call( lua_state, 1, 1 );
+    if ( !lua_istable(lua_state, -1) )
+    {
+        return luaL_error( lua_state, "Module '%s' didn't return a table", module->c_str() );
+    }
+
+    lua_getfield( lua_state, -1, function->c_str() );
+    if ( !lua_isfunction(lua_state, -1) )
+    {
+        return luaL_error( lua_state, "Module '%s' has no function '%s'", module->c_str(), function->c_str() );
+    }
+
+    int base = lua_gettop( lua_state );
+    int count = unmarshal( lua_state, *arguments );
+    lua_call( lua_state, count, LUA_MULTRET );
+    marshal( lua_state, base, lua_gettop(lua_state), results );
+    return 0;
+}
+
+void LuaStatePool::marshal_value( lua_State* lua_state, int index, int depth, std::string* values )
+{
+    index = lua_absindex( lua_state, index );
+    switch ( lua_type(lua_state, index) )
+    {
+        case LUA_TNIL:
+            values->push_back( 'n' );
+            break;
+
+        case LUA_TBOOLEAN:
+            values->push_back( lua_toboolean(lua_state, index) ? 't' : 'f' );
+            break;
+
+        case LUA_TNUMBER:
+            if ( lua_isinteger(lua_state, index) )
+            {
+                lua_Integer value = lua_tointeger( lua_state, index );
+                values->push_back( 'i' );
+                values->append( reinterpret_cast<const char*>(&value), sizeof(value) );
+            }
+            else
+            {
+                lua_Number value = lua_tonumber( lua_state, index );
+                values->push_back( 'd' );
+                values->append( reinterpret_cast<const char*>(&value), sizeof(value) );
+            }
+            break;
+
+        case LUA_TSTRING:
+        {
+            size_t length = 0;
+            const char* value = lua_tolstring( lua_state, index, &length );
+            values->push_back( 's' );
+            values->append( reinterpret_cast<const char*>(&length), sizeof(length) );
+            values->append( value, length );
+            break;
+        }
+
+        case LUA_TTABLE:
+        {
+            if ( depth >= MAXIMUM_TABLE_DEPTH )
+            {
+                luaL_error( lua_state, "Tables nested too deeply, or cyclic, to pass between Lua states" );
+            }
+            luaL_checkstack( lua_state, 2, "too many values to marshal" );
+            values->push_back( '{' );
+            lua_pushnil( lua_state );
+            while ( lua_next(lua_state, index) )
+            {
+                marshal_value( lua_state, -2, depth + 1, values );
+                marshal_value( lua_state, -1, depth + 1, values );
+                lua_pop( lua_state, 1 );
+            }
+            values->push_back( '}' );
+            break;
+        }
+
+        default:
+            luaL_error( lua_state, "Unable to pass a %s value between Lua states", luaL_typename(lua_state, index) );
+            break;
+    }
+}
+
+size_t LuaStatePool::unmarshal_value( lua_State* lua_state, const std::string& values, size_t position )
+{
+    SWEET_ASSERT( position < values.size() );
+    const char* data = values.c_str();
+    char type = data[position];
+    ++position;
+    switch ( type )
+    {
+        case 'n':
+            lua_pushnil( lua_state );
+            break;
+
+        case 't':
+        case 'f':
+            lua_pushboolean( lua_state, type == 't' );
+            break;
+
+        case 'i':
+        {
+            lua_Integer value = 0;
+            memcpy( &value, data + position, sizeof(value) );
+            lua_pushinteger( lua_state, value );
+            position += sizeof(value);
+            break;
+        }
+
+        case 'd':
+        {
+            lua_Number value = 0.0;
+            memcpy( &value, data + position, sizeof(value) );
+            lua_pushnumber( lua_state, value );
+            position += sizeof(value);
+            break;
+        }
+
+        case 's':
+        {
+            size_t length = 0;
+            memcpy( &length, data + position, sizeof(length) );
+            position += sizeof(length);
+            lua_pushlstring( lua_state, data + position, length );
+            position += length;
+            break;
+        }
+
+        case '{':
+        {
+            luaL_checkstack( lua_state, 3, "too many values to unmarshal" );
+            lua_newtable( lua_state );
+            while ( data[position] != '}' )
+            {
+                position = unmarshal_value( lua_state, values, position );
+                position = unmarshal_value( lua_state, values, position );
+                lua_rawset( lua_state, -3 );
+            }
+            ++position;
+            break;
+        }
+
+        default:
+            SWEET_ASSERT( false );
+            lua_pushnil( lua_state );
+            position = values.size();
+            break;
+    }
+    return position;
+}
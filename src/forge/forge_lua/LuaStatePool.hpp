@@ -0,0 +1,50 @@
+#ifndef FORGE_LUASTATEPOOL_HPP_INCLUDED
+#define FORGE_LUASTATEPOOL_HPP_INCLUDED
+
+#include <vector>
+#include <string>
+#include <mutex>
+
+struct lua_State;
+
+namespace sweet
+{
+
+namespace forge
+{
+
+/**
+// A pool of separate Lua states that call pure Lua functions on the
+// Executor's worker threads (see `spawn_lua()`).
+//
+// The states in the pool only have the standard Lua libraries; they can't
+// access the Forge or its Graph.  Arguments and results are passed between
+// states marshalled into strings and so are limited to nil, booleans,
+// numbers, strings, and tables of those.  States are reused between calls
+// so modules are only loaded once per state.
+*/
+class LuaStatePool
+{
+    std::mutex mutex_; ///< The mutex that ensures exclusive access to the free states.
+    std::vector<lua_State*> free_states_; ///< The states that aren't currently calling a function.
+
+public:
+    LuaStatePool();
+    ~LuaStatePool();
+    bool call( const std::string& package_path, const std::string& module, const std::string& function, const std::string& arguments, std::string* results );
+    static void marshal( lua_State* lua_state, int first, int last, std::string* values );
+    static int unmarshal( lua_State* lua_state, const std::string& values );
+
+private:
+    lua_State* acquire();
+    void release( lua_State* lua_state );
+    static int call_function( lua_State* lua_state );
+    static void marshal_value( lua_State* lua_state, int index, int depth, std::string* values );
+    static size_t unmarshal_value( lua_State* lua_state, const std::string& values, size_t position );
+};
+
+}
+
+}
+
+#endif
@@ -4,8 +4,10 @@
 //
 
 #include "LuaSystem.hpp"
+#include "LuaStatePool.hpp"
 #include "types.hpp"
 #include <forge/Forge.hpp>
+#include <forge/BytecodeCache.hpp>
 #include <forge/System.hpp>
 #include <forge/Filter.hpp>
 #include <forge/Arguments.hpp>
@@ -43,8 +45,13 @@ void LuaSystem::create( Forge* forge, lua_State* lua_state )
     {
         { "set_forge_hooks_library", &LuaSystem::set_forge_hooks_library },
         { "forge_hooks_library", &LuaSystem::forge_hooks_library },
+        { "set_bytecode_directory", &LuaSystem::set_bytecode_directory },
+        { "bytecode_directory", &LuaSystem::bytecode_directory },
+        { "set_failure_limit", &LuaSystem::set_failure_limit },
+        { "failure_limit", &LuaSystem::failure_limit },
         { "hash", &LuaSystem::hash },
         { "execute", &LuaSystem::execute },
+        { "spawn_lua", &LuaSystem::spawn_lua },
         { "print", &LuaSystem::print },
         { "getenv", &LuaSystem::getenv },
         { "sleep", &LuaSystem::sleep },
@@ -56,6 +63,15 @@ void LuaSystem::create( Forge* forge, lua_State* lua_state )
     lua_pushlightuserdata( lua_state, forge );
     luaL_setfuncs( lua_state, functions, 1 );
     lua_pop( lua_state, 1 );
+
+    // Replace the default Lua searcher, `package.searchers[2]`, with one that
+    // loads modules through the bytecode cache.
+    lua_getglobal( lua_state, "package" );
+    lua_getfield( lua_state, -1, "searchers" );
+    lua_pushlightuserdata( lua_state, forge );
+    lua_pushcclosure( lua_state, &LuaSystem::search_cached_bytecode, 1 );
+    lua_rawseti( lua_state, -2, 2 );
+    lua_pop( lua_state, 2 );
 }
 
 void LuaSystem::destroy()
@@ -81,6 +97,78 @@ int LuaSystem::forge_hooks_library( lua_State* lua_state )
     return 1;
 }
 
+int LuaSystem::set_bytecode_directory( lua_State* lua_state )
+{
+    const int FORGE = lua_upvalueindex( 1 );
+    const int BYTECODE_DIRECTORY = 1;
+    Forge* forge = (Forge*) lua_touserdata( lua_state, FORGE );
+    const char* bytecode_directory = luaL_optstring( lua_state, BYTECODE_DIRECTORY, "" );
+    forge->bytecode_cache()->set_directory( std::filesystem::path(bytecode_directory) );
+    return 0;
+}
+
+int LuaSystem::bytecode_directory( lua_State* lua_state )
+{
+    const int FORGE = lua_upvalueindex( 1 );
+    Forge* forge = (Forge*) lua_touserdata( lua_state, FORGE );
+    const string& bytecode_directory = forge->bytecode_cache()->directory().generic_string();
+    lua_pushlstring( lua_state, bytecode_directory.c_str(), bytecode_directory.size() );
+    return 1;
+}
+
+int LuaSystem::set_failure_limit( lua_State* lua_state )
+{
+    const int FORGE = lua_upvalueindex( 1 );
+    const int FAILURES = 1;
+    Forge* forge = (Forge*) lua_touserdata( lua_state, FORGE );
+    int failures = static_cast<int>( luaL_optinteger(lua_state, FAILURES, 0) );
+    forge->set_keep_going( failures );
+    return 0;
+}
+
+int LuaSystem::failure_limit( lua_State* lua_state )
+{
+    const int FORGE = lua_upvalueindex( 1 );
+    Forge* forge = (Forge*) lua_touserdata( lua_state, FORGE );
+    lua_pushinteger( lua_state, forge->keep_going() );
+    return 1;
+}
+
+/**
+// Search `package.path` for a Lua module and load it through the bytecode
+// cache.
+//
+// Behaves as the default Lua searcher: returns the loader and the name of the
+// file that it was loaded from if the module is found, a message listing the
+// files tried if the module isn't found, and raises an error if the module
+// is found but fails to load.
+*/
+int LuaSystem::search_cached_bytecode( lua_State* lua_state )
+{
+    const int FORGE = lua_upvalueindex( 1 );
+    const int NAME = 1;
+    Forge* forge = (Forge*) lua_touserdata( lua_state, FORGE );
+    const char* name = luaL_checkstring( lua_state, NAME );
+
+    lua_getglobal( lua_state, "package" );
+    lua_getfield( lua_state, -1, "searchpath" );
+    lua_pushstring( lua_state, name );
+    lua_getfield( lua_state, -3, "path" );
+    lua_call( lua_state, 2, 2 );
+    if ( lua_isnil(lua_state, -2) )
+    {
+        return 1;
+    }
+
+    const char* filename = lua_tostring( lua_state, -2 );
+    if ( forge->bytecode_cache()->load(lua_state, filename) != LUA_OK )
+    {
+        return luaL_error( lua_state, "error loading module '%s' from file '%s':\n\t%s", name, filename, lua_tostring(lua_state, -1) );
+    }
+    lua_pushstring( lua_state, filename );
+    return 2;
+}
+
 int LuaSystem::hash( lua_State* lua_state )
 {
     const int TABLE = 1;
@@ -218,6 +306,59 @@ int LuaSystem::execute( lua_State* lua_state )
     }
 }
 
+int LuaSystem::spawn_lua( lua_State* lua_state )
+{
+    const int FORGE = lua_upvalueindex( 1 );
+    const int MODULE = 1;
+    const int FUNCTION = 2;
+    const int ARGUMENTS = 3;
+    Forge* forge = (Forge*) lua_touserdata( lua_state, FORGE );
+
+    size_t module_length = 0;
+    const char* module = luaL_checklstring( lua_state, MODULE, &module_length );
+    luaL_argcheck( lua_state, module_length > 0, MODULE, "module must not be empty" );
+    size_t function_length = 0;
+    const char* function = luaL_checklstring( lua_state, FUNCTION, &function_length );
+    luaL_argcheck( lua_state, function_length > 0, FUNCTION, "function must not be empty" );
+
+    // Marshal the arguments before reading `package.path` so that the values
+    // pushed to read it aren't marshalled too.
+    string arguments;
+    int top = lua_gettop( lua_state );
+    LuaStatePool::marshal( lua_state, ARGUMENTS, top, &arguments );
+
+    lua_getglobal( lua_state, "package" );
+    lua_getfield( lua_state, -1, "path" );
+    size_t package_path_length = 0;
+    const char* package_path = lua_tolstring( lua_state, -1, &package_path_length );
+    string package_path_string( package_path ? package_path : "", package_path ? package_path_length : 0 );
+    lua_pop( lua_state, 2 );
+
+    forge->scheduler()->spawn_lua(
+        package_path_string,
+        string( module, module_length ),
+        string( function, function_length ),
+        arguments,
+        forge->context()
+    );
+    return lua_yieldk( lua_state, 0, top, &LuaSystem::spawn_lua_continue );
+}
+
+/**
+// Continue `spawn_lua()` when its coroutine is resumed by
+// Scheduler::spawn_lua_finished() with true and the values returned by the
+// called function or false and an error message.
+*/
+int LuaSystem::spawn_lua_continue( lua_State* lua_state, int /*status*/, lua_KContext context )
+{
+    const int SUCCESS = int(context) + 1;
+    if ( !lua_toboolean(lua_state, SUCCESS) )
+    {
+        return lua_error( lua_state );
+    }
+    return lua_gettop( lua_state ) - SUCCESS;
+}
+
 int LuaSystem::print( lua_State* lua_state )
 {
     const int FORGE = lua_upvalueindex( 1 );
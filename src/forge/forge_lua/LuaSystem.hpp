@@ -23,8 +23,15 @@ public:
 private:
     static int set_forge_hooks_library( lua_State* lua_state );
     static int forge_hooks_library( lua_State* lua_state );
+    static int set_bytecode_directory( lua_State* lua_state );
+    static int bytecode_directory( lua_State* lua_state );
+    static int set_failure_limit( lua_State* lua_state );
+    static int failure_limit( lua_State* lua_state );
+    static int search_cached_bytecode( lua_State* lua_state );
     static int hash( lua_State* lua_state );
     static int execute( lua_State* lua_state );
+    static int spawn_lua( lua_State* lua_state );
+    static int spawn_lua_continue( lua_State* lua_state, int status, lua_KContext context );
     static int print( lua_State* lua_state );
     static int getenv( lua_State* lua_state );
     static int sleep( lua_State* lua_state );
@@ -7,14 +7,17 @@
 #include "LuaGraph.hpp"
 #include "types.hpp"
 #include <forge/Target.hpp>
+#include <forge/DependencyFilter.hpp>
 #include <forge/Rule.hpp>
 #include <forge/Context.hpp>
 #include <forge/Forge.hpp>
 #include <forge/Graph.hpp>
+#include <forge/Scheduler.hpp>
 #include <luaxx/luaxx.hpp>
 #include <assert/assert.hpp>
 #include <lua.hpp>
 #include <algorithm>
+#include <string.h>
 
 using std::min;
 using std::max;
@@ -27,6 +30,20 @@ using namespace sweet::forge;
 static const char* STRING_VECTOR_CONST_ITERATOR_METATABLE = "forge.vector<string>::const_iterator";
 const char* LuaTarget::TARGET_METATABLE = "forge.Target";
 
+/**
+// Record the buildfile currently being loaded, if any, as having modified 
+// \e target (see Target::add_buildfile()).
+*/
+static void add_current_buildfile( Target* target )
+{
+    SWEET_ASSERT( target );
+    Context* context = target->graph()->forge()->scheduler()->context();
+    if ( context )
+    {
+        target->add_buildfile( context->current_buildfile() );
+    }
+}
+
 LuaTarget::LuaTarget()
 : lua_state_( nullptr )
 {
@@ -57,6 +74,8 @@ void LuaTarget::create( lua_State* lua_state, Forge* forge )
         { "cleanable", &LuaTarget::cleanable },
         { "set_built", &LuaTarget::set_built },
         { "built", &LuaTarget::built },
+        { "set_built_inputs", &LuaTarget::set_built_inputs },
+        { "built_inputs", &LuaTarget::built_inputs },
         { "timestamp", &LuaTarget::timestamp },
         { "last_write_time", &LuaTarget::last_write_time },
         { "outdated", &LuaTarget::outdated },
@@ -73,6 +92,9 @@ void LuaTarget::create( lua_State* lua_state, Forge* forge )
         { "clear_implicit_dependencies", &LuaTarget::clear_implicit_dependencies },
         { "add_ordering_dependency", &LuaTarget::add_ordering_dependency },
         { "add_passive_dependency", &LuaTarget::add_passive_dependency },
+        { "structural_hash", &LuaTarget::structural_hash },
+        { "prepared", &LuaTarget::prepared },
+        { "set_prepared", &LuaTarget::set_prepared },
         { nullptr, nullptr }
     };
     luaxx_push( lua_state_, this );
@@ -87,6 +109,7 @@ void LuaTarget::create( lua_State* lua_state, Forge* forge )
         { "dependencies", &LuaTarget::explicit_dependencies },
         { "ordering_dependency", &LuaTarget::ordering_dependency },
         { "all_dependencies", &LuaTarget::all_dependencies },
+        { "transitive_dependencies", &LuaTarget::transitive_dependencies },
         { nullptr, nullptr }
     };
     luaxx_push( lua_state_, this );
@@ -311,6 +334,35 @@ int LuaTarget::built( lua_State* lua_state )
     return 0;
 }
 
+int LuaTarget::set_built_inputs( lua_State* lua_state )
+{
+    const int TARGET = 1;
+    const int BUILT_INPUTS = 2;
+    Target* target = (Target*) luaxx_to( lua_state, TARGET, TARGET_TYPE );
+    luaL_argcheck( lua_state, target != nullptr, TARGET, "nil target" );
+    if ( target )
+    {
+        size_t length = 0;
+        const char* built_inputs = luaL_checklstring( lua_state, BUILT_INPUTS, &length );
+        target->set_built_inputs( string(built_inputs, length) );
+    }
+    return 0;
+}
+
+int LuaTarget::built_inputs( lua_State* lua_state )
+{
+    const int TARGET = 1;
+    Target* target = (Target*) luaxx_to( lua_state, TARGET, TARGET_TYPE );
+    luaL_argcheck( lua_state, target != nullptr, TARGET, "nil target" );
+    if ( target )
+    {
+        const string& built_inputs = target->built_inputs();
+        lua_pushlstring( lua_state, built_inputs.c_str(), built_inputs.length() );
+        return 1;
+    }
+    return 0;
+}
+
 int LuaTarget::timestamp( lua_State* lua_state )
 {
     const int TARGET = 1;
@@ -538,6 +590,10 @@ int LuaTarget::add_explicit_dependency( lua_State* lua_state )
     if ( target )
     {
         Target* dependency = (Target*) luaxx_to( lua_state, DEPENDENCY, TARGET_TYPE );
+        if ( dependency && !target->is_explicit_dependency(dependency) )
+        {
+            add_current_buildfile( target );
+        }
         target->add_explicit_dependency( dependency );
     }
     return 0;
@@ -593,6 +649,10 @@ int LuaTarget::add_ordering_dependency( lua_State* lua_state )
     if ( target )
     {
         Target* dependency = (Target*) luaxx_to( lua_state, DEPENDENCY, TARGET_TYPE );
+        if ( dependency && !target->is_ordering_dependency(dependency) )
+        {
+            add_current_buildfile( target );
+        }
         target->add_ordering_dependency( dependency );
     }
     return 0;
@@ -607,6 +667,10 @@ int LuaTarget::add_passive_dependency( lua_State* lua_state )
     if ( target )
     {
         Target* dependency = (Target*) luaxx_to( lua_state, DEPENDENCY, TARGET_TYPE );
+        if ( dependency && !target->is_passive_dependency(dependency) )
+        {
+            add_current_buildfile( target );
+        }
         target->add_passive_dependency( dependency );
     }
     return 0;
@@ -667,6 +731,211 @@ int LuaTarget::all_dependencies( lua_State* lua_state )
     return 3;
 }
 
+/**
+// Get the dependency kinds named by the string at \e index.
+*/
+static int dependency_kinds( lua_State* lua_state, int index )
+{
+    static const char* names [] = { "explicit", "implicit", "ordering", "passive", "all", nullptr };
+    static const int kinds [] =
+    {
+        DependencyFilter::KIND_EXPLICIT,
+        DependencyFilter::KIND_IMPLICIT,
+        DependencyFilter::KIND_ORDERING,
+        DependencyFilter::KIND_PASSIVE,
+        DependencyFilter::KIND_ALL
+    };
+    const char* name = lua_tostring( lua_state, index );
+    for ( int i = 0; name && names[i]; ++i )
+    {
+        if ( strcmp(name, names[i]) == 0 )
+        {
+            return kinds[i];
+        }
+    }
+    return luaL_error( lua_state, "Unknown dependency kind '%s'", name ? name : luaL_typename(lua_state, index) );
+}
+
+/**
+// Walk the transitive dependencies of a target.
+//
+// The filter table selects the dependencies yielded and recursed into (see
+// DependencyFilter).  Without a filter explicit dependencies with filenames
+// are yielded and those without filenames are recursed into.
+//
+// ~~~lua
+// function Target.transitive_dependencies( target, filter )
+// ~~~
+//
+// @return
+//  An array of the yielded dependencies in the order returned by
+//  Graph::transitive_dependencies().
+*/
+int LuaTarget::transitive_dependencies( lua_State* lua_state )
+{
+    const int TARGET = 1;
+    const int FILTER = 2;
+    Target* target = (Target*) luaxx_to( lua_state, TARGET, TARGET_TYPE );
+    luaL_argcheck( lua_state, target != nullptr, TARGET, "expected target table" );
+
+    int kinds = DependencyFilter::KIND_EXPLICIT;
+    bool filename = true;
+    bool recurse_yielded = false;
+    bool recurse_unyielded = true;
+    bool recurse_unruled = false;
+    int rules = 0;
+    if ( !lua_isnoneornil(lua_state, FILTER) )
+    {
+        luaL_argcheck( lua_state, lua_istable(lua_state, FILTER), FILTER, "expected filter table" );
+        lua_getfield( lua_state, FILTER, "dependencies" );
+        if ( lua_istable(lua_state, -1) )
+        {
+            kinds = 0;
+            for ( int i = 1; lua_rawgeti(lua_state, -1, i) != LUA_TNIL; ++i )
+            {
+                kinds |= dependency_kinds( lua_state, -1 );
+                lua_pop( lua_state, 1 );
+            }
+            lua_pop( lua_state, 1 );
+        }
+        else if ( !lua_isnil(lua_state, -1) )
+        {
+            kinds = dependency_kinds( lua_state, -1 );
+        }
+        lua_pop( lua_state, 1 );
+
+        lua_getfield( lua_state, FILTER, "filename" );
+        filename = lua_toboolean( lua_state, -1 ) != 0;
+        lua_getfield( lua_state, FILTER, "recurse_yielded" );
+        recurse_yielded = lua_toboolean( lua_state, -1 ) != 0;
+        lua_getfield( lua_state, FILTER, "recurse_unyielded" );
+        recurse_unyielded = lua_toboolean( lua_state, -1 ) != 0;
+        lua_getfield( lua_state, FILTER, "recurse_unruled" );
+        recurse_unruled = lua_toboolean( lua_state, -1 ) != 0;
+        lua_pop( lua_state, 4 );
+
+        // Check the rules before they're added to the filter so that errors
+        // raised here don't leak it.
+        lua_getfield( lua_state, FILTER, "rules" );
+        if ( !lua_isnil(lua_state, -1) )
+        {
+            luaL_argcheck( lua_state, lua_istable(lua_state, -1), FILTER, "expected rules table" );
+            while ( lua_rawgeti(lua_state, -1, rules + 1) != LUA_TNIL )
+            {
+                luaL_argcheck( lua_state, luaxx_to(lua_state, -1, RULE_TYPE) != nullptr, FILTER, "expected rule in rules" );
+                lua_pop( lua_state, 1 );
+                ++rules;
+            }
+            lua_pop( lua_state, 1 );
+        }
+    }
+
+    vector<Target*> dependencies;
+    {
+        DependencyFilter filter;
+        filter.set_kinds( kinds );
+        filter.set_filename( filename );
+        filter.set_recurse( recurse_yielded, recurse_unyielded, recurse_unruled );
+        for ( int i = 1; i <= rules; ++i )
+        {
+            lua_rawgeti( lua_state, -1, i );
+            filter.add_rule( (Rule*) luaxx_to(lua_state, -1, RULE_TYPE) );
+            lua_pop( lua_state, 1 );
+        }
+        dependencies = target->graph()->transitive_dependencies( target, filter );
+    }
+
+    LuaTarget* lua_target = reinterpret_cast<LuaTarget*>( lua_touserdata(lua_state, lua_upvalueindex(1)) );
+    SWEET_ASSERT( lua_target );
+    lua_createtable( lua_state, int(dependencies.size()), 0 );
+    for ( int i = 0; i < int(dependencies.size()); ++i )
+    {
+        Target* dependency = dependencies[i];
+        if ( !dependency->referenced_by_script() )
+        {
+            lua_target->create_target( dependency );
+        }
+        luaxx_push( lua_state, dependency );
+        lua_rawseti( lua_state, -2, i + 1 );
+    }
+    return 1;
+}
+
+/**
+// Get the structural hash of a target (see Graph::structural_hash()).
+//
+// ~~~lua
+// function Target.structural_hash( target )
+// ~~~
+*/
+int LuaTarget::structural_hash( lua_State* lua_state )
+{
+    const int TARGET = 1;
+    Target* target = (Target*) luaxx_to( lua_state, TARGET, TARGET_TYPE );
+    luaL_argcheck( lua_state, target != nullptr, TARGET, "expected target table" );
+    uint64_t structural_hash = target->graph()->structural_hash( target );
+    lua_pushinteger( lua_state, static_cast<lua_Integer>(structural_hash) );
+    return 1;
+}
+
+/**
+// Restore the explicit dependencies added when a target was last prepared
+// if its structural hash hasn't changed since (see
+// Target::restore_prepared()).
+//
+// If the target was pruned when it was last prepared then it is pruned
+// again.
+//
+// ~~~lua
+// function Target.prepared( target, structural_hash )
+// ~~~
+//
+// @return
+//  True if the target was restored and doesn't need to be prepared again
+//  otherwise false.
+*/
+int LuaTarget::prepared( lua_State* lua_state )
+{
+    const int TARGET = 1;
+    const int STRUCTURAL_HASH = 2;
+    Target* target = (Target*) luaxx_to( lua_state, TARGET, TARGET_TYPE );
+    luaL_argcheck( lua_state, target != nullptr, TARGET, "expected target table" );
+    uint64_t structural_hash = static_cast<uint64_t>( luaL_checkinteger(lua_state, STRUCTURAL_HASH) );
+    bool prepared = target->restore_prepared( structural_hash );
+    if ( prepared )
+    {
+        target->graph()->count_prepared( true );
+    }
+    if ( prepared && target->prepared_pruned() )
+    {
+        target->graph()->forge()->scheduler()->prune();
+    }
+    lua_pushboolean( lua_state, prepared ? 1 : 0 );
+    return 1;
+}
+
+/**
+// Remember the explicit dependencies of a target after it has been
+// prepared along with the structural hash it had before it was prepared
+// and whether or not it was pruned.
+//
+// ~~~lua
+// function Target.set_prepared( target, structural_hash )
+// ~~~
+*/
+int LuaTarget::set_prepared( lua_State* lua_state )
+{
+    const int TARGET = 1;
+    const int STRUCTURAL_HASH = 2;
+    Target* target = (Target*) luaxx_to( lua_state, TARGET, TARGET_TYPE );
+    luaL_argcheck( lua_state, target != nullptr, TARGET, "expected target table" );
+    uint64_t structural_hash = static_cast<uint64_t>( luaL_checkinteger(lua_state, STRUCTURAL_HASH) );
+    Context* context = target->graph()->forge()->scheduler()->context();
+    target->set_prepared( structural_hash, context && context->prune() );
+    target->graph()->count_prepared( false );
+    return 0;
+}
+
 int LuaTarget::explicit_dependency( lua_State* lua_state )
 {
     SWEET_ASSERT( lua_state );
@@ -818,6 +1087,7 @@ int LuaTarget::target_call_metamethod( lua_State* lua_state )
     {
         target->set_rule( rule );
         target->set_working_directory( working_directory );
+        target->add_buildfile( context->current_buildfile() );
     }
 
     bool update_working_directory = !target->working_directory();
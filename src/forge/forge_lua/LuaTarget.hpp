@@ -39,6 +39,8 @@ public:
     static int cleanable( lua_State* lua_state );
     static int set_built( lua_State* lua_state );
     static int built( lua_State* lua_state );
+    static int set_built_inputs( lua_State* lua_state );
+    static int built_inputs( lua_State* lua_state );
     static int timestamp( lua_State* lua_state );
     static int last_write_time( lua_State* lua_state );
     static int outdated( lua_State* lua_state );
@@ -59,6 +61,10 @@ public:
     static int add_passive_dependency( lua_State* lua_state );
     static int all_dependencies_iterator( lua_State* lua_state );
     static int all_dependencies( lua_State* lua_state );
+    static int transitive_dependencies( lua_State* lua_state );
+    static int structural_hash( lua_State* lua_state );
+    static int prepared( lua_State* lua_state );
+    static int set_prepared( lua_State* lua_state );
     static int explicit_dependency( lua_State* lua_state );
     static int explicit_dependencies_iterator( lua_State* lua_state );
     static int explicit_dependencies( lua_State* lua_state );
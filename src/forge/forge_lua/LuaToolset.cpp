@@ -10,6 +10,10 @@
 #include <luaxx/luaxx.hpp>
 #include <assert/assert.hpp>
 #include <lua.hpp>
+#include <ctype.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
 
 using std::string;
 using namespace sweet;
@@ -18,6 +22,332 @@ using namespace sweet::forge;
 
 const char* LuaToolset::TOOLSET_METATABLE = "forge.Toolset";
 
+static const lua_Integer MAXIMUM_INTERPOLATE_TEMPLATES = 4096;
+
+/**
+// A literal or a `${}` substitution in a template parsed by
+// `Toolset:interpolate()`.
+//
+// Tokens are stored in a flat array in a Lua userdata so that templates can
+// be cached and are released by the garbage collector even if an error is
+// raised while they are being interpolated.  The `begin` and `end` offsets
+// index into the template string.  A substitution covers the text between
+// its braces; its nested substitutions, if any, are the tokens in
+// [`first`, `last`) otherwise `first` and `last` are both zero and the text
+// is used as is.
+*/
+struct InterpolateToken
+{
+    bool substitution;
+    int begin;
+    int end;
+    int first;
+    int last;
+};
+
+/**
+// A template parsed by `Toolset:interpolate()`.
+//
+// The tokens for the top level of the template are [0, `count`) and the
+// tokens for nested substitutions follow.
+*/
+struct InterpolateTemplate
+{
+    int count;
+    InterpolateToken tokens [1];
+};
+
+/**
+// Match `%$(%b{})` at \e position in [\e position, \e end) of \e text.
+//
+// @return
+//  The offset of the closing brace of the match or -1 if there is no match.
+*/
+static int match_substitution( const char* text, int position, int end )
+{
+    if ( position + 1 >= end || text[position] != '$' || text[position + 1] != '{' )
+    {
+        return -1;
+    }
+    int depth = 1;
+    for ( int i = position + 2; i < end; ++i )
+    {
+        if ( text[i] == '}' )
+        {
+            if ( --depth == 0 )
+            {
+                return i;
+            }
+        }
+        else if ( text[i] == '{' )
+        {
+            ++depth;
+        }
+    }
+    return -1;
+}
+
+/**
+// Parse one level of [\e begin, \e end) of \e text into tokens starting at
+// \e first.
+//
+// @return
+//  One past the index of the last token parsed.
+*/
+static int parse_interpolate_tokens( const char* text, int begin, int end, InterpolateToken* tokens, int first )
+{
+    int last = first;
+    int position = begin;
+    while ( position < end )
+    {
+        int close = match_substitution( text, position, end );
+        if ( close >= 0 )
+        {
+            InterpolateToken& token = tokens[last];
+            token.substitution = true;
+            token.begin = position + 2;
+            token.end = close;
+            token.first = 0;
+            token.last = 0;
+            ++last;
+            position = close + 1;
+        }
+        else if ( last > first && !tokens[last - 1].substitution )
+        {
+            tokens[last - 1].end = position + 1;
+            ++position;
+        }
+        else
+        {
+            InterpolateToken& token = tokens[last];
+            token.substitution = false;
+            token.begin = position;
+            token.end = position + 1;
+            token.first = 0;
+            token.last = 0;
+            ++last;
+            ++position;
+        }
+    }
+    return last;
+}
+
+/**
+// Parse \e text into a new InterpolateTemplate userdata pushed onto the
+// stack.
+//
+// Each character is part of at most one literal token and each substitution
+// consumes at least three characters so a template never needs more tokens
+// than it has characters.
+*/
+static InterpolateTemplate* parse_interpolate_template( lua_State* lua_state, const char* text, int length )
+{
+    size_t size = sizeof(InterpolateTemplate) + sizeof(InterpolateToken) * length;
+    InterpolateTemplate* interpolate_template = (InterpolateTemplate*) lua_newuserdata( lua_state, size );
+    InterpolateToken* tokens = interpolate_template->tokens;
+    interpolate_template->count = parse_interpolate_tokens( text, 0, length, tokens, 0 );
+    int total = interpolate_template->count;
+    for ( int i = 0; i < total; ++i )
+    {
+        InterpolateToken& token = tokens[i];
+        if ( token.substitution )
+        {
+            int last = parse_interpolate_tokens( text, token.begin, token.end, tokens, total );
+            for ( int j = total; j < last; ++j )
+            {
+                if ( tokens[j].substitution )
+                {
+                    token.first = total;
+                    token.last = last;
+                    total = last;
+                    break;
+                }
+            }
+        }
+    }
+    return interpolate_template;
+}
+
+static void interpolate_tokens( lua_State* lua_state, const char* text, int begin, int end, const InterpolateToken* tokens, int first, int last );
+
+static const char* skip_space( const char* position, const char* end )
+{
+    while ( position < end && isspace((unsigned char) *position) )
+    {
+        ++position;
+    }
+    return position;
+}
+
+static const char* skip_word( const char* position, const char* end )
+{
+    while ( position < end && !isspace((unsigned char) *position) )
+    {
+        ++position;
+    }
+    return position;
+}
+
+/**
+// Push the value substituted for \e token, a substitution in the template
+// [\e begin, \e end) of \e text, onto the stack.
+//
+// The toolset and variables are at stack indices 1 and 3 as passed to
+// `LuaToolset::interpolate()`.
+*/
+static void substitute( lua_State* lua_state, const char* text, int begin, int end, const InterpolateToken* tokens, const InterpolateToken& token )
+{
+    const int TOOLSET = 1;
+    const int VARIABLES = 3;
+
+    luaL_checkstack( lua_state, 8, "too many nested substitutions" );
+    if ( token.first < token.last )
+    {
+        interpolate_tokens( lua_state, text, token.begin, token.end, tokens, token.first, token.last );
+    }
+    else
+    {
+        lua_pushlstring( lua_state, text + token.begin, token.end - token.begin );
+    }
+
+    const int PARAMETERS = lua_gettop( lua_state );
+    const int IDENTIFIER = PARAMETERS + 1;
+    size_t length = 0;
+    const char* parameters = lua_tolstring( lua_state, PARAMETERS, &length );
+    const char* parameters_end = parameters + length;
+    const char* identifier = skip_space( parameters, parameters_end );
+    const char* position = skip_word( identifier, parameters_end );
+    if ( identifier < position )
+    {
+        lua_pushlstring( lua_state, identifier, position - identifier );
+    }
+    else
+    {
+        lua_pushnil( lua_state );
+    }
+
+    if ( lua_toboolean(lua_state, VARIABLES) )
+    {
+        lua_pushvalue( lua_state, IDENTIFIER );
+        lua_gettable( lua_state, VARIABLES );
+    }
+    else
+    {
+        lua_pushnil( lua_state );
+    }
+    if ( !lua_toboolean(lua_state, -1) )
+    {
+        lua_pop( lua_state, 1 );
+        lua_pushvalue( lua_state, IDENTIFIER );
+        lua_gettable( lua_state, TOOLSET );
+    }
+    if ( !lua_toboolean(lua_state, -1) )
+    {
+        lua_pop( lua_state, 1 );
+        lua_pushglobaltable( lua_state );
+        lua_pushvalue( lua_state, IDENTIFIER );
+        lua_gettable( lua_state, -2 );
+        lua_remove( lua_state, -2 );
+    }
+    if ( !lua_toboolean(lua_state, -1) )
+    {
+        lua_pop( lua_state, 1 );
+        if ( lua_isnil(lua_state, IDENTIFIER) )
+        {
+            luaL_error( lua_state, "bad argument #1 to 'getenv' (string expected, got nil)" );
+        }
+        const char* value = getenv( lua_tostring(lua_state, IDENTIFIER) );
+        if ( value )
+        {
+            lua_pushstring( lua_state, value );
+        }
+        else
+        {
+            lua_pushnil( lua_state );
+        }
+    }
+
+    if ( lua_isfunction(lua_state, -1) )
+    {
+        lua_pushvalue( lua_state, TOOLSET );
+        int arguments = 1;
+        position = skip_space( position, parameters_end );
+        while ( position < parameters_end )
+        {
+            const char* word = position;
+            position = skip_word( word, parameters_end );
+            luaL_checkstack( lua_state, 1, "too many arguments to substitute" );
+            lua_pushlstring( lua_state, word, position - word );
+            ++arguments;
+            position = skip_space( position, parameters_end );
+        }
+        lua_call( lua_state, arguments, 1 );
+    }
+    else if ( lua_istable(lua_state, -1) )
+    {
+        const char* key = skip_space( position, parameters_end );
+        position = skip_word( key, parameters_end );
+        if ( key < position )
+        {
+            lua_pushlstring( lua_state, key, position - key );
+        }
+        else
+        {
+            lua_pushnil( lua_state );
+        }
+        lua_gettable( lua_state, -2 );
+        lua_remove( lua_state, -2 );
+    }
+
+    if ( !lua_toboolean(lua_state, -1) )
+    {
+        lua_pushliteral( lua_state, "Missing substitute for \"" );
+        luaL_tolstring( lua_state, IDENTIFIER, nullptr );
+        lua_pushliteral( lua_state, "\" in \"" );
+        lua_pushlstring( lua_state, text + begin, end - begin );
+        lua_pushliteral( lua_state, "\"" );
+        lua_concat( lua_state, 5 );
+        lua_error( lua_state );
+    }
+    if ( !lua_isstring(lua_state, -1) )
+    {
+        luaL_error( lua_state, "invalid replacement value (a %s)", luaL_typename(lua_state, -1) );
+    }
+    lua_replace( lua_state, PARAMETERS );
+    lua_settop( lua_state, PARAMETERS );
+}
+
+/**
+// Push the concatenation of the literals and substitutions in [\e first,
+// \e last) of \e tokens, parsed from [\e begin, \e end) of \e text, onto
+// the stack.
+*/
+static void interpolate_tokens( lua_State* lua_state, const char* text, int begin, int end, const InterpolateToken* tokens, int first, int last )
+{
+    const int MAXIMUM_PIECES = 16;
+    luaL_checkstack( lua_state, MAXIMUM_PIECES, "too many nested substitutions" );
+    int pieces = 0;
+    for ( int i = first; i < last; ++i )
+    {
+        const InterpolateToken& token = tokens[i];
+        if ( token.substitution )
+        {
+            substitute( lua_state, text, begin, end, tokens, token );
+        }
+        else
+        {
+            lua_pushlstring( lua_state, text + token.begin, token.end - token.begin );
+        }
+        ++pieces;
+        if ( pieces == MAXIMUM_PIECES )
+        {
+            lua_concat( lua_state, pieces );
+            pieces = 1;
+        }
+    }
+    lua_concat( lua_state, pieces );
+}
+
 LuaToolset::LuaToolset()
 : lua_state_( nullptr )
 {
@@ -44,6 +374,10 @@ void LuaToolset::create( lua_State* lua_state )
     };
     luaxx_push( lua_state_, this );
     luaL_setfuncs( lua_state_, functions, 0 );
+    lua_newtable( lua_state_ );
+    lua_pushinteger( lua_state_, 0 );
+    lua_pushcclosure( lua_state_, &LuaToolset::interpolate, 2 );
+    lua_setfield( lua_state_, -2, "interpolate" );
     lua_pop( lua_state_, 1 );
 
     // Set the metatable for `Toolset` to redirect calls to create new
@@ -117,6 +451,81 @@ int LuaToolset::id( lua_State* lua_state )
     return 0;
 }
 
+/**
+// Provide GNU Make like string substitution.
+//
+// Replaces each `${identifier arguments...}` in \e template with the value
+// of \e identifier found in \e variables (defaulting to the toolset), the
+// toolset, the global environment, or the process environment, in that
+// order.  Functions are called with the toolset and any arguments and
+// tables are indexed with the first argument.  Nested substitutions are
+// expanded first.
+//
+// Templates are parsed once and cached by string in the table in the
+// first upvalue.  The cache is discarded and restarted once it holds
+// MAXIMUM_INTERPOLATE_TEMPLATES templates, counted in the second upvalue.
+//
+// ~~~lua
+// function Toolset:interpolate( template, variables )
+// ~~~
+*/
+int LuaToolset::interpolate( lua_State* lua_state )
+{
+    const int TOOLSET = 1;
+    const int TEMPLATE = 2;
+    const int VARIABLES = 3;
+    const int CACHE = lua_upvalueindex( 1 );
+    const int CACHE_SIZE = lua_upvalueindex( 2 );
+
+    size_t length = 0;
+    const char* text = luaL_checklstring( lua_state, TEMPLATE, &length );
+    luaL_argcheck( lua_state, length < size_t(INT_MAX / sizeof(InterpolateToken)), TEMPLATE, "template too long" );
+    lua_settop( lua_state, VARIABLES );
+    if ( !lua_toboolean(lua_state, VARIABLES) )
+    {
+        lua_pushvalue( lua_state, TOOLSET );
+        lua_replace( lua_state, VARIABLES );
+    }
+
+    // Return templates without any possible substitutions unchanged without
+    // parsing or caching them.
+    const char* dollar = (const char*) memchr( text, '$', length );
+    while ( dollar && (dollar + 1 >= text + length || dollar[1] != '{') )
+    {
+        ++dollar;
+        dollar = (const char*) memchr( dollar, '$', text + length - dollar );
+    }
+    if ( !dollar )
+    {
+        lua_settop( lua_state, TEMPLATE );
+        return 1;
+    }
+
+    lua_pushvalue( lua_state, TEMPLATE );
+    lua_rawget( lua_state, CACHE );
+    InterpolateTemplate* interpolate_template = (InterpolateTemplate*) lua_touserdata( lua_state, -1 );
+    if ( !interpolate_template )
+    {
+        lua_pop( lua_state, 1 );
+        interpolate_template = parse_interpolate_template( lua_state, text, int(length) );
+        lua_Integer cache_size = lua_tointeger( lua_state, CACHE_SIZE );
+        if ( cache_size >= MAXIMUM_INTERPOLATE_TEMPLATES )
+        {
+            lua_newtable( lua_state );
+            lua_replace( lua_state, CACHE );
+            cache_size = 0;
+        }
+        lua_pushvalue( lua_state, TEMPLATE );
+        lua_pushvalue( lua_state, -2 );
+        lua_rawset( lua_state, CACHE );
+        lua_pushinteger( lua_state, cache_size + 1 );
+        lua_replace( lua_state, CACHE_SIZE );
+    }
+
+    interpolate_tokens( lua_state, text, 0, int(length), interpolate_template->tokens, 0, interpolate_template->count );
+    return 1;
+}
+
 /**
 // Redirect calls made on `forge.Toolset()` to `Toolset.new()`.
 //
@@ -32,6 +32,7 @@ public:
 
     static int id( lua_State* lua_state );
     static int prototype( lua_State* lua_state );
+    static int interpolate( lua_State* lua_state );
     static int create_call_metamethod( lua_State* lua_state );
     static int continue_create_call_metamethod( lua_State* lua_state, int /*status*/, lua_KContext /*context*/ );
 };
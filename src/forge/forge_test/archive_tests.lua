@@ -0,0 +1,79 @@
+local cc_test = dofile( root('cc_test.lua') );
+
+local SOURCES = {
+    ['foo.cpp'] = 'int foo() { return 1; }\n';
+    ['bar.cpp'] = 'int bar() { return 2; }\n';
+    ['main.cpp'] = 'int foo(); int bar(); int main() { return foo() + bar() - 3; }\n';
+};
+
+-- Declare an executable in *directory* that links against a static library
+-- archived with *settings* and return the executable.
+local function declare_archive_test( directory, settings )
+    local toolset = cc_test.toolset( directory, settings );
+    local library = ('${lib}/%s'):format( directory );
+    toolset:StaticLibrary( library ) {
+        toolset:Cxx '${obj}/%1' {
+            ('%s/foo.cpp'):format( directory );
+            ('%s/bar.cpp'):format( directory );
+        };
+    };
+    return toolset:Executable( ('${bin}/%s'):format(directory) ) {
+        library;
+        toolset:Cxx '${obj}/%1' {
+            ('%s/main.cpp'):format( directory );
+        };
+    };
+end
+
+-- Build an executable that links against a static library archived with
+-- *settings* and return the number of failures and whether the executable
+-- was built.
+local function build_archive_test( name, settings )
+    local directory = ('archive_tests_%s'):format( name );
+    cc_test.create_sources( directory, SOURCES );
+    local executable = declare_archive_test( directory, settings );
+    local failures = cc_test.build( executable );
+    local built = exists( executable );
+    rmdir( root(directory) );
+    return failures, built;
+end
+
+if operating_system() == 'linux' then
+    TestSuite {
+        archives_link = function()
+            local failures, built = build_archive_test( 'full', {} );
+            CHECK_EQUAL( 0, failures );
+            CHECK( built );
+        end;
+
+        thin_archives_link = function()
+            local failures, built = build_archive_test( 'thin', {thin_archives = true} );
+            CHECK_EQUAL( 0, failures );
+            CHECK( built );
+        end;
+
+        incremental_thin_archives_link = function()
+            local failures, built = build_archive_test( 'incremental', {thin_archives = true, incremental_archives = true} );
+            CHECK_EQUAL( 0, failures );
+            CHECK( built );
+        end;
+
+        incremental_archives_replace_only_outdated_members_in_later_runs = function()
+            local directory = 'archive_tests_incremental_runs';
+            local settings = { thin_archives = true, incremental_archives = true };
+            cc_test.create_sources( directory, SOURCES );
+            local failures, commands, executable = cc_test.rebuild(
+                'archive_tests_incremental_runs.cache',
+                function() return declare_archive_test( directory, settings ) end,
+                function() touch( ('%s/foo.cpp'):format(directory), os.time() + 60 ) end
+            );
+            CHECK_EQUAL( 0, failures );
+            CHECK( exists(executable) );
+            local archives = cc_test.matching( commands, 'ar -rcs' );
+            CHECK_EQUAL( 1, #archives );
+            CHECK_EQUAL( 1, #cc_test.matching(archives, 'foo.o') );
+            CHECK_EQUAL( 0, #cc_test.matching(archives, 'bar.o') );
+            rmdir( root(directory) );
+        end;
+    };
+end
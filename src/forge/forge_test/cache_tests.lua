@@ -0,0 +1,394 @@
+local function buildfile_content( name )
+    return ([[
+%s_loads = (%s_loads or 0) + 1;
+local cpp = Target( nil, '%s.cpp' );
+cpp:set_filename( cpp:path() );
+local obj = Target( nil, '%s.obj' );
+obj:set_filename( obj:path() );
+obj:set_cleanable( true );
+obj:add_dependency( cpp );
+]]):format( name, name, name, name );
+end
+
+TestSuite {
+    built_targets_are_merged_from_another_cached_graph = function()
+        create( 'merge_foo.cpp', 1 );
+        create( 'merge_foo.hpp', 1 );
+        create( 'merge_foo.obj', 2 );
+        create( 'merge.cache' );
+        remove( 'merge.cache' );
+
+        load_binary( 'merge.cache' );
+        local foo_cpp = Target( nil, 'merge_foo.cpp' );
+        foo_cpp:set_filename( foo_cpp:path() );
+        local foo_obj = Target( nil, 'merge_foo.obj' );
+        foo_obj:set_filename( foo_obj:path() );
+        foo_obj:set_cleanable( true );
+        foo_obj:add_dependency( foo_cpp );
+        postorder( foo_obj, function(target) 
+            if target == foo_obj then
+                local foo_hpp = Target( nil, 'merge_foo.hpp' );
+                foo_hpp:set_filename( foo_hpp:path() );
+                target:add_implicit_dependency( foo_hpp );
+            end
+            target:set_built( true );
+        end );
+        save_binary();
+
+        foo_obj:set_built( false );
+        foo_obj:clear_implicit_dependencies();
+        CHECK( merge_binary('merge.cache') > 0 );
+        CHECK( foo_obj:built() );
+        local dependencies = {};
+        for _, dependency in foo_obj:all_dependencies() do
+            table.insert( dependencies, dependency );
+        end
+        CHECK_EQUAL( 2, #dependencies );
+        CHECK( dependencies[1] == foo_cpp );
+        CHECK( dependencies[2] == find_target('merge_foo.hpp') );
+    end;
+
+    only_successfully_built_targets_are_checkpointed_as_built = function()
+        create( 'checkpoint.cpp', 1 );
+        create( 'checkpoint.cache' );
+        remove( 'checkpoint.cache' );
+
+        load_binary( 'checkpoint.cache' );
+        set_checkpoint_interval( 0, 1 );
+        local cpp = Target( nil, 'checkpoint.cpp' );
+        cpp:set_filename( cpp:path() );
+        local obj = Target( nil, 'checkpoint.obj' );
+        obj:set_filename( obj:path() );
+        obj:set_cleanable( true );
+        obj:add_dependency( cpp );
+        local exe = Target( nil, 'checkpoint.exe' );
+        exe:set_filename( exe:path() );
+        exe:set_cleanable( true );
+        exe:add_dependency( obj );
+        local failures = postorder( exe, function(target)
+            target:set_built( true );
+            if target == exe then
+                error( 'Interrupted before checkpoint.exe was built' );
+            end
+        end );
+        CHECK_EQUAL( 2, failures );
+        CHECK( exe:built() );
+        set_checkpoint_interval( 0, 0 );
+
+        load_binary( 'checkpoint.cache' );
+        CHECK( find_target('checkpoint.obj'):built() );
+        CHECK( not find_target('checkpoint.exe'):built() );
+    end;
+
+    only_changed_buildfiles_are_loaded_into_a_cached_graph = function()
+        create( 'reuse_a.cpp', 1 );
+        create( 'reuse_a.obj', 2 );
+        create( 'reuse_a.forge', 1, buildfile_content('reuse_a') );
+        create( 'reuse_b.cpp', 1 );
+        create( 'reuse_b.obj', 2 );
+        create( 'reuse_b.forge', 1, buildfile_content('reuse_b') );
+        create( 'reuse.cache' );
+        remove( 'reuse.cache' );
+
+        load_binary( 'reuse.cache', true );
+        buildfile( 'reuse_a.forge' );
+        buildfile( 'reuse_b.forge' );
+        postorder( find_target('reuse_a.obj'), function(target) target:set_built(true) end );
+        postorder( find_target('reuse_b.obj'), function(target) target:set_built(true) end );
+        save_binary();
+        CHECK_EQUAL( 1, reuse_a_loads );
+        CHECK_EQUAL( 1, reuse_b_loads );
+
+        local cache_target, reused = load_binary( 'reuse.cache', true );
+        buildfile( 'reuse_a.forge' );
+        buildfile( 'reuse_b.forge' );
+        CHECK( cache_target ~= nil );
+        CHECK( reused );
+        CHECK_EQUAL( 1, reuse_a_loads );
+        CHECK_EQUAL( 1, reuse_b_loads );
+        CHECK( find_target('reuse_a.obj'):cleanable() );
+        CHECK( find_target('reuse_a.obj'):dependency(1) == find_target('reuse_a.cpp') );
+
+        touch( 'reuse_b.forge', os.time() + 60 );
+        cache_target, reused = load_binary( 'reuse.cache', true );
+        CHECK( find_target('reuse_b.obj'):dependency(1) == nil );
+        buildfile( 'reuse_a.forge' );
+        buildfile( 'reuse_b.forge' );
+        CHECK( cache_target ~= nil );
+        CHECK( reused == false );
+        CHECK_EQUAL( 1, reuse_a_loads );
+        CHECK_EQUAL( 2, reuse_b_loads );
+        CHECK( find_target('reuse_a.obj'):dependency(1) == find_target('reuse_a.cpp') );
+        CHECK( find_target('reuse_b.obj'):dependency(1) == find_target('reuse_b.cpp') );
+
+        touch( 'reuse_a.cpp', 3 );
+        cache_target, reused = load_binary( 'reuse.cache', true );
+        buildfile( 'reuse_a.forge' );
+        buildfile( 'reuse_b.forge' );
+        CHECK( reused == false );
+        CHECK_EQUAL( 2, reuse_a_loads );
+        CHECK_EQUAL( 3, reuse_b_loads );
+    end;
+
+    targets_shared_by_unchanged_buildfiles_are_kept = function()
+        local function shared_content( name )
+            return ([[
+%s_loads = (%s_loads or 0) + 1;
+local cpp = Target( nil, '%s.cpp' );
+cpp:set_filename( cpp:path() );
+local shared = Target( nil, 'partial_shared' );
+shared:add_dependency( cpp );
+shared:add_ordering_dependency( Target(nil, 'partial_directory') );
+]]):format( name, name, name );
+        end
+
+        create( 'partial_a.cpp', 1 );
+        create( 'partial_a.forge', 1, shared_content('partial_a') );
+        create( 'partial_b.cpp', 1 );
+        create( 'partial_b.forge', 1, shared_content('partial_b') );
+        create( 'partial_c.cpp', 1 );
+        create( 'partial_c.obj', 2 );
+        create( 'partial_c.forge', 1, buildfile_content('partial_c') );
+        create( 'partial.cache' );
+        remove( 'partial.cache' );
+
+        load_binary( 'partial.cache', true );
+        buildfile( 'partial_a.forge' );
+        buildfile( 'partial_b.forge' );
+        buildfile( 'partial_c.forge' );
+        postorder( find_target('partial_shared'), function(target) target:set_built(true) end );
+        postorder( find_target('partial_c.obj'), function(target) target:set_built(true) end );
+        save_binary();
+
+        touch( 'partial_c.cpp', 3 );
+        local cache_target, reused = load_binary( 'partial.cache', true );
+        buildfile( 'partial_a.forge' );
+        buildfile( 'partial_b.forge' );
+        buildfile( 'partial_c.forge' );
+        CHECK( cache_target ~= nil );
+        CHECK( reused == false );
+        CHECK_EQUAL( 1, partial_a_loads );
+        CHECK_EQUAL( 1, partial_b_loads );
+        CHECK_EQUAL( 2, partial_c_loads );
+        CHECK( find_target('partial_shared'):dependency(1) == find_target('partial_a.cpp') );
+        CHECK( find_target('partial_shared'):dependency(2) == find_target('partial_b.cpp') );
+        CHECK( find_target('partial_shared'):ordering_dependency(1) == find_target('partial_directory') );
+        CHECK( find_target('partial_c.obj'):dependency(1) == find_target('partial_c.cpp') );
+    end;
+
+    buildfiles_that_glob_changed_directories_are_loaded_again = function()
+        mkdir( root('glob_reuse') );
+        create( 'glob_reuse/a.cpp', 1 );
+        touch( 'glob_reuse', 1 );
+        create( 'glob_reuse.forge', 1, [[
+glob_reuse_loads = (glob_reuse_loads or 0) + 1;
+glob_reuse_files = #glob( 'glob_reuse/*.cpp' );
+]] );
+        create( 'glob_reuse_other.forge', 1, 'glob_reuse_other_loads = (glob_reuse_other_loads or 0) + 1;\n' );
+        create( 'glob_reuse.cache' );
+        remove( 'glob_reuse.cache' );
+
+        load_binary( 'glob_reuse.cache', true );
+        buildfile( 'glob_reuse.forge' );
+        buildfile( 'glob_reuse_other.forge' );
+        save_binary();
+        CHECK_EQUAL( 1, glob_reuse_files );
+
+        local cache_target, reused = load_binary( 'glob_reuse.cache', true );
+        buildfile( 'glob_reuse.forge' );
+        buildfile( 'glob_reuse_other.forge' );
+        CHECK( reused );
+        CHECK_EQUAL( 1, glob_reuse_loads );
+        CHECK_EQUAL( 1, glob_reuse_other_loads );
+
+        create( 'glob_reuse/b.cpp', 1 );
+        cache_target, reused = load_binary( 'glob_reuse.cache', true );
+        buildfile( 'glob_reuse.forge' );
+        buildfile( 'glob_reuse_other.forge' );
+        CHECK( reused == false );
+        CHECK_EQUAL( 2, glob_reuse_loads );
+        CHECK_EQUAL( 1, glob_reuse_other_loads );
+        CHECK_EQUAL( 2, glob_reuse_files );
+        rmdir( root('glob_reuse') );
+    end;
+
+    mirror_sources_of_buildfiles_loaded_again_are_replaced = function()
+        mkdir( root('mirror_reuse_a') );
+        mkdir( root('mirror_reuse_b') );
+        mkdir( root('mirror_reuse_c') );
+        create( 'mirror_reuse_a/a.txt', 1, 'a' );
+        create( 'mirror_reuse_b/b.txt', 1, 'b' );
+        create( 'mirror_reuse_c/c.txt', 1, 'c' );
+        create( 'mirror_reuse.forge', 1, "add_mirror( root('mirror_reuse_destination'), root(mirror_reuse_source) );\n" );
+        create( 'mirror_reuse_other.forge', 1, "add_mirror( root('mirror_reuse_destination'), root('mirror_reuse_c') );\n" );
+        create( 'mirror_reuse.cache' );
+        remove( 'mirror_reuse.cache' );
+
+        mirror_reuse_source = 'mirror_reuse_a';
+        load_binary( 'mirror_reuse.cache', true );
+        buildfile( 'mirror_reuse.forge' );
+        buildfile( 'mirror_reuse_other.forge' );
+        save_binary();
+
+        mirror_reuse_source = 'mirror_reuse_b';
+        touch( 'mirror_reuse.forge', os.time() + 60 );
+        local cache_target, reused = load_binary( 'mirror_reuse.cache', true );
+        buildfile( 'mirror_reuse.forge' );
+        buildfile( 'mirror_reuse_other.forge' );
+        CHECK( cache_target ~= nil );
+        CHECK( reused == false );
+        sync_mirror( root('mirror_reuse_destination') );
+        CHECK( not exists(root('mirror_reuse_destination/a.txt')) );
+        CHECK( exists(root('mirror_reuse_destination/b.txt')) );
+        CHECK( exists(root('mirror_reuse_destination/c.txt')) );
+        rmdir( root('mirror_reuse_a') );
+        rmdir( root('mirror_reuse_b') );
+        rmdir( root('mirror_reuse_c') );
+        rmdir( root('mirror_reuse_destination') );
+    end;
+
+    buildfiles_declaring_dependencies_are_loaded_again_with_their_rules = function()
+        if operating_system() ~= 'linux' then
+            return;
+        end
+
+        -- Loading the forge module for the cc rules also sets a bytecode
+        -- directory that the other tests don't expect.
+        local cc_test = dofile( root('cc_test.lua') );
+        set_bytecode_directory();
+
+        cc_test.create_sources( 'cache_cc', {
+            ['foo.cpp'] = 'int foo() { return 1; }\n';
+            ['main.cpp'] = 'int foo(); int main() { return foo() - 1; }\n';
+        } );
+        create( 'cache_cc/library.forge', 1, [[
+cache_cc_library_loads = (cache_cc_library_loads or 0) + 1;
+cache_cc_toolset:StaticLibrary '${lib}/cache_cc_library' {
+    cache_cc_toolset:Cxx '${obj}/%1' {
+        'foo.cpp';
+    };
+};
+]] );
+        create( 'cache_cc/executable.forge', 1, [[
+cache_cc_executable_loads = (cache_cc_executable_loads or 0) + 1;
+cache_cc_executable = cache_cc_toolset:Executable '${bin}/cache_cc' {
+    '${lib}/cache_cc_library';
+    cache_cc_toolset:Cxx '${obj}/%1' {
+        'main.cpp';
+    };
+};
+]] );
+        create( 'cache_cc/other.forge', 1, 'cache_cc_other_loads = (cache_cc_other_loads or 0) + 1;\n' );
+        create( 'cache_cc.cache' );
+        remove( 'cache_cc.cache' );
+
+        local function load()
+            local _, reused = load_binary( 'cache_cc.cache', true );
+            cache_cc_toolset = cc_test.toolset( 'cache_cc' );
+            buildfile( 'cache_cc/library.forge' );
+            buildfile( 'cache_cc/executable.forge' );
+            buildfile( 'cache_cc/other.forge' );
+            return reused;
+        end
+
+        load();
+        CHECK_EQUAL( 0, cc_test.build(cache_cc_executable) );
+        save_binary();
+
+        touch( 'cache_cc/main.cpp', os.time() + 60 );
+        local reused = load();
+        CHECK( reused == false );
+        CHECK_EQUAL( 2, cache_cc_executable_loads );
+        CHECK_EQUAL( 2, cache_cc_library_loads );
+        CHECK_EQUAL( 1, cache_cc_other_loads );
+        CHECK( find_target(root('cache_cc/lib/cache_cc_library')):rule() == cache_cc_toolset.StaticLibrary );
+        local failures, commands = cc_test.build( cache_cc_executable );
+        CHECK_EQUAL( 0, failures );
+        CHECK_EQUAL( 1, #cc_test.matching(commands, '-lcache_cc_library') );
+        rmdir( root('cache_cc') );
+        remove( 'cache_cc.cache' );
+    end;
+
+    cached_graph_is_not_reused_unless_requested = function()
+        create( 'not_reused_foo.cpp', 1 );
+        create( 'not_reused_foo.obj', 2 );
+        create( 'not_reused.cache' );
+        remove( 'not_reused.cache' );
+
+        load_binary( 'not_reused.cache' );
+        local foo_cpp = Target( nil, 'not_reused_foo.cpp' );
+        foo_cpp:set_filename( foo_cpp:path() );
+        local foo_obj = Target( nil, 'not_reused_foo.obj' );
+        foo_obj:set_filename( foo_obj:path() );
+        foo_obj:set_cleanable( true );
+        foo_obj:add_dependency( foo_cpp );
+        postorder( foo_obj, function(target) target:set_built(true) end );
+        save_binary();
+
+        local cache_target, reused = load_binary( 'not_reused.cache' );
+        CHECK( cache_target ~= nil );
+        CHECK( reused == false );
+        CHECK( find_target('not_reused_foo.obj'):dependency(1) == nil );
+    end;
+
+    cached_graph_saved_without_reuse_is_not_reused = function()
+        create( 'unreusable_foo.cpp', 1 );
+        create( 'unreusable_foo.obj', 2 );
+        create( 'unreusable.cache' );
+        remove( 'unreusable.cache' );
+
+        load_binary( 'unreusable.cache' );
+        local foo_cpp = Target( nil, 'unreusable_foo.cpp' );
+        foo_cpp:set_filename( foo_cpp:path() );
+        local foo_obj = Target( nil, 'unreusable_foo.obj' );
+        foo_obj:set_filename( foo_obj:path() );
+        foo_obj:set_cleanable( true );
+        foo_obj:add_dependency( foo_cpp );
+        postorder( foo_obj, function(target) target:set_built(true) end );
+        save_binary();
+
+        local cache_target, reused = load_binary( 'unreusable.cache', true );
+        CHECK( cache_target ~= nil );
+        CHECK( reused == false );
+        CHECK( find_target('unreusable_foo.obj'):dependency(1) == nil );
+        CHECK( find_target('unreusable_foo.obj'):built() );
+    end;
+
+    buildfiles_and_modules_are_loaded_from_cached_bytecode = function()
+        local package_path = package.path;
+        rmdir( root('bytecode') );
+        set_bytecode_directory( root('bytecode') );
+        package.path = root( '?.lua' );
+        create( 'bytecode.forge', 1, 'bytecode_value = 1;\n' );
+        create( 'bytecode_module.lua', 1, 'return 1;\n' );
+        buildfile( 'bytecode.forge' );
+        CHECK_EQUAL( 1, bytecode_value );
+        CHECK_EQUAL( 1, require('bytecode_module') );
+        local files = 0;
+        for _ in ls(root('bytecode')) do
+            files = files + 1;
+        end
+        CHECK_EQUAL( 2, files );
+
+        -- Same path, last write time, and size loads the cached bytecode.
+        create( 'bytecode.forge', 1, 'bytecode_value = 3;\n' );
+        create( 'bytecode_module.lua', 1, 'return 3;\n' );
+        package.loaded.bytecode_module = nil;
+        buildfile( 'bytecode.forge' );
+        CHECK_EQUAL( 1, bytecode_value );
+        CHECK_EQUAL( 1, require('bytecode_module') );
+
+        -- A different last write time recompiles from source.
+        create( 'bytecode.forge', 2, 'bytecode_value = 2;\n' );
+        create( 'bytecode_module.lua', 2, 'return 2;\n' );
+        package.loaded.bytecode_module = nil;
+        buildfile( 'bytecode.forge' );
+        CHECK_EQUAL( 2, bytecode_value );
+        CHECK_EQUAL( 2, require('bytecode_module') );
+
+        package.loaded.bytecode_module = nil;
+        package.path = package_path;
+        set_bytecode_directory();
+        rmdir( root('bytecode') );
+    end;
+};
@@ -0,0 +1,83 @@
+-- Support for tests that build C/C++ sources with the cc module, loaded
+-- with `dofile( root('cc_test.lua') )`.
+local forge = require( 'forge' ):load();
+
+local cc_test = {};
+
+-- Create *sources*, a table of contents keyed by filename, in the test
+-- directory *directory*.
+function cc_test.create_sources( directory, sources )
+    mkdir( root(directory) );
+    for filename, content in pairs(sources) do
+        create( ('%s/%s'):format(directory, filename), 1, content );
+    end
+end
+
+-- Create a toolset that builds into *directory* with *settings* applied
+-- over its default object, library, and executable directories.
+function cc_test.toolset( directory, settings )
+    local values = {
+        obj = root( ('%s/obj'):format(directory) );
+        lib = root( ('%s/lib'):format(directory) );
+        bin = root( ('%s/bin'):format(directory) );
+        library_directories = { root(('%s/lib'):format(directory)) };
+    };
+    for key, value in pairs(settings or {}) do
+        values[key] = value;
+    end
+    local toolset = forge.Toolset( directory )( values );
+    toolset:install( 'forge.cc' );
+    return toolset;
+end
+
+-- Prepare and build *target* and return the number of failures and the
+-- arguments of each command run while building.
+function cc_test.build( target )
+    local commands = {};
+    local original_run = run;
+    run = function( command, arguments, ... )
+        table.insert( commands, arguments );
+        return original_run( command, arguments, ... );
+    end;
+    prepare( target );
+    local ok, failures = pcall( postorder, target, build_visit );
+    run = original_run;
+    assert( ok, failures );
+    return failures, commands;
+end
+
+-- Return the *commands* that contain *text*.
+function cc_test.matching( commands, text )
+    local matching = {};
+    for _, command in ipairs(commands) do
+        if command:find(text, 1, true) then
+            table.insert( matching, command );
+        end
+    end
+    return matching;
+end
+
+-- Build the target returned by *declare* twice, each time after loading
+-- the graph from *cache* as separate invocations of forge do, and call
+-- *change* between the two builds.  *declare* is passed the number of the
+-- build, 1 or 2, and returns the target to build followed by any values
+-- that the test needs.  Return the number of failures and the commands run
+-- by the second build followed by the values returned by *declare* for the
+-- second build.
+function cc_test.rebuild( cache, declare, change )
+    create( cache );
+    remove( cache );
+    load_binary( cache );
+    local first_failures = cc_test.build( declare(1) );
+    save_binary();
+    assert( first_failures == 0, 'first build failed' );
+
+    change();
+    load_binary( cache );
+    local declared = table.pack( declare(2) );
+    local failures, commands = cc_test.build( declared[1] );
+    remove( cache );
+    return failures, commands, table.unpack( declared, 1, declared.n );
+end
+
+return cc_test;
@@ -86,6 +86,23 @@ TestSuite {
         rm( destination );
     end;
 
+    cp_replaces_existing_files_and_cp_many_copies_each_pair = function()
+        create( 'cp_many_src.tmp', nil, 'hello' );
+        create( 'cp_many_dst_1.tmp', nil, 'stale' );
+        local source = root( 'cp_many_src.tmp' );
+        cp( root('cp_many_dst_1.tmp'), source );
+        cp_many( {
+            { root('cp_many_dst_1.tmp'), source };
+            { root('cp_many_dst_2.tmp'), source };
+        } );
+        CHECK( is_file(root('cp_many_dst_1.tmp')) );
+        CHECK( is_file(root('cp_many_dst_2.tmp')) );
+        CHECK( not pcall(cp_many, {{root('cp_many_dst_3.tmp'), root('cp_many_missing.tmp')}}) );
+        rm( root('cp_many_dst_1.tmp') );
+        rm( root('cp_many_dst_2.tmp') );
+        rm( source );
+    end;
+
     -- ls()
     ls_enumerates_directory_entries = function()
         local directory = root( 'ls_dir' );
@@ -112,17 +129,44 @@ TestSuite {
         create( 'find_dir/a.txt' );
         create( 'find_dir/nested/b.txt' );
         local found = {};
-        for entry in find( directory ) do
-            found[leaf(entry)] = true;
+        for entry, kind in find( directory ) do
+            found[leaf(entry)] = kind;
         end
-        CHECK( found['a.txt'] );
-        CHECK( found['b.txt'] );
+        CHECK_EQUAL( 'file', found['a.txt'] );
+        CHECK_EQUAL( 'file', found['b.txt'] );
+        CHECK_EQUAL( 'directory', found['nested'] );
         rm( root('find_dir/a.txt') );
         rm( root('find_dir/nested/b.txt') );
         rmdir( root('find_dir/nested') );
         rmdir( directory );
     end;
 
+    -- glob()
+    glob_matches_patterns_with_exclusions_and_extensions = function()
+        local directory = root( 'glob_dir' );
+        mkdir( root('glob_dir/nested/deeper') );
+        mkdir( root('glob_dir/excluded') );
+        create( 'glob_dir/a.cpp' );
+        create( 'glob_dir/b.txt' );
+        create( 'glob_dir/nested/c.cpp' );
+        create( 'glob_dir/nested/deeper/d.c' );
+        create( 'glob_dir/excluded/e.cpp' );
+        local filenames = glob( ('%s/**'):format(directory), {
+            exclude = ('%s/excluded'):format(directory);
+            extensions = { '.cpp', 'c' };
+        } );
+        CHECK_EQUAL( 3, #filenames );
+        CHECK_EQUAL( ('%s/a.cpp'):format(directory), filenames[1] );
+        CHECK_EQUAL( ('%s/nested/c.cpp'):format(directory), filenames[2] );
+        CHECK_EQUAL( ('%s/nested/deeper/d.c'):format(directory), filenames[3] );
+
+        create( 'glob_dir/nested/f.cpp' );
+        filenames = glob( ('%s/*/*.cpp'):format(directory) );
+        CHECK_EQUAL( 3, #filenames );
+        CHECK_EQUAL( ('%s/nested/f.cpp'):format(directory), filenames[3] );
+        rmdir( directory );
+    end;
+
     -- touch()
     touch_preserves_file = function()
         create( 'touch_preserves_file.tmp', 1000 );
@@ -1,4 +1,14 @@
 
+-- Return true if *targets* contains *target*.
+local function contains( targets, target )
+    for _, other in ipairs(targets) do
+        if other == target then
+            return true;
+        end
+    end
+    return false;
+end
+
 TestSuite {
     files_are_outdated_if_they_do_not_exist = function()
         local foo_cpp = Target( forge, 'outdated_missing_foo.cpp' );
@@ -54,4 +64,171 @@ TestSuite {
         local foo_cpp = Target( forge, 'children_foo.cpp', File );
         CHECK( foo_cpp:parent() == foo_cpp:working_directory() );
     end;
+
+    affected_targets_are_visited_without_unaffected_targets = function()
+        local a_cpp = Target( forge, 'affected_a.cpp' );
+        a_cpp:set_filename( a_cpp:path() );
+        local b_cpp = Target( forge, 'affected_b.cpp' );
+        b_cpp:set_filename( b_cpp:path() );
+        local a_obj = Target( forge, 'affected_a.obj' );
+        a_obj:add_dependency( a_cpp );
+        local b_obj = Target( forge, 'affected_b.obj' );
+        b_obj:add_dependency( b_cpp );
+        local affected_exe = Target( forge, 'affected.exe' );
+        affected_exe:add_dependency( a_obj );
+        affected_exe:add_dependency( b_obj );
+
+        local targets = affected_targets( {'affected_a.cpp'} );
+        CHECK_EQUAL( 3, #targets );
+        CHECK( targets[1] == a_cpp );
+        CHECK( targets[2] == a_obj );
+        CHECK( targets[3] == affected_exe );
+
+        local visited = {};
+        local failures = postorder( targets, function(target) table.insert(visited, target) end );
+        CHECK_EQUAL( 0, failures );
+        CHECK_EQUAL( 3, #visited );
+        CHECK( visited[1] == a_cpp );
+        CHECK( visited[2] == a_obj );
+        CHECK( visited[3] == affected_exe );
+    end;
+
+    shards_divide_dependencies_by_weight = function()
+        local shard_all = Target( forge, 'shard_all' );
+        local shard_large = Target( forge, 'shard_large' );
+        local shard_large_1 = Target( forge, 'shard_large_1' );
+        local shard_large_2 = Target( forge, 'shard_large_2' );
+        shard_large:add_dependency( shard_large_1 );
+        shard_large_1:add_dependency( shard_large_2 );
+        local shard_small_a = Target( forge, 'shard_small_a' );
+        local shard_small_b = Target( forge, 'shard_small_b' );
+        shard_all:add_dependency( shard_small_a );
+        shard_all:add_dependency( shard_large );
+        shard_all:add_dependency( shard_small_b );
+
+        -- The large dependency is heavier than a shard's share so it is
+        -- split and left for the final build along with the goal.
+        local first = shard_targets( shard_all, 1, 2 );
+        CHECK_EQUAL( 2, #first );
+        CHECK( contains(first, shard_large_1) );
+        CHECK( contains(first, shard_large_2) );
+
+        local second = shard_targets( shard_all, 2, 2 );
+        CHECK_EQUAL( 2, #second );
+        CHECK( contains(second, shard_small_a) );
+        CHECK( contains(second, shard_small_b) );
+        CHECK( not contains(first, shard_large) and not contains(second, shard_large) );
+
+        local only = shard_targets( shard_all, 1, 1 );
+        CHECK_EQUAL( 5, #only );
+    end;
+
+    shards_divide_the_jobs_of_a_single_large_dependency = function()
+        local all = Target( forge, 'shard_single_all' );
+        local executable = Target( forge, 'shard_single_executable' );
+        all:add_dependency( executable );
+        local objects = {};
+        for index = 1, 4 do
+            local object = Target( forge, ('shard_single_%d.o'):format(index) );
+            object:add_dependency( Target(forge, ('shard_single_%d.cpp'):format(index)) );
+            executable:add_dependency( object );
+            objects[index] = object;
+        end
+
+        local first = shard_targets( all, 1, 2 );
+        local second = shard_targets( all, 2, 2 );
+        CHECK_EQUAL( 4, #first );
+        CHECK_EQUAL( 4, #second );
+        for _, object in ipairs(objects) do
+            CHECK( contains(first, object) ~= contains(second, object) );
+        end
+        CHECK( not contains(first, executable) and not contains(second, executable) );
+    end;
+
+    dependencies_keep_their_order_when_there_are_many_of_them = function()
+        local target = Target( forge, 'many_dependencies' );
+        local dependencies = {};
+        for i = 1, 100 do
+            dependencies[i] = Target( forge, ('many_dependencies_%03d'):format(i) );
+            target:add_dependency( dependencies[i] );
+        end
+        target:add_dependency( dependencies[1] );
+        target:remove_dependency( dependencies[50] );
+        target:add_implicit_dependency( dependencies[2] );
+        target:add_ordering_dependency( dependencies[50] );
+
+        local expected = {};
+        for i = 2, 100 do
+            if i ~= 50 then
+                table.insert( expected, dependencies[i] );
+            end
+        end
+        table.insert( expected, dependencies[1] );
+        for i, dependency in ipairs(expected) do
+            CHECK( target:dependency(i) == dependency );
+        end
+        CHECK( target:dependency(#expected + 1) == nil );
+        CHECK( target:ordering_dependency(1) == dependencies[50] );
+    end;
+
+    mirrors_copy_changed_entries_and_remove_stale_entries = function()
+        local source = root( 'mirror_source' );
+        local destination = root( 'mirror_destination' );
+        mkdir( root('mirror_source/nested') );
+        create( 'mirror_source/a.txt', 1, 'a' );
+        create( 'mirror_source/nested/b.txt', 1, 'b' );
+        local mirror = Target( forge, 'mirror' );
+        mirror:set_filename( destination );
+        add_mirror( destination, source );
+        postorder( mirror, function() end );
+        CHECK( mirror:outdated() );
+
+        sync_mirror( destination );
+        CHECK( is_file(root('mirror_destination/a.txt')) );
+        CHECK( is_file(root('mirror_destination/nested/b.txt')) );
+
+        rm( root('mirror_source/a.txt') );
+        create( 'mirror_destination/unmirrored.txt' );
+        sync_mirror( destination );
+        CHECK( not exists(root('mirror_destination/a.txt')) );
+        CHECK( is_file(root('mirror_destination/nested/b.txt')) );
+        CHECK( is_file(root('mirror_destination/unmirrored.txt')) );
+
+        clean_mirror( destination );
+        CHECK( not exists(root('mirror_destination/nested')) );
+        CHECK( is_file(root('mirror_destination/unmirrored.txt')) );
+        rm( root('mirror_destination/unmirrored.txt') );
+        rmdir( destination );
+        rmdir( source );
+    end;
+
+    clean_targets_visits_targets_with_clean_functions_before_removing_files = function()
+        local dependency_filename;
+        local dependency_exists;
+        local Custom = Rule( 'CleanTargetsCustom' );
+        function Custom.clean( toolset, target )
+            dependency_filename = target:dependency(1):filename();
+            dependency_exists = exists( dependency_filename );
+        end
+        local foo_obj = Target( forge, 'clean_targets_foo.obj' );
+        foo_obj:set_filename( foo_obj:path() );
+        foo_obj:set_cleanable( true );
+        foo_obj:set_built( true );
+        local custom = Target( nil, 'clean_targets_custom', Custom );
+        custom:set_filename( custom:path() );
+        custom:set_cleanable( true );
+        custom:add_dependency( foo_obj );
+        create( 'clean_targets_foo.obj' );
+        create( 'clean_targets_custom' );
+
+        local failures = clean_targets( custom, clean_visit );
+        CHECK_EQUAL( 0, failures );
+        CHECK_EQUAL( root('clean_targets_foo.obj'), dependency_filename );
+        CHECK( dependency_exists );
+        CHECK( not exists(root('clean_targets_foo.obj')) );
+        CHECK( exists(root('clean_targets_custom')) );
+        CHECK_EQUAL( '', foo_obj:filename() );
+        CHECK( not foo_obj:built() );
+        rm( root('clean_targets_custom') );
+    end;
 };
@@ -0,0 +1,31 @@
+local forge = require( 'forge' );
+
+-- Load the forge module again from *directory* with a local settings file
+-- containing *local_settings* after setting the failure limit to
+-- *initial_limit* and return the failure limit that loading sets.
+local function load_failure_limit_test( directory, local_settings, initial_limit )
+    mkdir( root(directory) );
+    create( ('%s/local_settings.lua'):format(directory), 1, local_settings );
+    set_failure_limit( initial_limit );
+    forge.loaded = nil;
+    forge:load( directory );
+    local limit = failure_limit();
+    set_failure_limit( 0 );
+    rmdir( root(directory) );
+    return limit;
+end
+
+TestSuite {
+    load_without_keep_going_leaves_failure_limit_unset = function()
+        CHECK( keep_going == nil );
+        CHECK_EQUAL( 0, load_failure_limit_test('load_tests_unset', 'return {};', 0) );
+    end;
+
+    load_sets_failure_limit_from_local_settings = function()
+        CHECK_EQUAL( 3, load_failure_limit_test('load_tests_local_settings', 'return { keep_going = 3 };', 0) );
+    end;
+
+    load_keeps_failure_limit_set_by_fail_fast = function()
+        CHECK_EQUAL( 1, load_failure_limit_test('load_tests_fail_fast', 'return { keep_going = 3 };', 1) );
+    end;
+};
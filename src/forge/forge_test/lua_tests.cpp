@@ -41,6 +41,12 @@ SUITE( lua_tests )
         CHECK_EQUAL( 8, errors );
     }
 
+    TEST_FIXTURE( ForgeLuaFixture, toolset )
+    {
+        int errors = forge->file( "toolset_tests.lua" );
+        CHECK( errors == 0 );
+    }
+
     TEST_FIXTURE( ForgeLuaFixture, transitive_dependencies )
     {
         int errors = forge->file( "transitive_dependencies.lua" );
@@ -53,9 +59,33 @@ SUITE( lua_tests )
         CHECK_EQUAL( 1, errors );
     }
 
+    TEST_FIXTURE( ForgeLuaFixture, archive )
+    {
+        int errors = forge->file( "archive_tests.lua" );
+        CHECK( errors == 0 );
+    }
+
+    TEST_FIXTURE( ForgeLuaFixture, precompiled_header )
+    {
+        int errors = forge->file( "precompiled_header_tests.lua" );
+        CHECK( errors == 0 );
+    }
+
     TEST_FIXTURE( ForgeLuaFixture, postorder )
     {
         int errors = forge->file( "postorder_tests.lua" );
-        CHECK_EQUAL( 8, errors );
+        CHECK_EQUAL( 11, errors );
+    }
+
+    TEST_FIXTURE( ForgeLuaFixture, cache )
+    {
+        int errors = forge->file( "cache_tests.lua" );
+        CHECK_EQUAL( 2, errors );
+    }
+
+    TEST_FIXTURE( ForgeLuaFixture, load )
+    {
+        int errors = forge->file( "load_tests.lua" );
+        CHECK( errors == 0 );
     }
 }
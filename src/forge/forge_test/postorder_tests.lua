@@ -35,4 +35,91 @@ TestSuite {
         CHECK( error_message(0):find('Postorder called from within preorder or postorder', 1, true) ~= nil );
         CHECK_EQUAL( "Postorder visit of 'recursive_postorder_during_postorder_error' failed", error_message(1) );
     end;
+
+    cyclic_dependency_is_reported_and_handled = function()
+        local CyclicDependency = Rule( 'CyclicDependency' );
+        local cyclic_a = Target( forge, 'cyclic_a', CyclicDependency );
+        local cyclic_b = Target( forge, 'cyclic_b', CyclicDependency );
+        cyclic_a:add_dependency( cyclic_b );
+        cyclic_b:add_dependency( cyclic_a );
+        local failures = postorder( cyclic_a, function(target) end );
+        CHECK_EQUAL( 1, failures );
+        CHECK( error_message(0):find("Cyclic dependency from CyclicDependency '", 1, true) == 1 );
+        CHECK( error_message(0):find("/cyclic_b' to CyclicDependency '", 1, true) ~= nil );
+        CHECK( error_message(0):find("/cyclic_a' in bind", 1, true) ~= nil );
+    end;
+
+    postorder_stops_once_keep_going_failures_are_reached = function()
+        local KeepGoing = Rule( 'KeepGoing' );
+        local keep_going_all = Target( forge, 'keep_going_all', KeepGoing );
+        for i = 1, 3 do
+            keep_going_all:add_dependency( Target(forge, ('keep_going_%d'):format(i), KeepGoing) );
+        end
+        local visits = 0;
+        set_failure_limit( 1 );
+        local failures = postorder( keep_going_all, function(target)
+            visits = visits + 1;
+            error( 'Error in postorder visit' );
+        end );
+        set_failure_limit( 0 );
+        CHECK_EQUAL( 2, failures );
+        CHECK_EQUAL( 1, visits );
+        CHECK( error_message(0):find('Error in postorder visit', 1, true) ~= nil );
+        CHECK_EQUAL( "Postorder visit of 'keep_going_1' failed", error_message(1) );
+    end;
+
+    spawn_lua_calls_functions_on_worker_states_during_postorder = function()
+        create( 'spawn_lua_module.lua', 1, [[
+            return {
+                sum = function( values, offset )
+                    local total = offset;
+                    for _, value in ipairs(values) do
+                        total = total + value;
+                    end
+                    return total, { count = #values };
+                end;
+                fail = function()
+                    error( 'Error in worker state' );
+                end;
+            };
+        ]] );
+        local SpawnLua = Rule( 'SpawnLua' );
+        local spawn_lua_target = Target( forge, 'spawn_lua_target', SpawnLua );
+        local package_path = package.path;
+        package.path = './?.lua;'..package_path;
+        local total, summary, ok, message;
+        local failures = postorder( spawn_lua_target, function(target)
+            total, summary = spawn_lua( 'spawn_lua_module', 'sum', {1, 2, 3}, 10 );
+            ok, message = pcall( spawn_lua, 'spawn_lua_module', 'fail' );
+        end );
+        package.path = package_path;
+        CHECK_EQUAL( 0, failures );
+        CHECK_EQUAL( 16, total );
+        CHECK_EQUAL( 3, summary.count );
+        CHECK( not ok );
+        CHECK( message:find('Error in worker state', 1, true) ~= nil );
+    end;
+
+    deep_dependency_chain_is_visited_without_overflowing_the_stack = function()
+        local DEPTH = 1000000;
+        local DeepDependency = Rule( 'DeepDependency' );
+        local deepest = Target( forge, 'deep_dependency_1', DeepDependency );
+        local dependency = deepest;
+        for i = 2, DEPTH do
+            local target = Target( forge, ('deep_dependency_%d'):format(i), DeepDependency );
+            target:add_dependency( dependency );
+            dependency = target;
+        end
+        local visits = 0;
+        local first, last;
+        local failures = postorder( dependency, function(target) 
+            visits = visits + 1;
+            first = first or target;
+            last = target;
+        end );
+        CHECK_EQUAL( 0, failures );
+        CHECK_EQUAL( DEPTH, visits );
+        CHECK( first == deepest );
+        CHECK( last == dependency );
+    end;
 };
@@ -0,0 +1,118 @@
+local cc_test = dofile( root('cc_test.lua') );
+
+local SOURCES = {
+    ['prelude.hpp'] = '#include <string>\ninline int prelude() { return PRELUDE; }\n';
+    ['foo.cpp'] = 'int foo() { return prelude() + int(std::string("x").size()); }\n';
+    ['main.cpp'] = 'int foo(); int main() { return foo() - prelude() - 1; }\n';
+};
+
+-- Declare an executable in *directory* from sources that rely on a prelude
+-- header being included through the *precompiled_header* attribute and
+-- return the executable and the filenames of the precompiled headers that
+-- its objects are compiled with.
+local function declare_precompiled_header_test( directory, settings, defines )
+    local toolset = cc_test.toolset( directory, settings );
+    local objects = toolset:Cxx '${obj}/%1' {
+        precompiled_header = ('%s/prelude.hpp'):format( directory );
+        defines = defines or { 'PRELUDE=2' };
+        ('%s/foo.cpp'):format( directory );
+        ('%s/main.cpp'):format( directory );
+    };
+    local executable = toolset:Executable( ('${bin}/%s'):format(directory) ) {
+        objects;
+    };
+
+    local precompiled_headers = {};
+    for _, object in ipairs(objects) do
+        local precompiled_header = cc.precompiled_header( toolset, object );
+        if precompiled_header then
+            precompiled_headers[precompiled_header:filename()] = true;
+        end
+    end
+    return executable, precompiled_headers;
+end
+
+-- Return the number of *precompiled_headers* that exist.
+local function count_existing( precompiled_headers )
+    local count = 0;
+    for filename in pairs(precompiled_headers) do
+        if exists( filename ) then
+            count = count + 1;
+        end
+    end
+    return count;
+end
+
+-- Build an executable from sources that rely on a prelude header being
+-- included through the *precompiled_header* attribute and return the number
+-- of failures, whether the executable was built, and the number of
+-- precompiled headers built.
+local function build_precompiled_header_test( name, settings )
+    local directory = ('precompiled_header_tests_%s'):format( name );
+    cc_test.create_sources( directory, SOURCES );
+    local executable, precompiled_headers = declare_precompiled_header_test( directory, settings );
+    local failures = cc_test.build( executable );
+    local built = exists( executable );
+    local precompiled = count_existing( precompiled_headers );
+    rmdir( root(directory) );
+    return failures, built, precompiled;
+end
+
+if operating_system() == 'linux' then
+    TestSuite {
+        precompiled_header_is_shared_by_objects_with_the_same_flags = function()
+            local failures, built, precompiled = build_precompiled_header_test( 'shared', {} );
+            CHECK_EQUAL( 0, failures );
+            CHECK( built );
+            CHECK_EQUAL( 1, precompiled );
+        end;
+
+        precompiled_header_is_included_when_precompiling_is_disabled = function()
+            local failures, built, precompiled = build_precompiled_header_test( 'disabled', {pre_compiled_headers = false} );
+            CHECK_EQUAL( 0, failures );
+            CHECK( built );
+            CHECK_EQUAL( 0, precompiled );
+        end;
+
+        another_precompiled_header_is_built_when_defines_change = function()
+            local directory = 'precompiled_header_tests_defines';
+            cc_test.create_sources( directory, SOURCES );
+            local first_precompiled_headers;
+            local failures, commands, executable, precompiled_headers = cc_test.rebuild(
+                'precompiled_header_tests_defines.cache',
+                function( build )
+                    local executable, precompiled_headers = declare_precompiled_header_test( directory, {}, {('PRELUDE=%d'):format(build + 1)} );
+                    first_precompiled_headers = first_precompiled_headers or precompiled_headers;
+                    return executable, precompiled_headers;
+                end,
+                function() end
+            );
+            CHECK_EQUAL( 0, failures );
+            CHECK( exists(executable) );
+            CHECK_EQUAL( 1, count_existing(first_precompiled_headers) );
+            CHECK_EQUAL( 1, count_existing(precompiled_headers) );
+            for filename in pairs(precompiled_headers) do
+                CHECK( not first_precompiled_headers[filename] );
+            end
+            CHECK_EQUAL( 1, #cc_test.matching(commands, 'c++-header') );
+            rmdir( root(directory) );
+        end;
+
+        objects_are_built_again_when_the_precompiled_header_changes = function()
+            local directory = 'precompiled_header_tests_touched';
+            cc_test.create_sources( directory, SOURCES );
+            local failures, commands, executable, precompiled_headers = cc_test.rebuild(
+                'precompiled_header_tests_touched.cache',
+                function() return declare_precompiled_header_test( directory, {} ) end,
+                function() touch( ('%s/prelude.hpp'):format(directory), os.time() + 60 ) end
+            );
+            CHECK_EQUAL( 0, failures );
+            CHECK( exists(executable) );
+            CHECK_EQUAL( 1, count_existing(precompiled_headers) );
+            CHECK_EQUAL( 1, #cc_test.matching(commands, 'c++-header') );
+            CHECK_EQUAL( 1, #cc_test.matching(commands, 'foo.cpp') );
+            CHECK_EQUAL( 1, #cc_test.matching(commands, 'main.cpp') );
+            rmdir( root(directory) );
+        end;
+    };
+end
@@ -0,0 +1,70 @@
+
+local forge = require( 'forge' ):load();
+local toolset = forge.Toolset() {
+    obj = 'obj';
+    names = { debug = 'Debug' };
+    suffix = function( toolset, first, second ) return ('%s-%s'):format( first, second ); end;
+};
+
+TestSuite {
+    interpolate_returns_templates_without_substitutions_unchanged = function()
+        CHECK_EQUAL( 'foo/bar.o', toolset:interpolate('foo/bar.o') );
+        CHECK_EQUAL( '$obj/{bar}$', toolset:interpolate('$obj/{bar}$') );
+        CHECK_EQUAL( '${obj', toolset:interpolate('${obj') );
+    end;
+
+    interpolate_substitutes_variables_then_toolset_then_globals = function()
+        CHECK_EQUAL( 'obj/foo.o', toolset:interpolate('${obj}/foo.o') );
+        CHECK_EQUAL( 'out/foo.o', toolset:interpolate('${obj}/foo.o', {obj = 'out'}) );
+        CHECK_EQUAL( 'obj/foo.o', toolset:interpolate('${obj}/foo.o', {}) );
+        interpolate_test_global = 'global';
+        CHECK_EQUAL( 'global/obj', toolset:interpolate('${interpolate_test_global}/${obj}') );
+        interpolate_test_global = nil;
+    end;
+
+    interpolate_calls_functions_and_indexes_tables = function()
+        CHECK_EQUAL( 'a-b', toolset:interpolate('${suffix a b}') );
+        CHECK_EQUAL( 'Debug', toolset:interpolate('${names debug}') );
+        CHECK_EQUAL( 'obj-obj', toolset:interpolate('${suffix ${obj} ${obj}}') );
+    end;
+
+    interpolate_expands_nested_substitutions_first = function()
+        CHECK_EQUAL( 'obj', toolset:interpolate('${${key}}', {key = 'obj'}) );
+        CHECK_EQUAL( 'Debug/obj', toolset:interpolate('${names ${variant}}/${obj}', {variant = 'debug'}) );
+    end;
+
+    interpolate_reports_missing_substitutes = function()
+        local ok, message = pcall( toolset.interpolate, toolset, '${obj}/${missing_variable}' );
+        CHECK( not ok );
+        CHECK_EQUAL( 'Missing substitute for "missing_variable" in "${obj}/${missing_variable}"', message );
+        ok, message = pcall( toolset.interpolate, toolset, '${names ${missing_variant}}' );
+        CHECK( not ok );
+        CHECK_EQUAL( 'Missing substitute for "missing_variant" in "names ${missing_variant}"', message );
+    end;
+
+    cpdir_copies_files_and_symbolic_links_to_files = function()
+        if operating_system() ~= 'windows' then
+            mkdir( root('cpdir_source/nested') );
+            create( 'cpdir_source/nested/a.txt', 1, 'a' );
+            create( 'cpdir_linked.txt', 1, 'linked' );
+            os.execute( ('ln -s "%s" "%s"'):format(root('cpdir_linked.txt'), root('cpdir_source/linked.txt')) );
+            toolset:cpdir( root('cpdir_destination'), root('cpdir_source') );
+            CHECK( is_file(root('cpdir_destination/nested/a.txt')) );
+            CHECK( is_file(root('cpdir_destination/linked.txt')) );
+            rmdir( root('cpdir_source') );
+            rmdir( root('cpdir_destination') );
+        end
+    end;
+
+    cpdir_copies_to_relative_destinations = function()
+        mkdir( root('cpdir_relative_source/nested') );
+        create( 'cpdir_relative_source/nested/a.txt', 1, 'a' );
+        create( 'cpdir_relative_source/b.txt', 1, 'b' );
+        toolset:cpdir( 'cpdir_relative_destination', 'cpdir_relative_source' );
+        CHECK( is_file(root('cpdir_relative_destination/nested/a.txt')) );
+        CHECK( is_file(root('cpdir_relative_destination/b.txt')) );
+        CHECK( not exists(root('cpdir_relative_source/cpdir_relative_destination')) );
+        rmdir( root('cpdir_relative_source') );
+        rmdir( root('cpdir_relative_destination') );
+    end;
+};
@@ -29,4 +29,76 @@ TestSuite {
         CHECK( exe:dependency(3) == baz );
         CHECK( exe:dependency(4) == nil );
     end;
+
+    transitive_dependencies_are_listed_once_before_their_dependencies = function()
+        local left = toolset:StaticLibrary 'left' { 'shared' };
+        local right = toolset:StaticLibrary 'right' { 'shared' };
+        local shared = toolset:StaticLibrary 'shared' {};
+        local top = toolset:StaticLibrary 'top' { 'left'; 'right' };
+        local libraries = top:transitive_dependencies {
+            dependencies = 'all';
+            rules = { toolset.StaticLibrary };
+            recurse_yielded = true;
+        };
+        CHECK_EQUAL( 3, #libraries );
+        CHECK( libraries[1] == left );
+        CHECK( libraries[2] == right );
+        CHECK( libraries[3] == shared );
+        CHECK_EQUAL( 0, #top:transitive_dependencies() );
+    end;
+
+    transitive_dependencies_recurse_into_targets_without_filenames = function()
+        local group = Target( toolset, 'transitive_group' );
+        local object = Target( toolset, 'transitive_object.o' );
+        object:set_filename( object:path() );
+        group:add_dependency( object );
+        local binary = Target( toolset, 'transitive_binary' );
+        binary:add_dependency( group );
+        binary:add_dependency( object );
+        local dependencies = binary:transitive_dependencies();
+        CHECK_EQUAL( 1, #dependencies );
+        CHECK( dependencies[1] == object );
+    end;
+
+    prepare_is_skipped_when_dependency_structure_is_unchanged = function()
+        local exe = toolset:Executable 'prepared_exe' { 'prepared_foo' };
+        local foo = toolset:StaticLibrary 'prepared_foo' { 'prepared_bar' };
+        local bar = toolset:StaticLibrary 'prepared_bar' {};
+        local prepares = 0;
+        exe.prepare = structural_prepare( function( toolset, target )
+            prepares = prepares + 1;
+            cc.collect_transitive_dependencies( toolset, target );
+        end );
+
+        local structural_hash = exe:structural_hash();
+        prepare( exe );
+        CHECK_EQUAL( 1, prepares );
+        CHECK( exe:dependency(2) == bar );
+
+        exe:remove_dependency( bar );
+        bar:add_implicit_dependency( Target(nil, 'prepared_bar.hpp') );
+        CHECK_EQUAL( structural_hash, exe:structural_hash() );
+        prepare( exe );
+        CHECK_EQUAL( 1, prepares );
+        CHECK( exe:dependency(2) == bar );
+
+        exe:remove_dependency( bar );
+        local baz = toolset:StaticLibrary 'prepared_baz' {};
+        foo:add_passive_dependency( baz );
+        CHECK( structural_hash ~= exe:structural_hash() );
+        prepare( exe );
+        CHECK_EQUAL( 2, prepares );
+        CHECK( exe:dependency(3) == baz );
+    end;
+
+    prepare_is_always_called_when_not_structural = function()
+        local exe = toolset:Executable 'unstructured_exe' {};
+        local prepares = 0;
+        exe.prepare = function( toolset, target )
+            prepares = prepares + 1;
+        end;
+        prepare( exe );
+        prepare( exe );
+        CHECK_EQUAL( 2, prepares );
+    end;
 };
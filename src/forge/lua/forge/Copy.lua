@@ -1,8 +1,7 @@
 local Copy = PatternRule('Copy');
 
 function Copy.build(toolset, target)
-    rm(target);
-    cp(target, target:dependency());
+    cp(target, target:dependency(), toolset.link_copies);
 end
 
 return Copy;
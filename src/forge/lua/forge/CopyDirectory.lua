@@ -1,35 +1,26 @@
-local Copy = require('forge.Copy');
 local CopyDirectory = Rule('CopyDirectory');
 
 function CopyDirectory.create(toolset, identifier)
     local identifier = toolset:interpolate(identifier);
     local copy_directory = Target(toolset, anonymous(), CopyDirectory);
-    copy_directory:add_ordering_dependency(toolset:Directory(absolute(identifier)));
+    copy_directory:set_filename(absolute(identifier));
     return copy_directory;
 end
 
 function CopyDirectory.depend(toolset, target, dependencies)
+    local destination_directory = target:filename();
     for _, value in ipairs(dependencies) do
-        local source_directory = toolset:interpolate(value);
-        local destination_directory = target:ordering_dependency():filename();
-        local cache = find_target(forge.cache);
-        cache:add_dependency(toolset:SourceDirectory(source_directory));
-
-        pushd(source_directory);
-        for source_filename in find('') do
-            if is_file(source_filename) then
-                local filename = absolute(relative(source_filename), destination_directory);
-                local copy = toolset:Copy(filename) {
-                    source_filename;
-                };
-                target:add_dependency(copy[1]);
-            elseif is_directory(source_filename) then
-                local directory = toolset:SourceDirectory(source_filename);
-                cache:add_dependency(directory);
-            end
-        end
-        popd();
+        local source_directory = absolute(toolset:interpolate(value));
+        add_mirror(destination_directory, source_directory);
     end
 end
 
+function CopyDirectory.build(toolset, target)
+    sync_mirror(target:filename());
+end
+
+function CopyDirectory.clean(toolset, target)
+    clean_mirror(target:filename());
+end
+
 return CopyDirectory;
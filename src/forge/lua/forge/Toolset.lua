@@ -66,40 +66,8 @@ function Toolset:install(module)
     end
 end
 
--- Provide GNU Make like string substitution.
-function Toolset:interpolate(template, variables)
-    local function split(input)
-        local output = {};
-        for value in input:gmatch('%S+') do
-            table.insert(output, value);
-        end
-        return output;
-    end
-
-    local variables = variables or self;
-    return (template:gsub('%$(%b{})', function (word)
-        local parameters = split(self:interpolate(word:sub(2, -2), variables));
-        local identifier = parameters[1];
-        local index = 1;
-        local substitute = variables and variables[identifier];
-        if not substitute then
-            substitute = self[identifier];
-        end
-        if not substitute then
-            substitute = _G[identifier]
-        end
-        if not substitute then
-            substitute = os.getenv(identifier);
-        end
-        if type(substitute) == 'function' then
-            substitute = substitute(self, table.unpack(parameters, 2));
-        elseif type(substitute) == 'table' then
-            substitute = substitute[parameters[2]];
-        end
-        assertf(substitute, 'Missing substitute for "%s" in "%s"', identifier, template);
-        return substitute or word;
-    end));
-end
+-- `Toolset:interpolate(template, variables)` provides GNU Make like string
+-- substitution and is implemented natively in *LuaToolset.cpp*.
 
 -- Add dependencies detected by the injected build hooks library to the
 -- target /target/.
@@ -170,20 +138,23 @@ function Toolset:obj_directory(target)
 end
 
 -- Recursively copy files from *source* to *destination*.
+--
+-- Symbolic links to files are copied as the files that they link to.
 function Toolset:cpdir(destination, source, variables)
     local variables = variables or self;
-    local destination = self:interpolate(destination, variables);
-    local source = self:interpolate(source, variables);
+    local destination = absolute(self:interpolate(destination, variables));
+    local source = absolute(self:interpolate(source, variables));
+    local copies = {};
     pushd(source);
-    for source_filename in find('') do
-        if is_file(source_filename) then
+    for source_filename, kind in find('') do
+        if kind == 'file' or (kind == 'link' and is_file(source_filename)) then
             local filename = ('%s/%s'):format(destination, relative(source_filename));
             mkdir(branch(filename));
-            rm(filename);
-            cp(filename, source_filename);
+            table.insert(copies, {filename, absolute(source_filename)});
         end
     end
     popd();
+    cp_many(copies);
 end
 
 -- Find first existing file named *filename* in *paths*.
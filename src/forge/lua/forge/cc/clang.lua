@@ -16,21 +16,29 @@ function clang.install(toolset)
     exists(settings.ar);
 
     local Cc = PatternRule('Cc', clang.object_filename);
+    Cc.created = function (toolset, target) clang.add_precompiled_header(toolset, target, 'c') end;
     Cc.build = function (toolset, target) clang.compile(toolset, target, 'c') end;
     toolset.Cc = Cc;
 
     local Cxx = PatternRule('Cxx', clang.object_filename);
+    Cxx.created = function (toolset, target) clang.add_precompiled_header(toolset, target, 'c++') end;
     Cxx.build = function (toolset, target) clang.compile(toolset, target, 'c++') end;
     toolset.Cxx = Cxx;
 
     local ObjC = PatternRule('ObjC', clang.object_filename);
+    ObjC.created = function (toolset, target) clang.add_precompiled_header(toolset, target, 'objective-c') end;
     ObjC.build = function (toolset, target) clang.compile(toolset, target, 'objective-c') end;
     toolset.ObjC = ObjC;
 
     local ObjCxx = PatternRule('ObjCxx', clang.object_filename);
+    ObjCxx.created = function (toolset, target) clang.add_precompiled_header(toolset, target, 'objective-c++') end;
     ObjCxx.build = function (toolset, target) clang.compile(toolset, target, 'objective-c++') end;
     toolset.ObjCxx = ObjCxx;
 
+    local PrecompiledHeader = FileRule('PrecompiledHeader', clang.precompiled_header_filename);
+    PrecompiledHeader.build = clang.precompile;
+    toolset.PrecompiledHeader = PrecompiledHeader;
+
     local StaticLibrary = FileRule('StaticLibrary', clang.static_library_filename);
     StaticLibrary.depend = cc.static_library_depend;
     StaticLibrary.build = clang.archive;
@@ -52,14 +60,17 @@ function clang.install(toolset)
         debug = true;
         exceptions = true;
         generate_map_file = true;
+        incremental_archives = false;
         objc_arc = true;
         objc_modules = true;
         optimization = false;
+        pre_compiled_headers = true;
         preprocess = false;
         run_time_type_info = true;
         standard = 'c++17';
         standard_library = 'libc++';
         strip = false;
+        thin_archives = false;
         toolchain = 'clang';
         verbose_linking = false;
         warning_level = 3;
@@ -73,6 +84,12 @@ function clang.object_filename(toolset, identifier)
     return ('%s.o'):format(identifier);
 end
 
+function clang.precompiled_header_filename(toolset, identifier)
+    local identifier = absolute(toolset:interpolate(identifier));
+    local filename = ('%s.pch'):format(identifier);
+    return identifier, filename;
+end
+
 function clang.static_library_filename(toolset, identifier)
     local identifier = absolute(toolset:interpolate(identifier));
     local filename = ('%s/lib%s.a'):format(branch(identifier), leaf(identifier));
@@ -109,6 +126,7 @@ function clang.compile(toolset, target, language)
     clang.append_include_directories(toolset, target, flags);
     clang.append_framework_directories(toolset, target, flags);
     clang.append_compile_flags(toolset, target, flags, language);
+    clang.append_precompiled_header(toolset, target, flags);
 
     local ccflags = table.concat(flags, ' ');
     local cc;
@@ -131,37 +149,35 @@ function clang.compile(toolset, target, language)
     clang.parse_dependencies_file(toolset, dependencies, target);
 end
 
+-- Precompile a header with the flags recorded when the precompiled header
+-- was added to the objects that use it.  The language is given explicitly
+-- in those flags so the C++ driver precompiles headers for any language.
+function clang.precompile(toolset, target)
+    local cxx = toolset.clang.cxx;
+    local environment = { PATH = branch(cxx) };
+    local header = target:dependency();
+    printf(leaf(header));
+    local dependencies = ('%s.d'):format(target);
+    local output = target:filename();
+    local input = absolute(header);
+    run(
+        cxx,
+        ('%s %s -MMD -MF "%s" -o "%s" "%s"'):format(leaf(cxx), target.precompile_flags, dependencies, output, input),
+        environment
+    );
+    clang.parse_dependencies_file(toolset, dependencies, target);
+end
+
 -- Archive objects into a static library.
 function clang.archive(toolset, target)
-    pushd(toolset:obj_directory(target));
-    local objects = {};
-    local outdated_objects = 0;
-    for _, dependency in target:dependencies() do
-        local rule = dependency:rule();
-        if rule ~= toolset.Directory and rule ~= toolset.StaticLibrary and rule ~= toolset.DynamicLibrary then
-            table.insert(objects, relative(dependency));
-            if dependency:outdated() then
-                outdated_objects = outdated_objects + 1;
-            end
-        end
-    end
-    if outdated_objects > 0 or not exists(target) then
-        printf(leaf(target));
-        local objects = table.concat(objects, '" "');
-        local ar = toolset.clang.ar;
-        local environment = { PATH = branch(ar) };
-        run(ar, ('ar -rcs "%s" "%s"'):format(native(target), objects), environment);
-    else
-        touch(target);
-    end
-    popd();
+    cc.archive(toolset, target, toolset.clang.ar);
 end
 
 -- Link dynamic libraries and executables.
 function clang.link(toolset, target)
     local objects = {};
     pushd(toolset:obj_directory(target));
-    for _, dependency in walk_dependencies(target) do
+    for _, dependency in ipairs(target:transitive_dependencies()) do
         local rule = dependency:rule();
         if rule ~= toolset.StaticLibrary and rule ~= toolset.DynamicLibrary and rule ~= toolset.Directory then
             table.insert(objects, relative(dependency));
@@ -253,7 +269,7 @@ function clang.append_compile_flags(toolset, target, flags, language)
             table.insert(flags, '-fobjc-arc');
         end
         if toolset.objc_modules then
-            if language == 'objective-c' then
+            if language == 'objective-c' or language == 'objective-c-header' then
                 table.insert(flags, '-fmodules');
             end
         end
@@ -303,6 +319,35 @@ function clang.append_compile_flags(toolset, target, flags, language)
     end
 end
 
+-- Add a precompiled header, for the header named in *target*'s
+-- *precompiled_header* attribute, to the compile target *target*.
+function clang.add_precompiled_header(toolset, target, language)
+    if target.precompiled_header then
+        local flags = {};
+        clang.append_defines(toolset, target, flags);
+        clang.append_include_directories(toolset, target, flags);
+        clang.append_framework_directories(toolset, target, flags);
+        clang.append_compile_flags(toolset, target, flags, language);
+        local header_flags = {};
+        clang.append_defines(toolset, target, header_flags);
+        clang.append_include_directories(toolset, target, header_flags);
+        clang.append_framework_directories(toolset, target, header_flags);
+        clang.append_compile_flags(toolset, target, header_flags, ('%s-header'):format(language));
+        cc.add_precompiled_header(toolset, target, table.concat(flags, ' '), table.concat(header_flags, ' '));
+    end
+end
+
+-- Include the header named in *target*'s *precompiled_header* attribute,
+-- from its precompiled header if there is one, ahead of the source.
+function clang.append_precompiled_header(toolset, target, flags)
+    local precompiled_header = cc.precompiled_header(toolset, target);
+    if precompiled_header then
+        table.insert(flags, ('-include-pch "%s"'):format(precompiled_header:filename()));
+    elseif target.precompiled_header then
+        table.insert(flags, ('-include "%s"'):format(target.precompiled_header));
+    end
+end
+
 function clang.append_library_directories(toolset, target, flags)
     clang.append_flags(flags, target.library_directories, '-L "%s"');
     clang.append_flags(flags, toolset.library_directories, '-L "%s"');
@@ -16,13 +16,19 @@ function gcc.install(toolset)
     assert(exists(settings.ar));
 
     local Cc = PatternRule('Cc', gcc.object_filename);
+    Cc.created = function (toolset, target) gcc.add_precompiled_header(toolset, target, 'c') end;
     Cc.build = function (toolset, target) gcc.compile(toolset, target, 'c') end;
     toolset.Cc = Cc;
 
     local Cxx = PatternRule('Cxx', gcc.object_filename);
+    Cxx.created = function (toolset, target) gcc.add_precompiled_header(toolset, target, 'c++') end;
     Cxx.build = function (toolset, target) gcc.compile(toolset, target, 'c++') end;
     toolset.Cxx = Cxx;
 
+    local PrecompiledHeader = FileRule('PrecompiledHeader', gcc.precompiled_header_filename);
+    PrecompiledHeader.build = gcc.precompile;
+    toolset.PrecompiledHeader = PrecompiledHeader;
+
     local StaticLibrary = FileRule('StaticLibrary', gcc.static_library_filename);
     StaticLibrary.build = gcc.archive;
     StaticLibrary.depend = cc.static_library_depend;
@@ -45,11 +51,14 @@ function gcc.install(toolset)
         exceptions = true;
         fast_floating_point = false;
         generate_map_file = true;
+        incremental_archives = false;
         optimization = false;
+        pre_compiled_headers = true;
         preprocess = false;
         run_time_type_info = true;
         standard = 'c++17';
         strip = false;
+        thin_archives = false;
         toolchain = 'gcc';
         verbose_linking = false;
         warning_level = 3;
@@ -63,6 +72,12 @@ function gcc.object_filename(toolset, identifier)
     return ('%s.o'):format(identifier);
 end
 
+function gcc.precompiled_header_filename(toolset, identifier)
+    local identifier = absolute(toolset:interpolate(identifier));
+    local filename = ('%s.gch'):format(identifier);
+    return identifier, filename;
+end
+
 function gcc.static_library_filename(toolset, identifier)
     local identifier = absolute(toolset:interpolate(identifier));
     local filename = ('%s/lib%s.a'):format(branch(identifier), leaf(identifier));
@@ -87,6 +102,7 @@ function gcc.compile(toolset, target, language)
     gcc.append_defines(toolset, target, flags);
     gcc.append_include_directories(toolset, target, flags);
     gcc.append_compile_flags(toolset, target, flags, language);
+    gcc.append_precompiled_header(toolset, target, flags);
 
     local gcc_ = toolset.gcc.gcc;
     local environment = { PATH = branch(gcc_) };
@@ -105,30 +121,26 @@ function gcc.compile(toolset, target, language)
     );
 end
 
+-- Precompile a header with the flags recorded when the precompiled header
+-- was added to the objects that use it.
+function gcc.precompile(toolset, target)
+    local gcc_ = toolset.gcc.gcc;
+    local environment = { PATH = branch(gcc_) };
+    local header = target:dependency();
+    local output = target:filename();
+    local input = absolute(header:filename());
+    printf(leaf(header:id()));
+    run(
+        gcc_,
+        ('gcc %s -o "%s" "%s"'):format(target.precompile_flags, output, input),
+        environment,
+        toolset:dependencies_filter(target)
+    );
+end
+
 -- Archive objects into a static library.
 function gcc.archive(toolset, target)
-    pushd(toolset:obj_directory(target));
-    local objects = {};
-    local outdated_objects = 0;
-    for _, dependency in target:dependencies() do
-        local rule = dependency:rule();
-        if rule ~= toolset.Directory and rule ~= toolset.StaticLibrary and rule ~= toolset.DynamicLibrary then
-            table.insert(objects, relative(dependency));
-            if dependency:outdated() then
-                outdated_objects = outdated_objects + 1;
-            end
-        end
-    end
-    if outdated_objects > 0 or not exists(target) then
-        printf(leaf(target));
-        local objects = table.concat(objects, '" "');
-        local ar = toolset.gcc.ar;
-        local environment = { PATH = branch(ar) };
-        run(ar, ('ar -rcs "%s" "%s"'):format(native(target), objects), environment);
-    else
-        touch(target);
-    end
-    popd();
+    cc.archive(toolset, target, toolset.gcc.ar);
 end
 
 -- Link dynamic libraries and executables.
@@ -136,7 +148,7 @@ function gcc.link(toolset, target)
     pushd(toolset:obj_directory(target));
 
     local objects = {};
-    for _, dependency in walk_dependencies(target) do
+    for _, dependency in ipairs(target:transitive_dependencies()) do
         local rule = dependency:rule();
         if rule ~= toolset.StaticLibrary and rule ~= toolset.DynamicLibrary and rule ~= toolset.Directory then
             table.insert(objects, relative(dependency));
@@ -251,6 +263,34 @@ function gcc.append_compile_flags(toolset, target, flags, language)
     end
 end
 
+-- Add a precompiled header, for the header named in *target*'s
+-- *precompiled_header* attribute, to the compile target *target*.
+function gcc.add_precompiled_header(toolset, target, language)
+    if target.precompiled_header then
+        local flags = {};
+        gcc.append_defines(toolset, target, flags);
+        gcc.append_include_directories(toolset, target, flags);
+        gcc.append_compile_flags(toolset, target, flags, language);
+        local header_flags = {};
+        gcc.append_defines(toolset, target, header_flags);
+        gcc.append_include_directories(toolset, target, header_flags);
+        gcc.append_compile_flags(toolset, target, header_flags, ('%s-header'):format(language));
+        cc.add_precompiled_header(toolset, target, table.concat(flags, ' '), table.concat(header_flags, ' '));
+    end
+end
+
+-- Include the header named in *target*'s *precompiled_header* attribute,
+-- from its precompiled header if there is one, ahead of the source.
+function gcc.append_precompiled_header(toolset, target, flags)
+    local precompiled_header = cc.precompiled_header(toolset, target);
+    if precompiled_header then
+        table.insert(flags, '-Winvalid-pch');
+        table.insert(flags, ('-include "%s"'):format(precompiled_header:path()));
+    elseif target.precompiled_header then
+        table.insert(flags, ('-include "%s"'):format(target.precompiled_header));
+    end
+end
+
 function gcc.append_library_directories(toolset, target, flags)
     gcc.append_flags(flags, target.library_directories, '-L "%s"');
     gcc.append_flags(flags, toolset.library_directories, '-L "%s"');
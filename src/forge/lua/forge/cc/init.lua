@@ -10,30 +10,26 @@ local cc = {};
 -- executable or dynamic library at the root of the walk.
 --
 -- Duplicate libraries are removed and the libraries are ordered such that
--- dependent libraries are listed earlier on the linker command line.
-function cc.collect_transitive_dependencies(toolset, target)
-    local function yield_recurse_on_library(target)
-        local rule = target:rule();
-        local yield = rule == toolset.StaticLibrary;
-        local recurse = yield or rule == nil;
-        return yield, recurse;
-    end
-
-    local libraries = {};
-    local index_by_library = {};
-    for _, dependency in walk_all_dependencies(target, yield_recurse_on_library) do
-        table.insert(libraries, dependency);
-        index_by_library[dependency] = #libraries;
-    end
-
-    for index, library in ipairs(libraries) do
-        if index == index_by_library[library] then
-            target:add_dependency(library);
-        end
+-- dependent libraries are listed earlier on the linker command line.  The
+-- libraries reachable from each static library are remembered for the rest
+-- of the prepare pass so that libraries shared by many executables are only
+-- walked once.
+--
+-- Only the rules of, and dependencies between, targets are examined so the
+-- call is skipped while the dependency structure is unchanged (see
+-- `structural_prepare()`).
+cc.collect_transitive_dependencies = structural_prepare(function(toolset, target)
+    local libraries = target:transitive_dependencies {
+        dependencies = { 'explicit', 'passive' };
+        rules = { toolset.StaticLibrary };
+        recurse_yielded = true;
+        recurse_unruled = true;
+    };
+    for _, library in ipairs(libraries) do
+        target:add_dependency(library);
     end
-
     prune();
-end
+end);
 
 -- Implement depend() for transitive dependencies on static libraries.
 --
@@ -55,6 +51,99 @@ function cc.static_library_depend(toolset, target, dependencies)
     end
 end
 
+-- Archive objects into a static library with `ar`.
+--
+-- Every object is archived whenever any object is outdated unless the
+-- *incremental_archives* setting is true, in which case only the members
+-- for outdated objects are replaced.  The members archived are recorded
+-- with `Target.set_built_inputs()` so that they're saved with the cache.
+-- Thin archives, that reference objects in place rather than copying
+-- them, are made when the *thin_archives* setting is true; their member
+-- paths are stored relative to the archive.  The archive is removed and
+-- made again from every object whenever the objects archived or the kind
+-- of archive changes so that removed objects don't linger as stale
+-- members.
+function cc.archive(toolset, target, ar)
+    pushd(toolset:obj_directory(target));
+    local objects = {};
+    local outdated_objects = {};
+    for _, dependency in target:dependencies() do
+        local rule = dependency:rule();
+        if rule ~= toolset.Directory and rule ~= toolset.StaticLibrary and rule ~= toolset.DynamicLibrary then
+            local object = relative(dependency);
+            table.insert(objects, object);
+            if dependency:outdated() then
+                table.insert(outdated_objects, object);
+            end
+        end
+    end
+
+    local thin = toolset.thin_archives == true;
+    local members = ('%s\n%s'):format(thin and 'thin' or 'normal', table.concat(objects, '\n'));
+    local unchanged = exists(target) and target:built_inputs() == members;
+    if #outdated_objects > 0 or not unchanged then
+        printf(leaf(target));
+        local replaced_objects = objects;
+        if unchanged and toolset.incremental_archives then
+            replaced_objects = outdated_objects;
+        else
+            rm(target);
+        end
+        local flags = thin and '-rcs --thin' or '-rcs';
+        local archive = thin and relative(target) or target:filename();
+        local environment = { PATH = branch(ar) };
+        run(ar, ('ar %s "%s" "%s"'):format(flags, native(archive), table.concat(replaced_objects, '" "')), environment);
+        target:set_built_inputs(members);
+    else
+        touch(target);
+    end
+    popd();
+end
+
+-- Make the compile target *target* depend on a precompiled header for the
+-- header named by its *precompiled_header* attribute.
+--
+-- The precompiled header is identified by a hash of the header's path and
+-- *flags*, the flags that *target* is compiled with, so that a header is
+-- precompiled once for each toolset and combination of flags and shared by
+-- every object compiled with them.  Changing the flags names a different
+-- precompiled header rather than rebuilding a shared one so objects are
+-- never compiled against a precompiled header built with other flags.
+-- The header is precompiled with *header_flags*.
+--
+-- The *precompiled_header* attribute is replaced with the absolute path to
+-- the header so that it can still be included, without being precompiled,
+-- when the *pre_compiled_headers* setting is false.
+function cc.add_precompiled_header(toolset, target, flags, header_flags)
+    local header = target.precompiled_header;
+    if header then
+        local header = toolset:SourceFile(header);
+        target.precompiled_header = header:filename();
+        local previous_precompiled_header = cc.precompiled_header(toolset, target);
+        if previous_precompiled_header then
+            target:remove_dependency(previous_precompiled_header);
+        end
+        if toolset.pre_compiled_headers then
+            local key = hash { header = header:filename(); flags = flags };
+            local identifier = ('${obj}/precompiled_headers/%016x/%s'):format(key, leaf(header));
+            local precompiled_header = toolset:PrecompiledHeader(identifier);
+            precompiled_header.precompile_flags = header_flags;
+            precompiled_header:add_dependency(header);
+            target:add_dependency(precompiled_header);
+        end
+    end
+end
+
+-- Get the precompiled header that the compile target *target* is compiled
+-- with or nil if it isn't compiled with a precompiled header.
+function cc.precompiled_header(toolset, target)
+    for _, dependency in target:dependencies() do
+        if dependency:rule() == toolset.PrecompiledHeader then
+            return dependency;
+        end
+    end
+end
+
 _G.cc = cc;
 
 local operating_system = _G.operating_system();
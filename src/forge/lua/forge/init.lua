@@ -17,11 +17,38 @@ function default()
     return build();
 end
 
--- Call prepare on targets that provide it.
+-- Prepare functions that depend only on the dependency structure that the
+-- structural hash covers (see `structural_prepare()`).
+local structural_prepares = setmetatable({}, {__mode = 'k'});
+
+-- Mark *prepare_function* as depending only on the paths, rules, filenames,
+-- settings, and dependencies of the targets that it prepares and their
+-- transitive dependencies so that calls to it can be skipped when none of
+-- those have changed (see `prepare_visit()`).
+--
+-- Returns *prepare_function*.
+function structural_prepare(prepare_function)
+    structural_prepares[prepare_function] = true;
+    return prepare_function;
+end
+
+-- Call prepare on targets that provide it.  Targets with structural prepare
+-- functions whose dependency structure is unchanged since they were last
+-- prepared have the dependencies that prepare added then restored instead.
+-- Other prepare functions may read attributes the structural hash doesn't
+-- cover so they are always called.
 function prepare_visit(target)
     local prepare_function = target.prepare;
     if prepare_function then
-        return prepare_function(target.toolset, target);
+        if structural_prepares[prepare_function] then
+            local structural_hash = target:structural_hash();
+            if not target:prepared(structural_hash) then
+                prepare_function(target.toolset, target);
+                target:set_prepared(structural_hash);
+            end
+        else
+            prepare_function(target.toolset, target);
+        end
     end
 end
 
@@ -68,23 +95,112 @@ function prepare(target)
     return failures;
 end
 
+-- Expand a variable naming files into an array of absolute paths.
+--
+-- The value is a comma separated list of files or '@' followed by the name 
+-- of a file that lists one file per line.  Relative paths are relative to
+-- the root directory.
+local function file_list(value, name)
+    assertf(value, 'Set %s to a list of files or @ and a file listing them', name);
+    local filenames = {};
+    local function add_filename(filename)
+        filename = filename:match('^%s*(.-)%s*$');
+        if filename ~= '' then
+            table.insert(filenames, root(filename));
+        end
+    end
+    if value:sub(1, 1) == '@' then
+        local list = value:sub(2);
+        assertf(exists(list), 'The list of files "%s" does not exist', list);
+        for line in io.lines(list) do
+            add_filename(line);
+        end
+    else
+        for filename in value:gmatch('[^,]+') do
+            add_filename(filename);
+        end
+    end
+    return filenames;
+end
+
 -- Build action.
+--
+-- Builds just one shard of the build when `shard` is set to "k/N" (e.g. 
+-- `forge shard=2/4`).  The dependencies of the goal, split into smaller
+-- subgraphs where they are too large to balance, are divided between N
+-- shards deterministically and shard k builds those assigned to it and 
+-- everything they depend on.  Merge the shards' caches with the *merge* 
+-- command before a final build of the goal itself.
 function build()
     local target = find_initial_target(goal);
-    local failures = prepare(target) + postorder(target, build_visit);
+    local failures = prepare(target);
+    if shard then
+        local index, count = tostring(shard):match('^(%d+)/(%d+)$');
+        index, count = tonumber(index), tonumber(count);
+        assertf(index and count and index >= 1 and index <= count, 'Set shard to k/N with 1 <= k <= N, e.g. shard=1/4, not "%s"', tostring(shard));
+        local targets = shard_targets(target, index, count);
+        failures = failures + postorder(targets, build_visit);
+        forge:save();
+        printf("forge: build (shard %d/%d, %d targets)=%dms", index, count, #targets, math.ceil(ticks()));
+        return failures;
+    end
+    failures = failures + postorder(target, build_visit);
     forge:save();
     printf("forge: default (build)=%dms", math.ceil(ticks()));
     return failures;
 end
 
 -- Clean action.
+--
+-- Cleanable targets without a "clean" function have their files removed in
+-- bulk by clean_targets() after the targets with a "clean" function have been
+-- visited.
 function clean()
-    local failures = postorder(find_initial_target(goal), clean_visit);
+    local failures = clean_targets(find_initial_target(goal), clean_visit);
     forge:save();
     printf("forge: clean=%sms", tostring(math.ceil(ticks())));
     return failures;
 end
 
+-- Affected action.
+--
+-- Prepares and builds only the targets affected by the changed files named
+-- by the `files` variable, assuming that every other target is up to date.
+-- Set `files` to a comma separated list of files or to '@' followed by the
+-- name of a file listing one changed file per line, e.g. the output of `git
+-- diff --name-only` in `forge affected files=@changed.txt`.  Relative paths
+-- are relative to the root directory.
+function affected()
+    local targets = affected_targets(file_list(files, 'files'));
+    local failures = preorder(targets, prepare_visit) + postorder(targets, build_visit);
+    forge:save();
+    printf("forge: affected=%dms (%d targets)", math.ceil(ticks()), #targets);
+    return failures;
+end
+
+-- Merge action.
+--
+-- Merges the built state from the cache files named by the `files` variable,
+-- e.g. the caches saved by each shard of a sharded build, into the cached 
+-- dependency graph so that a following build only builds what they didn't.
+function merge()
+    local failures = 0;
+    local merged = 0;
+    for _, filename in ipairs(file_list(files, 'files')) do
+        local targets = merge_binary(filename);
+        if targets < 0 then
+            failures = failures + 1;
+        else
+            merged = merged + targets;
+        end
+    end
+    -- Save even when the cached graph was reused as it has now changed.
+    forge.reused = false;
+    forge:save();
+    printf("forge: merge (%d targets)=%dms", merged, math.ceil(ticks()));
+    return failures;
+end
+
 -- Provide global reconfigure command.
 function reconfigure()
     local cache_directory = forge.cache_directory;
@@ -115,8 +231,14 @@ function help()
 Variables:
   goal={goal}        Target to build, default is all.
   variant={variant}  Variant to build, default is debug.
+  reuse=true         Only reload changed buildfiles into the cached graph.
+  shard=k/N          Build only the kth of N shards of the build.
+  keep_going=N       Stop building after N failures, default is 0 (never).
+  checkpoint=N       Save built targets every N seconds, default is 60.
 Commands:
   build              Build outdated targets.
+  affected           Build targets affected by files={files|@list}.
+  merge              Merge cached graphs from files={files|@list}.
   clean              Clean all targets.
   reconfigure        Re-run auto-detected configuration.
   dependencies       Print dependency hierarchy.
@@ -346,11 +468,11 @@ function PatternRule(identifier, identify, pattern)
                     target:set_cleanable(true);
                     target:add_ordering_dependency(toolset:Directory(branch(target)));
                     merge(target, attributes);
+                    target:add_dependency(source_file);
                     local created = target.created;
                     if created then
                         created(toolset, target);
                     end
-                    target:add_dependency(source_file);
                     table.insert(targets, target);
                 end
                 return targets;
@@ -523,7 +645,24 @@ function forge:load(cache_directory)
             self.cache = root('.forge');
         end
         self.loaded = true;
-        load_binary(self.cache);
+        set_bytecode_directory(('%s/.bytecode'):format(branch(self.cache)));
+        local checkpoint = _G.checkpoint or self.local_settings.checkpoint or 60;
+        local checkpoint_jobs = _G.checkpoint_jobs or self.local_settings.checkpoint_jobs or 0;
+        assertf(math.tointeger(tonumber(checkpoint)) and math.tointeger(tonumber(checkpoint_jobs)), 'Set checkpoint and checkpoint_jobs to whole numbers of seconds and jobs, not "%s" and "%s"', tostring(checkpoint), tostring(checkpoint_jobs));
+        set_checkpoint_interval(math.tointeger(tonumber(checkpoint)), math.tointeger(tonumber(checkpoint_jobs)));
+        -- The keep_going variable overrides --fail-fast but the local settings
+        -- only apply when no failure limit has been set already.
+        local keep_going = _G.keep_going;
+        if keep_going == nil and failure_limit() == 0 then
+            keep_going = self.local_settings.keep_going;
+        end
+        if keep_going ~= nil then
+            assertf(math.tointeger(tonumber(keep_going)), 'Set keep_going to the number of failed jobs to stop after or 0 to never stop, not "%s"', tostring(keep_going));
+            set_failure_limit(math.tointeger(tonumber(keep_going)));
+        end
+        local reuse = _G.reuse or self.local_settings.reuse;
+        local _, reused = load_binary(self.cache, reuse == true or reuse == 'true');
+        self.reused = reused;
     end
     return self;
 end
@@ -582,6 +721,34 @@ function forge:save()
         serialize(file, local_settings, 0);
         file:close();
     end
+
+    -- Skip saving a reused dependency graph as it hasn't changed.
+    if self.reused then
+        return;
+    end
+
+    -- Make the local settings and Lua modules dependencies of the cache so
+    -- that changing them prevents the cached dependency graph being reused.
+    local cache_target = find_target(self.cache);
+    if cache_target then
+        local function add_file_dependency(filename)
+            local target = Target(nil, absolute(filename));
+            target:set_filename(target:path());
+            cache_target:add_dependency(target);
+        end
+        local cache_directory = self.cache_directory;
+        local local_settings_filename = cache_directory and root(('%s/local_settings.lua'):format(cache_directory)) or root('local_settings.lua');
+        if exists(local_settings_filename) then
+            add_file_dependency(local_settings_filename);
+        end
+        for name, _ in pairs(package.loaded) do
+            local filename = type(name) == 'string' and package.searchpath(name, package.path);
+            if filename then
+                add_file_dependency(filename);
+            end
+        end
+    end
+
     mkdir(branch(forge.cache));
     save_binary();
 end
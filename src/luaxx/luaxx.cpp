@@ -9,6 +9,7 @@
 #include <algorithm>
 #include <string.h>
 #include <stdlib.h>
+#include <stdio.h>
 
 using std::max;
 using namespace sweet::luaxx;
@@ -41,15 +42,37 @@ const char* TYPE_KEYWORD = "__luaxx_type";
 */
 const char* WEAK_OBJECTS_KEYWORD = "__luaxx_weak_objects";
 
+/**
+// Report an error raised outside of any protected call as `luaL_newstate()`
+// does for the states that it creates.
+*/
+static int luaxx_panic( lua_State* lua_state )
+{
+    const char* message = lua_tostring( lua_state, -1 );
+    fprintf( stderr, "PANIC: unprotected error in call to Lua API (%s)\n", message ? message : "error object is not a string" );
+    fflush( stderr );
+    return 0;
+}
+
 /**
 // Create a new, independent Lua state.
 //
+// @param allocate
+//  The function that the Lua state allocates memory with (defaults to
+//  `luaxx_allocate()`).
+//
+// @param context
+//  The context passed to each call to \e allocate.
+//
 // @return 
 //  The newly created lua_State.
 */
-lua_State* luaxx_newstate()
+lua_State* luaxx_newstate( void* (*allocate)(void*, void*, size_t, size_t), void* context )
 {
-    lua_State* lua_state = luaL_newstate();
+    SWEET_ASSERT( allocate );
+    lua_State* lua_state = lua_newstate( allocate, context );
+    SWEET_ASSERT( lua_state );
+    lua_atpanic( lua_state, &luaxx_panic );
     luaL_openlibs( lua_state );
 
     // Create the weak objects metatable and table.  The metatable is used to 
@@ -15,7 +15,8 @@ extern const char* THIS_KEYWORD;
 extern const char* TYPE_KEYWORD;
 extern const char* WEAK_OBJECTS_KEYWORD;
 
-lua_State* luaxx_newstate();
+void* luaxx_allocate( void* /*context*/, void* ptr, size_t /*osize*/, size_t nsize );
+lua_State* luaxx_newstate( void* (*allocate)(void*, void*, size_t, size_t) = &luaxx_allocate, void* context = nullptr );
 void luaxx_create( lua_State* lua, void* object, const char* tname );
 void luaxx_destroy( lua_State* lua, void* object );
 void luaxx_attach( lua_State* lua, void* object, const char* tname );
@@ -26,7 +27,6 @@ void luaxx_strengthen( lua_State* lua, void* object );
 bool luaxx_push( lua_State* lua, void* object );
 void* luaxx_to( lua_State* lua, int position, const char* tname );
 void* luaxx_check( lua_State* l, int position, const char* tname );
-void* luaxx_allocate( void* /*context*/, void* ptr, size_t /*osize*/, size_t nsize );
 int luaxx_stack_trace_for_call( lua_State* lua );
 const char* luaxx_stack_trace_for_resume( lua_State* lua_state, bool stack_trace_enabled, char* message, int length );
 
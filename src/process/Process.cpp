@@ -4,6 +4,7 @@
 //
 
 #include <stdio.h>
+#include <stdlib.h>
 #include "stdafx.hpp"
 #include "Process.hpp"
 #include "Environment.hpp"
@@ -43,7 +44,9 @@ Process::Process()
   environment_( NULL ),
   start_suspended_( false ),
   inherit_environment_( false ),
+  process_group_( false ),
   pipes_(),
+  mutex_(),
 #if defined(BUILD_OS_WINDOWS)
   process_( INVALID_HANDLE_VALUE ),
   suspended_thread_( INVALID_HANDLE_VALUE ),
@@ -91,12 +94,12 @@ Process::~Process()
 #elif defined(BUILD_OS_MACOS) || defined(BUILD_OS_LINUX)
     if ( process_ != 0 )
     {
-        process_ = 0;
         pid_t result = waitpid( process_, &exit_code_, 0 );
         while ( result < 0 && errno == EINTR )
         {
             result = waitpid( process_, &exit_code_, 0 );
         }
+        process_ = 0;
     }
 
     for ( vector<Pipe>::iterator pipe = pipes_.begin(); pipe != pipes_.end(); ++pipe )
@@ -136,6 +139,24 @@ void Process::inherit_environment( bool inherit_environment )
     inherit_environment_ = inherit_environment;
 }
 
+/**
+// Start this Process in a new process group of its own.
+//
+// Processes in their own process group are terminated along with any 
+// processes that they start in turn (e.g. a compiler driver and the compiler
+// and assembler that it runs) by Process::terminate().  They also no longer
+// receive signals sent to the terminal's foreground process group, e.g. 
+// SIGINT from Ctrl+C.  Ignored on Windows.
+//
+// @param process_group
+//  True to start this Process in its own process group or false to start it
+//  in the process group of the calling process (the default).
+*/
+void Process::process_group( bool process_group )
+{
+    process_group_ = process_group;
+}
+
 /**
 // Create a pipe to communicate with the spawned process.
 //
@@ -333,14 +354,21 @@ void Process::run( const char* arguments )
     // closed on `execve()` due to their `FD_CLOEXEC` flag being set.
     posix_spawnattr_t attributes;
     posix_spawnattr_init( &attributes );
-    posix_spawnattr_setflags( &attributes, POSIX_SPAWN_CLOEXEC_DEFAULT );
+    short flags = POSIX_SPAWN_CLOEXEC_DEFAULT;
 
     if ( start_suspended_ )
     {
-        posix_spawnattr_setflags( &attributes, POSIX_SPAWN_START_SUSPENDED );
+        flags |= POSIX_SPAWN_START_SUSPENDED;
         suspended_ = true;
     }
 
+    if ( process_group_ )
+    {
+        flags |= POSIX_SPAWN_SETPGROUP;
+        posix_spawnattr_setpgroup( &attributes, 0 );
+    }
+    posix_spawnattr_setflags( &attributes, flags );
+
     posix_spawn_file_actions_t file_actions;
     posix_spawn_file_actions_init( &file_actions );
     for ( vector<Pipe>::iterator pipe = pipes_.begin(); pipe != pipes_.end(); ++pipe )
@@ -411,6 +439,11 @@ void Process::run( const char* arguments )
     }
     else if ( process_ == 0 )
     {
+        if ( process_group_ )
+        {
+            setpgid( 0, 0 );
+        }
+
         if ( directory_ )
         {
             int result = chdir( directory_ );
@@ -485,6 +518,14 @@ void Process::run( const char* arguments )
     }
     else
     {
+        // Also set the process group from the parent so that the child is 
+        // in its own process group before Process::terminate() can be 
+        // called no matter which process runs first.
+        if ( process_group_ )
+        {
+            setpgid( process_, process_ );
+        }
+
         // Close write ends of pipes in the parent process.
         for ( vector<Pipe>::iterator pipe = pipes_.begin(); pipe != pipes_.end(); ++pipe )
         {
@@ -556,8 +597,45 @@ void Process::resume()
 #endif
 }
 
+/**
+// Ask this Process to exit or, if \e force is true, kill it.
+//
+// Processes started in their own process group (see 
+// Process::process_group()) are signalled along with the rest of their
+// process group.  Waiting for this Process to finish reports an error that
+// it was terminated by a signal.  Does nothing if this Process isn't
+// running.  On Windows this Process is always terminated immediately.
+//
+// This function may be called from a thread other than the thread that is
+// waiting for this Process to finish.
+//
+// @param force
+//  True to send SIGKILL or false to send SIGTERM.
+*/
+void Process::terminate( bool force )
+{
+    std::unique_lock<std::mutex> lock( mutex_ );
+#if defined(BUILD_OS_WINDOWS)
+    (void) force;
+    if ( process_ != INVALID_HANDLE_VALUE )
+    {
+        ::TerminateProcess( process_, EXIT_FAILURE );
+    }
+#elif defined(BUILD_OS_MACOS) || defined(BUILD_OS_LINUX)
+    if ( process_ > 0 )
+    {
+        kill( process_group_ ? -process_ : process_, force ? SIGKILL : SIGTERM );
+    }
+#endif
+}
+
 /**
 // Wait for this Process to finish.
+//
+// The wait itself is made without holding the lock that Process::terminate()
+// takes.  The handle is only closed, or the process reaped, once that lock
+// is held so that Process::terminate() never signals a closed handle or a
+// reused process identifier.
 */
 void Process::wait()
 {
@@ -572,6 +650,7 @@ void Process::wait()
         SWEET_ERROR( WaitForProcessFailedError("Waiting for a process failed - %s", error) );
     }
 
+    std::unique_lock<std::mutex> lock( mutex_ );
     DWORD exit_code = 0;
     BOOL exited = ::GetExitCodeProcess( process_, &exit_code );
     if ( !exited )
@@ -595,6 +674,14 @@ void Process::wait()
 #elif defined(BUILD_OS_MACOS) || defined(BUILD_OS_LINUX)
     SWEET_ASSERT( process_ != 0 );
 
+    siginfo_t information;
+    int waited = waitid( P_PID, process_, &information, WEXITED | WNOWAIT );
+    while ( waited < 0 && errno == EINTR )
+    {
+        waited = waitid( P_PID, process_, &information, WEXITED | WNOWAIT );
+    }
+
+    std::unique_lock<std::mutex> lock( mutex_ );
     int status = 0;
     pid_t result = waitpid( process_, &status, 0 );
     while ( result >= 0 && !WIFEXITED(status) && !WIFSIGNALED(status) )
@@ -609,6 +696,10 @@ void Process::wait()
         return;
     }
 
+    // The process has been reaped so its identifier may be reused; don't 
+    // signal or wait for it again.
+    process_ = 0;
+
     if ( WIFSIGNALED(status) )
     {
         int signal = WTERMSIG(status);
@@ -620,8 +711,6 @@ void Process::wait()
     {
         exit_code_ = WEXITSTATUS( status );
     }
-
-    process_ = 0;
 #endif
 }
 
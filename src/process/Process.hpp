@@ -2,6 +2,7 @@
 #define SWEET_PROCESS_PROCESS_HPP_INCLUDED
 
 #include <build.hpp>
+#include <mutex>
 #include <vector>
 #include <stdint.h>
 
@@ -43,7 +44,9 @@ class Process
     const Environment* environment_;
     bool start_suspended_;
     bool inherit_environment_;
+    bool process_group_;
     std::vector<Pipe> pipes_;
+    std::mutex mutex_; ///< Guards process_ between Process::terminate() and Process::wait() on different threads.
 #if defined(BUILD_OS_WINDOWS)
     void* process_; ///< The handle to this Process.
     void* suspended_thread_; ///< The handle to the suspended main thread of this Process.
@@ -72,10 +75,12 @@ class Process
         void environment( const Environment* environment );
         void start_suspended( bool start_suspended );
         void inherit_environment( bool inherit_environment );
+        void process_group( bool process_group );
         intptr_t pipe( int child_fd );
         void run( const char* arguments );
 
         void resume();
+        void terminate( bool force );
         void wait();
         int exit_code();
 };